@@ -3,6 +3,8 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  */
+#include <stdarg.h>
+#include <string.h>
 #include <sdkconfig.h>
 
 #define HEAP_TRACE_SRCFILE /* don't warn on inclusion here */
@@ -84,6 +86,37 @@ void heap_trace_dump_caps(__attribute__((unused)) const uint32_t caps)
     return;
 }
 
+#if CONFIG_HEAP_TRACE_SAMPLING
+static int sysview_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int ret = esp_sysview_vprintf(format, args);
+    va_end(args);
+    return ret;
+}
+
+/* SystemView messages are limited to SEGGER_SYSVIEW_MAX_STRING_LEN characters, so longer lines are split */
+static void write_tohost(void *arg, const char *line)
+{
+    const int max_len = 100;
+    for (int len = strlen(line); len > 0; len -= max_len, line += max_len) {
+        sysview_printf("%.*s", len < max_len ? len : max_len, line);
+    }
+}
+
+esp_err_t heap_trace_sampling_dump_tohost(heap_trace_sampling_format_t format)
+{
+    return heap_trace_sampling_write(format, write_tohost, NULL);
+}
+#endif // CONFIG_HEAP_TRACE_SAMPLING
+
+/* Used by heap_trace.inc to skip reading the call stack when nothing is recorded */
+static HEAP_IRAM_ATTR bool is_tracing(void)
+{
+    return s_tracing;
+}
+
 /* Add a new allocation to the heap trace records */
 static HEAP_IRAM_ATTR void record_allocation(const heap_trace_record_t *record)
 {
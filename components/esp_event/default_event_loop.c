@@ -100,7 +100,8 @@ esp_err_t esp_event_loop_create_default(void)
         .task_name = "sys_evt",
         .task_stack_size = ESP_TASKD_EVENT_STACK,
         .task_priority = ESP_TASKD_EVENT_PRIO,
-        .task_core_id = 0
+        .task_core_id = 0,
+        .data_slot_size = CONFIG_ESP_EVENT_DEFAULT_LOOP_DATA_SLOT_SIZE
     };
 
     esp_err_t err;
@@ -142,18 +142,11 @@ static void handler_execute(esp_event_loop_instance_t* loop, esp_event_handler_n
 
     xSemaphoreTake(loop->profiling_mutex, portMAX_DELAY);
 
-    // At this point handler may be already unregistered.
-    // This happens in "handler instance can unregister itself" test case.
-    // To prevent memory corruption error it's necessary to check if pointer is still valid.
-    esp_event_loop_node_t* loop_node;
-    esp_event_handler_node_t* handler_node;
-    SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
-        SLIST_FOREACH(handler_node, &(loop_node->handlers), next) {
-            if (handler_node == handler) {
-                handler->invoked++;
-                handler->time += diff;
-            }
-        }
+    // At this point handler may be already unregistered, e.g. by itself. It is only freed once the
+    // dispatch finishes, but is no longer listed and its statistics don't matter.
+    if (!handler->removed) {
+        handler->invoked++;
+        handler->time += diff;
     }
 
     xSemaphoreGive(loop->profiling_mutex);
@@ -316,7 +309,52 @@ static esp_err_t loop_node_add_handler(esp_event_loop_node_t* loop_node,
     }
 }
 
-static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+// Whether a dispatch in progress can still execute a handler which has been unregistered
+static bool handler_node_in_use(esp_event_loop_instance_t* loop, esp_event_handler_node_t* handler)
+{
+    if (loop->dispatching) {
+        return true;
+    }
+
+    // Workers only execute handlers resolved before their dispatch started
+    for (uint32_t i = 0; i < loop->workers_count; i++) {
+        uint32_t seq = loop->workers[i].dispatch_seq;
+        if (seq != 0 && (int32_t)(seq - handler->removed_seq) <= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void handler_node_free(esp_event_loop_instance_t* loop, esp_event_handler_node_t* handler)
+{
+    // Handlers may unregister themselves or other handlers of the event being dispatched, and on loops run by
+    // more than one task, handlers being executed by other workers. These can still be referenced by the
+    // dispatch. They are skipped and only freed once the dispatches referencing them finish.
+    handler->removed = true;
+    handler->removed_seq = loop->dispatch_seq;
+
+    if (handler_node_in_use(loop, handler)) {
+        SLIST_INSERT_HEAD(&(loop->removed_handlers), handler, next_removed);
+    } else {
+        free(handler->handler_ctx);
+        free(handler);
+    }
+}
+
+static void handlers_free_removed(esp_event_loop_instance_t* loop)
+{
+    esp_event_handler_node_t *it, *temp;
+    SLIST_FOREACH_SAFE(it, &(loop->removed_handlers), next_removed, temp) {
+        if (!handler_node_in_use(loop, it)) {
+            SLIST_REMOVE(&(loop->removed_handlers), it, esp_event_handler_node, next_removed);
+            free(it->handler_ctx);
+            free(it);
+        }
+    }
+}
+
+static esp_err_t handler_instances_remove(esp_event_loop_instance_t* loop, esp_event_handler_nodes_t* handlers, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
 {
     esp_event_handler_node_t *it, *temp;
 
@@ -324,15 +362,13 @@ static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, e
         if (legacy) {
             if (it->handler_ctx->handler == handler_ctx->handler) {
                 SLIST_REMOVE(handlers, it, esp_event_handler_node, next);
-                free(it->handler_ctx);
-                free(it);
+                handler_node_free(loop, it);
                 return ESP_OK;
             }
         } else {
             if (it->handler_ctx == handler_ctx) {
                 SLIST_REMOVE(handlers, it, esp_event_handler_node, next);
-                free(it->handler_ctx);
-                free(it);
+                handler_node_free(loop, it);
                 return ESP_OK;
             }
         }
@@ -341,15 +377,15 @@ static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, e
     return ESP_ERR_NOT_FOUND;
 }
 
-static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+static esp_err_t base_node_remove_handler(esp_event_loop_instance_t* loop, esp_event_base_node_t* base_node, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
 {
     if (id == ESP_EVENT_ANY_ID) {
-        return handler_instances_remove(&(base_node->handlers), handler_ctx, legacy);
+        return handler_instances_remove(loop, &(base_node->handlers), handler_ctx, legacy);
     } else {
         esp_event_id_node_t *it, *temp;
         SLIST_FOREACH_SAFE(it, &(base_node->id_nodes), next, temp) {
             if (it->id == id) {
-                esp_err_t res = handler_instances_remove(&(it->handlers), handler_ctx, legacy);
+                esp_err_t res = handler_instances_remove(loop, &(it->handlers), handler_ctx, legacy);
 
                 if (res == ESP_OK) {
                     if (SLIST_EMPTY(&(it->handlers))) {
@@ -365,15 +401,15 @@ static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int3
     return ESP_ERR_NOT_FOUND;
 }
 
-static esp_err_t loop_node_remove_handler(esp_event_loop_node_t* loop_node, esp_event_base_t base, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+static esp_err_t loop_node_remove_handler(esp_event_loop_instance_t* loop, esp_event_loop_node_t* loop_node, esp_event_base_t base, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
 {
     if (base == esp_event_any_base && id == ESP_EVENT_ANY_ID) {
-        return handler_instances_remove(&(loop_node->handlers), handler_ctx, legacy);
+        return handler_instances_remove(loop, &(loop_node->handlers), handler_ctx, legacy);
     } else {
         esp_event_base_node_t *it, *temp;
         SLIST_FOREACH_SAFE(it, &(loop_node->base_nodes), next, temp) {
             if (it->base == base) {
-                esp_err_t res = base_node_remove_handler(it, id, handler_ctx, legacy);
+                esp_err_t res = base_node_remove_handler(loop, it, id, handler_ctx, legacy);
 
                 if (res == ESP_OK) {
                     if (SLIST_EMPTY(&(it->handlers)) && SLIST_EMPTY(&(it->id_nodes))) {
@@ -389,54 +425,615 @@ static esp_err_t loop_node_remove_handler(esp_event_loop_node_t* loop_node, esp_
     return ESP_ERR_NOT_FOUND;
 }
 
-static void handler_instances_remove_all(esp_event_handler_nodes_t* handlers)
+static void handler_instances_remove_all(esp_event_loop_instance_t* loop, esp_event_handler_nodes_t* handlers)
 {
     esp_event_handler_node_t *it, *temp;
     SLIST_FOREACH_SAFE(it, handlers, next, temp) {
         SLIST_REMOVE(handlers, it, esp_event_handler_node, next);
-        free(it->handler_ctx);
-        free(it);
+        handler_node_free(loop, it);
     }
 }
 
-static void base_node_remove_all_handler(esp_event_base_node_t* base_node)
+static void base_node_remove_all_handler(esp_event_loop_instance_t* loop, esp_event_base_node_t* base_node)
 {
-    handler_instances_remove_all(&(base_node->handlers));
+    handler_instances_remove_all(loop, &(base_node->handlers));
 
     esp_event_id_node_t *it, *temp;
     SLIST_FOREACH_SAFE(it, &(base_node->id_nodes), next, temp) {
-        handler_instances_remove_all(&(it->handlers));
+        handler_instances_remove_all(loop, &(it->handlers));
         SLIST_REMOVE(&(base_node->id_nodes), it, esp_event_id_node, next);
         free(it);
     }
 }
 
-static void loop_node_remove_all_handler(esp_event_loop_node_t* loop_node)
+static void loop_node_remove_all_handler(esp_event_loop_instance_t* loop, esp_event_loop_node_t* loop_node)
 {
-    handler_instances_remove_all(&(loop_node->handlers));
+    handler_instances_remove_all(loop, &(loop_node->handlers));
 
     esp_event_base_node_t *it, *temp;
     SLIST_FOREACH_SAFE(it, &(loop_node->base_nodes), next, temp) {
-        base_node_remove_all_handler(it);
+        base_node_remove_all_handler(loop, it);
         SLIST_REMOVE(&(loop_node->base_nodes), it, esp_event_base_node, next);
         free(it);
     }
 }
 
-static void inline __attribute__((always_inline)) post_instance_delete(esp_event_post_instance_t* post)
+static inline __attribute__((always_inline)) uint32_t dispatch_hash(esp_event_base_t base, int32_t id)
+{
+    uint32_t hash = (uint32_t) (uintptr_t) base * 0x9E3779B1U + (uint32_t) id * 0x85EBCA77U;
+    return hash ^ (hash >> 16);
+}
+
+static esp_event_dispatch_entries_t* dispatch_bucket(esp_event_dispatch_table_t* table, esp_event_base_t base, int32_t id)
+{
+    return &(table->buckets[dispatch_hash(base, id) & (table->buckets_count - 1)]);
+}
+
+static esp_event_dispatch_entry_t* dispatch_entry_find(esp_event_dispatch_table_t* table, esp_event_base_t base, int32_t id)
+{
+    if (table->buckets_count == 0) {
+        return NULL;
+    }
+
+    esp_event_dispatch_entry_t* entry;
+    SLIST_FOREACH(entry, dispatch_bucket(table, base, id), next) {
+        if (entry->base == base && entry->id == id) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void dispatch_table_grow(esp_event_dispatch_table_t* table)
+{
+    uint32_t buckets_count = table->buckets_count ? table->buckets_count * 2 : 8;
+    esp_event_dispatch_entries_t* buckets = calloc(buckets_count, sizeof(*buckets));
+    if (buckets == NULL) {
+        // Keep the current buckets, lookups only get slower
+        return;
+    }
+
+    esp_event_dispatch_entries_t* old_buckets = table->buckets;
+    uint32_t old_buckets_count = table->buckets_count;
+    table->buckets = buckets;
+    table->buckets_count = buckets_count;
+
+    for (uint32_t i = 0; i < old_buckets_count; i++) {
+        esp_event_dispatch_entry_t* entry;
+        while ((entry = SLIST_FIRST(&(old_buckets[i]))) != NULL) {
+            SLIST_REMOVE_HEAD(&(old_buckets[i]), next);
+            SLIST_INSERT_HEAD(dispatch_bucket(table, entry->base, entry->id), entry, next);
+        }
+    }
+    free(old_buckets);
+}
+
+// Adds an entry for events of the base and id a handler is registered to. ESP_EVENT_ANY_ID as id adds the entry
+// for events of the base with ids which have no entry of their own.
+static esp_err_t dispatch_entry_add(esp_event_dispatch_table_t* table, esp_event_base_t base, int32_t id)
+{
+    if (dispatch_entry_find(table, base, id) != NULL) {
+        return ESP_OK;
+    }
+
+    if (table->entries_count >= table->buckets_count) {
+        dispatch_table_grow(table);
+        if (table->buckets_count == 0) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_event_dispatch_entry_t* entry = calloc(1, sizeof(*entry));
+    if (entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Generation 0 is never current, the handlers are resolved on first use
+    entry->base = base;
+    entry->id = id;
+    SLIST_INSERT_HEAD(dispatch_bucket(table, base, id), entry, next);
+    table->entries_count++;
+    return ESP_OK;
+}
+
+static void dispatch_handlers_release(esp_event_dispatch_handlers_t* handlers)
+{
+    if (handlers != NULL && --handlers->refs == 0) {
+        free(handlers);
+    }
+}
+
+static void dispatch_entry_remove(esp_event_dispatch_table_t* table, esp_event_dispatch_entry_t* entry)
+{
+    SLIST_REMOVE(dispatch_bucket(table, entry->base, entry->id), entry, esp_event_dispatch_entry, next);
+    table->entries_count--;
+    dispatch_handlers_release(entry->handlers);
+    free(entry);
+}
+
+static void dispatch_table_init(esp_event_dispatch_table_t* table)
+{
+    table->generation = 1;
+    table->loop_entry.base = esp_event_any_base;
+    table->loop_entry.id = ESP_EVENT_ANY_ID;
+}
+
+static void dispatch_table_invalidate(esp_event_dispatch_table_t* table)
+{
+    if (++table->generation == 0) {
+        table->generation = 1;
+    }
+}
+
+static void dispatch_table_free(esp_event_dispatch_table_t* table)
+{
+    for (uint32_t i = 0; i < table->buckets_count; i++) {
+        esp_event_dispatch_entry_t* entry;
+        while ((entry = SLIST_FIRST(&(table->buckets[i]))) != NULL) {
+            SLIST_REMOVE_HEAD(&(table->buckets[i]), next);
+            dispatch_handlers_release(entry->handlers);
+            free(entry);
+        }
+    }
+    free(table->buckets);
+    dispatch_handlers_release(table->loop_entry.handlers);
+}
+
+static bool dispatch_entry_append(esp_event_dispatch_entry_t* entry, esp_event_handler_node_t* handler)
+{
+    esp_event_dispatch_handlers_t* handlers = entry->handlers;
+    if (handlers == NULL || handlers->count == handlers->size) {
+        uint32_t size = handlers ? handlers->size * 2 : 4;
+        handlers = realloc(handlers, sizeof(*handlers) + size * sizeof(handlers->nodes[0]));
+        if (handlers == NULL) {
+            return false;
+        }
+        if (entry->handlers == NULL) {
+            handlers->refs = 1;
+            handlers->count = 0;
+        }
+        handlers->size = size;
+        entry->handlers = handlers;
+    }
+    handlers->nodes[handlers->count++] = handler;
+    return true;
+}
+
+// Collects the handlers of the entry's event in the order a walk of the handler lists executes them.
+// own_handlers is set to the number of handlers registered to exactly the base and id of the entry.
+static esp_err_t dispatch_entry_resolve(esp_event_loop_instance_t* loop, esp_event_dispatch_entry_t* entry, uint32_t* own_handlers)
+{
+    esp_event_handler_node_t *handler;
+    esp_event_loop_node_t *loop_node;
+    esp_event_base_node_t *base_node;
+    esp_event_id_node_t *id_node;
+
+    // Handlers still executed by a worker are left to it, the entry gets new ones
+    if (entry->handlers != NULL && entry->handlers->refs > 1) {
+        dispatch_handlers_release(entry->handlers);
+        entry->handlers = NULL;
+    }
+    if (entry->handlers != NULL) {
+        entry->handlers->count = 0;
+    }
+    *own_handlers = 0;
+
+    SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+        SLIST_FOREACH(handler, &(loop_node->handlers), next) {
+            if (!dispatch_entry_append(entry, handler)) {
+                return ESP_ERR_NO_MEM;
+            }
+        }
+
+        SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+            if (base_node->base == entry->base) {
+                SLIST_FOREACH(handler, &(base_node->handlers), next) {
+                    if (!dispatch_entry_append(entry, handler)) {
+                        return ESP_ERR_NO_MEM;
+                    }
+                    *own_handlers += (entry->id == ESP_EVENT_ANY_ID);
+                }
+
+                SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                    if (id_node->id == entry->id) {
+                        SLIST_FOREACH(handler, &(id_node->handlers), next) {
+                            if (!dispatch_entry_append(entry, handler)) {
+                                return ESP_ERR_NO_MEM;
+                            }
+                            (*own_handlers)++;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    entry->generation = loop->dispatch_table.generation;
+    return ESP_OK;
+}
+
+// Brings an entry found in the table up to date with the handler lists. An entry without handlers registered
+// to its own base and id is removed and set to NULL, the event then falls back to the next entry.
+static esp_err_t dispatch_entry_update(esp_event_loop_instance_t* loop, esp_event_dispatch_entry_t** entry)
+{
+    esp_event_dispatch_table_t* table = &(loop->dispatch_table);
+
+    if (*entry == NULL || (*entry)->generation == table->generation) {
+        return ESP_OK;
+    }
+
+    uint32_t own_handlers;
+    esp_err_t err = dispatch_entry_resolve(loop, *entry, &own_handlers);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (own_handlers == 0 && *entry != &(table->loop_entry)) {
+        dispatch_entry_remove(table, *entry);
+        *entry = NULL;
+    }
+    return ESP_OK;
+}
+
+// Returns the handlers to execute for an event: those of its id if any handler is registered to it, otherwise
+// those of its base, otherwise the loop level handlers. Returns NULL if the handlers can't be resolved for
+// lack of memory.
+static esp_event_dispatch_entry_t* dispatch_entry_get(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id)
+{
+    esp_event_dispatch_table_t* table = &(loop->dispatch_table);
+    esp_event_dispatch_entry_t* entry = dispatch_entry_find(table, base, id);
+
+    if (dispatch_entry_update(loop, &entry) != ESP_OK) {
+        return NULL;
+    }
+
+    if (entry == NULL) {
+        entry = dispatch_entry_find(table, base, ESP_EVENT_ANY_ID);
+        if (dispatch_entry_update(loop, &entry) != ESP_OK) {
+            return NULL;
+        }
+    }
+
+    if (entry == NULL) {
+        entry = &(table->loop_entry);
+        if (dispatch_entry_update(loop, &entry) != ESP_OK) {
+            return NULL;
+        }
+    }
+
+    return entry;
+}
+
+static esp_err_t data_slots_create(esp_event_loop_instance_t* loop, uint32_t slot_size, uint32_t slot_count)
+{
+    // Keep the slots aligned like heap allocations, the bitmap follows the slots
+    slot_size = (slot_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    uint32_t bitmap_words = (slot_count + 31) / 32;
+
+    loop->data_slots = calloc(1, slot_size * slot_count + bitmap_words * sizeof(atomic_uint_least32_t));
+    if (loop->data_slots == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    loop->data_slots_used = (atomic_uint_least32_t*) (loop->data_slots + slot_size * slot_count);
+    loop->data_slot_size = slot_size;
+    loop->data_slot_count = slot_count;
+
+    // Bits past the last slot are marked as used, so they are never handed out
+    for (uint32_t i = 0; i < bitmap_words; i++) {
+        uint32_t valid = slot_count - i * 32;
+        atomic_init(&loop->data_slots_used[i], valid >= 32 ? 0 : ~((1U << valid) - 1));
+    }
+    return ESP_OK;
+}
+
+// The slots are claimed and released with atomic operations only, so this is safe to call from ISRs
+// and tasks posting to the loop at the same time.
+static inline __attribute__((always_inline)) void* data_slot_alloc(esp_event_loop_instance_t* loop, size_t size)
+{
+    if (loop->data_slots == NULL || size > loop->data_slot_size) {
+        return NULL;
+    }
+
+    uint32_t bitmap_words = (loop->data_slot_count + 31) / 32;
+    for (uint32_t i = 0; i < bitmap_words; i++) {
+        uint32_t used = atomic_load(&loop->data_slots_used[i]);
+        while (used != UINT32_MAX) {
+            uint32_t bit = ~used & (used + 1);
+            if (atomic_compare_exchange_weak(&loop->data_slots_used[i], &used, used | bit)) {
+                uint32_t index = i * 32;
+                while (bit >>= 1) {
+                    index++;
+                }
+                return loop->data_slots + index * loop->data_slot_size;
+            }
+        }
+    }
+    return NULL;
+}
+
+static inline __attribute__((always_inline)) bool data_slot_free(esp_event_loop_instance_t* loop, void* ptr)
+{
+    uint8_t* slot = (uint8_t*) ptr;
+    if (slot < loop->data_slots || slot >= loop->data_slots + loop->data_slot_size * loop->data_slot_count) {
+        return false;
+    }
+
+    uint32_t index = (slot - loop->data_slots) / loop->data_slot_size;
+    atomic_fetch_and(&loop->data_slots_used[index / 32], ~(1U << (index % 32)));
+    return true;
+}
+
+static void inline __attribute__((always_inline)) post_instance_delete(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post)
 {
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
-    if (post->data_allocated && post->data.ptr) {
+    if (post->data_allocated && post->data.ptr && !data_slot_free(loop, post->data.ptr)) {
         free(post->data.ptr);
     }
 #else
-    if (post->data) {
+    if (post->data && !data_slot_free(loop, post->data)) {
         free(post->data);
     }
 #endif
     memset(post, 0, sizeof(*post));
 }
 
+// Executes the handlers of a worker with the loop mutex released, so that the workers of a loop execute
+// handlers in parallel. The handlers are kept, and those unregistered meanwhile not freed, until it finishes.
+static bool post_dispatch_unlocked(esp_event_loop_instance_t* loop, esp_event_loop_worker_t* worker,
+                                   esp_event_dispatch_handlers_t* handlers, esp_event_post_instance_t post)
+{
+    bool exec = false;
+
+    if (handlers == NULL) {
+        return exec;
+    }
+
+    handlers->refs++;
+    if (++loop->dispatch_seq == 0) {
+        loop->dispatch_seq = 1;
+    }
+    worker->dispatch_seq = loop->dispatch_seq;
+
+    xSemaphoreGiveRecursive(loop->mutex);
+
+    for (uint32_t i = 0; i < handlers->count; i++) {
+        esp_event_handler_node_t* handler = handlers->nodes[i];
+        if (!handler->removed) {
+            handler_execute(loop, handler, post);
+            exec |= true;
+        }
+    }
+
+    xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
+
+    worker->dispatch_seq = 0;
+    dispatch_handlers_release(handlers);
+    handlers_free_removed(loop);
+
+    return exec;
+}
+
+// On event lookup performance: The library keeps the registered handlers in linked lists, which have O(n)
+// lookup time in the number of registered bases and ids. Events are therefore dispatched through a hash table
+// keyed by (base, id), whose entries hold the handlers to execute in order. An entry is resolved from the lists
+// on first use after the handlers changed, with the handlers of ESP_EVENT_ANY_BASE and ESP_EVENT_ANY_ID included,
+// so dispatching an event only walks the lists again after a registration or unregistration.
+//
+// Executes the handlers of a post, called and returning with the loop mutex held. worker is NULL unless the loop is
+// run by more than one task.
+static bool post_dispatch(esp_event_loop_instance_t* loop, esp_event_loop_worker_t* worker, esp_event_post_instance_t post)
+{
+    bool exec = false;
+
+    esp_event_handler_node_t *handler, *temp_handler;
+    esp_event_loop_node_t *loop_node, *temp_node;
+    esp_event_base_node_t *base_node, *temp_base;
+    esp_event_id_node_t *id_node, *temp_id_node;
+
+    esp_event_dispatch_entry_t* entry = NULL;
+    if (!loop->dispatch_table.disabled) {
+        entry = dispatch_entry_get(loop, post.base, post.id);
+    }
+
+    if (worker != NULL && entry != NULL) {
+        return post_dispatch_unlocked(loop, worker, entry->handlers, post);
+    }
+
+    // Handlers unregistered from here on are skipped and freed once all handlers have run
+    loop->dispatching = true;
+
+    if (entry != NULL) {
+        esp_event_dispatch_handlers_t* handlers = entry->handlers;
+        for (uint32_t i = 0; handlers != NULL && i < handlers->count; i++) {
+            handler = handlers->nodes[i];
+            if (!handler->removed) {
+                handler_execute(loop, handler, post);
+                exec |= true;
+            }
+        }
+    } else {
+        // Without the dispatch table, walk the handler lists
+        SLIST_FOREACH_SAFE(loop_node, &(loop->loop_nodes), next, temp_node) {
+            // Execute loop level handlers
+            SLIST_FOREACH_SAFE(handler, &(loop_node->handlers), next, temp_handler) {
+                if (!handler->removed) {
+                    handler_execute(loop, handler, post);
+                    exec |= true;
+                }
+            }
+
+            SLIST_FOREACH_SAFE(base_node, &(loop_node->base_nodes), next, temp_base) {
+                if (base_node->base == post.base) {
+                    // Execute base level handlers
+                    SLIST_FOREACH_SAFE(handler, &(base_node->handlers), next, temp_handler) {
+                        if (!handler->removed) {
+                            handler_execute(loop, handler, post);
+                            exec |= true;
+                        }
+                    }
+
+                    SLIST_FOREACH_SAFE(id_node, &(base_node->id_nodes), next, temp_id_node) {
+                        if (id_node->id == post.id) {
+                            // Execute id level handlers
+                            SLIST_FOREACH_SAFE(handler, &(id_node->handlers), next, temp_handler) {
+                                if (!handler->removed) {
+                                    handler_execute(loop, handler, post);
+                                    exec |= true;
+                                }
+                            }
+                            // Skip to next base node
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    loop->dispatching = false;
+    handlers_free_removed(loop);
+
+    return exec;
+}
+
+static inline __attribute__((always_inline)) esp_event_loop_worker_t* loop_worker_get(esp_event_loop_instance_t* loop,
+                                                                                   esp_event_base_t base, int32_t id)
+{
+    if (loop->workers_order == ESP_EVENT_LOOP_ORDER_BASE) {
+        id = 0;
+    }
+    return &(loop->workers[dispatch_hash(base, id) % loop->workers_count]);
+}
+
+// Whether the calling task is one of the workers of the loop
+static bool loop_worker_is_current(esp_event_loop_instance_t* loop)
+{
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    for (uint32_t i = 0; i < loop->workers_count; i++) {
+        if (loop->workers[i].task == current) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void esp_event_loop_run_worker(void* args)
+{
+    esp_event_loop_worker_t* worker = (esp_event_loop_worker_t*) args;
+    esp_event_loop_instance_t* loop = worker->loop;
+    esp_event_post_instance_t post;
+
+    ESP_LOGD(TAG, "running worker %p for loop %p", worker, loop);
+
+    while (1) {
+        if (xQueueReceive(worker->queue, &post, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // A post without base asks the worker to exit, the loop may be gone right after it is acknowledged
+        if (post.base == NULL) {
+            ESP_LOGD(TAG, "stopping worker %p for loop %p", worker, loop);
+            xSemaphoreGive(loop->workers_stopped);
+            vTaskDelete(NULL);
+        }
+
+        xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
+
+        bool exec = post_dispatch(loop, worker, post);
+
+        esp_event_base_t base = post.base;
+        int32_t id = post.id;
+
+        post_instance_delete(loop, &post);
+
+        xSemaphoreGiveRecursive(loop->mutex);
+
+        if (!exec) {
+            ESP_LOGD(TAG, "no handlers have been registered for event %s:%"PRIu32" posted to loop %p", base, id, loop);
+        }
+    }
+}
+
+static esp_err_t loop_workers_create(esp_event_loop_instance_t* loop, const esp_event_loop_args_t* event_loop_args)
+{
+    loop->workers = calloc(event_loop_args->task_count, sizeof(*(loop->workers)));
+    if (loop->workers == NULL) {
+        ESP_LOGE(TAG, "alloc for event loop workers failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    loop->workers_count = event_loop_args->task_count;
+    loop->workers_order = event_loop_args->task_order;
+
+    for (uint32_t i = 0; i < loop->workers_count; i++) {
+        loop->workers[i].loop = loop;
+        loop->workers[i].queue = xQueueCreate(event_loop_args->queue_size, sizeof(esp_event_post_instance_t));
+        if (loop->workers[i].queue == NULL) {
+            ESP_LOGE(TAG, "create event loop queue failed");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t loop_workers_start(esp_event_loop_instance_t* loop, const esp_event_loop_args_t* event_loop_args)
+{
+    for (uint32_t i = 0; i < loop->workers_count; i++) {
+        BaseType_t core_id = event_loop_args->task_pin_per_core ? (BaseType_t)(i % configNUMBER_OF_CORES) :
+                             event_loop_args->task_core_id;
+        BaseType_t task_created = xTaskCreatePinnedToCore(esp_event_loop_run_worker, event_loop_args->task_name,
+                                                          event_loop_args->task_stack_size, (void*) &(loop->workers[i]),
+                                                          event_loop_args->task_priority, &(loop->workers[i].task), core_id);
+        if (task_created != pdPASS) {
+            ESP_LOGE(TAG, "create task for loop failed");
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+// Lets the workers finish the events they are handling and exit. Deleting them instead could interrupt them
+// anywhere in a handler or in between.
+static void loop_workers_stop(esp_event_loop_instance_t* loop)
+{
+    StaticSemaphore_t workers_stopped_buffer;
+    loop->workers_stopped = xSemaphoreCreateCountingStatic(loop->workers_count, 0, &workers_stopped_buffer);
+
+    esp_event_post_instance_t stop = { 0 };
+    uint32_t started = 0;
+    for (uint32_t i = 0; i < loop->workers_count; i++) {
+        if (loop->workers[i].task != NULL) {
+            xQueueSendToFront(loop->workers[i].queue, &stop, portMAX_DELAY);
+            loop->workers[i].task = NULL;
+            started++;
+        }
+    }
+
+    while (started-- > 0) {
+        xSemaphoreTake(loop->workers_stopped, portMAX_DELAY);
+    }
+    vSemaphoreDelete(loop->workers_stopped);
+    loop->workers_stopped = NULL;
+}
+
+static void loop_workers_delete(esp_event_loop_instance_t* loop)
+{
+    for (uint32_t i = 0; i < loop->workers_count; i++) {
+        esp_event_loop_worker_t* worker = &(loop->workers[i]);
+        if (worker->queue != NULL) {
+            esp_event_post_instance_t post;
+            while (xQueueReceive(worker->queue, &post, 0) == pdTRUE) {
+                post_instance_delete(loop, &post);
+            }
+            vQueueDelete(worker->queue);
+        }
+    }
+    free(loop->workers);
+    loop->workers = NULL;
+    loop->workers_count = 0;
+}
+
 /* ---------------------------- Public API --------------------------------- */
 
 esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, esp_event_loop_handle_t* event_loop)
@@ -460,10 +1057,18 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
         return err;
     }
 
-    loop->queue = xQueueCreate(event_loop_args->queue_size, sizeof(esp_event_post_instance_t));
-    if (loop->queue == NULL) {
-        ESP_LOGE(TAG, "create event loop queue failed");
-        goto on_err;
+    // A loop run by more than one task has a queue for each task instead of one for the loop
+    bool has_workers = event_loop_args->task_name != NULL && event_loop_args->task_count > 1;
+    if (has_workers) {
+        if (loop_workers_create(loop, event_loop_args) != ESP_OK) {
+            goto on_err;
+        }
+    } else {
+        loop->queue = xQueueCreate(event_loop_args->queue_size, sizeof(esp_event_post_instance_t));
+        if (loop->queue == NULL) {
+            ESP_LOGE(TAG, "create event loop queue failed");
+            goto on_err;
+        }
     }
 
     loop->mutex = xSemaphoreCreateRecursiveMutex();
@@ -472,6 +1077,15 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
         goto on_err;
     }
 
+    // One slot more than each queue holds, for the post being handled while the queue is full
+    if (event_loop_args->data_slot_size > 0) {
+        uint32_t slot_count = (event_loop_args->queue_size + 1) * (has_workers ? loop->workers_count : 1);
+        if (data_slots_create(loop, event_loop_args->data_slot_size, slot_count) != ESP_OK) {
+            ESP_LOGE(TAG, "alloc for event data slots failed");
+            goto on_err;
+        }
+    }
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     loop->profiling_mutex = xSemaphoreCreateMutex();
     if (loop->profiling_mutex == NULL) {
@@ -481,9 +1095,21 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
 #endif
 
     SLIST_INIT(&(loop->loop_nodes));
+    SLIST_INIT(&(loop->removed_handlers));
+    dispatch_table_init(&(loop->dispatch_table));
 
     // Create the loop task if requested
-    if (event_loop_args->task_name != NULL) {
+    if (has_workers) {
+        err = loop_workers_start(loop, event_loop_args);
+        if (err != ESP_OK) {
+            goto on_err;
+        }
+
+        loop->name = event_loop_args->task_name;
+        loop->task = NULL;
+
+        ESP_LOGD(TAG, "created %"PRIu32" tasks for loop %p", loop->workers_count, loop);
+    } else if (event_loop_args->task_name != NULL) {
         BaseType_t task_created = xTaskCreatePinnedToCore(esp_event_loop_run_task, event_loop_args->task_name,
                                                           event_loop_args->task_stack_size, (void*) loop,
                                                           event_loop_args->task_priority, &(loop->task), event_loop_args->task_core_id);
@@ -517,6 +1143,11 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
     return ESP_OK;
 
 on_err:
+    if (loop->workers != NULL) {
+        loop_workers_stop(loop);
+        loop_workers_delete(loop);
+    }
+
     if (loop->queue != NULL) {
         vQueueDelete(loop->queue);
     }
@@ -525,6 +1156,8 @@ on_err:
         vSemaphoreDelete(loop->mutex);
     }
 
+    free(loop->data_slots);
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     if (loop->profiling_mutex != NULL) {
         vSemaphoreDelete(loop->profiling_mutex);
@@ -536,12 +1169,6 @@ on_err:
     return err;
 }
 
-// On event lookup performance: The library implements the event list as a linked list, which results to O(n)
-// lookup time. The test comparing this implementation to the O(lg n) performance of rbtrees
-// (https://github.com/freebsd/freebsd/blob/master/sys/sys/tree.h)
-// indicate that the difference is not that substantial, especially considering the additional
-// pointers per node of rbtrees. Code for the rbtree implementation of the event loop library is archived
-// in feature/esp_event_loop_library_rbtrees if needed.
 esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t ticks_to_run)
 {
     assert(event_loop);
@@ -557,53 +1184,23 @@ esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t tick
     int64_t remaining_ticks = ticks_to_run;
 #endif
 
+    if (loop->workers != NULL) {
+        ESP_LOGE(TAG, "loop %p is run by its tasks", event_loop);
+        return ESP_ERR_INVALID_STATE;
+    }
+
     while (xQueueReceive(loop->queue, &post, ticks_to_run) == pdTRUE) {
         // The event has already been unqueued, so ensure it gets executed.
         xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
 
         loop->running_task = xTaskGetCurrentTaskHandle();
 
-        bool exec = false;
-
-        esp_event_handler_node_t *handler, *temp_handler;
-        esp_event_loop_node_t *loop_node, *temp_node;
-        esp_event_base_node_t *base_node, *temp_base;
-        esp_event_id_node_t *id_node, *temp_id_node;
-
-        SLIST_FOREACH_SAFE(loop_node, &(loop->loop_nodes), next, temp_node) {
-            // Execute loop level handlers
-            SLIST_FOREACH_SAFE(handler, &(loop_node->handlers), next, temp_handler) {
-                handler_execute(loop, handler, post);
-                exec |= true;
-            }
-
-            SLIST_FOREACH_SAFE(base_node, &(loop_node->base_nodes), next, temp_base) {
-                if (base_node->base == post.base) {
-                    // Execute base level handlers
-                    SLIST_FOREACH_SAFE(handler, &(base_node->handlers), next, temp_handler) {
-                        handler_execute(loop, handler, post);
-                        exec |= true;
-                    }
-
-                    SLIST_FOREACH_SAFE(id_node, &(base_node->id_nodes), next, temp_id_node) {
-                        if (id_node->id == post.id) {
-                            // Execute id level handlers
-                            SLIST_FOREACH_SAFE(handler, &(id_node->handlers), next, temp_handler) {
-                                handler_execute(loop, handler, post);
-                                exec |= true;
-                            }
-                            // Skip to next base node
-                            break;
-                        }
-                    }
-                }
-            }
-        }
+        bool exec = post_dispatch(loop, NULL, post);
 
         esp_event_base_t base = post.base;
         int32_t id = post.id;
 
-        post_instance_delete(&post);
+        post_instance_delete(loop, &post);
 
         if (ticks_to_run != portMAX_DELAY) {
             end = xTaskGetTickCount();
@@ -641,6 +1238,11 @@ esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
     SemaphoreHandle_t loop_profiling_mutex = loop->profiling_mutex;
 #endif
 
+    // Workers need the mutex to finish the events they are handling
+    if (loop->workers != NULL) {
+        loop_workers_stop(loop);
+    }
+
     xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
@@ -655,22 +1257,31 @@ esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
         vTaskDelete(loop->task);
     }
 
+    // Delete the queues of the workers along with the posts on them
+    if (loop->workers != NULL) {
+        loop_workers_delete(loop);
+    }
+
     // Remove all registered events and handlers in the loop
     esp_event_loop_node_t *it, *temp;
     SLIST_FOREACH_SAFE(it, &(loop->loop_nodes), next, temp) {
-        loop_node_remove_all_handler(it);
+        loop_node_remove_all_handler(loop, it);
         SLIST_REMOVE(&(loop->loop_nodes), it, esp_event_loop_node, next);
         free(it);
     }
 
     // Drop existing posts on the queue
     esp_event_post_instance_t post;
-    while (xQueueReceive(loop->queue, &post, 0) == pdTRUE) {
-        post_instance_delete(&post);
+    while (loop->queue != NULL && xQueueReceive(loop->queue, &post, 0) == pdTRUE) {
+        post_instance_delete(loop, &post);
     }
 
     // Cleanup loop
-    vQueueDelete(loop->queue);
+    dispatch_table_free(&(loop->dispatch_table));
+    if (loop->queue != NULL) {
+        vQueueDelete(loop->queue);
+    }
+    free(loop->data_slots);
     free(loop);
     // Free loop mutex before deleting
     xSemaphoreGiveRecursive(loop_mutex);
@@ -713,6 +1324,15 @@ esp_err_t esp_event_handler_register_with_internal(esp_event_loop_handle_t event
 
     bool is_loop_level_handler = (event_base == esp_event_any_base) && (event_id == ESP_EVENT_ANY_ID);
 
+    // Events of the base and id have to find the handler in the dispatch table
+    if (!is_loop_level_handler) {
+        err = dispatch_entry_add(&(loop->dispatch_table), event_base, event_id);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "alloc for dispatch table entry failed");
+            goto on_err;
+        }
+    }
+
     if (!last_loop_node ||
             (last_loop_node && !SLIST_EMPTY(&(last_loop_node->base_nodes)) && is_loop_level_handler)) {
         loop_node = (esp_event_loop_node_t*) calloc(1, sizeof(*loop_node));
@@ -741,6 +1361,8 @@ esp_err_t esp_event_handler_register_with_internal(esp_event_loop_handle_t event
         err = loop_node_add_handler(last_loop_node, event_base, event_id, event_handler, event_handler_arg, handler_ctx_arg, legacy);
     }
 
+    dispatch_table_invalidate(&(loop->dispatch_table));
+
 on_err:
     xSemaphoreGiveRecursive(loop->mutex);
     return err;
@@ -781,7 +1403,7 @@ esp_err_t esp_event_handler_unregister_with_internal(esp_event_loop_handle_t eve
     esp_event_loop_node_t *it, *temp;
 
     SLIST_FOREACH_SAFE(it, &(loop->loop_nodes), next, temp) {
-        esp_err_t res = loop_node_remove_handler(it, event_base, event_id, handler_ctx, legacy);
+        esp_err_t res = loop_node_remove_handler(loop, it, event_base, event_id, handler_ctx, legacy);
 
         if (res == ESP_OK && SLIST_EMPTY(&(it->base_nodes)) && SLIST_EMPTY(&(it->handlers))) {
             SLIST_REMOVE(&(loop->loop_nodes), it, esp_event_loop_node, next);
@@ -790,6 +1412,8 @@ esp_err_t esp_event_handler_unregister_with_internal(esp_event_loop_handle_t eve
         }
     }
 
+    dispatch_table_invalidate(&(loop->dispatch_table));
+
     xSemaphoreGiveRecursive(loop->mutex);
 
     return ESP_OK;
@@ -830,8 +1454,13 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
     memset((void*)(&post), 0, sizeof(post));
 
     if (event_data != NULL && event_data_size != 0) {
-        // Make persistent copy of event data on heap.
-        void* event_data_copy = calloc(1, event_data_size);
+        // Make persistent copy of event data, in a data slot of the loop if there is a free one
+        // which is large enough, otherwise on heap.
+        void* event_data_copy = data_slot_alloc(loop, event_data_size);
+
+        if (event_data_copy == NULL) {
+            event_data_copy = calloc(1, event_data_size);
+        }
 
         if (event_data_copy == NULL) {
             return ESP_ERR_NO_MEM;
@@ -851,9 +1480,18 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
 
     BaseType_t result = pdFALSE;
 
-    // Find the task that currently executes the loop. It is safe to query loop->task since it is
-    // not mutated since loop creation. ENSURE THIS REMAINS TRUE.
-    if (loop->task == NULL) {
+    // Find the task that currently executes the loop. It is safe to query loop->task and loop->workers since they
+    // are not mutated since loop creation. ENSURE THIS REMAINS TRUE.
+    if (loop->workers != NULL) {
+        // The loop has a task for the event. The workers of the loop post without blocking, to the queue of another
+        // worker as well as to their own, since that worker may be blocked posting to the queue of the caller.
+        esp_event_loop_worker_t* worker = loop_worker_get(loop, event_base, event_id);
+        if (!loop_worker_is_current(loop)) {
+            result = xQueueSendToBack(worker->queue, &post, ticks_to_wait);
+        } else {
+            result = xQueueSendToBack(worker->queue, &post, 0);
+        }
+    } else if (loop->task == NULL) {
         // The loop has no dedicated task. Find out what task is currently running it.
         result = xSemaphoreTakeRecursive(loop->mutex, ticks_to_wait);
 
@@ -876,7 +1514,7 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
     }
 
     if (result != pdTRUE) {
-        post_instance_delete(&post);
+        post_instance_delete(loop, &post);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
         atomic_fetch_add(&loop->events_dropped, 1);
@@ -906,13 +1544,27 @@ esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop, esp_event_ba
     esp_event_post_instance_t post;
     memset((void*)(&post), 0, sizeof(post));
 
-    if (event_data_size > sizeof(post.data.val)) {
+    if (event_data_size > sizeof(post.data.val) && event_data_size > loop->data_slot_size) {
         return ESP_ERR_INVALID_ARG;
     }
 
     if (event_data != NULL && event_data_size != 0) {
-        memcpy((void*)(&(post.data.val)), event_data, event_data_size);
-        post.data_allocated = false;
+        if (event_data_size <= sizeof(post.data.val)) {
+            memcpy((void*)(&(post.data.val)), event_data, event_data_size);
+            post.data_allocated = false;
+        } else {
+            // Heap can't be used here, the post fails like on a full queue if there is no free slot
+            void* event_data_copy = data_slot_alloc(loop, event_data_size);
+            if (event_data_copy == NULL) {
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+                atomic_fetch_add(&loop->events_dropped, 1);
+#endif
+                return ESP_FAIL;
+            }
+            memcpy(event_data_copy, event_data, event_data_size);
+            post.data.ptr = event_data_copy;
+            post.data_allocated = true;
+        }
         post.data_set = true;
     }
     post.base = event_base;
@@ -921,10 +1573,11 @@ esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop, esp_event_ba
     BaseType_t result = pdFALSE;
 
     // Post the event from an ISR,
-    result = xQueueSendToBackFromISR(loop->queue, &post, task_unblocked);
+    QueueHandle_t queue = loop->workers != NULL ? loop_worker_get(loop, event_base, event_id)->queue : loop->queue;
+    result = xQueueSendToBackFromISR(queue, &post, task_unblocked);
 
     if (result != pdTRUE) {
-        post_instance_delete(&post);
+        post_instance_delete(loop, &post);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
         atomic_fetch_add(&loop->events_dropped, 1);
@@ -967,7 +1620,7 @@ esp_err_t esp_event_dump(FILE* file)
         events_recieved = atomic_load(&loop_it->events_recieved);
         events_dropped = atomic_load(&loop_it->events_dropped);
 
-        PRINT_DUMP_INFO(dst, sz, LOOP_DUMP_FORMAT, loop_it, loop_it->task != NULL ? loop_it->name : "none",
+        PRINT_DUMP_INFO(dst, sz, LOOP_DUMP_FORMAT, loop_it, (loop_it->task != NULL || loop_it->workers != NULL) ? loop_it->name : "none",
                         events_recieved, events_dropped);
 
         int sz_bak = sz;
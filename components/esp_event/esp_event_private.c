@@ -55,3 +55,12 @@ out:
     xSemaphoreGive(loop->mutex);
     return result;
 }
+
+void esp_event_loop_set_dispatch_table(esp_event_loop_handle_t event_loop, bool enable)
+{
+    esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
+
+    xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
+    loop->dispatch_table.disabled = !enable;
+    xSemaphoreGiveRecursive(loop->mutex);
+}
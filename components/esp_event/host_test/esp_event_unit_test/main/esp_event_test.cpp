@@ -8,7 +8,15 @@
 */
 
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
 #include "esp_event.h"
+#include "esp_event_private.h"
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -40,6 +48,107 @@ static esp_event_loop_args_t test_event_get_default_loop_args(void)
 
 void dummy_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data) { }
 
+ESP_EVENT_DEFINE_BASE(TEST_BASE);
+
+const int32_t TEST_ID = 1;
+
+/* Keeps the posts to the loop queue in a FIFO, so events can be posted and run without FreeRTOS */
+struct MockFifoQueue : public CMockFix {
+    MockFifoQueue()
+    {
+        items.clear();
+        xQueueGenericCreate_Stub(create);
+        vQueueDelete_Ignore();
+        xQueueGenericSend_Stub(send);
+        xQueueGenericSendFromISR_Stub(send_from_isr);
+        xQueueReceive_Stub(receive);
+        xQueueTakeMutexRecursive_IgnoreAndReturn(pdTRUE);
+        xQueueGiveMutexRecursive_IgnoreAndReturn(pdTRUE);
+        xTaskGetCurrentTaskHandle_IgnoreAndReturn(reinterpret_cast<TaskHandle_t>(1));
+        xTaskGetTickCount_IgnoreAndReturn(0);
+    }
+
+    ~MockFifoQueue()
+    {
+        xQueueGenericCreate_Stub(nullptr);
+        vQueueDelete_StopIgnore();
+        xQueueGenericSend_Stub(nullptr);
+        xQueueGenericSendFromISR_Stub(nullptr);
+        xQueueReceive_Stub(nullptr);
+        xQueueTakeMutexRecursive_StopIgnore();
+        xQueueGiveMutexRecursive_StopIgnore();
+        xTaskGetCurrentTaskHandle_StopIgnore();
+        xTaskGetTickCount_StopIgnore();
+    }
+
+    static QueueHandle_t create(const UBaseType_t length, const UBaseType_t item_size, const uint8_t type, int calls)
+    {
+        if (type == queueQUEUE_TYPE_BASE) {
+            queue_length = length;
+            queue_item_size = item_size;
+        }
+        return reinterpret_cast<QueueHandle_t>(0xdeadbeef);
+    }
+
+    static BaseType_t send(QueueHandle_t queue, const void *const item, TickType_t ticks, const BaseType_t pos, int calls)
+    {
+        if (items.size() == queue_length) {
+            return pdFALSE;
+        }
+        const uint8_t *bytes = static_cast<const uint8_t *>(item);
+        items.emplace_back(bytes, bytes + queue_item_size);
+        return pdTRUE;
+    }
+
+    static BaseType_t send_from_isr(QueueHandle_t queue, const void *const item, BaseType_t *const woken,
+                                    const BaseType_t pos, int calls)
+    {
+        return send(queue, item, 0, pos, calls);
+    }
+
+    static BaseType_t receive(QueueHandle_t queue, void *const buffer, TickType_t ticks, int calls)
+    {
+        if (items.empty()) {
+            return pdFALSE;
+        }
+        memcpy(buffer, items.front().data(), queue_item_size);
+        items.pop_front();
+        return pdTRUE;
+    }
+
+    static inline std::deque<std::vector<uint8_t>> items;
+    static inline UBaseType_t queue_length;
+    static inline UBaseType_t queue_item_size;
+};
+
+struct TestPayload {
+    uint32_t seq;
+    uint8_t fill[28];
+};
+
+/* Checks the payload of each event and records where the loop keeps it */
+struct PayloadRecorder {
+    static void handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+    {
+        PayloadRecorder *recorder = static_cast<PayloadRecorder *>(event_handler_arg);
+        const TestPayload *payload = static_cast<const TestPayload *>(event_data);
+        recorder->in_order &= payload->seq == recorder->received++ && payload->fill[27] == (uint8_t) payload->seq;
+        recorder->addresses.push_back(reinterpret_cast<uintptr_t>(event_data));
+    }
+
+    uint32_t received = 0;
+    bool in_order = true;
+    std::vector<uintptr_t> addresses;
+};
+
+esp_err_t post_payload(esp_event_loop_handle_t loop, uint32_t seq, size_t size = sizeof(TestPayload))
+{
+    TestPayload payload[2] = {};
+    payload[0].seq = seq;
+    payload[0].fill[27] = (uint8_t) seq;
+    return esp_event_post_to(loop, TEST_BASE, TEST_ID, payload, size, portMAX_DELAY);
+}
+
 }
 
 // TODO: IDF-2693, function definition just to satisfy linker, implement esp_common instead
@@ -149,3 +258,356 @@ TEST_CASE("registering with ANY_BASE but specific ID fails")
                                           dummy_handler,
                                           nullptr) == ESP_ERR_INVALID_ARG);
 }
+
+TEST_CASE("event data is copied into the data slots of the loop")
+{
+    MockFifoQueue queue;
+    MockMutex sem(CreateAnd::IGNORE);
+    PayloadRecorder recorder;
+    esp_event_loop_handle_t loop;
+
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.task_name = nullptr;
+    loop_args.data_slot_size = sizeof(TestPayload);
+    REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &loop));
+    REQUIRE(ESP_OK == esp_event_handler_register_with(loop, TEST_BASE, TEST_ID, PayloadRecorder::handler, &recorder));
+
+    for (int round = 0; round < 3; round++) {
+        uint32_t first = recorder.received;
+        recorder.addresses.clear();
+        for (uint32_t i = first; i < first + QUEUE_SIZE; i++) {
+            REQUIRE(ESP_OK == post_payload(loop, i));
+        }
+        CHECK(ESP_ERR_TIMEOUT == post_payload(loop, 0));
+        CHECK(ESP_OK == esp_event_loop_run(loop, portMAX_DELAY));
+        CHECK(recorder.received == first + QUEUE_SIZE);
+
+        // All the copies are within the QUEUE_SIZE + 1 slots
+        auto range = std::minmax_element(recorder.addresses.begin(), recorder.addresses.end());
+        CHECK(*range.second - *range.first <= QUEUE_SIZE * sizeof(TestPayload));
+    }
+
+    // Larger data is still copied to heap
+    recorder.addresses.clear();
+    REQUIRE(ESP_OK == post_payload(loop, recorder.received, sizeof(TestPayload) + 4));
+    CHECK(ESP_OK == esp_event_loop_run(loop, portMAX_DELAY));
+    CHECK(recorder.in_order);
+
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+}
+
+#if CONFIG_ESP_EVENT_POST_FROM_ISR
+TEST_CASE("event data larger than 4 bytes can be posted from ISR to a loop with data slots")
+{
+    MockFifoQueue queue;
+    MockMutex sem(CreateAnd::IGNORE);
+    PayloadRecorder recorder;
+    esp_event_loop_handle_t loop;
+    esp_event_loop_handle_t loop_without_slots;
+    TestPayload payload = {};
+
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.task_name = nullptr;
+    REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &loop_without_slots));
+    CHECK(ESP_ERR_INVALID_ARG == esp_event_isr_post_to(loop_without_slots, TEST_BASE, TEST_ID, &payload, sizeof(payload), nullptr));
+    CHECK(ESP_OK == esp_event_loop_delete(loop_without_slots));
+
+    loop_args.data_slot_size = sizeof(TestPayload);
+    REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &loop));
+    REQUIRE(ESP_OK == esp_event_handler_register_with(loop, TEST_BASE, TEST_ID, PayloadRecorder::handler, &recorder));
+
+    for (uint32_t i = 0; i < QUEUE_SIZE; i++) {
+        payload.seq = i;
+        payload.fill[27] = (uint8_t) i;
+        CHECK(ESP_OK == esp_event_isr_post_to(loop, TEST_BASE, TEST_ID, &payload, sizeof(payload), nullptr));
+    }
+    // The queue is full, the data slot is released again
+    CHECK(ESP_FAIL == esp_event_isr_post_to(loop, TEST_BASE, TEST_ID, &payload, sizeof(payload), nullptr));
+    CHECK(ESP_ERR_INVALID_ARG == esp_event_isr_post_to(loop, TEST_BASE, TEST_ID, &payload, sizeof(payload) + 1, nullptr));
+
+    CHECK(ESP_OK == esp_event_loop_run(loop, portMAX_DELAY));
+    CHECK(recorder.received == QUEUE_SIZE);
+    CHECK(recorder.in_order);
+
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+}
+#endif
+
+/* Events per second posted and run in batches of QUEUE_SIZE */
+static double post_rate(uint32_t data_slot_size)
+{
+    const int BATCHES = 1000;
+    PayloadRecorder recorder;
+    esp_event_loop_handle_t loop;
+
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.task_name = nullptr;
+    loop_args.data_slot_size = data_slot_size;
+    REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &loop));
+    REQUIRE(ESP_OK == esp_event_handler_register_with(loop, TEST_BASE, TEST_ID, PayloadRecorder::handler, &recorder));
+    recorder.addresses.reserve(BATCHES * QUEUE_SIZE);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int batch = 0; batch < BATCHES; batch++) {
+        for (uint32_t i = 0; i < QUEUE_SIZE; i++) {
+            post_payload(loop, recorder.received + i);
+        }
+        esp_event_loop_run(loop, portMAX_DELAY);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    CHECK(recorder.received == BATCHES * QUEUE_SIZE);
+    CHECK(recorder.in_order);
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+    return BATCHES * QUEUE_SIZE / elapsed.count();
+}
+
+TEST_CASE("event post rate with data on heap and in data slots", "[perf]")
+{
+    MockFifoQueue queue;
+    MockMutex sem(CreateAnd::IGNORE);
+
+    // Best of a few runs, the rates are noisy on a loaded host
+    double heap_rate = 0, slots_rate = 0;
+    for (int run = 0; run < 5; run++) {
+        heap_rate = std::max(heap_rate, post_rate(0));
+        slots_rate = std::max(slots_rate, post_rate(sizeof(TestPayload)));
+    }
+    printf("%16s %16s\n", "heap (ev/s)", "slots (ev/s)");
+    printf("%16.0f %16.0f\n", heap_rate, slots_rate);
+}
+
+namespace {
+
+/* Records the order in which handlers are executed */
+struct DispatchRecorder {
+    struct Handler {
+        DispatchRecorder *recorder;
+        int index;
+    };
+
+    static void handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+    {
+        Handler *handler = static_cast<Handler *>(event_handler_arg);
+        handler->recorder->executed.push_back(handler->index);
+    }
+
+    std::vector<int> executed;
+};
+
+std::vector<int> dispatch(esp_event_loop_handle_t loop, DispatchRecorder &recorder, esp_event_base_t base, int32_t id)
+{
+    recorder.executed.clear();
+    REQUIRE(ESP_OK == esp_event_post_to(loop, base, id, nullptr, 0, portMAX_DELAY));
+    REQUIRE(ESP_OK == esp_event_loop_run(loop, portMAX_DELAY));
+    return recorder.executed;
+}
+
+}
+
+TEST_CASE("dispatch table executes the same handlers in the same order as the handler lists")
+{
+    MockFifoQueue queue;
+    MockMutex sem(CreateAnd::IGNORE);
+    const int BASES = 4;
+    const int IDS = 4;
+
+    /* The last base and id are never registered */
+    std::vector<std::string> base_names;
+    for (int i = 0; i <= BASES; i++) {
+        base_names.push_back("base" + std::to_string(i));
+    }
+
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.task_name = nullptr;
+    esp_event_loop_handle_t table_loop, list_loop;
+    REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &table_loop));
+    REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &list_loop));
+    esp_event_loop_set_dispatch_table(list_loop, false);
+
+    DispatchRecorder table_recorder, list_recorder;
+    std::deque<DispatchRecorder::Handler> handlers;
+    struct Registration {
+        esp_event_base_t base;
+        int32_t id;
+        esp_event_handler_instance_t table_instance;
+        esp_event_handler_instance_t list_instance;
+    };
+    std::vector<Registration> registered;
+
+    auto check_same_dispatch = [&]() {
+        for (const std::string &name : base_names) {
+            for (int32_t id = 0; id <= IDS; id++) {
+                INFO("event " << name << ":" << id);
+                CHECK(dispatch(table_loop, table_recorder, name.c_str(), id) ==
+                      dispatch(list_loop, list_recorder, name.c_str(), id));
+            }
+        }
+    };
+
+    std::mt19937 rng(42);
+    for (int pass = 0; pass < 4; pass++) {
+        for (int i = 0; i < 40; i++) {
+            /* Any base goes with any id, specific ids are more common */
+            int base = rng() % (BASES + 1);
+            int id = rng() % (IDS + 2);
+            Registration reg = {};
+            reg.base = base == BASES ? ESP_EVENT_ANY_BASE : base_names[base].c_str();
+            reg.id = (base == BASES || id >= IDS) ? ESP_EVENT_ANY_ID : id;
+
+            int index = handlers.size() / 2;
+            handlers.push_back({ &table_recorder, index });
+            handlers.push_back({ &list_recorder, index });
+            REQUIRE(ESP_OK == esp_event_handler_instance_register_with(table_loop, reg.base, reg.id, DispatchRecorder::handler,
+                                                                       &handlers[handlers.size() - 2], &reg.table_instance));
+            REQUIRE(ESP_OK == esp_event_handler_instance_register_with(list_loop, reg.base, reg.id, DispatchRecorder::handler,
+                                                                       &handlers.back(), &reg.list_instance));
+            registered.push_back(reg);
+        }
+        check_same_dispatch();
+
+        /* Unregistering keeps the order of the remaining handlers */
+        std::shuffle(registered.begin(), registered.end(), rng);
+        for (size_t i = 0; i < registered.size() / 2; i++) {
+            const Registration &reg = registered.back();
+            CHECK(ESP_OK == esp_event_handler_instance_unregister_with(table_loop, reg.base, reg.id, reg.table_instance));
+            CHECK(ESP_OK == esp_event_handler_instance_unregister_with(list_loop, reg.base, reg.id, reg.list_instance));
+            registered.pop_back();
+        }
+        check_same_dispatch();
+    }
+
+    CHECK(ESP_OK == esp_event_loop_delete(table_loop));
+    CHECK(ESP_OK == esp_event_loop_delete(list_loop));
+}
+
+namespace {
+
+/* Unregisters itself and another handler of the same event */
+struct UnregisteringHandler {
+    static void handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+    {
+        UnregisteringHandler *self = static_cast<UnregisteringHandler *>(event_handler_arg);
+        self->calls++;
+        esp_event_handler_instance_unregister_with(self->loop, TEST_BASE, TEST_ID, self->instance);
+        esp_event_handler_instance_unregister_with(self->loop, TEST_BASE, TEST_ID, self->other);
+    }
+
+    esp_event_loop_handle_t loop;
+    esp_event_handler_instance_t instance;
+    esp_event_handler_instance_t other;
+    int calls;
+};
+
+}
+
+TEST_CASE("handlers unregistered while an event is dispatched are not executed")
+{
+    MockFifoQueue queue;
+    MockMutex sem(CreateAnd::IGNORE);
+
+    for (bool table : { true, false }) {
+        INFO("dispatch table " << table);
+        esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+        loop_args.task_name = nullptr;
+        esp_event_loop_handle_t loop;
+        REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &loop));
+        esp_event_loop_set_dispatch_table(loop, table);
+
+        /* The first handler removes itself and the one after the next */
+        UnregisteringHandler first = {};
+        first.loop = loop;
+        DispatchRecorder recorder;
+        DispatchRecorder::Handler second = { &recorder, 2 };
+        DispatchRecorder::Handler third = { &recorder, 3 };
+        esp_event_handler_instance_t second_instance;
+        REQUIRE(ESP_OK == esp_event_handler_instance_register_with(loop, TEST_BASE, TEST_ID, UnregisteringHandler::handler,
+                                                                   &first, &first.instance));
+        REQUIRE(ESP_OK == esp_event_handler_instance_register_with(loop, TEST_BASE, TEST_ID, DispatchRecorder::handler,
+                                                                   &second, &second_instance));
+        REQUIRE(ESP_OK == esp_event_handler_instance_register_with(loop, TEST_BASE, TEST_ID, DispatchRecorder::handler,
+                                                                   &third, &first.other));
+
+        CHECK(dispatch(loop, recorder, TEST_BASE, TEST_ID) == std::vector<int> { 2 });
+        CHECK(dispatch(loop, recorder, TEST_BASE, TEST_ID) == std::vector<int> { 2 });
+        CHECK(first.calls == 1);
+
+        CHECK(ESP_OK == esp_event_loop_delete(loop));
+    }
+}
+
+namespace {
+
+void counting_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    (*static_cast<uint32_t *>(event_handler_arg))++;
+}
+
+/* Nanoseconds per event posted and dispatched, for each of the events in turn */
+double dispatch_time(esp_event_loop_handle_t loop, const std::vector<std::pair<esp_event_base_t, int32_t>> &events)
+{
+    const int ROUNDS = 200;
+    uint32_t queued = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const auto &event : events) {
+            esp_event_post_to(loop, event.first, event.second, nullptr, 0, portMAX_DELAY);
+            if (++queued == QUEUE_SIZE) {
+                esp_event_loop_run(loop, portMAX_DELAY);
+                queued = 0;
+            }
+        }
+    }
+    esp_event_loop_run(loop, portMAX_DELAY);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (ROUNDS * events.size());
+}
+
+}
+
+TEST_CASE("dispatch time with the dispatch table compared to the handler lists", "[perf]")
+{
+    MockFifoQueue queue;
+    MockMutex sem(CreateAnd::IGNORE);
+    const std::pair<int, int> sizes[] = { { 2, 5 }, { 10, 16 }, { 32, 32 } };
+
+    printf("%8s %12s %12s\n", "handlers", "lists (ns)", "table (ns)");
+    for (const auto &size : sizes) {
+        /* A handler for each id of each base, and one for all events */
+        std::vector<std::string> base_names;
+        for (int i = 0; i < size.first; i++) {
+            base_names.push_back("base" + std::to_string(i));
+        }
+        std::vector<std::pair<esp_event_base_t, int32_t>> events;
+        for (const std::string &name : base_names) {
+            for (int32_t id = 0; id < size.second; id++) {
+                events.emplace_back(name.c_str(), id);
+            }
+        }
+
+        double times[2];
+        for (bool table : { false, true }) {
+            esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+            loop_args.task_name = nullptr;
+            esp_event_loop_handle_t loop;
+            REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &loop));
+            esp_event_loop_set_dispatch_table(loop, table);
+
+            uint32_t calls = 0;
+            REQUIRE(ESP_OK == esp_event_handler_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID, counting_handler, &calls));
+            for (const auto &event : events) {
+                REQUIRE(ESP_OK == esp_event_handler_register_with(loop, event.first, event.second, counting_handler, &calls));
+            }
+
+            /* Best of a few runs, the first ones warm up the caches */
+            times[table] = dispatch_time(loop, events);
+            for (int run = 1; run < 3; run++) {
+                times[table] = std::min(times[table], dispatch_time(loop, events));
+            }
+            CHECK(calls == 3 * 2 * 200 * events.size());
+            CHECK(ESP_OK == esp_event_loop_delete(loop));
+        }
+        printf("%8zu %12.0f %12.0f\n", events.size() + 1, times[0], times[1]);
+    }
+}
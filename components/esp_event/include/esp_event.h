@@ -20,6 +20,12 @@
 extern "C" {
 #endif
 
+/// Events which a loop run by more than one task handles in the order they were posted
+typedef enum {
+    ESP_EVENT_LOOP_ORDER_ID = 0,                /**< events with the same base and id */
+    ESP_EVENT_LOOP_ORDER_BASE,                  /**< events with the same base */
+} esp_event_loop_order_t;
+
 /// Configuration for creating event loops
 typedef struct {
     int32_t queue_size;                         /**< size of the event loop queue */
@@ -29,6 +35,21 @@ typedef struct {
     uint32_t task_stack_size;                   /**< stack size of the event loop task, ignored if task name is NULL */
     BaseType_t task_core_id;                    /**< core to which the event loop task is pinned to,
                                                         ignored if task name is NULL */
+    uint32_t data_slot_size;                    /**< size of the preallocated slots for event data; if 0, the data
+                                                        of each post is copied to heap. Otherwise queue_size + 1
+                                                        slots are allocated with the loop and data of up to this
+                                                        size is copied to a free slot instead */
+    uint32_t task_count;                        /**< number of tasks which execute the handlers of the loop in
+                                                        parallel, ignored if task name is NULL. 0 and 1 create a
+                                                        single task. Each task has its own queue of queue_size
+                                                        events, only the events selected by task_order are then
+                                                        handled in the order they were posted. Handlers
+                                                        posting to their own loop don't block on a full queue */
+    esp_event_loop_order_t task_order;          /**< events which are handled by the same task, in the order they
+                                                        were posted, ignored if task_count is 1 or less */
+    bool task_pin_per_core;                     /**< pin the tasks to all cores in turn, starting with core 0,
+                                                        instead of pinning them all to task_core_id; ignored if
+                                                        task_count is 1 or less */
 } esp_event_loop_args_t;
 
 /**
@@ -51,6 +72,9 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t *event_loop_args, es
  *
  * @param[in] event_loop event loop to delete, must not be NULL
  *
+ * @note for a loop run by more than one task, this waits for the handlers being executed to return, and
+ * must not be called from a handler of the loop
+ *
  * @return
  *  - ESP_OK: Success
  *  - Others: Fail
@@ -102,6 +126,7 @@ esp_err_t esp_event_loop_delete_default(void);
  *
  * @return
  *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_STATE: The loop is run by more than one task
  *  - Others: Fail
  */
 esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t ticks_to_run);
@@ -374,6 +399,9 @@ esp_err_t esp_event_post(esp_event_base_t event_base,
  * This function behaves in the same manner as esp_event_post, except the additional specification of the event loop
  * to post the event to.
  *
+ * If the loop was created with data slots (see data_slot_size of esp_event_loop_args_t), event data which fits
+ * into a slot is copied there instead of to heap. The copy is made on heap only while all slots are in use.
+ *
  * @param[in] event_loop the event loop to post to, must not be NULL
  * @param[in] event_base the event base that identifies the event
  * @param[in] event_id the event ID that identifies the event
@@ -402,7 +430,8 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
  * @param[in] event_base the event base that identifies the event
  * @param[in] event_id the event ID that identifies the event
  * @param[in] event_data the data, specific to the event occurrence, that gets passed to the handler
- * @param[in] event_data_size the size of the event data; max is 4 bytes
+ * @param[in] event_data_size the size of the event data; max is 4 bytes, or the data slot size of
+ *                            the default event loop if it is larger
  * @param[out] task_unblocked an optional parameter (can be NULL) which indicates that an event task with
  *                            higher priority than currently running task has been unblocked by the posted event;
  *                            a context switch should be requested before the interrupt is existed.
@@ -413,9 +442,9 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
  *
  * @return
  *  - ESP_OK: Success
- *  - ESP_FAIL: Event queue for the default event loop full
+ *  - ESP_FAIL: Event queue or data slots for the default event loop full
  *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event ID,
- *                          data size of more than 4 bytes
+ *                          data size of more than 4 bytes and more than the data slot size
  *  - Others: Fail
  */
 esp_err_t esp_event_isr_post(esp_event_base_t event_base,
@@ -431,7 +460,8 @@ esp_err_t esp_event_isr_post(esp_event_base_t event_base,
  * @param[in] event_base the event base that identifies the event
  * @param[in] event_id the event ID that identifies the event
  * @param[in] event_data the data, specific to the event occurrence, that gets passed to the handler
- * @param[in] event_data_size the size of the event data
+ * @param[in] event_data_size the size of the event data; max is 4 bytes, or the data slot size of
+ *                            the loop if it is larger
  * @param[out] task_unblocked an optional parameter (can be NULL) which indicates that an event task with
  *                            higher priority than currently running task has been unblocked by the posted event;
  *                            a context switch should be requested before the interrupt is existed.
@@ -442,9 +472,9 @@ esp_err_t esp_event_isr_post(esp_event_base_t event_base,
  *
  * @return
  *  - ESP_OK: Success
- *  - ESP_FAIL: Event queue for the loop full
+ *  - ESP_FAIL: Event queue or data slots for the loop full
  *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event ID,
- *                          data size of more than 4 bytes
+ *                          data size of more than 4 bytes and more than the data slot size
  *  - Others: Fail
  */
 esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop,
@@ -30,7 +30,11 @@ typedef struct esp_event_handler_node {
     uint32_t invoked;                                               /**< number of times this handler has been invoked */
     int64_t time;                                                   /**< total runtime of this handler across all calls */
 #endif
+    bool removed;                                                   /**< unregistered while the loop was dispatching,
+                                                                            freed once the dispatch finishes */
+    uint32_t removed_seq;                                           /**< last dispatch started when it was unregistered */
     SLIST_ENTRY(esp_event_handler_node) next;                   /**< next event handler in the list */
+    SLIST_ENTRY(esp_event_handler_node) next_removed;           /**< next handler waiting to be freed */
 } esp_event_handler_node_t;
 
 typedef SLIST_HEAD(esp_event_handler_instances, esp_event_handler_node) esp_event_handler_nodes_t;
@@ -65,6 +69,48 @@ typedef struct esp_event_loop_node {
 
 typedef SLIST_HEAD(esp_event_loop_nodes, esp_event_loop_node) esp_event_loop_nodes_t;
 
+/// Handlers of an event in the order they are executed, kept until the last dispatch using them finishes
+typedef struct esp_event_dispatch_handlers {
+    uint32_t refs;                                                  /**< the entry they were resolved for, and each
+                                                                            dispatch executing them */
+    uint32_t count;                                                 /**< number of handlers */
+    uint32_t size;                                                  /**< allocated size of the nodes array */
+    esp_event_handler_node_t* nodes[];                              /**< handlers */
+} esp_event_dispatch_handlers_t;
+
+/// Handlers executed for an event, resolved from the handler lists of the loop
+typedef struct esp_event_dispatch_entry {
+    esp_event_base_t base;                                          /**< base of the event */
+    int32_t id;                                                     /**< id of the event, ESP_EVENT_ANY_ID for the
+                                                                            entry used for the other ids of the base */
+    uint32_t generation;                                            /**< generation of the handler lists the
+                                                                            handlers were resolved from */
+    esp_event_dispatch_handlers_t* handlers;                        /**< handlers, NULL if there are none */
+    SLIST_ENTRY(esp_event_dispatch_entry) next;                     /**< next entry in the same bucket */
+} esp_event_dispatch_entry_t;
+
+typedef SLIST_HEAD(esp_event_dispatch_entries, esp_event_dispatch_entry) esp_event_dispatch_entries_t;
+
+/// Hash table of the handlers to execute for each event, keyed by (base, id)
+typedef struct esp_event_dispatch_table {
+    esp_event_dispatch_entries_t* buckets;                          /**< array of entry lists */
+    uint32_t buckets_count;                                         /**< size of the buckets array, a power of two */
+    uint32_t entries_count;                                         /**< number of entries in the buckets */
+    uint32_t generation;                                            /**< incremented on every change of the handler
+                                                                            lists, older entries are resolved again */
+    esp_event_dispatch_entry_t loop_entry;                          /**< entry for events of bases without handlers */
+    bool disabled;                                                  /**< dispatch by walking the handler lists */
+} esp_event_dispatch_table_t;
+
+/// Task of a loop run by more than one task, with the queue of the events it handles
+typedef struct esp_event_loop_worker {
+    struct esp_event_loop_instance* loop;                           /**< loop the task belongs to */
+    QueueHandle_t queue;                                            /**< event queue */
+    TaskHandle_t task;                                              /**< task that consumes the event queue */
+    uint32_t dispatch_seq;                                          /**< sequence number of the dispatch being
+                                                                            executed, 0 if none */
+} esp_event_loop_worker_t;
+
 /// Event loop
 typedef struct esp_event_loop_instance {
     const char* name;                                               /**< name of this event loop */
@@ -75,6 +121,22 @@ typedef struct esp_event_loop_instance {
     SemaphoreHandle_t mutex;                                        /**< mutex for updating the events linked list */
     esp_event_loop_nodes_t loop_nodes;                              /**< set of linked lists containing the
                                                                             registered handlers for the loop */
+    esp_event_dispatch_table_t dispatch_table;                      /**< handlers to execute for each event */
+    bool dispatching;                                               /**< handlers of an event are being executed
+                                                                            with the mutex held */
+    SLIST_HEAD(, esp_event_handler_node) removed_handlers;          /**< handlers unregistered while dispatching */
+    esp_event_loop_worker_t* workers;                               /**< tasks of a loop run by more than one
+                                                                            task, NULL otherwise */
+    uint32_t workers_count;                                         /**< number of workers */
+    esp_event_loop_order_t workers_order;                           /**< events handled by the same worker */
+    SemaphoreHandle_t workers_stopped;                              /**< given by each worker as it exits */
+    uint32_t dispatch_seq;                                          /**< sequence number of the last dispatch
+                                                                            started by a worker */
+    uint8_t* data_slots;                                            /**< preallocated storage for event data,
+                                                                            NULL if the loop has none */
+    atomic_uint_least32_t* data_slots_used;                         /**< bitmap of the data slots in use */
+    uint32_t data_slot_size;                                        /**< size of each data slot */
+    uint32_t data_slot_count;                                       /**< number of data slots */
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     atomic_uint_least32_t events_recieved;                          /**< number of events successfully posted to the loop */
     atomic_uint_least32_t events_dropped;                           /**< number of events dropped due to queue being full */
@@ -95,7 +157,8 @@ typedef void* esp_event_post_data_t;
 /// Event posted to the event queue
 typedef struct esp_event_post_instance {
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
-    bool data_allocated;                                             /**< indicates whether data is allocated from heap */
+    bool data_allocated;                                             /**< indicates whether data is stored outside of
+                                                                            the post, on heap or in a data slot */
     bool data_set;                                                   /**< indicates if data is null */
 #endif
     esp_event_base_t base;                                           /**< the event base */
@@ -31,6 +31,17 @@ extern "C" {
  */
 bool esp_event_is_handler_registered(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler);
 
+/**
+ * @brief Enables or disables the dispatch table of an event loop.
+ *
+ * With the dispatch table disabled, the loop finds the handlers of each event by walking its handler lists.
+ * The table is enabled when the loop is created, this is only used to compare both in tests.
+ *
+ * @param[in] event_loop the loop to configure
+ * @param[in] enable whether to dispatch events through the dispatch table
+ */
+void esp_event_loop_set_dispatch_table(esp_event_loop_handle_t event_loop, bool enable);
+
 /**
  * @brief Deinitializes the event loop library
  *
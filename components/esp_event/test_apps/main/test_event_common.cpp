@@ -1532,6 +1532,18 @@ TEST_CASE("event data many bytes are copied on post", "[event][linux]")
     TEST_ASSERT_EQUAL_HEX8_ARRAY(ev_data_expected, saved_ev_data.event_data, EventData::MAX_SIZE);
 }
 
+TEST_CASE("loop run by multiple tasks can not be run by other tasks", "[event][linux]")
+{
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.task_count = 2;
+    esp_event_loop_handle_t loop;
+    TEST_ESP_OK(esp_event_loop_create(&loop_args, &loop));
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_event_loop_run(loop, ZERO_DELAY));
+
+    TEST_ESP_OK(esp_event_loop_delete(loop));
+}
+
 TEST_CASE("default loop: registering fails on uninitialized default loop", "[event][default][linux]")
 {
     esp_event_handler_instance_t instance;
@@ -75,6 +75,7 @@ typedef struct {
 } simple_arg_t;
 
 ESP_EVENT_DECLARE_BASE(s_test_base1);
+ESP_EVENT_DECLARE_BASE(s_test_base2);
 
 enum {
     TEST_EVENT_BASE1_EV1,
@@ -647,6 +648,159 @@ TEST_CASE("performance test - no dedicated task", "[event][qemu-ignore]")
     performance_test(false);
 }
 
+static void test_event_take_sem_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake((SemaphoreHandle_t) event_handler_arg, portMAX_DELAY));
+}
+
+static void test_event_give_sem_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreGive((SemaphoreHandle_t) event_handler_arg));
+}
+
+TEST_CASE("loop run by multiple tasks executes handlers in parallel", "[event]")
+{
+    const int events = 16;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.queue_size = events;
+    loop_args.task_count = 4;
+    loop_args.task_pin_per_core = true;
+    esp_event_loop_handle_t loop;
+    TEST_ESP_OK(esp_event_loop_create(&loop_args, &loop));
+
+    SemaphoreHandle_t blocking_sem = xSemaphoreCreateBinary();
+    SemaphoreHandle_t done_sem = xSemaphoreCreateCounting(events, 0);
+    TEST_ASSERT(blocking_sem);
+    TEST_ASSERT(done_sem);
+
+    TEST_ESP_OK(esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_take_sem_handler, blocking_sem));
+    TEST_ESP_OK(esp_event_handler_register_with(loop, s_test_base2, ESP_EVENT_ANY_ID, test_event_give_sem_handler, done_sem));
+
+    // Events with other ids go to other tasks, which don't wait for the blocked handler
+    TEST_ESP_OK(esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, NULL, 0, portMAX_DELAY));
+    for (int id = 0; id < events; id++) {
+        TEST_ESP_OK(esp_event_post_to(loop, s_test_base2, id, NULL, 0, portMAX_DELAY));
+    }
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(done_sem, pdMS_TO_TICKS(100)));
+
+    // The rest are handled once the blocked handler returns
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreGive(blocking_sem));
+    for (int i = 1; i < events; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(done_sem, pdMS_TO_TICKS(100)));
+    }
+
+    TEST_ESP_OK(esp_event_loop_delete(loop));
+    vSemaphoreDelete(blocking_sem);
+    vSemaphoreDelete(done_sem);
+}
+
+typedef struct {
+    int last[2][2];
+    bool in_order;
+    SemaphoreHandle_t done;
+} ordered_events_t;
+
+static void test_event_check_order_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    ordered_events_t* events = (ordered_events_t*) event_handler_arg;
+    int seq = *((int*) event_data);
+    int* last = &(events->last[event_base == s_test_base2][event_id]);
+
+    // The events of each base and id are handled by one task, the others don't touch its last sequence number
+    if (seq <= *last) {
+        events->in_order = false;
+    }
+    *last = seq;
+    xSemaphoreGive(events->done);
+}
+
+TEST_CASE("loop run by multiple tasks handles events in the order they were posted", "[event]")
+{
+    const int events_count = 100;
+    const esp_event_loop_order_t orders[] = { ESP_EVENT_LOOP_ORDER_ID, ESP_EVENT_LOOP_ORDER_BASE };
+    const esp_event_base_t bases[] = { s_test_base1, s_test_base1, s_test_base2 };
+    const int32_t ids[] = { 0, 1, 0 };
+
+    for (int i = 0; i < sizeof(orders) / sizeof(orders[0]); i++) {
+        esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+        loop_args.queue_size = events_count;
+        loop_args.task_count = 3;
+        loop_args.task_order = orders[i];
+        loop_args.task_pin_per_core = true;
+        loop_args.data_slot_size = sizeof(int);
+        esp_event_loop_handle_t loop;
+        TEST_ESP_OK(esp_event_loop_create(&loop_args, &loop));
+
+        ordered_events_t events = { .in_order = true };
+        events.done = xSemaphoreCreateCounting(events_count, 0);
+        TEST_ASSERT(events.done);
+        TEST_ESP_OK(esp_event_handler_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID, test_event_check_order_handler, &events));
+
+        for (int seq = 1; seq <= events_count; seq++) {
+            TEST_ESP_OK(esp_event_post_to(loop, bases[seq % 3], ids[seq % 3], &seq, sizeof(seq), portMAX_DELAY));
+        }
+        for (int j = 0; j < events_count; j++) {
+            TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(events.done, pdMS_TO_TICKS(100)));
+        }
+        TEST_ASSERT_TRUE(events.in_order);
+
+        TEST_ESP_OK(esp_event_loop_delete(loop));
+        vSemaphoreDelete(events.done);
+    }
+}
+
+typedef struct {
+    esp_event_loop_handle_t loop;
+    int posts;
+    int accepted;
+    SemaphoreHandle_t done;
+} repost_arg_t;
+
+static void test_event_repost_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    repost_arg_t* arg = (repost_arg_t*) event_handler_arg;
+    for (int i = 0; i < arg->posts; i++) {
+        if (esp_event_post_to(arg->loop, s_test_base2, 0, NULL, 0, portMAX_DELAY) == ESP_OK) {
+            arg->accepted++;
+        }
+    }
+    xSemaphoreGive(arg->done);
+}
+
+TEST_CASE("loop run by multiple tasks doesn't block handlers posting to a full queue", "[event]")
+{
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.queue_size = 1;
+    loop_args.task_count = 2;
+    esp_event_loop_handle_t loop;
+    TEST_ESP_OK(esp_event_loop_create(&loop_args, &loop));
+
+    SemaphoreHandle_t blocking_sem = xSemaphoreCreateCounting(loop_args.queue_size + 2, 0);
+    TEST_ASSERT(blocking_sem);
+    repost_arg_t arg = {
+        .loop = loop,
+        .posts = loop_args.queue_size + 2,
+        .done = xSemaphoreCreateBinary(),
+    };
+    TEST_ASSERT(arg.done);
+
+    TEST_ESP_OK(esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_repost_handler, &arg));
+    TEST_ESP_OK(esp_event_handler_register_with(loop, s_test_base2, 0, test_event_take_sem_handler, blocking_sem));
+
+    // Whichever task handles the reposted events, its queue is full while the first one blocks, and posting to it
+    // from a handler of the loop fails instead of waiting for the blocked task
+    TEST_ESP_OK(esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, NULL, 0, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(arg.done, pdMS_TO_TICKS(1000)));
+    TEST_ASSERT_LESS_THAN(arg.posts, arg.accepted);
+
+    for (int i = 0; i < arg.accepted; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreGive(blocking_sem));
+    }
+    TEST_ESP_OK(esp_event_loop_delete(loop));
+    vSemaphoreDelete(blocking_sem);
+    vSemaphoreDelete(arg.done);
+}
+
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
 TEST_CASE("data posted normally is correctly set internally", "[event][intr]")
 {
@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+#include "esp_http_server.h"
+#include "esp_httpd_priv.h"
+#include "httpd_uri_lookup.h"
+
+const char *httpd_uri_lookup(httpd_handle_t handle, const char *uri, httpd_method_t method, httpd_err_code_t *err)
+{
+    httpd_uri_t *handler = httpd_find_uri_handler((struct httpd_data *) handle, uri, strlen(uri), method, err);
+    return handler ? handler->uri : NULL;
+}
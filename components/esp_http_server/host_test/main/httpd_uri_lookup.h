@@ -0,0 +1,26 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Looks up the handler for a URI path the way the server does for a request
+ *
+ * The lookup is internal to the server, the private header cannot be
+ * included from C++ (it uses C11 atomics).
+ *
+ * @return URI template of the handler found, NULL if none
+ */
+const char *httpd_uri_lookup(httpd_handle_t handle, const char *uri, httpd_method_t method, httpd_err_code_t *err);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,27 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_http_server.h"
+
+/**
+ * @brief Session open callback (httpd_config_t::open_fn) of the test servers
+ *
+ * Responses are sent in several pieces, this sets TCP_NODELAY so that Nagle's
+ * algorithm doesn't hold them back until the client's delayed ACK, which would
+ * dominate every latency.
+ */
+esp_err_t test_httpd_open_session(httpd_handle_t hd, int sockfd);
+
+/**
+ * @brief Connects a client to a test server on the loopback interface
+ *
+ * The socket has TCP_NODELAY set and a receive timeout of 5 seconds.
+ *
+ * @return Socket descriptor of the connection
+ */
+int test_httpd_connect(uint16_t port);
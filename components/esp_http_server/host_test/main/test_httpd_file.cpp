@@ -0,0 +1,443 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <string>
+
+#include "esp_http_server.h"
+#include "test_httpd_client.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std;
+
+static const uint16_t FILE_PORT = 8074;
+static const size_t LARGE_FILE_SIZE = 4 * 1024 * 1024;
+
+static const char MAPPED_DATA[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+static const char MAPPED_ETAG[] = "\"mapped-v1\"";
+
+struct Response {
+    int status;
+    string headers;
+    string body;
+
+    string header(const char *field) const
+    {
+        string key = string("\r\n") + field + ": ";
+        size_t pos = headers.find(key);
+        if (pos == string::npos) {
+            return "";
+        }
+        pos += key.size();
+        return headers.substr(pos, headers.find("\r\n", pos) - pos);
+    }
+};
+
+/* A directory with test files, removed again at the end of the test */
+class TestDir {
+public:
+    TestDir()
+    {
+        char tmpl[] = "/tmp/httpd_file_XXXXXX";
+        REQUIRE(mkdtemp(tmpl) != nullptr);
+        path = tmpl;
+    }
+
+    ~TestDir()
+    {
+        string cmd = "rm -rf " + path;
+        system(cmd.c_str());
+    }
+
+    void mkdir(const string &name)
+    {
+        REQUIRE(::mkdir((path + "/" + name).c_str(), 0700) == 0);
+    }
+
+    void write(const string &name, const string &content)
+    {
+        FILE *f = fopen((path + "/" + name).c_str(), "wb");
+        REQUIRE(f != nullptr);
+        REQUIRE(fwrite(content.data(), 1, content.size(), f) == content.size());
+        fclose(f);
+    }
+
+    string path;
+};
+
+static esp_err_t mapped_get_handler(httpd_req_t *req)
+{
+    return httpd_resp_send_mapped(req, MAPPED_DATA, sizeof(MAPPED_DATA) - 1, MAPPED_ETAG);
+}
+
+/* How a handler sends a file without httpd_resp_send_file(): read into a buffer, send it as a chunk */
+static esp_err_t chunked_get_handler(httpd_req_t *req)
+{
+    const char *path = (const char *) req->user_ctx;
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+        if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+            fclose(f);
+            return ESP_FAIL;
+        }
+    }
+    fclose(f);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/* Like the default send function, but keeps httpd_resp_send_file() from using sendfile(),
+ * so the file is sent the way it is on targets without it */
+static int copy_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    int ret = send(sockfd, buf, buf_len, flags);
+    return ret < 0 ? HTTPD_SOCK_ERR_FAIL : ret;
+}
+
+static esp_err_t copy_get_handler(httpd_req_t *req)
+{
+    httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), copy_send);
+    return httpd_resp_send_file(req, (const char *) req->user_ctx);
+}
+
+static httpd_handle_t start_server(const httpd_file_server_config_t *config, const string &chunked_path = "")
+{
+    httpd_config_t server_config = HTTPD_DEFAULT_CONFIG();
+    server_config.server_port = FILE_PORT;
+    server_config.ctrl_port = FILE_PORT;
+    server_config.uri_match_fn = httpd_uri_match_wildcard;
+    server_config.open_fn = test_httpd_open_session;
+
+    httpd_handle_t server = nullptr;
+    REQUIRE(httpd_start(&server, &server_config) == ESP_OK);
+
+    httpd_uri_t mapped = {};
+    mapped.uri = "/mapped";
+    mapped.method = HTTP_GET;
+    mapped.handler = mapped_get_handler;
+    REQUIRE(httpd_register_uri_handler(server, &mapped) == ESP_OK);
+
+    httpd_uri_t chunked = {};
+    chunked.uri = "/chunked";
+    chunked.method = HTTP_GET;
+    chunked.handler = chunked_get_handler;
+    chunked.user_ctx = (void *) chunked_path.c_str();
+    REQUIRE(httpd_register_uri_handler(server, &chunked) == ESP_OK);
+
+    httpd_uri_t copy = chunked;
+    copy.uri = "/copy";
+    copy.handler = copy_get_handler;
+    REQUIRE(httpd_register_uri_handler(server, &copy) == ESP_OK);
+
+    REQUIRE(httpd_register_file_server(server, config) == ESP_OK);
+    return server;
+}
+
+static int connect_client()
+{
+    return test_httpd_connect(FILE_PORT);
+}
+
+/* Reads a response with a Content-Length or chunked body, HEAD and 304 responses have none */
+static Response read_response(int fd, bool body_expected)
+{
+    Response resp = {};
+    string data;
+    char buf[16384];
+    size_t header_end;
+    while ((header_end = data.find("\r\n\r\n")) == string::npos) {
+        ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+        REQUIRE(ret > 0);
+        data.append(buf, ret);
+    }
+    resp.headers = data.substr(0, header_end + 2);
+    resp.status = atoi(data.c_str() + strlen("HTTP/1.1 "));
+    data.erase(0, header_end + 4);
+    if (!body_expected || resp.status == 304) {
+        return resp;
+    }
+
+    if (resp.header("Transfer-Encoding") == "chunked") {
+        for (;;) {
+            size_t line_end;
+            while ((line_end = data.find("\r\n")) == string::npos) {
+                ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+                REQUIRE(ret > 0);
+                data.append(buf, ret);
+            }
+            size_t chunk_len = strtoul(data.c_str(), nullptr, 16);
+            while (data.size() < line_end + 2 + chunk_len + 2) {
+                ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+                REQUIRE(ret > 0);
+                data.append(buf, ret);
+            }
+            resp.body.append(data, line_end + 2, chunk_len);
+            data.erase(0, line_end + 2 + chunk_len + 2);
+            if (chunk_len == 0) {
+                return resp;
+            }
+        }
+    }
+
+    size_t content_len = strtoul(resp.header("Content-Length").c_str(), nullptr, 10);
+    while (data.size() < content_len) {
+        ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+        REQUIRE(ret > 0);
+        data.append(buf, ret);
+    }
+    resp.body = data;
+    return resp;
+}
+
+static Response request(int fd, const string &method, const string &uri, const string &headers = "")
+{
+    string req = method + " " + uri + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n";
+    REQUIRE(send(fd, req.data(), req.size(), 0) == (ssize_t) req.size());
+    return read_response(fd, method != "HEAD");
+}
+
+TEST_CASE("files are served with ETag and conditional requests", "[httpd][file]")
+{
+    TestDir dir;
+    dir.write("index.html", "<html>index</html>");
+    dir.write("style.css", "body {}");
+    httpd_file_server_config_t config = {};
+    config.uri_prefix = "/static";
+    config.base_path = dir.path.c_str();
+    config.index_file = "index.html";
+    config.cache_control = "max-age=60";
+    httpd_handle_t server = start_server(&config);
+    int fd = connect_client();
+
+    Response resp = request(fd, "GET", "/static/style.css?v=2");
+    CHECK(resp.status == 200);
+    CHECK(resp.body == "body {}");
+    CHECK(resp.header("Content-Type") == "text/css");
+    CHECK(resp.header("Cache-Control") == "max-age=60");
+    CHECK(resp.header("Accept-Ranges") == "bytes");
+    string etag = resp.header("ETag");
+    CHECK(etag.size() > 2);
+
+    resp = request(fd, "GET", "/static/style.css", "If-None-Match: \"other\", " + etag + "\r\n");
+    CHECK(resp.status == 304);
+    CHECK(resp.header("ETag") == etag);
+    resp = request(fd, "GET", "/static/style.css", "If-None-Match: W/" + etag + "\r\n");
+    CHECK(resp.status == 304);
+    resp = request(fd, "GET", "/static/style.css", "If-None-Match: \"other\"\r\n");
+    CHECK(resp.status == 200);
+
+    resp = request(fd, "GET", "/static/");
+    CHECK(resp.status == 200);
+    CHECK(resp.body == "<html>index</html>");
+    CHECK(resp.header("Content-Type") == "text/html");
+
+    resp = request(fd, "HEAD", "/static/style.css");
+    CHECK(resp.status == 200);
+    CHECK(resp.header("Content-Length") == "7");
+
+    CHECK(request(fd, "GET", "/static/missing.css").status == 404);
+    close(fd);
+
+    /* The connection is closed after a 400 */
+    fd = connect_client();
+    CHECK(request(fd, "GET", "/static/../secret").status == 400);
+    close(fd);
+
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("byte ranges of files are served", "[httpd][file]")
+{
+    TestDir dir;
+    dir.write("data.bin", "0123456789");
+    httpd_file_server_config_t config = {};
+    config.uri_prefix = "";
+    config.base_path = dir.path.c_str();
+    httpd_handle_t server = start_server(&config);
+    int fd = connect_client();
+
+    Response resp = request(fd, "GET", "/data.bin", "Range: bytes=2-5\r\n");
+    CHECK(resp.status == 206);
+    CHECK(resp.body == "2345");
+    CHECK(resp.header("Content-Range") == "bytes 2-5/10");
+    CHECK(resp.header("Content-Type") == HTTPD_TYPE_OCTET);
+
+    resp = request(fd, "GET", "/data.bin", "Range: bytes=7-\r\n");
+    CHECK(resp.status == 206);
+    CHECK(resp.body == "789");
+
+    resp = request(fd, "GET", "/data.bin", "Range: bytes=-3\r\n");
+    CHECK(resp.status == 206);
+    CHECK(resp.body == "789");
+
+    resp = request(fd, "GET", "/data.bin", "Range: bytes=8-100\r\n");
+    CHECK(resp.status == 206);
+    CHECK(resp.body == "89");
+
+    resp = request(fd, "GET", "/data.bin", "Range: bytes=10-\r\n");
+    CHECK(resp.status == 416);
+    CHECK(resp.header("Content-Range") == "bytes */10");
+    CHECK(resp.body.empty());
+
+    /* Several ranges are answered with the whole file */
+    resp = request(fd, "GET", "/data.bin", "Range: bytes=0-1,4-5\r\n");
+    CHECK(resp.status == 200);
+    CHECK(resp.body == "0123456789");
+
+    /* If-Range with another ETag asks for the whole file */
+    resp = request(fd, "GET", "/data.bin", "Range: bytes=0-1\r\nIf-Range: \"old\"\r\n");
+    CHECK(resp.status == 200);
+    CHECK(resp.body == "0123456789");
+
+    resp = request(fd, "GET", "/mapped", "Range: bytes=10-15\r\n");
+    CHECK(resp.status == 206);
+    CHECK(resp.body == "abcdef");
+    resp = request(fd, "GET", "/mapped", string("If-None-Match: ") + MAPPED_ETAG + "\r\n");
+    CHECK(resp.status == 304);
+
+    close(fd);
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("precompressed variants are served to clients accepting gzip", "[httpd][file]")
+{
+    TestDir dir;
+    dir.write("app.js", "plain");
+    dir.write("app.js.gz", "compressed");
+    dir.write("only.js.gz", "compressed only");
+    httpd_file_server_config_t config = {};
+    config.uri_prefix = "";
+    config.base_path = dir.path.c_str();
+    httpd_handle_t server = start_server(&config);
+    int fd = connect_client();
+
+    Response resp = request(fd, "GET", "/app.js", "Accept-Encoding: deflate, gzip\r\n");
+    CHECK(resp.status == 200);
+    CHECK(resp.body == "compressed");
+    CHECK(resp.header("Content-Encoding") == "gzip");
+    CHECK(resp.header("Content-Type") == "application/javascript");
+    CHECK(resp.header("Vary") == "Accept-Encoding");
+    string gzip_etag = resp.header("ETag");
+
+    resp = request(fd, "GET", "/app.js");
+    CHECK(resp.status == 200);
+    CHECK(resp.body == "plain");
+    CHECK(resp.header("Content-Encoding") == "");
+    CHECK(resp.header("Vary") == "Accept-Encoding");
+    CHECK(resp.header("ETag") != gzip_etag);
+
+    CHECK(request(fd, "GET", "/only.js", "Accept-Encoding: gzip\r\n").body == "compressed only");
+    CHECK(request(fd, "GET", "/only.js").status == 404);
+
+    close(fd);
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("directories are not served as files", "[httpd][file]")
+{
+    TestDir dir;
+    dir.mkdir("sub");
+    dir.write("sub/page.html", "page");
+    dir.write("lib.js", "plain");
+    dir.mkdir("lib.js.gz");
+    httpd_file_server_config_t config = {};
+    config.uri_prefix = "";
+    config.base_path = dir.path.c_str();
+    httpd_handle_t server = start_server(&config);
+    int fd = connect_client();
+
+    CHECK(request(fd, "GET", "/sub/page.html").body == "page");
+
+    /* A directory named like the compressed variant is ignored */
+    Response resp = request(fd, "GET", "/lib.js", "Accept-Encoding: gzip\r\n");
+    CHECK(resp.status == 200);
+    CHECK(resp.body == "plain");
+    CHECK(resp.header("Content-Encoding") == "");
+    CHECK(resp.header("Vary") == "");
+
+    resp = request(fd, "GET", "/sub");
+    CHECK(resp.status == 404);
+    CHECK(resp.header("Vary") == "");
+
+    close(fd);
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+/* Reads a response into a scratch buffer, keeping only the number of body bytes (including chunk framing) */
+static size_t drain_response(int fd, size_t body_len)
+{
+    static char buf[65536];
+    string headers;
+    size_t header_end;
+    while ((header_end = headers.find("\r\n\r\n")) == string::npos) {
+        ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+        REQUIRE(ret > 0);
+        headers.append(buf, ret);
+    }
+    if (headers.find("chunked") != string::npos) {
+        /* Every chunk of 4096 bytes adds "1000\r\n" and "\r\n", plus the final "0\r\n\r\n" */
+        body_len += (body_len / 4096) * 8 + 5;
+    }
+    size_t received = headers.size() - (header_end + 4);
+    while (received < body_len) {
+        ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+        REQUIRE(ret > 0);
+        received += ret;
+    }
+    return received;
+}
+
+TEST_CASE("file transfer compared to chunked sending", "[httpd][file][perf]")
+{
+    const int ROUNDS = 20;
+
+    TestDir dir;
+    string content(LARGE_FILE_SIZE, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = (char) (i * 31 + i / 4096);
+    }
+    dir.write("large.bin", content);
+    string chunked_path = dir.path + "/large.bin";
+
+    httpd_file_server_config_t config = {};
+    config.uri_prefix = "/files";
+    config.base_path = dir.path.c_str();
+    httpd_handle_t server = start_server(&config, chunked_path);
+    int fd = connect_client();
+
+    const char *methods[] = { "fread + send_chunk", "send_file, read + send", "send_file, sendfile()" };
+    const char *uris[] = { "/chunked", "/copy", "/files/large.bin" };
+    double mb_per_sec[3];
+    for (int i = 0; i < 3; ++i) {
+        CHECK(request(fd, "GET", uris[i]).body == content);
+
+        string req = string("GET ") + uris[i] + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        auto start = chrono::steady_clock::now();
+        for (int round = 0; round < ROUNDS; ++round) {
+            REQUIRE(send(fd, req.data(), req.size(), 0) == (ssize_t) req.size());
+            drain_response(fd, content.size());
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        mb_per_sec[i] = ROUNDS * (LARGE_FILE_SIZE / 1048576.0) / elapsed.count();
+    }
+    printf("%24s %12s\n", "", "MB/s");
+    for (int i = 0; i < 3; ++i) {
+        printf("%24s %12.0f\n", methods[i], mb_per_sec[i]);
+    }
+
+    close(fd);
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
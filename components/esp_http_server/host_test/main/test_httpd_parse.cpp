@@ -0,0 +1,306 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "esp_http_server.h"
+#include "test_httpd_client.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std;
+
+static const uint16_t PARSE_PORT = 8075;
+
+/* Headers reported by the /headers handler */
+static const char *const REPORTED_HEADERS[] = { "Host", "x-first", "X-Dup", "X-Empty", "X-Missing", "X-Last" };
+
+/* Responds with "name=length:value;" for each of the reported headers, "name=-;" if not found */
+static esp_err_t headers_get_handler(httpd_req_t *req)
+{
+    string out;
+    for (const char *field : REPORTED_HEADERS) {
+        size_t len = httpd_req_get_hdr_value_len(req, field);
+        char val[64];
+        esp_err_t ret = httpd_req_get_hdr_value_str(req, field, val, sizeof(val));
+        out += string(field) + "=";
+        out += ret == ESP_OK ? to_string(len) + ":" + val : "-";
+        out += ";";
+    }
+    /* Truncation is reported, the value is cut */
+    char small[4];
+    if (httpd_req_get_hdr_value_str(req, "X-Last", small, sizeof(small)) == ESP_ERR_HTTPD_RESULT_TRUNC) {
+        out += string("trunc=") + small;
+    }
+    return httpd_resp_send(req, out.c_str(), out.size());
+}
+
+/* Responds with the value of the query parameter "n" */
+static esp_err_t id_get_handler(httpd_req_t *req)
+{
+    char query[32], id[16];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+            httpd_query_key_value(query, "n", id, sizeof(id)) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+    }
+    return httpd_resp_sendstr(req, id);
+}
+
+/* Responds with the request body */
+static esp_err_t echo_post_handler(httpd_req_t *req)
+{
+    string body(req->content_len, '\0');
+    size_t received = 0;
+    while (received < body.size()) {
+        int ret = httpd_req_recv(req, &body[received], body.size() - received);
+        if (ret <= 0) {
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    return httpd_resp_send(req, body.data(), body.size());
+}
+
+/* Responds with the time per lookup of the X-Target header in nanoseconds */
+static esp_err_t lookup_get_handler(httpd_req_t *req)
+{
+    const int LOOKUPS = 100000;
+    char val[32];
+    int found = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < LOOKUPS; ++i) {
+        found += httpd_req_get_hdr_value_str(req, "X-Target", val, sizeof(val)) == ESP_OK ? 1 : 0;
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    if (found != LOOKUPS) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+    char out[32];
+    snprintf(out, sizeof(out), "%.1f", elapsed.count() / LOOKUPS);
+    return httpd_resp_sendstr(req, out);
+}
+
+static void register_handler(httpd_handle_t server, const char *uri, httpd_method_t method,
+                             esp_err_t (*handler)(httpd_req_t *r))
+{
+    httpd_uri_t uri_handler = {};
+    uri_handler.uri = uri;
+    uri_handler.method = method;
+    uri_handler.handler = handler;
+    REQUIRE(httpd_register_uri_handler(server, &uri_handler) == ESP_OK);
+}
+
+static httpd_handle_t start_server()
+{
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = PARSE_PORT;
+    config.ctrl_port = PARSE_PORT;
+    config.open_fn = test_httpd_open_session;
+
+    httpd_handle_t server = nullptr;
+    REQUIRE(httpd_start(&server, &config) == ESP_OK);
+
+    register_handler(server, "/headers", HTTP_GET, headers_get_handler);
+    register_handler(server, "/id", HTTP_GET, id_get_handler);
+    register_handler(server, "/echo", HTTP_POST, echo_post_handler);
+    register_handler(server, "/lookup", HTTP_GET, lookup_get_handler);
+    return server;
+}
+
+/* A keep-alive connection, responses to pipelined requests may arrive in one segment */
+class Client {
+public:
+    Client()
+    {
+        fd = test_httpd_connect(PARSE_PORT);
+    }
+
+    ~Client()
+    {
+        close(fd);
+    }
+
+    void send_all(const string &data)
+    {
+        REQUIRE(send(fd, data.data(), data.size(), 0) == (ssize_t)data.size());
+    }
+
+    /* Returns the body of the next response, which must have status 200 */
+    string read_body()
+    {
+        size_t header_end;
+        while ((header_end = data.find("\r\n\r\n")) == string::npos) {
+            receive();
+        }
+        REQUIRE(data.compare(0, strlen("HTTP/1.1 200"), "HTTP/1.1 200") == 0);
+        size_t length_pos = data.find("Content-Length: ");
+        REQUIRE(length_pos < header_end);
+        size_t body_len = atoi(data.c_str() + length_pos + strlen("Content-Length: "));
+        while (data.size() < header_end + 4 + body_len) {
+            receive();
+        }
+        string body = data.substr(header_end + 4, body_len);
+        data.erase(0, header_end + 4 + body_len);
+        return body;
+    }
+
+    bool idle() const
+    {
+        return data.empty();
+    }
+
+private:
+    void receive()
+    {
+        char buf[4096];
+        ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+        REQUIRE(ret > 0);
+        data.append(buf, ret);
+    }
+
+    int fd;
+    string data;
+};
+
+static string get_request(const string &uri, const string &headers = "")
+{
+    return "GET " + uri + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n";
+}
+
+static string post_request(const string &uri, const string &body)
+{
+    return "POST " + uri + " HTTP/1.1\r\nHost: localhost\r\nContent-Length: " + to_string(body.size()) +
+           "\r\n\r\n" + body;
+}
+
+/* Short headers which don't change the result of /headers */
+static string filler_headers(int count)
+{
+    string headers;
+    for (int i = 0; i < count; ++i) {
+        headers += "f" + to_string(i) + ":" + to_string(i) + "\r\n";
+    }
+    return headers;
+}
+
+static const char TEST_HEADERS[] = "X-FIRST: one\r\n"
+                                   "x-dup: first\r\n"
+                                   "X-Empty:\r\n"
+                                   "X-Dup: second\r\n"
+                                   "X-Last:   last value\r\n";
+static const char TEST_HEADERS_RESULT[] = "Host=9:localhost;x-first=3:one;X-Dup=5:first;X-Empty=0:;X-Missing=-;"
+                                          "X-Last=10:last value;trunc=las";
+
+TEST_CASE("request headers are found by name", "[httpd][parse]")
+{
+    httpd_handle_t server = start_server();
+    {
+        Client client;
+        client.send_all(get_request("/headers", TEST_HEADERS));
+        CHECK(client.read_body() == TEST_HEADERS_RESULT);
+
+        /* More headers than fit into the header index are found by scanning them */
+        client.send_all(get_request("/headers", filler_headers(20) + TEST_HEADERS + filler_headers(20)));
+        CHECK(client.read_body() == TEST_HEADERS_RESULT);
+
+        /* Nothing is left over from the previous request */
+        client.send_all(get_request("/headers"));
+        CHECK(client.read_body() == "Host=9:localhost;x-first=-;X-Dup=-;X-Empty=-;X-Missing=-;X-Last=-;");
+    }
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("pipelined requests are served in order", "[httpd][parse]")
+{
+    const int REQUESTS = 30;
+    httpd_handle_t server = start_server();
+    {
+        Client client;
+        string requests;
+        vector<string> expected;
+        for (int i = 0; i < REQUESTS; ++i) {
+            if (i % 3 == 2) {
+                /* Bodies of varying size, some longer than a receive block */
+                string body(i * 37, 'a' + i % 26);
+                requests += post_request("/echo", body);
+                expected.push_back(body);
+            } else if (i % 3 == 1) {
+                requests += get_request("/headers", TEST_HEADERS);
+                expected.push_back(TEST_HEADERS_RESULT);
+            } else {
+                requests += get_request("/id?n=" + to_string(i));
+                expected.push_back(to_string(i));
+            }
+        }
+
+        /* All at once, and split at every possible point of the first few requests */
+        client.send_all(requests);
+        for (const string &body : expected) {
+            CHECK(client.read_body() == body);
+        }
+        for (size_t split = 1; split < 300; split += 7) {
+            client.send_all(requests.substr(0, split));
+            usleep(1000);
+            client.send_all(requests.substr(split));
+            for (const string &body : expected) {
+                CHECK(client.read_body() == body);
+            }
+        }
+        CHECK(client.idle());
+    }
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("pipelined requests and header lookup time", "[httpd][parse][perf]")
+{
+    const int REQUESTS = 2000;
+    const int DEPTH = 50;
+    httpd_handle_t server = start_server();
+    {
+        Client client;
+
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < REQUESTS; ++i) {
+            client.send_all(get_request("/id?n=" + to_string(i)));
+            REQUIRE(client.read_body() == to_string(i));
+        }
+        chrono::duration<double> sequential = chrono::steady_clock::now() - start;
+
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < REQUESTS; i += DEPTH) {
+            string requests;
+            for (int j = i; j < i + DEPTH; ++j) {
+                requests += get_request("/id?n=" + to_string(j));
+            }
+            client.send_all(requests);
+            for (int j = i; j < i + DEPTH; ++j) {
+                REQUIRE(client.read_body() == to_string(j));
+            }
+        }
+        chrono::duration<double> pipelined = chrono::steady_clock::now() - start;
+
+        printf("%16s %16s\n", "sequential (r/s)", "pipelined (r/s)");
+        printf("%16.0f %16.0f\n", REQUESTS / sequential.count(), REQUESTS / pipelined.count());
+
+        /* The looked up header is the 12th in both requests, the second one
+         * has too many headers for the index and is scanned */
+        string target = filler_headers(10) + "X-Target: value\r\n";
+        client.send_all(get_request("/lookup", target));
+        double indexed_ns = atof(client.read_body().c_str());
+        client.send_all(get_request("/lookup", target + filler_headers(40)));
+        double scanned_ns = atof(client.read_body().c_str());
+
+        printf("%16s %16s\n", "scan (ns)", "index (ns)");
+        printf("%16.1f %16.1f\n", scanned_ns, indexed_ns);
+    }
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
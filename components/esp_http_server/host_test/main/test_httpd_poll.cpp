@@ -0,0 +1,324 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "esp_http_server.h"
+#include "test_httpd_client.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std;
+
+static const uint16_t TEST_PORT = 8071;
+static const char TEST_REQUEST[] = "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+static const char SLOW_REQUEST[] = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n";
+static const char TEST_BODY[] = "Hello World!";
+
+/* Sessions of a server holding this many keep-alive connections do not fit into an fd_set */
+static const size_t MANY_CLIENTS = 1000;
+static const size_t FEW_CLIENTS = 8;
+static const uint8_t WORKERS = 4;
+static const int SLOW_HANDLER_MS = 500;
+
+static esp_err_t hello_get_handler(httpd_req_t *req)
+{
+    return httpd_resp_sendstr(req, TEST_BODY);
+}
+
+static esp_err_t slow_get_handler(httpd_req_t *req)
+{
+    usleep(SLOW_HANDLER_MS * 1000);
+    return httpd_resp_sendstr(req, TEST_BODY);
+}
+
+static httpd_handle_t start_server(size_t max_open_sockets, uint8_t worker_count = 0)
+{
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = TEST_PORT;
+    config.max_open_sockets = max_open_sockets;
+    config.backlog_conn = 1024;
+    config.open_fn = test_httpd_open_session;
+    config.worker_count = worker_count;
+
+    httpd_handle_t server = nullptr;
+    REQUIRE(httpd_start(&server, &config) == ESP_OK);
+
+    httpd_uri_t hello = {};
+    hello.uri = "/hello";
+    hello.method = HTTP_GET;
+    hello.handler = hello_get_handler;
+    REQUIRE(httpd_register_uri_handler(server, &hello) == ESP_OK);
+
+    httpd_uri_t slow = {};
+    slow.uri = "/slow";
+    slow.method = HTTP_GET;
+    slow.handler = slow_get_handler;
+    REQUIRE(httpd_register_uri_handler(server, &slow) == ESP_OK);
+    return server;
+}
+
+/* Both the client and the server side of every connection need a descriptor */
+static size_t max_clients(size_t wanted)
+{
+    struct rlimit limit;
+    REQUIRE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return min(wanted, (size_t)(limit.rlim_cur - 32) / 2);
+}
+
+static int connect_client()
+{
+    return test_httpd_connect(TEST_PORT);
+}
+
+static size_t active_sessions(httpd_handle_t server, size_t max_sessions)
+{
+    vector<int> fds(max_sessions);
+    size_t count = max_sessions;
+    REQUIRE(httpd_get_client_list(server, &count, fds.data()) == ESP_OK);
+    return count;
+}
+
+/* Sessions are created by the server thread, wait until all connections have been accepted */
+static void wait_for_sessions(httpd_handle_t server, size_t max_sessions, size_t expected)
+{
+    for (int i = 0; i < 500 && active_sessions(server, max_sessions) != expected; ++i) {
+        usleep(10000);
+    }
+    REQUIRE(active_sessions(server, max_sessions) == expected);
+}
+
+static void send_request(int fd, const char *request = TEST_REQUEST)
+{
+    REQUIRE(send(fd, request, strlen(request), 0) == (ssize_t)strlen(request));
+}
+
+/* Reads one complete response, returns false on error or if the status is not 200 */
+static bool read_response(int fd)
+{
+    char buf[512];
+    size_t len = 0;
+    size_t total = 0;
+    while (total == 0 || len < total) {
+        ssize_t ret = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (ret <= 0) {
+            return false;
+        }
+        len += ret;
+        buf[len] = '\0';
+        const char *end = strstr(buf, "\r\n\r\n");
+        const char *length = strstr(buf, "Content-Length: ");
+        if (total == 0 && end && length) {
+            total = (end - buf) + 4 + atoi(length + strlen("Content-Length: "));
+        }
+        if (total > sizeof(buf) - 1) {
+            return false;
+        }
+    }
+    /* Responses are only read after the request has been sent, so nothing may follow */
+    return len == total && strncmp(buf, "HTTP/1.1 200 OK", strlen("HTTP/1.1 200 OK")) == 0;
+}
+
+struct LoadResult {
+    size_t clients;
+    unsigned workers;
+    double requests_per_sec;
+    double idle_p50_us;
+    double idle_p99_us;
+};
+
+/* Every client keeps its connection open: all clients send a request, then all
+ * responses are read, for a number of rounds. Afterwards a single client issues
+ * requests one by one while all the others stay connected but idle, which shows
+ * the cost of a wakeup with that many open sessions. */
+static LoadResult run_load(size_t client_count, uint8_t worker_count = 0)
+{
+    const int ROUNDS = 20;
+    const int IDLE_REQUESTS = 200;
+
+    httpd_handle_t server = start_server(client_count, worker_count);
+    vector<int> clients;
+    for (size_t i = 0; i < client_count; ++i) {
+        clients.push_back(connect_client());
+    }
+    wait_for_sessions(server, client_count, client_count);
+
+    LoadResult result = {};
+    result.clients = client_count;
+    result.workers = worker_count;
+
+    size_t failed = 0;
+    auto start = chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (int fd : clients) {
+            send_request(fd);
+        }
+        for (int fd : clients) {
+            failed += read_response(fd) ? 0 : 1;
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    CHECK(failed == 0);
+    result.requests_per_sec = ROUNDS * client_count / elapsed.count();
+
+    vector<double> latencies;
+    for (int i = 0; i < IDLE_REQUESTS; ++i) {
+        auto request_start = chrono::steady_clock::now();
+        send_request(clients[0]);
+        REQUIRE(read_response(clients[0]));
+        chrono::duration<double, micro> latency = chrono::steady_clock::now() - request_start;
+        latencies.push_back(latency.count());
+    }
+    sort(latencies.begin(), latencies.end());
+    result.idle_p50_us = latencies[IDLE_REQUESTS / 2];
+    result.idle_p99_us = latencies[IDLE_REQUESTS * 99 / 100];
+
+    for (int fd : clients) {
+        close(fd);
+    }
+    REQUIRE(httpd_stop(server) == ESP_OK);
+    return result;
+}
+
+TEST_CASE("requests are served on keep-alive connections", "[httpd]")
+{
+    httpd_handle_t server = start_server(FEW_CLIENTS);
+    int fd = connect_client();
+    for (int i = 0; i < 3; ++i) {
+        send_request(fd);
+        CHECK(read_response(fd));
+    }
+    close(fd);
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("requests sent back to back in one segment are all served", "[httpd]")
+{
+    httpd_handle_t server = start_server(FEW_CLIENTS);
+    int fd = connect_client();
+
+    /* The second request ends up in the pending buffer of the session while
+     * the first one is parsed, so the socket will not report it as readable */
+    char requests[2 * sizeof(TEST_REQUEST)];
+    strcpy(requests, TEST_REQUEST);
+    strcat(requests, TEST_REQUEST);
+    REQUIRE(send(fd, requests, strlen(requests), 0) == (ssize_t)strlen(requests));
+
+    char buf[1024];
+    size_t len = 0;
+    int responses = 0;
+    while (responses < 2) {
+        ssize_t ret = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        REQUIRE(ret > 0);
+        len += ret;
+        buf[len] = '\0';
+        responses = 0;
+        for (const char *p = strstr(buf, TEST_BODY); p; p = strstr(p + 1, TEST_BODY)) {
+            responses++;
+        }
+    }
+    CHECK(responses == 2);
+
+    close(fd);
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("sessions of closed connections are released", "[httpd]")
+{
+    const size_t client_count = max_clients(MANY_CLIENTS);
+    httpd_handle_t server = start_server(client_count);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        vector<int> clients;
+        for (size_t i = 0; i < client_count; ++i) {
+            clients.push_back(connect_client());
+        }
+        wait_for_sessions(server, client_count, client_count);
+        for (int fd : clients) {
+            close(fd);
+        }
+        wait_for_sessions(server, client_count, 0);
+    }
+
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("requests are served by workers", "[httpd]")
+{
+    httpd_handle_t server = start_server(FEW_CLIENTS, WORKERS);
+    vector<int> clients;
+    for (size_t i = 0; i < FEW_CLIENTS; ++i) {
+        clients.push_back(connect_client());
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (int fd : clients) {
+            send_request(fd);
+        }
+        for (int fd : clients) {
+            CHECK(read_response(fd));
+        }
+    }
+    for (int fd : clients) {
+        close(fd);
+    }
+    wait_for_sessions(server, FEW_CLIENTS, 0);
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("slow handler does not delay other sessions with workers", "[httpd]")
+{
+    httpd_handle_t server = start_server(FEW_CLIENTS, WORKERS);
+    int slow = connect_client();
+    int fast = connect_client();
+    wait_for_sessions(server, FEW_CLIENTS, 2);
+
+    send_request(slow, SLOW_REQUEST);
+    usleep(50 * 1000);
+
+    /* Served by another worker while the first one is still in the slow handler */
+    auto start = chrono::steady_clock::now();
+    send_request(fast);
+    CHECK(read_response(fast));
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    CHECK(elapsed.count() < SLOW_HANDLER_MS / 2);
+
+    CHECK(read_response(slow));
+
+    /* The session is handed back to the server after the slow request */
+    send_request(slow);
+    CHECK(read_response(slow));
+
+    close(slow);
+    close(fast);
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+TEST_CASE("load with many concurrent keep-alive clients", "[httpd][perf]")
+{
+    LoadResult results[] = {
+        run_load(FEW_CLIENTS),
+        run_load(max_clients(MANY_CLIENTS)),
+        run_load(FEW_CLIENTS, WORKERS),
+        run_load(max_clients(MANY_CLIENTS), WORKERS),
+    };
+
+    printf("%8s %8s %14s %14s %14s\n", "clients", "workers", "requests/s", "idle p50 (us)", "idle p99 (us)");
+    for (const LoadResult &result : results) {
+        printf("%8zu %8u %14.0f %14.1f %14.1f\n", result.clients, result.workers, result.requests_per_sec,
+               result.idle_p50_us, result.idle_p99_us);
+    }
+}
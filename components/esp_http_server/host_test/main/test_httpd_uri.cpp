@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "esp_http_server.h"
+#include "httpd_uri_lookup.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std;
+
+static const uint16_t ROUTER_PORT = 8072;
+static const uint16_t SCAN_PORT = 8073;
+static const size_t MAX_HANDLERS = 128;
+
+static esp_err_t dummy_handler(httpd_req_t *req)
+{
+    return ESP_OK;
+}
+
+/* The server only builds the routing tree for the URI matching functions it knows,
+ * these wrappers behave the same but make it match every handler one by one */
+static bool match_simple_scan(const char *reference_uri, const char *uri_to_match, size_t match_upto)
+{
+    return strlen(reference_uri) == match_upto && strncmp(reference_uri, uri_to_match, match_upto) == 0;
+}
+
+static bool match_wildcard_scan(const char *reference_uri, const char *uri_to_match, size_t match_upto)
+{
+    return httpd_uri_match_wildcard(reference_uri, uri_to_match, match_upto);
+}
+
+static httpd_handle_t start_server(uint16_t port, httpd_uri_match_func_t uri_match_fn)
+{
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.ctrl_port = port;
+    config.max_uri_handlers = MAX_HANDLERS;
+    config.uri_match_fn = uri_match_fn;
+
+    httpd_handle_t server = nullptr;
+    REQUIRE(httpd_start(&server, &config) == ESP_OK);
+    return server;
+}
+
+static esp_err_t register_handler(httpd_handle_t server, const char *uri, httpd_method_t method)
+{
+    httpd_uri_t handler = {};
+    handler.uri = uri;
+    handler.method = method;
+    handler.handler = dummy_handler;
+    return httpd_register_uri_handler(server, &handler);
+}
+
+/* All strings of up to max_len characters from the alphabet */
+static vector<string> all_strings(const string &alphabet, size_t max_len)
+{
+    vector<string> result = { "" };
+    for (size_t begin = 0; begin < result.size(); ++begin) {
+        if (result[begin].size() == max_len) {
+            continue;
+        }
+        for (char c : alphabet) {
+            result.push_back(result[begin] + c);
+        }
+    }
+    return result;
+}
+
+static void check_same_lookup(httpd_handle_t router, httpd_handle_t scan, const vector<string> &uris)
+{
+    const httpd_method_t methods[] = { HTTP_GET, HTTP_POST, HTTP_PUT };
+    for (const string &uri : uris) {
+        for (httpd_method_t method : methods) {
+            httpd_err_code_t router_err, scan_err;
+            const char *router_match = httpd_uri_lookup(router, uri.c_str(), method, &router_err);
+            const char *scan_match = httpd_uri_lookup(scan, uri.c_str(), method, &scan_err);
+            INFO("uri '" << uri << "' method " << method);
+            CHECK(router_err == scan_err);
+            CHECK(string(router_match ? router_match : "(none)") == string(scan_match ? scan_match : "(none)"));
+        }
+    }
+}
+
+/* Registers random templates in both servers, then unregisters some of them again,
+ * and compares the handlers found for every short URI made of the same characters */
+static void check_router_matches_scan(httpd_uri_match_func_t router_fn, httpd_uri_match_func_t scan_fn)
+{
+    httpd_handle_t router = start_server(ROUTER_PORT, router_fn);
+    httpd_handle_t scan = start_server(SCAN_PORT, scan_fn);
+
+    const vector<string> uris = all_strings("/ab", 5);
+    const vector<string> templates = all_strings("/ab*?", 4);
+    const httpd_method_t methods[] = { HTTP_GET, HTTP_POST, (httpd_method_t) HTTP_ANY };
+
+    mt19937 rng(42);
+    for (int pass = 0; pass < 4; ++pass) {
+        vector<pair<string, httpd_method_t>> registered;
+        for (size_t i = 0; i < MAX_HANDLERS / 2; ++i) {
+            string uri = templates[rng() % templates.size()];
+            httpd_method_t method = methods[rng() % 3];
+            esp_err_t ret = register_handler(router, uri.c_str(), method);
+            CHECK(ret == register_handler(scan, uri.c_str(), method));
+            if (ret == ESP_OK) {
+                registered.emplace_back(uri, method);
+            }
+        }
+        check_same_lookup(router, scan, uris);
+
+        /* Removal has to leave the remaining routes intact */
+        shuffle(registered.begin(), registered.end(), rng);
+        for (size_t i = 0; i < registered.size() / 2; ++i) {
+            const char *uri = registered[i].first.c_str();
+            if (i % 2) {
+                CHECK(httpd_unregister_uri(router, uri) == httpd_unregister_uri(scan, uri));
+            } else {
+                CHECK(httpd_unregister_uri_handler(router, uri, registered[i].second) ==
+                      httpd_unregister_uri_handler(scan, uri, registered[i].second));
+            }
+        }
+        check_same_lookup(router, scan, uris);
+
+        for (const auto &handler : registered) {
+            httpd_unregister_uri(router, handler.first.c_str());
+            httpd_unregister_uri(scan, handler.first.c_str());
+        }
+        check_same_lookup(router, scan, { "", "/", "/a" });
+    }
+
+    REQUIRE(httpd_stop(scan) == ESP_OK);
+    REQUIRE(httpd_stop(router) == ESP_OK);
+}
+
+TEST_CASE("URI router finds the same handlers as the linear scan", "[httpd][uri]")
+{
+    check_router_matches_scan(httpd_uri_match_wildcard, match_wildcard_scan);
+}
+
+TEST_CASE("URI router finds the same handlers as the linear scan without wildcards", "[httpd][uri]")
+{
+    check_router_matches_scan(nullptr, match_simple_scan);
+}
+
+TEST_CASE("URI router reports method not allowed", "[httpd][uri]")
+{
+    httpd_handle_t server = start_server(ROUTER_PORT, httpd_uri_match_wildcard);
+    REQUIRE(register_handler(server, "/api/*", HTTP_GET) == ESP_OK);
+    REQUIRE(register_handler(server, "/api/items", HTTP_POST) == ESP_OK);
+    /* Already covered by the wildcard */
+    CHECK(register_handler(server, "/api/items", HTTP_GET) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+
+    httpd_err_code_t err;
+    CHECK(string(httpd_uri_lookup(server, "/api/items", HTTP_GET, &err)) == "/api/*");
+    CHECK(err == 0);
+    CHECK(string(httpd_uri_lookup(server, "/api/items", HTTP_POST, &err)) == "/api/items");
+    CHECK(httpd_uri_lookup(server, "/api/items", HTTP_PUT, &err) == nullptr);
+    CHECK(err == HTTPD_405_METHOD_NOT_ALLOWED);
+    CHECK(httpd_uri_lookup(server, "/index.html", HTTP_GET, &err) == nullptr);
+    CHECK(err == HTTPD_404_NOT_FOUND);
+
+    REQUIRE(httpd_stop(server) == ESP_OK);
+}
+
+/* Nanoseconds per lookup of each of the URIs */
+static double lookup_time(httpd_handle_t server, const vector<string> &uris)
+{
+    const int ROUNDS = 2000;
+    size_t found = 0;
+    auto start = chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (const string &uri : uris) {
+            found += httpd_uri_lookup(server, uri.c_str(), HTTP_GET, nullptr) ? 1 : 0;
+        }
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    CHECK(found == ROUNDS * uris.size());
+    return elapsed.count() / (ROUNDS * uris.size());
+}
+
+TEST_CASE("URI router lookup time compared to the linear scan", "[httpd][uri][perf]")
+{
+    const size_t RESOURCES = 16;
+    const char *const actions[] = { "", "/config", "/status", "/*" };
+
+    httpd_handle_t router = start_server(ROUTER_PORT, httpd_uri_match_wildcard);
+    httpd_handle_t scan = start_server(SCAN_PORT, match_wildcard_scan);
+
+    /* A typical REST API: 64 endpoints, each queried once per round */
+    vector<string> templates;
+    vector<string> uris;
+    for (size_t i = 0; i < RESOURCES; ++i) {
+        for (const char *action : actions) {
+            string uri = "/api/v1/resource" + to_string(i) + action;
+            templates.push_back(uri);
+            uris.push_back(uri.back() == '*' ? uri.substr(0, uri.size() - 1) + "17/value" : uri);
+        }
+    }
+    for (const string &uri : templates) {
+        REQUIRE(register_handler(router, uri.c_str(), HTTP_GET) == ESP_OK);
+        REQUIRE(register_handler(scan, uri.c_str(), HTTP_GET) == ESP_OK);
+    }
+
+    double router_ns = lookup_time(router, uris);
+    double scan_ns = lookup_time(scan, uris);
+    printf("%8s %12s %12s\n", "handlers", "scan (ns)", "router (ns)");
+    printf("%8zu %12.0f %12.0f\n", templates.size(), scan_ns, router_ns);
+
+    REQUIRE(httpd_stop(scan) == ESP_OK);
+    REQUIRE(httpd_stop(router) == ESP_OK);
+}
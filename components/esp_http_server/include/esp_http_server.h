@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -76,7 +76,8 @@ initializer that should be kept in sync
         .keep_alive_count = 0,                          \
         .open_fn = NULL,                                \
         .close_fn = NULL,                               \
-        .uri_match_fn = NULL                            \
+        .uri_match_fn = NULL,                           \
+        .worker_count = 0                               \
 }
 
 #define ESP_ERR_HTTPD_BASE              (0xb000)                    /*!< Starting number of HTTPD error codes */
@@ -277,6 +278,24 @@ typedef struct httpd_config {
      * of the `httpd_uri_match_func_t` function prototype)
      */
     httpd_uri_match_func_t uri_match_fn;
+
+    /**
+     * Number of worker tasks processing requests.
+     *
+     * With 0 (the default), requests are parsed and URI handlers are run on the server
+     * task itself, so a slow handler delays all other clients.
+     *
+     * Otherwise, the server task only waits for socket activity and hands sessions with
+     * incoming data over to a pool of worker tasks. A session is owned by one worker
+     * until its request has been processed, so requests of the same session are never
+     * processed concurrently, while requests of different sessions are. URI handlers
+     * must then be safe to run concurrently. Work queued with httpd_queue_work() still
+     * runs on the server task.
+     *
+     * Workers use the stack size, priority and stack memory capabilities of the server
+     * task and are not pinned to a core.
+     */
+    uint8_t worker_count;
 } httpd_config_t;
 
 /**
@@ -1186,10 +1205,13 @@ static inline esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *r, const char *str
 /* Some commonly used status codes */
 #define HTTPD_200      "200 OK"                     /*!< HTTP Response 200 */
 #define HTTPD_204      "204 No Content"             /*!< HTTP Response 204 */
+#define HTTPD_206      "206 Partial Content"        /*!< HTTP Response 206 */
 #define HTTPD_207      "207 Multi-Status"           /*!< HTTP Response 207 */
+#define HTTPD_304      "304 Not Modified"           /*!< HTTP Response 304 */
 #define HTTPD_400      "400 Bad Request"            /*!< HTTP Response 400 */
 #define HTTPD_404      "404 Not Found"              /*!< HTTP Response 404 */
 #define HTTPD_408      "408 Request Timeout"        /*!< HTTP Response 408 */
+#define HTTPD_416      "416 Range Not Satisfiable"  /*!< HTTP Response 416 */
 #define HTTPD_500      "500 Internal Server Error"  /*!< HTTP Response 500 */
 
 /**
@@ -1661,6 +1683,120 @@ esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *ar
  * @}
  */
 
+/* ************** Group: File Serving ************** */
+/** @name File Serving
+ * APIs for serving static files
+ * @{
+ */
+
+/**
+ * @brief   API to send a file from the VFS as HTTP response
+ *
+ * The file is sent with a Content-Length in blocks of CONFIG_HTTPD_FILE_BLOCK_SIZE
+ * read straight into the send buffer. On the Linux target, for sessions using
+ * the default send function, the file is passed to the socket with sendfile().
+ *
+ * Besides sending the whole file, this takes care of:
+ *  - Precompressed files: if "<path>.gz" exists and the client accepts
+ *    gzip, that file is sent with 'Content-Encoding: gzip'. If only the
+ *    ".gz" file exists, it is sent to such clients only.
+ *  - Validation: an ETag is derived from the size and modification time
+ *    of the file (if the filesystem keeps it). A matching 'If-None-Match'
+ *    gets a '304 Not Modified' response without body.
+ *  - Ranges: a single byte range in 'Range' (subject to 'If-Range') gets
+ *    a '206 Partial Content' response with that part of the file, or
+ *    '416 Range Not Satisfiable'. Requests for several ranges get the
+ *    whole file.
+ *  - HEAD requests get the headers only.
+ *
+ * If the content type was left at the default, it is derived from the
+ * file extension.
+ *
+ * @note
+ *  - This API is supposed to be called only from the context of
+ *    a URI handler where httpd_req_t* request pointer is valid.
+ *  - Up to 5 response headers are added with httpd_resp_set_hdr(), keep
+ *    max_resp_headers in httpd_config_t large enough for those.
+ *  - Once this API is called, all request headers are purged.
+ *
+ * @param[in] r     The request being responded to
+ * @param[in] path  Path of the file in the VFS, e.g. "/spiffs/index.html"
+ *
+ * @return
+ *  - ESP_OK : On successfully sending the response (which may be 206, 304 or 416)
+ *  - ESP_ERR_NOT_FOUND : Neither the file nor an acceptable ".gz" variant exists,
+ *                        nothing has been sent
+ *  - ESP_ERR_INVALID_ARG : Null arguments
+ *  - ESP_ERR_NO_MEM : Failed to allocate the block buffer
+ *  - ESP_ERR_HTTPD_RESP_HDR    : Essential headers are too large for internal buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND   : Error in raw send or reading the file
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request pointer
+ */
+esp_err_t httpd_resp_send_file(httpd_req_t *r, const char *path);
+
+/**
+ * @brief   API to send memory mapped data, e.g. a partition region
+ *          mapped with esp_partition_mmap(), as HTTP response
+ *
+ * The data is passed to the send function without copying it first.
+ * 'If-None-Match', 'Range' and HEAD requests are handled like by
+ * httpd_resp_send_file(). The content type and encoding are not
+ * changed, set them before calling this API if needed.
+ *
+ * @param[in] r     The request being responded to
+ * @param[in] data  Start of the mapped data
+ * @param[in] size  Size of the data
+ * @param[in] etag  ETag of the data including the quotes, e.g. "\"v1.2\"", or NULL
+ *
+ * @return
+ *  - ESP_OK : On successfully sending the response (which may be 206, 304 or 416)
+ *  - ESP_ERR_INVALID_ARG : Null arguments
+ *  - ESP_ERR_HTTPD_RESP_HDR    : Essential headers are too large for internal buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND   : Error in raw send
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request pointer
+ */
+esp_err_t httpd_resp_send_mapped(httpd_req_t *r, const void *data, size_t size, const char *etag);
+
+/**
+ * @brief   Static file server configuration
+ */
+typedef struct httpd_file_server_config {
+    const char *uri_prefix;     /*!< URI prefix of the files, e.g. "/static", or "" to serve all URIs */
+    const char *base_path;      /*!< VFS directory the URIs are mapped to, e.g. "/spiffs/www" */
+    const char *index_file;     /*!< File sent for URIs ending with '/', e.g. "index.html", or NULL */
+    const char *cache_control;  /*!< Value of the 'Cache-Control' response header, or NULL */
+} httpd_file_server_config_t;
+
+/**
+ * @brief   Registers a handler serving the files in a VFS directory
+ *
+ * GET and HEAD requests for "<uri_prefix>/<path>" are answered with
+ * httpd_resp_send_file() for "<base_path>/<path>", the query string is
+ * ignored. Paths with ".." segments are rejected with 400, missing
+ * files with 404.
+ *
+ * @note
+ *  - The URI handlers are registered for uri_prefix followed by a '/' and
+ *    the '*' wildcard, so the server must use httpd_uri_match_wildcard()
+ *    as uri_match_fn.
+ *  - The configuration is not copied, it must stay valid as long as the
+ *    handlers are registered.
+ *
+ * @param[in] handle  Handle to server returned by httpd_start
+ * @param[in] config  File server configuration
+ *
+ * @return
+ *  - ESP_OK : On successfully registering the handlers
+ *  - ESP_ERR_INVALID_ARG   : Null arguments
+ *  - ESP_ERR_INVALID_STATE : The server doesn't use httpd_uri_match_wildcard()
+ *  - Errors of httpd_register_uri_handler()
+ */
+esp_err_t httpd_register_file_server(httpd_handle_t handle, const httpd_file_server_config_t *config);
+
+/** End of Group File Serving
+ * @}
+ */
+
 /* ************** Group: WebSocket ************** */
 /** @name WebSocket
  * Functions and structs for WebSocket server
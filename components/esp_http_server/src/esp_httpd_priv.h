@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -9,6 +9,7 @@
 #define _HTTPD_PRIV_H_
 
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <sys/socket.h>
 #include <sys/param.h>
 #include <netinet/in.h>
@@ -32,8 +33,17 @@ extern "C" {
 
 /* Size of request data block/chunk (not to be confused with chunked encoded data)
  * that is received and parsed in one turn of the parsing process. This should not
- * exceed the scratch buffer size and should at least be 8 bytes */
-#define PARSER_BLOCK_SIZE  128
+ * exceed the scratch buffer size and should at least be 8 bytes. Data received
+ * past the end of a request is kept in the pending buffer of the session, which
+ * has the same size */
+#define PARSER_BLOCK_SIZE  CONFIG_HTTPD_RECV_BLOCK_SIZE
+
+/* Number of hash chains in the index of request headers, a power of 2 */
+#define HTTPD_REQ_HDR_BUCKETS  16
+
+/* Maximum number of requests of a session processed in one go, when the client
+ * has pipelined them and they have already been received */
+#define HTTPD_PIPELINE_BURST  8
 
 /* Calculate the maximum size needed for the scratch buffer */
 #define HTTPD_SCRATCH_BUF  MAX(HTTPD_MAX_REQ_HDR_LEN, HTTPD_MAX_URI_LEN)
@@ -80,6 +90,10 @@ struct sock_db {
     bool ws_control_frames;                         /*!< WebSocket flag indicating that control frames should be passed to user handlers */
     void *ws_user_ctx;                         /*!< Pointer to user context data which will be available to handler for websocket*/
 #endif
+    bool poll_pending;                      /*!< Queued by the poller for processing without new socket activity */
+    bool poll_paused;                       /*!< Not watched by the poller (see httpd_poll_pause()) */
+    bool in_worker;                         /*!< Owned by a worker task until its request has been processed */
+    bool close_deferred;                    /*!< Closure was requested while the session was owned by a worker */
 };
 
 /**
@@ -100,6 +114,16 @@ struct httpd_req_aux {
         const char *value;
     } *resp_hdrs;                                   /*!< Additional headers in response packet */
     struct http_parser_url url_parse_res;           /*!< URL parsing result, used for retrieving URL elements */
+    unsigned        req_hdrs_indexed;               /*!< Count of request headers in the index */
+    struct req_hdr {
+        uint16_t        field;                      /*!< Offset of the field name in scratch buffer */
+        uint16_t        field_len;                  /*!< Length of the field name */
+        uint16_t        value;                      /*!< Offset of the null terminated value in scratch buffer */
+        uint16_t        value_len;                  /*!< Length of the value */
+        struct req_hdr *next;                       /*!< Next header in the same hash chain */
+    } **req_hdr_buckets;                            /*!< Hash chains of the request header index, NULL if empty */
+    size_t          arena_used;                     /*!< Bytes allocated from arena */
+    uintptr_t       arena[(CONFIG_HTTPD_REQ_ARENA_SIZE + sizeof(uintptr_t) - 1) / sizeof(uintptr_t)]; /*!< Bump allocated memory, reset for every request */
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     bool ws_handshake_detect;                       /*!< WebSocket handshake detection flag */
     httpd_ws_type_t ws_type;                        /*!< WebSocket frame type */
@@ -108,6 +132,16 @@ struct httpd_req_aux {
 #endif
 };
 
+/**
+ * @brief   Worker task processing requests on behalf of the server task
+ */
+struct httpd_worker {
+    struct httpd_data *hd;                  /*!< Server instance */
+    struct thread_data td;                  /*!< Information for the worker thread */
+    struct httpd_req req;                   /*!< The request processed by this worker */
+    struct httpd_req_aux req_aux;           /*!< Additional data about the request kept unexposed */
+};
+
 /**
  * @brief   Server data for each instance. This is exposed publicly as
  *          httpd_handle_t but internal structure/members are kept private.
@@ -123,10 +157,18 @@ struct httpd_data {
     struct thread_data hd_td;               /*!< Information for the HTTPD thread */
     struct sock_db *hd_sd;                  /*!< The socket database */
     int hd_sd_active_count;                 /*!< The number of the active sockets */
+    struct httpd_poller *hd_poll;           /*!< State of the socket poller backend */
     httpd_uri_t **hd_calls;                 /*!< Registered URI handlers */
+    struct httpd_uri_node *hd_uri_tree;     /*!< Routing tree of the registered URI handlers, see httpd_uri.c */
+    uint32_t hd_uri_seq;                    /*!< Registration sequence number of the next URI handler */
     struct httpd_req hd_req;                /*!< The current HTTPD request */
     struct httpd_req_aux hd_req_aux;        /*!< Additional data about the HTTPD request kept unexposed */
     uint64_t lru_counter;                   /*!< LRU counter */
+    struct httpd_worker *hd_workers;        /*!< Worker tasks, NULL if requests are processed by the server task */
+    int hd_worker_count;                    /*!< The number of running workers */
+    oqueue_t hd_work_queue;                 /*!< Sessions handed to the workers */
+    oqueue_t hd_done_queue;                 /*!< Sessions handed back by the workers, with the processing result */
+    atomic_bool hd_done_signalled;          /*!< A worker has sent a control message since the done queue was drained */
 
     /* Array of registered error handler functions */
     httpd_err_handler_func_t *err_handler_fns;
@@ -203,12 +245,15 @@ esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd);
  *
  * @param[in] hd      Server instance data
  * @param[in] session Session
+ * @param[in] r       Request structure to be used, owned by the calling task
+ * @param[in] ra      Storage for the auxiliary data of the request
  *
  * @return
  *  - ESP_OK    : on successfully receiving, parsing and responding to a request
  *  - ESP_FAIL  : in case of failure in any of the stages of processing
  */
-esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session);
+esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session,
+                             httpd_req_t *r, struct httpd_req_aux *ra);
 
 /**
  * @brief   Remove client descriptor from the session / socket database
@@ -296,6 +341,172 @@ void httpd_sess_close_all(struct httpd_data *hd);
  * @}
  */
 
+/****************** Group : Socket Polling ********************/
+/** @name Socket Polling
+ * Waiting for activity on the listening, control and session sockets.
+ * The backend is chosen at build time: select() by default, epoll on
+ * Linux hosts (CONFIG_HTTPD_POLL_EPOLL)
+ * @{
+ */
+
+/**
+ * @brief   Sockets found ready by httpd_poll_wait()
+ */
+struct httpd_poll_result {
+    bool ctrl_ready;            /*!< Control socket has a message */
+    bool listen_ready;          /*!< Listening socket has a connection request */
+    int sess_count;             /*!< Number of sessions to be processed */
+    struct sock_db **sessions;  /*!< Sessions to be processed, owned by the poller */
+};
+
+/**
+ * @brief   Creates the poller of a server instance. Must be called once the
+ *          listening and control sockets are open.
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return
+ *  - ESP_OK                  : on success
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : if memory allocation failed
+ *  - ESP_FAIL                : if the backend could not be set up
+ */
+esp_err_t httpd_poll_init(struct httpd_data *hd);
+
+/**
+ * @brief   Releases the poller of a server instance, if any
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_poll_deinit(struct httpd_data *hd);
+
+/**
+ * @brief   Starts watching the socket of a new session
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session, with the socket descriptor already set
+ *
+ * @return
+ *  - ESP_OK   : on success
+ *  - ESP_FAIL : if the socket cannot be watched
+ */
+esp_err_t httpd_poll_add(struct httpd_data *hd, struct sock_db *session);
+
+/**
+ * @brief   Stops watching the socket of a session. Must be called
+ *          before the socket is closed.
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ */
+void httpd_poll_del(struct httpd_data *hd, struct sock_db *session);
+
+/**
+ * @brief   Notifies the poller that a request of the session has been processed
+ *
+ * Lets the backend pick up sessions which still have data buffered
+ * in user space (see httpd_sess_pending()) and so will not be
+ * reported as readable by the socket.
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ */
+void httpd_poll_processed(struct httpd_data *hd, struct sock_db *session);
+
+/**
+ * @brief   Waits for activity on the server sockets
+ *
+ * Sessions in the result may get deleted while the control message
+ * is processed, the caller must skip those having a negative fd.
+ *
+ * @param[in]  hd  Server instance data
+ * @param[out] res Sockets ready for processing
+ *
+ * @return
+ *  - ESP_OK   : on success, res may be empty if the wait got interrupted
+ *  - ESP_FAIL : if waiting failed, e.g. because of an invalid descriptor
+ */
+esp_err_t httpd_poll_wait(struct httpd_data *hd, struct httpd_poll_result *res);
+
+/**
+ * @brief   Stops reporting activity of a session until httpd_poll_resume()
+ *          is called, e.g. while a worker owns it
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ */
+void httpd_poll_pause(struct httpd_data *hd, struct sock_db *session);
+
+/**
+ * @brief   Resumes reporting activity of a session paused by httpd_poll_pause()
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ */
+void httpd_poll_resume(struct httpd_data *hd, struct sock_db *session);
+
+/** End of Group : Socket Polling
+ * @}
+ */
+
+/****************** Group : Workers ********************/
+/** @name Workers
+ * Processing requests on a pool of worker tasks (httpd_config_t::worker_count).
+ * All functions except httpd_worker_current() must be called by the server task
+ * @{
+ */
+
+/**
+ * @brief   Starts the configured number of worker tasks, if any
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return
+ *  - ESP_OK                  : on success
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : if memory allocation failed
+ *  - ESP_ERR_HTTPD_TASK      : if a task could not be created
+ */
+esp_err_t httpd_workers_start(struct httpd_data *hd);
+
+/**
+ * @brief   Stops the worker tasks after they have finished their current
+ *          requests, and releases their resources
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_workers_stop(struct httpd_data *hd);
+
+/**
+ * @brief   Hands a session with incoming data over to the workers.
+ *          The session is not watched by the poller until it is handed back.
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ */
+void httpd_workers_dispatch(struct httpd_data *hd, struct sock_db *session);
+
+/**
+ * @brief   Takes back the sessions processed by the workers. Sessions whose
+ *          processing failed or whose closure was requested meanwhile are deleted.
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_workers_collect(struct httpd_data *hd);
+
+/**
+ * @brief   Returns the worker the calling task belongs to
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return
+ *  - Worker of the calling task
+ *  - NULL if not called by a worker task
+ */
+struct httpd_worker *httpd_worker_current(struct httpd_data *hd);
+
+/** End of Group : Workers
+ * @}
+ */
+
 /****************** Group : URI Handling ********************/
 /** @name URI Handling
  * Methods for accessing URI handlers
@@ -307,12 +518,38 @@ void httpd_sess_close_all(struct httpd_data *hd);
  *          and invokes the appropriate one if found
  *
  * @param[in] hd  Server instance data for which handler needs to be invoked
+ * @param[in] req The parsed request
  *
  * @return
  *  - ESP_OK    : if handler found and executed successfully
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_uri(struct httpd_data *hd);
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req);
+
+/**
+ * @brief   Finds the handler with matching URI and method
+ *
+ * With the default URI matching or httpd_uri_match_wildcard() as uri_match_fn
+ * the handlers are looked up in a routing tree, with a custom uri_match_fn
+ * all of them are matched in registration order. Either way, the first
+ * registered handler matching the URI and method is returned.
+ *
+ * @param[in]  hd       Server instance data
+ * @param[in]  uri      URI path to look up, need not be null terminated
+ * @param[in]  uri_len  Length of the URI path
+ * @param[in]  method   Method of the request
+ * @param[out] err      HTTPD_404_NOT_FOUND if no handler matches the URI,
+ *                      HTTPD_405_METHOD_NOT_ALLOWED if none of those matching
+ *                      the URI allows the method, 0 if found. Can be NULL.
+ *
+ * @return
+ *  - Handler found
+ *  - NULL : no handler matches both the URI and method
+ */
+httpd_uri_t *httpd_find_uri_handler(struct httpd_data *hd,
+                                    const char *uri, size_t uri_len,
+                                    httpd_method_t method,
+                                    httpd_err_code_t *err);
 
 /**
  * @brief   Unregister all URI handlers
@@ -362,24 +599,27 @@ bool httpd_validate_req_ptr(httpd_req_t *r);
  *
  * @param[in] hd  Server instance data
  * @param[in] sd  Pointer to socket which is needed for receiving TCP packets.
+ * @param[in] r   Request structure to be filled
+ * @param[in] ra  Storage for the auxiliary data of the request
  *
  * @return
  *  - ESP_OK    : if request packet is valid
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd);
+esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd,
+                        httpd_req_t *r, struct httpd_req_aux *ra);
 
 /**
  * @brief   For an HTTP request, resets the resources allocated for it and
  *          purges any data left to be received
  *
- * @param[in] hd  Server instance data
+ * @param[in] r   Request initialized by httpd_req_new()
  *
  * @return
  *  - ESP_OK    : if request packet deleted and resources cleaned.
  *  - ESP_FAIL  : otherwise.
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd);
+esp_err_t httpd_req_delete(httpd_req_t *r);
 
 /**
  * @brief   For handling HTTP errors by invoking registered
@@ -417,6 +657,35 @@ esp_err_t httpd_req_handle_err(httpd_req_t *req, httpd_err_code_t error);
  */
 int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len);
 
+/**
+ * @brief   For sending out all of the data, retrying partial sends
+ *
+ * @param[in] req     Pointer to the HTTP request for which the response needs to be sent
+ * @param[in] buf     Pointer to the data
+ * @param[in] buf_len Length of the data
+ *
+ * @return
+ *  - ESP_OK   : if all data was sent
+ *  - ESP_FAIL : if failed
+ */
+esp_err_t httpd_send_all(httpd_req_t *req, const char *buf, size_t buf_len);
+
+/**
+ * @brief   For sending out the status line and headers of a response with
+ *          the given content length, the body is to be sent with httpd_send_all()
+ *
+ * @note    Request headers are no longer available afterwards
+ *
+ * @param[in] req         Pointer to the HTTP request for which the response needs to be sent
+ * @param[in] content_len Value of the Content-Length header
+ *
+ * @return
+ *  - ESP_OK                 : if successful
+ *  - ESP_ERR_HTTPD_RESP_HDR : essential headers are too large for the scratch buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND: error in raw send
+ */
+esp_err_t httpd_resp_send_hdrs(httpd_req_t *req, size_t content_len);
+
 /**
  * @brief   For receiving HTTP request data
  *
@@ -444,7 +713,8 @@ int httpd_recv_with_opt(httpd_req_t *r, char *buf, size_t buf_len, bool halt_aft
  *
  * This function copies data into internal buffer pending_data so that
  * when httpd_recv is called, it first fetches this pending data and
- * then only starts receiving from the socket
+ * then only starts receiving from the socket. Data still pending is
+ * kept and will be received after the un-received data.
  *
  * @note    If data is too large for the internal buffer then only
  *          part of the data is unreceived, reflected in the returned
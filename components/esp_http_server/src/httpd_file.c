@@ -0,0 +1,475 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+static const char *TAG = "httpd_file";
+
+/* Request header values longer than this are treated as absent,
+ * which only means that the whole file is sent */
+#define HTTPD_FILE_HDR_LEN  128
+
+/* Source of the response body */
+struct httpd_file_src {
+    int fd;                 /*!< File to send, -1 for mapped data */
+    const char *data;       /*!< Mapped data */
+    size_t size;            /*!< Size of the file or mapped data */
+};
+
+enum httpd_file_range {
+    HTTPD_FILE_RANGE_NONE,          /*!< Send the whole body */
+    HTTPD_FILE_RANGE_OK,            /*!< Send the requested range */
+    HTTPD_FILE_RANGE_UNSATISFIABLE, /*!< Requested range is outside of the body */
+};
+
+static const struct {
+    const char *ext;
+    const char *type;
+} httpd_file_types[] = {
+    { ".html", "text/html" },
+    { ".htm", "text/html" },
+    { ".css", "text/css" },
+    { ".js", "application/javascript" },
+    { ".json", HTTPD_TYPE_JSON },
+    { ".txt", "text/plain" },
+    { ".xml", "text/xml" },
+    { ".png", "image/png" },
+    { ".jpg", "image/jpeg" },
+    { ".jpeg", "image/jpeg" },
+    { ".gif", "image/gif" },
+    { ".svg", "image/svg+xml" },
+    { ".ico", "image/x-icon" },
+    { ".woff2", "font/woff2" },
+    { ".wasm", "application/wasm" },
+    { ".pdf", "application/pdf" },
+};
+
+static const char *httpd_file_type(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    if (ext && !strchr(ext, '/')) {
+        for (size_t i = 0; i < sizeof(httpd_file_types) / sizeof(httpd_file_types[0]); i++) {
+            if (strcasecmp(ext, httpd_file_types[i].ext) == 0) {
+                return httpd_file_types[i].type;
+            }
+        }
+    }
+    return HTTPD_TYPE_OCTET;
+}
+
+static bool httpd_file_get_hdr(httpd_req_t *r, const char *field, char *val)
+{
+    return httpd_req_get_hdr_value_str(r, field, val, HTTPD_FILE_HDR_LEN) == ESP_OK;
+}
+
+/* Checks whether the list of entity tags in If-None-Match contains etag,
+ * using the weak comparison required for this header */
+static bool httpd_file_etag_match(const char *list, const char *etag)
+{
+    const size_t etag_len = strlen(etag);
+    while (*list) {
+        list += strspn(list, " ,");
+        if (*list == '*') {
+            return true;
+        }
+        if (strncmp(list, "W/", 2) == 0) {
+            list += 2;
+        }
+        size_t len = strcspn(list, " ,");
+        if (len == etag_len && strncmp(list, etag, len) == 0) {
+            return true;
+        }
+        list += len;
+    }
+    return false;
+}
+
+static bool httpd_file_parse_num(const char **str, size_t *num)
+{
+    char *end;
+    if (**str < '0' || **str > '9') {
+        return false;
+    }
+    errno = 0;
+    unsigned long long val = strtoull(*str, &end, 10);
+    if (errno || val > SIZE_MAX) {
+        return false;
+    }
+    *num = val;
+    *str = end;
+    return true;
+}
+
+/* Parses a single byte range ("bytes=first-last", "bytes=first-" or "bytes=-suffix").
+ * Anything else, including several ranges, is ignored and the whole body is sent */
+static enum httpd_file_range httpd_file_parse_range(const char *range, size_t size,
+                                                    size_t *start, size_t *len)
+{
+    if (strncmp(range, "bytes=", strlen("bytes=")) != 0) {
+        return HTTPD_FILE_RANGE_NONE;
+    }
+    range += strlen("bytes=");
+
+    size_t first = 0, last = SIZE_MAX;
+    bool suffix = *range == '-';
+    if (!suffix && !httpd_file_parse_num(&range, &first)) {
+        return HTTPD_FILE_RANGE_NONE;
+    }
+    if (*range++ != '-') {
+        return HTTPD_FILE_RANGE_NONE;
+    }
+    if ((*range || suffix) && !httpd_file_parse_num(&range, &last)) {
+        return HTTPD_FILE_RANGE_NONE;
+    }
+    if (*range || last < first) {
+        return HTTPD_FILE_RANGE_NONE;
+    }
+
+    if (suffix) {
+        /* The last bytes of the body */
+        if (last == 0 || size == 0) {
+            return HTTPD_FILE_RANGE_UNSATISFIABLE;
+        }
+        first = last < size ? size - last : 0;
+        last = size - 1;
+    } else if (first >= size) {
+        return HTTPD_FILE_RANGE_UNSATISFIABLE;
+    }
+    if (last >= size) {
+        last = size - 1;
+    }
+    *start = first;
+    *len = last - first + 1;
+    return HTTPD_FILE_RANGE_OK;
+}
+
+static esp_err_t httpd_file_send_fd(httpd_req_t *r, int fd, size_t start, size_t len)
+{
+    struct httpd_req_aux *ra = r->aux;
+
+    /* Let the kernel copy the file to the socket if nothing like TLS is in between */
+    if (ra->sd->send_fn == httpd_default_send) {
+        while (len > 0) {
+            ssize_t ret = httpd_os_sendfile(ra->sd->fd, fd, start, len);
+            if (ret <= 0) {
+                if (ret < 0 && errno == ENOSYS) {
+                    break;
+                }
+                ESP_LOGD(TAG, LOG_FMT("error in sendfile (%d)"), errno);
+                return ESP_ERR_HTTPD_RESP_SEND;
+            }
+            start += ret;
+            len -= ret;
+        }
+        if (len == 0) {
+            return ESP_OK;
+        }
+    }
+
+    if (lseek(fd, start, SEEK_SET) < 0) {
+        ESP_LOGE(TAG, LOG_FMT("error in lseek (%d)"), errno);
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    char *buf = malloc(CONFIG_HTTPD_FILE_BLOCK_SIZE);
+    if (!buf) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for file block"));
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Keep the reads aligned to the block size, so that filesystems like
+     * FAT can read whole sectors straight into the buffer */
+    size_t offset = start;
+    esp_err_t ret = ESP_OK;
+    while (len > 0) {
+        size_t block = CONFIG_HTTPD_FILE_BLOCK_SIZE - offset % CONFIG_HTTPD_FILE_BLOCK_SIZE;
+        ssize_t read_len = read(fd, buf, MIN(block, len));
+        if (read_len <= 0) {
+            ESP_LOGE(TAG, LOG_FMT("error reading file (%d)"), read_len < 0 ? errno : 0);
+            ret = ESP_ERR_HTTPD_RESP_SEND;
+            break;
+        }
+        if (httpd_send_all(r, buf, read_len) != ESP_OK) {
+            ret = ESP_ERR_HTTPD_RESP_SEND;
+            break;
+        }
+        offset += read_len;
+        len -= read_len;
+    }
+    free(buf);
+    return ret;
+}
+
+static esp_err_t httpd_file_respond(httpd_req_t *r, const struct httpd_file_src *src,
+                                    const char *etag)
+{
+    /* Header values set with httpd_resp_set_hdr() must stay valid until they are sent */
+    char content_range[48];
+    char val[HTTPD_FILE_HDR_LEN];
+    size_t start = 0;
+    size_t len = src->size;
+    bool head = r->method == HTTP_HEAD;
+    esp_err_t ret;
+
+    if ((ret = httpd_resp_set_hdr(r, "Accept-Ranges", "bytes")) != ESP_OK) {
+        return ret;
+    }
+    if (etag) {
+        if ((ret = httpd_resp_set_hdr(r, "ETag", etag)) != ESP_OK) {
+            return ret;
+        }
+        if (httpd_file_get_hdr(r, "If-None-Match", val) && httpd_file_etag_match(val, etag)) {
+            ESP_LOGD(TAG, LOG_FMT("not modified"));
+            httpd_resp_set_status(r, HTTPD_304);
+            return httpd_resp_send_hdrs(r, src->size);
+        }
+    }
+
+    /* If-Range asks for the whole body if it has changed */
+    bool range = true;
+    if (httpd_req_get_hdr_value_len(r, "If-Range")) {
+        range = etag && httpd_file_get_hdr(r, "If-Range", val) && strcmp(val, etag) == 0;
+    }
+    if (range && httpd_file_get_hdr(r, "Range", val)) {
+        switch (httpd_file_parse_range(val, src->size, &start, &len)) {
+        case HTTPD_FILE_RANGE_OK:
+            snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u",
+                     (unsigned) start, (unsigned) (start + len - 1), (unsigned) src->size);
+            httpd_resp_set_status(r, HTTPD_206);
+            if ((ret = httpd_resp_set_hdr(r, "Content-Range", content_range)) != ESP_OK) {
+                return ret;
+            }
+            break;
+        case HTTPD_FILE_RANGE_UNSATISFIABLE:
+            snprintf(content_range, sizeof(content_range), "bytes */%u", (unsigned) src->size);
+            httpd_resp_set_status(r, HTTPD_416);
+            if ((ret = httpd_resp_set_hdr(r, "Content-Range", content_range)) != ESP_OK) {
+                return ret;
+            }
+            return httpd_resp_send_hdrs(r, 0);
+        default:
+            break;
+        }
+    }
+
+    if ((ret = httpd_resp_send_hdrs(r, len)) != ESP_OK) {
+        return ret;
+    }
+    if (head || len == 0) {
+        return ESP_OK;
+    }
+
+    if (src->fd < 0) {
+        ret = httpd_send_all(r, src->data + start, len) == ESP_OK ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+    } else {
+        ret = httpd_file_send_fd(r, src->fd, start, len);
+    }
+    if (ret == ESP_OK) {
+        struct httpd_req_aux *ra = r->aux;
+        esp_http_server_event_data evt_data = {
+            .fd = ra->sd->fd,
+            .data_len = len,
+        };
+        esp_http_server_dispatch_event(HTTP_SERVER_EVENT_SENT_DATA, &evt_data, sizeof(esp_http_server_event_data));
+    }
+    return ret;
+}
+
+/* Accept-Encoding is only checked for the gzip coding, without weights */
+static bool httpd_file_accepts_gzip(httpd_req_t *r)
+{
+    char val[HTTPD_FILE_HDR_LEN];
+    return httpd_file_get_hdr(r, "Accept-Encoding", val) && strstr(val, "gzip");
+}
+
+esp_err_t httpd_resp_send_file(httpd_req_t *r, const char *path)
+{
+    if (r == NULL || path == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    size_t path_len = strlen(path);
+    char *gz_path = malloc(path_len + sizeof(".gz"));
+    if (!gz_path) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(gz_path, path, path_len);
+    memcpy(gz_path + path_len, ".gz", sizeof(".gz"));
+
+    /* Only regular files are sent, the size of anything else is meaningless */
+    struct stat st;
+    const char *send_path = path;
+    bool has_gz = stat(gz_path, &st) == 0 && S_ISREG(st.st_mode);
+    bool gzip = has_gz && httpd_file_accepts_gzip(r);
+    if (gzip) {
+        send_path = gz_path;
+    } else if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        free(gz_path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (has_gz) {
+        /* The response depends on the Accept-Encoding of the request */
+        httpd_resp_set_hdr(r, "Vary", "Accept-Encoding");
+    }
+
+    struct httpd_file_src src = {
+        .fd = open(send_path, O_RDONLY),
+        .size = st.st_size,
+    };
+    free(gz_path);
+    if (src.fd < 0) {
+        ESP_LOGW(TAG, LOG_FMT("error opening %s (%d)"), path, errno);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    struct httpd_req_aux *ra = r->aux;
+    if (strcmp(ra->content_type, HTTPD_TYPE_TEXT) == 0) {
+        httpd_resp_set_type(r, httpd_file_type(path));
+    }
+    esp_err_t ret = ESP_OK;
+    if (gzip) {
+        ret = httpd_resp_set_hdr(r, "Content-Encoding", "gzip");
+    }
+
+    /* Filesystems without modification times would give the same ETag
+     * to different contents of the same size, don't risk stale caches */
+    char etag[32];
+    bool has_etag = st.st_mtime != 0;
+    if (has_etag) {
+        snprintf(etag, sizeof(etag), "\"%x-%llx\"", (unsigned) st.st_size, (unsigned long long) st.st_mtime);
+    }
+
+    if (ret == ESP_OK) {
+        ESP_LOGD(TAG, LOG_FMT("sending %s (%u bytes)"), send_path == path ? path : "gzip variant", (unsigned) src.size);
+        ret = httpd_file_respond(r, &src, has_etag ? etag : NULL);
+    }
+    close(src.fd);
+    return ret;
+}
+
+esp_err_t httpd_resp_send_mapped(httpd_req_t *r, const void *data, size_t size, const char *etag)
+{
+    if (r == NULL || (data == NULL && size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    struct httpd_file_src src = {
+        .fd = -1,
+        .data = data,
+        .size = size,
+    };
+    return httpd_file_respond(r, &src, etag);
+}
+
+/* Checks for ".." path segments which would leave the base directory */
+static bool httpd_file_path_escapes(const char *path, size_t len)
+{
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (path[i] == '.' && path[i + 1] == '.' &&
+                (i == 0 || path[i - 1] == '/') &&
+                (i + 2 == len || path[i + 2] == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static esp_err_t httpd_file_server_handler(httpd_req_t *req)
+{
+    const httpd_file_server_config_t *config = req->user_ctx;
+
+    /* The handler is registered for uri_prefix followed by a '/' and the wildcard */
+    const char *uri = req->uri + strlen(config->uri_prefix);
+    size_t uri_len = strcspn(uri, "?#");
+    if (httpd_file_path_escapes(uri, uri_len)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+    }
+
+    const char *index_file = "";
+    if (uri_len == 0 || uri[uri_len - 1] == '/') {
+        if (!config->index_file) {
+            return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+        }
+        index_file = config->index_file;
+    }
+
+    size_t base_len = strlen(config->base_path);
+    char *path = malloc(base_len + uri_len + strlen(index_file) + 1);
+    if (!path) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+    memcpy(path, config->base_path, base_len);
+    memcpy(path + base_len, uri, uri_len);
+    strcpy(path + base_len + uri_len, index_file);
+
+    if (config->cache_control) {
+        httpd_resp_set_hdr(req, "Cache-Control", config->cache_control);
+    }
+    esp_err_t ret = httpd_resp_send_file(req, path);
+    free(path);
+    if (ret == ESP_ERR_NOT_FOUND) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    return ret;
+}
+
+esp_err_t httpd_register_file_server(httpd_handle_t handle, const httpd_file_server_config_t *config)
+{
+    if (handle == NULL || config == NULL || config->uri_prefix == NULL || config->base_path == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    if (hd->config.uri_match_fn != httpd_uri_match_wildcard) {
+        ESP_LOGE(TAG, LOG_FMT("file server needs httpd_uri_match_wildcard as uri_match_fn"));
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t prefix_len = strlen(config->uri_prefix);
+    char *uri = malloc(prefix_len + sizeof("/*"));
+    if (!uri) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(uri, config->uri_prefix, prefix_len);
+    memcpy(uri + prefix_len, "/*", sizeof("/*"));
+
+    httpd_uri_t file_server = {
+        .uri = uri,
+        .method = HTTP_GET,
+        .handler = httpd_file_server_handler,
+        .user_ctx = (void *) config,
+    };
+    esp_err_t ret = httpd_register_uri_handler(handle, &file_server);
+    if (ret == ESP_OK) {
+        file_server.method = HTTP_HEAD;
+        ret = httpd_register_uri_handler(handle, &file_server);
+        if (ret != ESP_OK) {
+            httpd_unregister_uri_handler(handle, uri, HTTP_GET);
+        }
+    }
+    free(uri);
+    return ret;
+}
@@ -1,10 +1,11 @@
 /*
- * SPDX-FileCopyrightText: 2018-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
 #include <string.h>
+#include <limits.h>
 #include <sys/socket.h>
 #include <sys/param.h>
 #include <errno.h>
@@ -20,7 +21,10 @@
 #include "freertos/semphr.h"
 #endif
 
-#if defined(CONFIG_LWIP_MAX_SOCKETS)
+#if HTTPD_POLL_EPOLL
+/* Host sockets are used on Linux, epoll is only limited by RLIMIT_NOFILE */
+#define HTTPD_MAX_SOCKETS INT_MAX
+#elif defined(CONFIG_LWIP_MAX_SOCKETS)
 #define HTTPD_MAX_SOCKETS CONFIG_LWIP_MAX_SOCKETS
 #else
 /* LwIP component is not included into the build, use a default value */
@@ -31,11 +35,6 @@ static const int DEFAULT_KEEP_ALIVE_IDLE = 5;
 static const int DEFAULT_KEEP_ALIVE_INTERVAL= 5;
 static const int DEFAULT_KEEP_ALIVE_COUNT= 3;
 
-typedef struct {
-    fd_set *fdset;
-    struct httpd_data *hd;
-} process_session_context_t;
-
 static const char *TAG = "httpd";
 
 ESP_EVENT_DEFINE_BASE(ESP_HTTP_SERVER_EVENT);
@@ -137,6 +136,7 @@ struct httpd_ctrl_data {
     enum httpd_ctrl_msg {
         HTTPD_CTRL_SHUTDOWN,
         HTTPD_CTRL_WORK,
+        HTTPD_CTRL_SESS_DONE,
     } hc_msg;
     httpd_work_fn_t hc_work;
     void *hc_work_arg;
@@ -231,6 +231,10 @@ static void httpd_process_ctrl_msg(struct httpd_data *hd)
             (*msg.hc_work)(msg.hc_work_arg);
         }
         break;
+    case HTTPD_CTRL_SESS_DONE:
+        /* Sessions handed back by the workers are collected by httpd_server() */
+        ESP_LOGD(TAG, LOG_FMT("session done"));
+        break;
     case HTTPD_CTRL_SHUTDOWN:
         ESP_LOGD(TAG, LOG_FMT("shutdown"));
         hd->hd_td.status = THREAD_STOPPING;
@@ -243,58 +247,194 @@ static void httpd_process_ctrl_msg(struct httpd_data *hd)
 #endif
 }
 
-// Called for each session from httpd_server
-static int httpd_process_session(struct sock_db *session, void *context)
+/* Result of processing a session on a worker */
+struct httpd_worker_done {
+    struct sock_db *session;
+    esp_err_t ret;
+};
+
+/* Wakes up the server task to collect the sessions handed back by the workers */
+static void httpd_worker_signal(struct httpd_data *hd)
+{
+    /* One message is enough for all sessions handed back
+     * until the server task drains the done queue */
+    if (atomic_exchange(&hd->hd_done_signalled, true)) {
+        return;
+    }
+
+    struct httpd_ctrl_data msg = {
+        .hc_msg = HTTPD_CTRL_SESS_DONE,
+    };
+#if CONFIG_HTTPD_QUEUE_WORK_BLOCKING
+    /* Don't wait for a free slot on the control socket. No message is sent
+     * then, so let the next worker which hands back a session try again */
+    if (xSemaphoreTake(hd->ctrl_sock_semaphore, 0) != pdTRUE) {
+        atomic_store(&hd->hd_done_signalled, false);
+        return;
+    }
+#endif
+    if (cs_send_to_ctrl_sock(hd->msg_fd, hd->config.ctrl_port, &msg, sizeof(msg)) < 0) {
+        ESP_LOGW(TAG, LOG_FMT("failed to signal session done"));
+        atomic_store(&hd->hd_done_signalled, false);
+#if CONFIG_HTTPD_QUEUE_WORK_BLOCKING
+        xSemaphoreGive(hd->ctrl_sock_semaphore);
+#endif
+    }
+}
+
+static void httpd_worker_thread(void *arg)
+{
+    struct httpd_worker *worker = (struct httpd_worker *) arg;
+    struct httpd_data *hd = worker->hd;
+    worker->td.status = THREAD_RUNNING;
+
+    struct sock_db *session;
+    /* A NULL session asks the worker to stop */
+    while (httpd_os_queue_recv(hd->hd_work_queue, &session, true) == OS_SUCCESS && session) {
+        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), session->fd);
+        struct httpd_worker_done done = {
+            .session = session,
+            .ret = httpd_sess_process(hd, session, &worker->req, &worker->req_aux),
+        };
+        httpd_os_queue_send(hd->hd_done_queue, &done);
+        httpd_worker_signal(hd);
+    }
+
+    worker->td.status = THREAD_STOPPED;
+    httpd_os_thread_delete();
+}
+
+esp_err_t httpd_workers_start(struct httpd_data *hd)
+{
+    int count = hd->config.worker_count;
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    hd->hd_workers = calloc(count, sizeof(struct httpd_worker));
+    if (!hd->hd_workers) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP workers"));
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    /* A session is queued at most once, plus one stop request per worker */
+    if (httpd_os_queue_create(&hd->hd_work_queue, hd->config.max_open_sockets + count,
+                              sizeof(struct sock_db *)) != OS_SUCCESS ||
+            httpd_os_queue_create(&hd->hd_done_queue, hd->config.max_open_sockets,
+                                  sizeof(struct httpd_worker_done)) != OS_SUCCESS) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to create HTTP worker queues"));
+        httpd_workers_stop(hd);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct httpd_worker *worker = &hd->hd_workers[i];
+        worker->hd = hd;
+        worker->req_aux.resp_hdrs = calloc(hd->config.max_resp_headers, sizeof(struct resp_hdr));
+        if (!worker->req_aux.resp_hdrs) {
+            ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP response headers"));
+            httpd_workers_stop(hd);
+            return ESP_ERR_HTTPD_ALLOC_MEM;
+        }
+        if (httpd_os_thread_create(&worker->td.handle, "httpd_worker",
+                                   hd->config.stack_size,
+                                   hd->config.task_priority,
+                                   httpd_worker_thread, worker,
+                                   tskNO_AFFINITY,
+                                   hd->config.task_caps) != ESP_OK) {
+            free(worker->req_aux.resp_hdrs);
+            worker->req_aux.resp_hdrs = NULL;
+            httpd_workers_stop(hd);
+            return ESP_ERR_HTTPD_TASK;
+        }
+        hd->hd_worker_count++;
+    }
+    return ESP_OK;
+}
+
+void httpd_workers_stop(struct httpd_data *hd)
 {
-    if ((!session) || (!context)) {
-        return 0;
+    if (!hd->hd_workers) {
+        return;
     }
 
-    if (session->fd < 0) {
-        return 1;
+    /* Queued sessions are processed before the stop requests */
+    struct sock_db *stop = NULL;
+    for (int i = 0; i < hd->hd_worker_count; i++) {
+        httpd_os_queue_send(hd->hd_work_queue, &stop);
+    }
+    for (int i = 0; i < hd->hd_worker_count; i++) {
+        while (hd->hd_workers[i].td.status != THREAD_STOPPED) {
+            httpd_os_thread_sleep(10);
+        }
+    }
+    hd->hd_worker_count = 0;
+
+    /* Sessions still marked as owned by a worker are closed
+     * along with all others by the caller */
+    for (int i = 0; i < hd->config.worker_count; i++) {
+        free(hd->hd_workers[i].req_aux.resp_hdrs);
+    }
+    if (hd->hd_done_queue) {
+        httpd_os_queue_delete(hd->hd_done_queue);
+        hd->hd_done_queue = NULL;
     }
+    if (hd->hd_work_queue) {
+        httpd_os_queue_delete(hd->hd_work_queue);
+        hd->hd_work_queue = NULL;
+    }
+    free(hd->hd_workers);
+    hd->hd_workers = NULL;
+}
+
+void httpd_workers_dispatch(struct httpd_data *hd, struct sock_db *session)
+{
+    httpd_poll_pause(hd, session);
+    session->in_worker = true;
+    httpd_os_queue_send(hd->hd_work_queue, &session);
+}
 
-    process_session_context_t *ctx = (process_session_context_t *)context;
-    int fd = session->fd;
+void httpd_workers_collect(struct httpd_data *hd)
+{
+    /* Clear the flag first, a worker handing back a session after
+     * this point sends a new message */
+    atomic_store(&hd->hd_done_signalled, false);
+
+    struct httpd_worker_done done;
+    while (httpd_os_queue_recv(hd->hd_done_queue, &done, false) == OS_SUCCESS) {
+        struct sock_db *session = done.session;
+        session->in_worker = false;
+        if (done.ret != ESP_OK || session->close_deferred) {
+            httpd_sess_delete(hd, session); // Delete session
+            continue;
+        }
+        session->lru_counter = ++hd->lru_counter;
+        httpd_poll_resume(hd, session);
+        httpd_poll_processed(hd, session);
+    }
+}
 
-    if (FD_ISSET(fd, ctx->fdset) || httpd_sess_pending(ctx->hd, session)) {
-        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), fd);
-        if (httpd_sess_process(ctx->hd, session) != ESP_OK) {
-            httpd_sess_delete(ctx->hd, session); // Delete session
+struct httpd_worker *httpd_worker_current(struct httpd_data *hd)
+{
+    othread_t self = httpd_os_thread_handle();
+    for (int i = 0; i < hd->hd_worker_count; i++) {
+        if (hd->hd_workers[i].td.handle == self) {
+            return &hd->hd_workers[i];
         }
     }
-    return 1;
+    return NULL;
 }
 
 /* Manage in-coming connection or data requests */
 static esp_err_t httpd_server(struct httpd_data *hd)
 {
-    fd_set read_set;
-    FD_ZERO(&read_set);
-    if (hd->config.lru_purge_enable || httpd_is_sess_available(hd)) {
-        /* Only listen for new connections if server has capacity to
-         * handle more (or when LRU purge is enabled, in which case
-         * older connections will be closed) */
-        FD_SET(hd->listen_fd, &read_set);
-    }
-    FD_SET(hd->ctrl_fd, &read_set);
-
-    int tmp_max_fd;
-    httpd_sess_set_descriptors(hd, &read_set, &tmp_max_fd);
-    int maxfd = MAX(hd->listen_fd, tmp_max_fd);
-    tmp_max_fd = maxfd;
-    maxfd = MAX(hd->ctrl_fd, tmp_max_fd);
-
-    ESP_LOGD(TAG, LOG_FMT("doing select maxfd+1 = %d"), maxfd + 1);
-    int active_cnt = select(maxfd + 1, &read_set, NULL, NULL, NULL);
-    if (active_cnt < 0) {
-        ESP_LOGE(TAG, LOG_FMT("error in select (%d)"), errno);
+    struct httpd_poll_result res;
+    if (httpd_poll_wait(hd, &res) != ESP_OK) {
         httpd_sess_delete_invalid(hd);
         return ESP_OK;
     }
 
     /* Case0: Do we have a control message? */
-    if (FD_ISSET(hd->ctrl_fd, &read_set)) {
+    if (res.ctrl_ready) {
         ESP_LOGD(TAG, LOG_FMT("processing ctrl message"));
         httpd_process_ctrl_msg(hd);
         if (hd->hd_td.status == THREAD_STOPPING) {
@@ -303,17 +443,35 @@ static esp_err_t httpd_server(struct httpd_data *hd)
         }
     }
 
+    if (hd->hd_workers) {
+        httpd_workers_collect(hd);
+    }
+
     /* Case1: Do we have any activity on the current data
      * sessions? */
-    process_session_context_t context = {
-        .fdset = &read_set,
-        .hd = hd
-    };
-    httpd_sess_enum(hd, httpd_process_session, &context);
+    for (int i = 0; i < res.sess_count; i++) {
+        struct sock_db *session = res.sessions[i];
+        if (session->fd < 0) {
+            /* Closed by the control message */
+            continue;
+        }
+        if (hd->hd_workers) {
+            ESP_LOGD(TAG, LOG_FMT("dispatching socket %d"), session->fd);
+            httpd_workers_dispatch(hd, session);
+            continue;
+        }
+        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), session->fd);
+        if (httpd_sess_process(hd, session, &hd->hd_req, &hd->hd_req_aux) != ESP_OK) {
+            httpd_sess_delete(hd, session); // Delete session
+        } else {
+            session->lru_counter = ++hd->lru_counter;
+            httpd_poll_processed(hd, session);
+        }
+    }
 
     /* Case2: Do we have any incoming connection requests to
      * process? */
-    if (FD_ISSET(hd->listen_fd, &read_set)) {
+    if (res.listen_ready) {
         ESP_LOGD(TAG, LOG_FMT("processing listen socket %d"), hd->listen_fd);
         if (httpd_accept_conn(hd, hd->listen_fd) != ESP_OK) {
             ESP_LOGW(TAG, LOG_FMT("error accepting new connection"));
@@ -338,6 +496,8 @@ static void httpd_thread(void *arg)
     }
 
     ESP_LOGD(TAG, LOG_FMT("web server exiting"));
+    /* Workers may still use the control socket until they are done */
+    httpd_workers_stop(hd);
     close(hd->msg_fd);
     cs_free_ctrl_sock(hd->ctrl_fd);
     httpd_sess_close_all(hd);
@@ -414,6 +574,14 @@ static esp_err_t httpd_server_init(struct httpd_data *hd)
     hd->listen_fd = fd;
     hd->ctrl_fd = ctrl_fd;
     hd->msg_fd  = msg_fd;
+
+    esp_err_t err = httpd_poll_init(hd);
+    if (err != ESP_OK) {
+        close(fd);
+        cs_free_ctrl_sock(ctrl_fd);
+        close(msg_fd);
+        return err;
+    }
     return ESP_OK;
 }
 
@@ -464,6 +632,7 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
 static void httpd_delete(struct httpd_data *hd)
 {
     struct httpd_req_aux *ra = &hd->hd_req_aux;
+    httpd_poll_deinit(hd);
     /* Free memory of httpd instance data */
     free(hd->err_handler_fns);
     free(ra->resp_hdrs);
@@ -516,12 +685,18 @@ esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
     }
 #endif
 
-    if (httpd_server_init(hd) != ESP_OK) {
+    esp_err_t err = httpd_server_init(hd);
+    if (err != ESP_OK) {
         httpd_delete(hd);
-        return ESP_FAIL;
+        return err == ESP_ERR_HTTPD_ALLOC_MEM ? err : ESP_FAIL;
     }
 
     httpd_sess_init(hd);
+    err = httpd_workers_start(hd);
+    if (err != ESP_OK) {
+        httpd_delete(hd);
+        return err;
+    }
     if (httpd_os_thread_create(&hd->hd_td.handle, "httpd",
                                hd->config.stack_size,
                                hd->config.task_priority,
@@ -529,6 +704,7 @@ esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
                                hd->config.core_id,
                                hd->config.task_caps) != ESP_OK) {
         /* Failed to launch task */
+        httpd_workers_stop(hd);
         httpd_delete(hd);
         return ESP_ERR_HTTPD_TASK;
     }
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -48,6 +48,12 @@ typedef struct {
         size_t      length;
     } last;
 
+    /* Field name of the header whose value is being parsed */
+    struct {
+        const char *at;
+        size_t      length;
+    } field;
+
     /* State variables */
     bool   paused;          /*!< Parser is paused */
     size_t pre_parsed;      /*!< Length of data to be skipped while parsing */
@@ -140,6 +146,72 @@ static esp_err_t cb_url(http_parser *parser,
     return ESP_OK;
 }
 
+/* Case insensitive FNV-1a hash of a header field name. Setting bit 5 turns
+ * upper case letters into lower case and leaves digits and '-' unchanged */
+static uint32_t hdr_hash(const char *field, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    while (length--) {
+        hash = (hash ^ (uint8_t)(*field++ | 0x20)) * 16777619u;
+    }
+    return hash;
+}
+
+/* Allocates from the arena of the request, which is reset for every request */
+static void *arena_alloc(struct httpd_req_aux *ra, size_t size)
+{
+    size_t offset = (ra->arena_used + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+    if (offset + size > sizeof(ra->arena)) {
+        return NULL;
+    }
+    ra->arena_used = offset + size;
+    return (char *)ra->arena + offset;
+}
+
+/* Adds the header that has just been parsed to the header index. If it doesn't
+ * fit, the index stays incomplete and the header getters scan the headers */
+static void index_header(parser_data_t *parser_data)
+{
+    struct httpd_req_aux *ra = parser_data->req->aux;
+
+    if (ra->req_hdrs_indexed != ra->req_hdrs_count) {
+        return;
+    }
+
+    size_t value = parser_data->last.at - ra->scratch;
+    if (value + parser_data->last.length > UINT16_MAX) {
+        return;
+    }
+
+    if (!ra->req_hdr_buckets) {
+        ra->req_hdr_buckets = arena_alloc(ra, HTTPD_REQ_HDR_BUCKETS * sizeof(struct req_hdr *));
+        if (!ra->req_hdr_buckets) {
+            return;
+        }
+        memset(ra->req_hdr_buckets, 0, HTTPD_REQ_HDR_BUCKETS * sizeof(struct req_hdr *));
+    }
+
+    struct req_hdr *hdr = arena_alloc(ra, sizeof(struct req_hdr));
+    if (!hdr) {
+        ESP_LOGD(TAG, LOG_FMT("header index full"));
+        return;
+    }
+    hdr->field     = parser_data->field.at - ra->scratch;
+    hdr->field_len = parser_data->field.length;
+    hdr->value     = value;
+    hdr->value_len = parser_data->last.length;
+    hdr->next      = NULL;
+
+    /* Append, so that the first of repeated headers is found */
+    struct req_hdr **link = &ra->req_hdr_buckets[hdr_hash(parser_data->field.at, parser_data->field.length) &
+                                                 (HTTPD_REQ_HDR_BUCKETS - 1)];
+    while (*link) {
+        link = &(*link)->next;
+    }
+    *link = hdr;
+    ra->req_hdrs_indexed++;
+}
+
 static esp_err_t pause_parsing(http_parser *parser, const char* at)
 {
     parser_data_t *parser_data = (parser_data_t *) parser->data;
@@ -227,6 +299,7 @@ static esp_err_t cb_header_field(http_parser *parser, const char *at, size_t len
          * (key: value) pair with null characters */
         char *term_start = (char *)parser_data->last.at + parser_data->last.length;
         memset(term_start, '\0', at - term_start);
+        index_header(parser_data);
 
         /* Store current values of the parser callback arguments */
         parser_data->last.at     = at;
@@ -258,6 +331,10 @@ static esp_err_t cb_header_value(http_parser *parser, const char *at, size_t len
 
     /* Check previous status */
     if (parser_data->status == PARSING_HDR_FIELD) {
+        /* Keep the field name for the header index */
+        parser_data->field.at     = parser_data->last.at;
+        parser_data->field.length = parser_data->last.length;
+
         /* Store current values of the parser callback arguments */
         parser_data->last.at     = at;
         parser_data->last.length = 0;
@@ -350,6 +427,8 @@ static esp_err_t cb_headers_complete(http_parser *parser)
             return ESP_FAIL;
         }
 
+        index_header(parser_data);
+
         /* Place the parser ptr right after the end of headers section */
         parser_data->last.at = at;
 
@@ -618,9 +697,8 @@ static void parse_init(httpd_req_t *r, http_parser *parser, parser_data_t *data)
 
 /* Function that receives TCP data and runs parser on it
  */
-static esp_err_t httpd_parse_req(struct httpd_data *hd)
+static esp_err_t httpd_parse_req(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     int blk_len,  offset;
     http_parser   parser = {};
     parser_data_t parser_data = {};
@@ -660,7 +738,7 @@ static esp_err_t httpd_parse_req(struct httpd_data *hd)
     } while (parser_data.status != PARSING_COMPLETE);
 
     ESP_LOGD(TAG, LOG_FMT("parsing complete"));
-    return httpd_uri(hd);
+    return httpd_uri(hd, r);
 }
 
 static void init_req(httpd_req_t *r, httpd_config_t *config)
@@ -685,6 +763,9 @@ static void init_req_aux(struct httpd_req_aux *ra, httpd_config_t *config)
     ra->content_type = 0;
     ra->first_chunk_sent = 0;
     ra->req_hdrs_count = 0;
+    ra->req_hdrs_indexed = 0;
+    ra->req_hdr_buckets = NULL;
+    ra->arena_used = 0;
     ra->resp_hdrs_count = 0;
 #if CONFIG_HTTPD_WS_SUPPORT
     ra->ws_handshake_detect = false;
@@ -715,6 +796,10 @@ static void httpd_req_cleanup(httpd_req_t *r)
     ra->sd->ignore_sess_ctx_changes = r->ignore_sess_ctx_changes;
 
     /* Clear out the request and request_aux structures */
+    ra->req_hdrs_count = 0;
+    ra->req_hdrs_indexed = 0;
+    ra->req_hdr_buckets = NULL;
+    ra->arena_used = 0;
     ra->sd = NULL;
     r->handle = NULL;
     r->aux = NULL;
@@ -724,16 +809,15 @@ static void httpd_req_cleanup(httpd_req_t *r)
 /* Function that processes incoming TCP data and
  * updates the http request data httpd_req_t
  */
-esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
+esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd,
+                        httpd_req_t *r, struct httpd_req_aux *ra)
 {
-    httpd_req_t *r = &hd->hd_req;
     init_req(r, &hd->config);
-    init_req_aux(&hd->hd_req_aux, &hd->config);
+    init_req_aux(ra, &hd->config);
     r->handle = hd;
-    r->aux = &hd->hd_req_aux;
+    r->aux = ra;
 
     /* Associate the request to the socket */
-    struct httpd_req_aux *ra = r->aux;
     ra->sd = sd;
 
     /* Set defaults */
@@ -788,7 +872,7 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 #endif
 
     /* Parse request */
-    ret = httpd_parse_req(hd);
+    ret = httpd_parse_req(hd, r);
     if (ret != ESP_OK) {
         httpd_req_cleanup(r);
     }
@@ -797,9 +881,8 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 
 /* Function that resets the http request data
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd)
+esp_err_t httpd_req_delete(httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     struct httpd_req_aux *ra = r->aux;
 
     /* Finish off reading any pending/leftover data */
@@ -839,8 +922,9 @@ bool httpd_validate_req_ptr(httpd_req_t *r)
         struct httpd_data *hd = (struct httpd_data *) r->handle;
         if (hd) {
             /* Check if this function is running in the context of
-             * the correct httpd server thread */
-            if (httpd_os_thread_handle() == hd->hd_td.handle) {
+             * the correct httpd server thread or one of its workers */
+            if (httpd_os_thread_handle() == hd->hd_td.handle ||
+                    httpd_worker_current(hd) != NULL) {
                 return true;
             }
         }
@@ -956,18 +1040,27 @@ esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len)
     return ESP_ERR_NOT_FOUND;
 }
 
-/* Get the length of the value string of a header request field */
-size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+/* Finds the value of a header request field, NULL if not found */
+static const char *httpd_req_find_hdr(struct httpd_req_aux *ra, const char *field, size_t *val_len)
 {
-    if (r == NULL || field == NULL) {
-        return 0;
-    }
+    size_t field_len = strlen(field);
 
-    if (!httpd_valid_req(r)) {
-        return 0;
+    /* Headers are looked up in the index unless some did not fit into it */
+    if (ra->req_hdrs_indexed == ra->req_hdrs_count) {
+        if (!ra->req_hdrs_count) {
+            return NULL;
+        }
+        const struct req_hdr *hdr = ra->req_hdr_buckets[hdr_hash(field, field_len) & (HTTPD_REQ_HDR_BUCKETS - 1)];
+        for (; hdr; hdr = hdr->next) {
+            if ((hdr->field_len == field_len) &&
+                    (strncasecmp(ra->scratch + hdr->field, field, field_len) == 0)) {
+                *val_len = hdr->value_len;
+                return ra->scratch + hdr->value;
+            }
+        }
+        return NULL;
     }
 
-    struct httpd_req_aux *ra = r->aux;
     const char   *hdr_ptr = ra->scratch;         /*!< Request headers are kept in scratch buffer */
     unsigned      count   = ra->req_hdrs_count;  /*!< Count set during parsing  */
 
@@ -984,8 +1077,8 @@ size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
          * Compare lengths first as field from header is not
          * null terminated (has ':' in the end).
          */
-        if ((val_ptr - hdr_ptr != strlen(field)) ||
-            (strncasecmp(hdr_ptr, field, strlen(field)))) {
+        if ((val_ptr - hdr_ptr != field_len) ||
+            (strncasecmp(hdr_ptr, field, field_len))) {
             if (count) {
                 /* Jump to end of header field-value string */
                 hdr_ptr = 1 + strchr(hdr_ptr, '\0');
@@ -1006,9 +1099,26 @@ size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
         while ((*val_ptr != '\0') && (*val_ptr == ' ')) {
             val_ptr++;
         }
-        return strlen(val_ptr);
+        *val_len = strlen(val_ptr);
+        return val_ptr;
     }
-    return 0;
+    return NULL;
+}
+
+/* Get the length of the value string of a header request field */
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+{
+    if (r == NULL || field == NULL) {
+        return 0;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return 0;
+    }
+
+    size_t val_len = 0;
+    httpd_req_find_hdr(r->aux, field, &val_len);
+    return val_len;
 }
 
 /* Get the value of a field from the request headers */
@@ -1022,60 +1132,24 @@ esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *v
         return ESP_ERR_HTTPD_INVALID_REQ;
     }
 
-    struct httpd_req_aux *ra = r->aux;
-    const char   *hdr_ptr = ra->scratch;         /*!< Request headers are kept in scratch buffer */
-    unsigned     count    = ra->req_hdrs_count;  /*!< Count set during parsing  */
-    const size_t buf_len  = val_size;
-
-    while (count--) {
-        /* Search for the ':' character. Else, it would mean
-         * that the field is invalid
-         */
-        const char *val_ptr = strchr(hdr_ptr, ':');
-        if (!val_ptr) {
-            break;
-        }
-
-        /* If the field, does not match, continue searching.
-         * Compare lengths first as field from header is not
-         * null terminated (has ':' in the end).
-         */
-        if ((val_ptr - hdr_ptr != strlen(field)) ||
-            (strncasecmp(hdr_ptr, field, strlen(field)))) {
-            if (count) {
-                /* Jump to end of header field-value string */
-                hdr_ptr = 1 + strchr(hdr_ptr, '\0');
-
-                /* Skip all null characters (with which the line
-                 * terminators had been overwritten) */
-                while (*hdr_ptr == '\0') {
-                    hdr_ptr++;
-                }
-            }
-            continue;
-        }
-
-        /* Skip ':' */
-        val_ptr++;
-
-        /* Skip preceding space */
-        while ((*val_ptr != '\0') && (*val_ptr == ' ')) {
-            val_ptr++;
-        }
-
-        /* Get the NULL terminated value and copy it to the caller's buffer. */
-        strlcpy(val, val_ptr, buf_len);
+    size_t val_len;
+    const char *val_ptr = httpd_req_find_hdr(r->aux, field, &val_len);
+    if (!val_ptr) {
+        return ESP_ERR_NOT_FOUND;
+    }
 
-        /* Update value length, including one byte for null */
-        val_size = strlen(val_ptr) + 1;
+    /* Copy the value to the caller's buffer, null terminated */
+    if (val_size) {
+        size_t copy_len = MIN(val_len, val_size - 1);
+        memcpy(val, val_ptr, copy_len);
+        val[copy_len] = '\0';
+    }
 
-        /* If buffer length is smaller than needed, return truncation error */
-        if (buf_len < val_size) {
-            return ESP_ERR_HTTPD_RESULT_TRUNC;
-        }
-        return ESP_OK;
+    /* If buffer length is smaller than needed, return truncation error */
+    if (val_size < val_len + 1) {
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
     }
-    return ESP_ERR_NOT_FOUND;
+    return ESP_OK;
 }
 
 /* Helper function to get a cookie value from a cookie string of the type "cookie1=val1; cookie2=val2" */
@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+#if !HTTPD_POLL_EPOLL
+
+static const char *TAG = "httpd_poll";
+
+struct httpd_poller {
+    fd_set read_set;                /*!< Descriptors found readable by the last select() */
+    bool pending;                   /*!< A processed session still has data buffered in user space */
+    int sess_count;                 /*!< Number of entries in sessions */
+    struct sock_db *sessions[];     /*!< Sessions to be processed, max_open_sockets entries */
+};
+
+esp_err_t httpd_poll_init(struct httpd_data *hd)
+{
+    hd->hd_poll = calloc(1, sizeof(struct httpd_poller) + hd->config.max_open_sockets * sizeof(struct sock_db *));
+    if (!hd->hd_poll) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP poller"));
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    return ESP_OK;
+}
+
+void httpd_poll_deinit(struct httpd_data *hd)
+{
+    free(hd->hd_poll);
+    hd->hd_poll = NULL;
+}
+
+/* The descriptor set is rebuilt from the socket database on every wait,
+ * so there is nothing to track when sessions come and go */
+esp_err_t httpd_poll_add(struct httpd_data *hd, struct sock_db *session)
+{
+    return ESP_OK;
+}
+
+void httpd_poll_del(struct httpd_data *hd, struct sock_db *session)
+{
+}
+
+/* Every session is checked with httpd_sess_pending() on each wait,
+ * just make sure that the next wait doesn't block in that case */
+void httpd_poll_processed(struct httpd_data *hd, struct sock_db *session)
+{
+    if (httpd_sess_pending(hd, session)) {
+        hd->hd_poll->pending = true;
+    }
+}
+
+/* Paused sessions are left out of the descriptor set (see
+ * httpd_sess_set_descriptors()) and are not collected */
+void httpd_poll_pause(struct httpd_data *hd, struct sock_db *session)
+{
+    session->poll_paused = true;
+}
+
+void httpd_poll_resume(struct httpd_data *hd, struct sock_db *session)
+{
+    session->poll_paused = false;
+}
+
+// Called for each session from httpd_poll_wait
+static int httpd_poll_collect_session(struct sock_db *session, void *context)
+{
+    if ((!session) || (!context)) {
+        return 0;
+    }
+
+    if (session->fd < 0 || session->poll_paused) {
+        return 1;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *)context;
+    struct httpd_poller *poll = hd->hd_poll;
+    if (FD_ISSET(session->fd, &poll->read_set) || httpd_sess_pending(hd, session)) {
+        poll->sessions[poll->sess_count++] = session;
+    }
+    return 1;
+}
+
+esp_err_t httpd_poll_wait(struct httpd_data *hd, struct httpd_poll_result *res)
+{
+    struct httpd_poller *poll = hd->hd_poll;
+    fd_set *read_set = &poll->read_set;
+    FD_ZERO(read_set);
+    if (hd->config.lru_purge_enable || httpd_is_sess_available(hd)) {
+        /* Only listen for new connections if server has capacity to
+         * handle more (or when LRU purge is enabled, in which case
+         * older connections will be closed) */
+        FD_SET(hd->listen_fd, read_set);
+    }
+    FD_SET(hd->ctrl_fd, read_set);
+
+    int tmp_max_fd;
+    httpd_sess_set_descriptors(hd, read_set, &tmp_max_fd);
+    int maxfd = MAX(hd->listen_fd, tmp_max_fd);
+    tmp_max_fd = maxfd;
+    maxfd = MAX(hd->ctrl_fd, tmp_max_fd);
+
+    struct timeval no_wait = { 0 };
+    struct timeval *timeout = poll->pending ? &no_wait : NULL;
+    poll->pending = false;
+
+    ESP_LOGD(TAG, LOG_FMT("doing select maxfd+1 = %d"), maxfd + 1);
+    int active_cnt = select(maxfd + 1, read_set, NULL, NULL, timeout);
+    if (active_cnt < 0) {
+        ESP_LOGE(TAG, LOG_FMT("error in select (%d)"), errno);
+        return ESP_FAIL;
+    }
+
+    poll->sess_count = 0;
+    httpd_sess_enum(hd, httpd_poll_collect_session, hd);
+
+    res->ctrl_ready = FD_ISSET(hd->ctrl_fd, read_set);
+    res->listen_ready = FD_ISSET(hd->listen_fd, read_set);
+    res->sess_count = poll->sess_count;
+    res->sessions = poll->sessions;
+    return ESP_OK;
+}
+
+#endif /* !HTTPD_POLL_EPOLL */
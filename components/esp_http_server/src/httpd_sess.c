@@ -1,9 +1,10 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <stdlib.h>
+#include <string.h>
 #include <esp_log.h>
 #include <esp_err.h>
 #include <fcntl.h>
@@ -15,6 +16,14 @@
 
 static const char *TAG = "httpd_sess";
 
+/* Request being processed by the calling task. Its aux member is NULL
+ * when there is none */
+static httpd_req_t *httpd_sess_current_req(struct httpd_data *hd)
+{
+    struct httpd_worker *worker = httpd_worker_current(hd);
+    return worker ? &worker->req : &hd->hd_req;
+}
+
 typedef enum {
     HTTPD_TASK_NONE = 0,
     HTTPD_TASK_INIT,            // Init session
@@ -87,7 +96,7 @@ static int enum_function(struct sock_db *session, void *context)
         break;
     // Set descriptor
     case HTTPD_TASK_SET_DESCRIPTOR:
-        if (session->fd != -1) {
+        if (session->fd != -1 && !session->poll_paused) {
             FD_SET(session->fd, ctx->fdset);
             if (session->fd > ctx->max_fd) {
                 ctx->max_fd = session->fd;
@@ -96,7 +105,8 @@ static int enum_function(struct sock_db *session, void *context)
         break;
     // Delete invalid session
     case HTTPD_TASK_DELETE_INVALID:
-        if (!fd_is_valid(session->fd)) {
+        // Sessions owned by a worker are deleted once they are handed back
+        if (!session->in_worker && !fd_is_valid(session->fd)) {
             ESP_LOGW(TAG, LOG_FMT("Closing invalid socket %d"), session->fd);
             httpd_sess_delete(ctx->hd, session);
         }
@@ -108,7 +118,7 @@ static int enum_function(struct sock_db *session, void *context)
             return 0;
         }
         // Only close sockets that are not in use
-        if (session->for_async_req == false) {
+        if (session->for_async_req == false && session->in_worker == false) {
             // Check/update lowest lru
             if (session->lru_counter < ctx->lru_counter) {
                 ctx->lru_counter = session->lru_counter;
@@ -144,6 +154,11 @@ static void httpd_sess_close(void *arg)
         return;
     }
     sock_db->lru_socket = false;
+    if (sock_db->in_worker) {
+        // Deleted by httpd_workers_collect() once the worker hands it back
+        sock_db->close_deferred = true;
+        return;
+    }
     struct httpd_data *hd = (struct httpd_data *) sock_db->handle;
     httpd_sess_delete(hd, sock_db);
 }
@@ -173,8 +188,9 @@ struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd)
 
     // Check if called inside a request handler, and the session sockfd in use is same as the parameter
     // => Just return the pointer to the sock_db corresponding to the request
-    if ((hd->hd_req_aux.sd) && (hd->hd_req_aux.sd->fd == sockfd)) {
-        return hd->hd_req_aux.sd;
+    struct httpd_req_aux *ra = httpd_sess_current_req(hd)->aux;
+    if ((ra) && (ra->sd) && (ra->sd->fd == sockfd)) {
+        return ra->sd;
     }
 
     enum_context_t context = {
@@ -207,6 +223,12 @@ esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd)
     session->send_fn = httpd_default_send;
     session->recv_fn = httpd_default_recv;
 
+    if (httpd_poll_add(hd, session) != ESP_OK) {
+        ESP_LOGD(TAG, LOG_FMT("unable to watch fd = %d"), newfd);
+        session->fd = -1;
+        return ESP_FAIL;
+    }
+
     // increment number of sessions
     hd->hd_sd_active_count++;
 
@@ -267,9 +289,10 @@ void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd)
     // Check if the function has been called from inside a
     // request handler, in which case fetch the context from
     // the httpd_req_t structure
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == session) {
-        return hd->hd_req.sess_ctx;
+    httpd_req_t *r = httpd_sess_current_req((struct httpd_data *) handle);
+    struct httpd_req_aux *ra = r->aux;
+    if (ra && ra->sd == session) {
+        return r->sess_ctx;
     }
     return session->ctx;
 }
@@ -284,17 +307,18 @@ void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void *ctx, httpd_free
     // Check if the function has been called from inside a
     // request handler, in which case set the context inside
     // the httpd_req_t structure
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == session) {
-        if (hd->hd_req.sess_ctx != ctx) {
+    httpd_req_t *r = httpd_sess_current_req((struct httpd_data *) handle);
+    struct httpd_req_aux *ra = r->aux;
+    if (ra && ra->sd == session) {
+        if (r->sess_ctx != ctx) {
             // Don't free previous context if it is in sockdb
             // as it will be freed inside httpd_req_cleanup()
-            if (session->ctx != hd->hd_req.sess_ctx) {
-                httpd_sess_free_ctx(&hd->hd_req.sess_ctx, hd->hd_req.free_ctx); // Free previous context
+            if (session->ctx != r->sess_ctx) {
+                httpd_sess_free_ctx(&r->sess_ctx, r->free_ctx); // Free previous context
             }
-            hd->hd_req.sess_ctx = ctx;
+            r->sess_ctx = ctx;
         }
-        hd->hd_req.free_ctx = free_fn;
+        r->free_ctx = free_fn;
         return;
     }
 
@@ -367,6 +391,9 @@ void httpd_sess_delete(struct httpd_data *hd, struct sock_db *session)
         }
     }
 
+    // Stop watching the socket while the descriptor is still valid
+    httpd_poll_del(hd, session);
+
     // Call close function if defined
     if (hd->config.close_fn) {
         hd->config.close_fn(hd, session->fd);
@@ -412,26 +439,57 @@ bool httpd_sess_pending(struct httpd_data *hd, struct sock_db *session)
     return (session->pending_len != 0);
 }
 
+/* Checks if the pending buffer of the session holds the complete
+ * header section of another request, which can then be parsed
+ * without waiting for the socket */
+static bool httpd_sess_pending_req(struct sock_db *session)
+{
+    if (session->pending_len == 0 || session->fd < 0) {
+        return false;
+    }
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    if (session->ws_handshake_done) {
+        return false;
+    }
+#endif
+    const char *data = session->pending_data + sizeof(session->pending_data) - session->pending_len;
+    const char *end  = data + session->pending_len;
+    const char *lf   = memchr(data, '\n', end - data);
+    while (lf && lf + 1 < end) {
+        /* An empty line, with either CRLF or LF line terminator */
+        if (lf[1] == '\n' || (lf[1] == '\r' && lf + 2 < end && lf[2] == '\n')) {
+            return true;
+        }
+        lf = memchr(lf + 1, '\n', end - lf - 1);
+    }
+    return false;
+}
+
 /* This MUST return ESP_OK on successful execution. If any other
  * value is returned, everything related to this socket will be
  * cleaned up and the socket will be closed.
  */
-esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session)
+esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session,
+                             httpd_req_t *r, struct httpd_req_aux *ra)
 {
     if ((!hd) || (!session)) {
         return ESP_FAIL;
     }
 
-    ESP_LOGD(TAG, LOG_FMT("httpd_req_new"));
-    if (httpd_req_new(hd, session) != ESP_OK) {
-        return ESP_FAIL;
-    }
-    ESP_LOGD(TAG, LOG_FMT("httpd_req_delete"));
-    if (httpd_req_delete(hd) != ESP_OK) {
-        return ESP_FAIL;
-    }
+    /* Requests pipelined by the client are served right away as long as
+     * they have been received completely, bounded for fairness */
+    int burst = HTTPD_PIPELINE_BURST;
+    do {
+        ESP_LOGD(TAG, LOG_FMT("httpd_req_new"));
+        if (httpd_req_new(hd, session, r, ra) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        ESP_LOGD(TAG, LOG_FMT("httpd_req_delete"));
+        if (httpd_req_delete(r) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    } while (--burst && httpd_sess_pending_req(session));
     ESP_LOGD(TAG, LOG_FMT("success"));
-    session->lru_counter = ++hd->lru_counter;
     return ESP_OK;
 }
 
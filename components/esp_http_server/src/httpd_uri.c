@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -80,17 +80,347 @@ bool httpd_uri_match_wildcard(const char *template, const char *uri, size_t len)
     }
 }
 
-/* Find handler with matching URI and method, and set
- * appropriate error code if URI or method not found */
-static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
-                                           const char *uri, size_t uri_len,
-                                           httpd_method_t method,
-                                           httpd_err_code_t *err)
+/* URI routing tree
+ *
+ * With the default URI matching or httpd_uri_match_wildcard() the registered
+ * handlers are also kept in a radix tree, so a lookup walks the path once
+ * instead of matching every registered template. A template is stored as
+ * up to two routes (see httpd_uri_routes()):
+ *  - an exact route matches the URI ending at its node
+ *  - a prefix route matches every URI passing through its node
+ * Routes carry the registration sequence number, so that the first
+ * registered handler wins like with the linear scan. Custom URI
+ * matching functions are opaque and always use the linear scan. */
+struct httpd_uri_route {
+    struct httpd_uri_route *next;       /*!< Next route on the same node, in registration order */
+    httpd_uri_t *handler;               /*!< Registered handler */
+    uint32_t seq;                       /*!< Registration sequence number of the handler */
+};
+
+struct httpd_uri_node {
+    struct httpd_uri_route *exact;      /*!< Routes matching URIs ending at this node */
+    struct httpd_uri_route *prefix;     /*!< Routes matching URIs passing through this node */
+    struct httpd_uri_node **children;   /*!< Child nodes, sorted by the first character of the label */
+    size_t child_count;                 /*!< Number of entries in children */
+    size_t label_len;                   /*!< Length of label */
+    char label[];                       /*!< Part of the path from the parent to this node, not null terminated */
+};
+
+/* Part of a template a route is stored under */
+struct httpd_uri_key {
+    size_t len;                         /*!< Length of the template prefix the route is stored under */
+    bool prefix;                        /*!< Prefix route, else exact route */
+};
+
+static bool httpd_uri_tree_enabled(struct httpd_data *hd)
+{
+    return !hd->config.uri_match_fn || hd->config.uri_match_fn == httpd_uri_match_wildcard;
+}
+
+/* Splits a template into the routes matching the same URIs as
+ * httpd_uri_match_wildcard() does, returns the number of routes */
+static int httpd_uri_routes(struct httpd_data *hd, const char *template,
+                            struct httpd_uri_key keys[2])
+{
+    const size_t tpl_len = strlen(template);
+    if (!hd->config.uri_match_fn) {
+        keys[0].len = tpl_len;
+        keys[0].prefix = false;
+        return 1;
+    }
+
+    const char last = (const char) (tpl_len > 0 ? template[tpl_len - 1] : 0);
+    const char prevlast = (const char) (tpl_len > 1 ? template[tpl_len - 2] : 0);
+    const bool asterisk = last == '*' || (prevlast == '*' && last == '?');
+    const bool quest = last == '?' || (prevlast == '?' && last == '*');
+
+    if (tpl_len < asterisk + quest*2) {
+        /* Invalid template, never matches */
+        return 0;
+    }
+    const size_t exact_match_chars = tpl_len - (asterisk + quest*2);
+
+    if (!quest) {
+        keys[0].len = exact_match_chars;
+        keys[0].prefix = asterisk;
+        return 1;
+    }
+    /* Either only the mandatory part, or followed by the optional
+     * character, which is at template[exact_match_chars] */
+    keys[0].len = exact_match_chars;
+    keys[0].prefix = false;
+    keys[1].len = exact_match_chars + 1;
+    keys[1].prefix = asterisk;
+    return 2;
+}
+
+/* Returns the index of the child with the label starting with c,
+ * or the index to insert such a child at */
+static size_t httpd_uri_node_find(const struct httpd_uri_node *node, char c, bool *found)
+{
+    size_t lo = 0, hi = node->child_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        char first = node->children[mid]->label[0];
+        if (first == c) {
+            *found = true;
+            return mid;
+        }
+        if ((unsigned char) first < (unsigned char) c) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = false;
+    return lo;
+}
+
+static struct httpd_uri_node *httpd_uri_node_new(const char *label, size_t len)
+{
+    struct httpd_uri_node *node = calloc(1, sizeof(struct httpd_uri_node) + len);
+    if (node && len) {
+        memcpy(node->label, label, len);
+        node->label_len = len;
+    }
+    return node;
+}
+
+static esp_err_t httpd_uri_node_add_child(struct httpd_uri_node *node, size_t index,
+                                          struct httpd_uri_node *child)
+{
+    struct httpd_uri_node **children = realloc(node->children,
+                                               (node->child_count + 1) * sizeof(struct httpd_uri_node *));
+    if (!children) {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    memmove(&children[index + 1], &children[index],
+            (node->child_count - index) * sizeof(struct httpd_uri_node *));
+    children[index] = child;
+    node->children = children;
+    node->child_count++;
+    return ESP_OK;
+}
+
+static void httpd_uri_node_free(struct httpd_uri_node *node)
+{
+    for (struct httpd_uri_route *route = node->exact, *next; route; route = next) {
+        next = route->next;
+        free(route);
+    }
+    for (struct httpd_uri_route *route = node->prefix, *next; route; route = next) {
+        next = route->next;
+        free(route);
+    }
+    for (size_t i = 0; i < node->child_count; i++) {
+        httpd_uri_node_free(node->children[i]);
+    }
+    free(node->children);
+    free(node);
+}
+
+static esp_err_t httpd_uri_tree_insert(struct httpd_data *hd, const char *key,
+                                       const struct httpd_uri_key *route_key,
+                                       httpd_uri_t *handler, uint32_t seq)
+{
+    if (!hd->hd_uri_tree) {
+        hd->hd_uri_tree = httpd_uri_node_new(NULL, 0);
+        if (!hd->hd_uri_tree) {
+            return ESP_ERR_HTTPD_ALLOC_MEM;
+        }
+    }
+
+    struct httpd_uri_route *route = calloc(1, sizeof(struct httpd_uri_route));
+    if (!route) {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    route->handler = handler;
+    route->seq = seq;
+
+    struct httpd_uri_node *node = hd->hd_uri_tree;
+    size_t len = route_key->len;
+    while (len > 0) {
+        bool found;
+        size_t index = httpd_uri_node_find(node, key[0], &found);
+        if (!found) {
+            struct httpd_uri_node *child = httpd_uri_node_new(key, len);
+            if (!child || httpd_uri_node_add_child(node, index, child) != ESP_OK) {
+                free(child);
+                free(route);
+                return ESP_ERR_HTTPD_ALLOC_MEM;
+            }
+            node = child;
+            break;
+        }
+
+        struct httpd_uri_node *child = node->children[index];
+        size_t common = 1;
+        while (common < child->label_len && common < len && child->label[common] == key[common]) {
+            common++;
+        }
+        if (common < child->label_len) {
+            /* Split the label, the new node takes the common part */
+            struct httpd_uri_node *split = httpd_uri_node_new(child->label, common);
+            if (!split || httpd_uri_node_add_child(split, 0, child) != ESP_OK) {
+                free(split);
+                free(route);
+                return ESP_ERR_HTTPD_ALLOC_MEM;
+            }
+            child->label_len -= common;
+            memmove(child->label, child->label + common, child->label_len);
+            node->children[index] = split;
+            child = split;
+        }
+        node = child;
+        key += common;
+        len -= common;
+    }
+
+    /* Sequence numbers only grow, appending keeps the registration order */
+    struct httpd_uri_route **tail = route_key->prefix ? &node->prefix : &node->exact;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = route;
+    return ESP_OK;
+}
+
+/* Removes the route of the handler, and the nodes left without routes and
+ * children on the way back. Labels are not merged again, the tree only
+ * gets less compressed. Returns true if the route was found. */
+static bool httpd_uri_tree_remove(struct httpd_uri_node *node, const char *key,
+                                  const struct httpd_uri_key *route_key, size_t len,
+                                  const httpd_uri_t *handler)
+{
+    if (len == 0) {
+        struct httpd_uri_route **link = route_key->prefix ? &node->prefix : &node->exact;
+        for (; *link; link = &(*link)->next) {
+            if ((*link)->handler == handler) {
+                struct httpd_uri_route *route = *link;
+                *link = route->next;
+                free(route);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool found;
+    size_t index = httpd_uri_node_find(node, key[0], &found);
+    if (!found) {
+        return false;
+    }
+    struct httpd_uri_node *child = node->children[index];
+    if (len < child->label_len || memcmp(child->label, key, child->label_len) != 0) {
+        return false;
+    }
+    if (!httpd_uri_tree_remove(child, key + child->label_len, route_key,
+                               len - child->label_len, handler)) {
+        return false;
+    }
+    if (!child->exact && !child->prefix && !child->child_count) {
+        httpd_uri_node_free(child);
+        node->child_count--;
+        memmove(&node->children[index], &node->children[index + 1],
+                (node->child_count - index) * sizeof(struct httpd_uri_node *));
+    }
+    return true;
+}
+
+static esp_err_t httpd_uri_tree_add(struct httpd_data *hd, httpd_uri_t *handler)
+{
+    if (!httpd_uri_tree_enabled(hd)) {
+        return ESP_OK;
+    }
+    struct httpd_uri_key keys[2];
+    int count = httpd_uri_routes(hd, handler->uri, keys);
+    uint32_t seq = hd->hd_uri_seq++;
+    for (int i = 0; i < count; i++) {
+        if (httpd_uri_tree_insert(hd, handler->uri, &keys[i], handler, seq) != ESP_OK) {
+            while (i-- > 0) {
+                httpd_uri_tree_remove(hd->hd_uri_tree, handler->uri, &keys[i], keys[i].len, handler);
+            }
+            return ESP_ERR_HTTPD_ALLOC_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+static void httpd_uri_tree_del(struct httpd_data *hd, const httpd_uri_t *handler)
+{
+    if (!hd->hd_uri_tree) {
+        return;
+    }
+    struct httpd_uri_key keys[2];
+    int count = httpd_uri_routes(hd, handler->uri, keys);
+    for (int i = 0; i < count; i++) {
+        httpd_uri_tree_remove(hd->hd_uri_tree, handler->uri, &keys[i], keys[i].len, handler);
+    }
+}
+
+/* Picks the earliest registered route allowing the method from a list,
+ * if it was registered before the best one found so far */
+static void httpd_uri_tree_match(const struct httpd_uri_route *route, httpd_method_t method,
+                                 const struct httpd_uri_route **best, bool *uri_found)
+{
+    if (route) {
+        *uri_found = true;
+    }
+    for (; route && (!*best || route->seq < (*best)->seq); route = route->next) {
+        if (route->handler->method == method || route->handler->method == HTTP_ANY) {
+            *best = route;
+            return;
+        }
+    }
+}
+
+static httpd_uri_t *httpd_uri_tree_find(struct httpd_data *hd,
+                                        const char *uri, size_t uri_len,
+                                        httpd_method_t method,
+                                        bool *uri_found)
+{
+    const struct httpd_uri_route *best = NULL;
+    const struct httpd_uri_node *node = hd->hd_uri_tree;
+    while (node) {
+        httpd_uri_tree_match(node->prefix, method, &best, uri_found);
+        if (uri_len == 0) {
+            httpd_uri_tree_match(node->exact, method, &best, uri_found);
+            break;
+        }
+        bool found;
+        size_t index = httpd_uri_node_find(node, uri[0], &found);
+        if (!found) {
+            break;
+        }
+        const struct httpd_uri_node *child = node->children[index];
+        if (uri_len < child->label_len || memcmp(child->label, uri, child->label_len) != 0) {
+            break;
+        }
+        uri += child->label_len;
+        uri_len -= child->label_len;
+        node = child;
+    }
+    return best ? best->handler : NULL;
+}
+
+httpd_uri_t *httpd_find_uri_handler(struct httpd_data *hd,
+                                    const char *uri, size_t uri_len,
+                                    httpd_method_t method,
+                                    httpd_err_code_t *err)
 {
     if (err) {
         *err = HTTPD_404_NOT_FOUND;
     }
 
+    if (httpd_uri_tree_enabled(hd)) {
+        bool uri_found = false;
+        httpd_uri_t *handler = httpd_uri_tree_find(hd, uri, uri_len, method, &uri_found);
+        if (err && uri_found) {
+            *err = handler ? 0 : HTTPD_405_METHOD_NOT_ALLOWED;
+        }
+        return handler;
+    }
+
     for (int i = 0; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
             break;
@@ -173,6 +503,15 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
                 hd->hd_calls[i]->supported_subprotocol = NULL;
             }
 #endif
+            if (httpd_uri_tree_add(hd, hd->hd_calls[i]) != ESP_OK) {
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+                free((char*)hd->hd_calls[i]->supported_subprotocol);
+#endif
+                free((char*)hd->hd_calls[i]->uri);
+                free(hd->hd_calls[i]);
+                hd->hd_calls[i] = NULL;
+                return ESP_ERR_HTTPD_ALLOC_MEM;
+            }
             ESP_LOGD(TAG, LOG_FMT("[%d] installed %s"), i, uri_handler->uri);
             return ESP_OK;
         }
@@ -198,6 +537,7 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
             (strcmp(hd->hd_calls[i]->uri, uri) == 0)) {  // Then match URI string
             ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, hd->hd_calls[i]->uri);
 
+            httpd_uri_tree_del(hd, hd->hd_calls[i]);
             free((char*)hd->hd_calls[i]->uri);
             free(hd->hd_calls[i]);
             hd->hd_calls[i] = NULL;
@@ -236,6 +576,7 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
         if (strcmp(hd->hd_calls[i]->uri, uri) == 0) {   // Match URI strings
             ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, uri);
 
+            httpd_uri_tree_del(hd, hd->hd_calls[i]);
             free((char*)hd->hd_calls[i]->uri);
             free(hd->hd_calls[i]);
             hd->hd_calls[i] = NULL;
@@ -271,13 +612,17 @@ void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
         free(hd->hd_calls[i]);
         hd->hd_calls[i] = NULL;
     }
+    if (hd->hd_uri_tree) {
+        httpd_uri_node_free(hd->hd_uri_tree);
+        hd->hd_uri_tree = NULL;
+    }
 }
 
-esp_err_t httpd_uri(struct httpd_data *hd)
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req)
 {
     httpd_uri_t            *uri = NULL;
-    httpd_req_t            *req = &hd->hd_req;
-    struct http_parser_url *res = &hd->hd_req_aux.url_parse_res;
+    struct httpd_req_aux   *ra  = req->aux;
+    struct http_parser_url *res = &ra->url_parse_res;
 
     /* For conveying URI not found/method not allowed */
     httpd_err_code_t err = 0;
@@ -313,7 +658,7 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     struct httpd_req_aux   *aux = req->aux;
     if (uri->is_websocket && aux->ws_handshake_detect && uri->method == HTTP_GET) {
         ESP_LOGD(TAG, LOG_FMT("Responding WS handshake to sock %d"), aux->sd->fd);
-        esp_err_t ret = httpd_ws_respond_server_handshake(&hd->hd_req, uri->supported_subprotocol);
+        esp_err_t ret = httpd_ws_respond_server_handshake(req, uri->supported_subprotocol);
         if (ret != ESP_OK) {
             return ret;
         }
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -9,8 +9,12 @@
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <sys/types.h>
 #include <esp_timer.h>
 
 #ifdef __cplusplus
@@ -21,6 +25,7 @@ extern "C" {
 #define OS_FAIL    ESP_FAIL
 
 typedef TaskHandle_t othread_t;
+typedef QueueHandle_t oqueue_t;
 
 static inline int httpd_os_thread_create(othread_t *thread,
                                  const char *name, uint16_t stacksize, int prio,
@@ -50,6 +55,36 @@ static inline othread_t httpd_os_thread_handle(void)
     return xTaskGetCurrentTaskHandle();
 }
 
+static inline int httpd_os_queue_create(oqueue_t *queue, unsigned length, unsigned item_size)
+{
+    *queue = xQueueCreate(length, item_size);
+    return *queue ? OS_SUCCESS : OS_FAIL;
+}
+
+static inline void httpd_os_queue_delete(oqueue_t queue)
+{
+    vQueueDelete(queue);
+}
+
+/* Blocks until there is space in the queue */
+static inline int httpd_os_queue_send(oqueue_t queue, const void *item)
+{
+    return xQueueSend(queue, item, portMAX_DELAY) == pdTRUE ? OS_SUCCESS : OS_FAIL;
+}
+
+/* Fails if the queue is empty and block is false */
+static inline int httpd_os_queue_recv(oqueue_t queue, void *item, bool block)
+{
+    return xQueueReceive(queue, item, block ? portMAX_DELAY : 0) == pdTRUE ? OS_SUCCESS : OS_FAIL;
+}
+
+/* Files are read through the VFS into a buffer, there is no sendfile() */
+static inline ssize_t httpd_os_sendfile(int sockfd, int fd, off_t offset, size_t count)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,203 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+#if HTTPD_POLL_EPOLL
+
+#include <sys/epoll.h>
+
+static const char *TAG = "httpd_poll";
+
+/* Unlike select(), epoll keeps the set of watched descriptors in the kernel
+ * and only reports the ready ones, so a wakeup costs O(ready sockets)
+ * instead of O(max_open_sockets) and FD_SETSIZE does not apply.
+ *
+ * Sessions are registered with their sock_db as event data. The listening
+ * and control sockets are registered with pointers to their descriptors in
+ * httpd_data, which cannot collide with any session. */
+struct httpd_poller {
+    int epoll_fd;                   /*!< epoll instance */
+    bool listen_enabled;            /*!< Listening socket is watched for input */
+    int max_events;                 /*!< Number of entries in events */
+    struct epoll_event *events;     /*!< Events returned by epoll_wait() */
+    int pending_count;              /*!< Number of entries in pending */
+    struct sock_db **pending;       /*!< Sessions with data buffered in user space, max_open_sockets entries */
+    struct sock_db **sessions;      /*!< Sessions to be processed, max_open_sockets entries */
+};
+
+static esp_err_t httpd_poll_ctl(struct httpd_poller *poll, int op, int fd, uint32_t events, void *ptr)
+{
+    struct epoll_event ev = {
+        .events = events,
+        .data.ptr = ptr,
+    };
+    if (epoll_ctl(poll->epoll_fd, op, fd, &ev) < 0) {
+        ESP_LOGE(TAG, LOG_FMT("error in epoll_ctl %d for fd %d (%d)"), op, fd, errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_poll_init(struct httpd_data *hd)
+{
+    struct httpd_poller *poll = calloc(1, sizeof(struct httpd_poller));
+    if (!poll) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP poller"));
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    poll->epoll_fd = -1;
+    hd->hd_poll = poll;
+
+    /* Every session plus the listening and control sockets may be ready at once */
+    poll->max_events = hd->config.max_open_sockets + 2;
+    poll->events = calloc(poll->max_events, sizeof(struct epoll_event));
+    poll->pending = calloc(hd->config.max_open_sockets, sizeof(struct sock_db *));
+    poll->sessions = calloc(hd->config.max_open_sockets, sizeof(struct sock_db *));
+    if (!poll->events || !poll->pending || !poll->sessions) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP poller"));
+        httpd_poll_deinit(hd);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+
+    poll->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (poll->epoll_fd < 0) {
+        ESP_LOGE(TAG, LOG_FMT("error in epoll_create1 (%d)"), errno);
+        httpd_poll_deinit(hd);
+        return ESP_FAIL;
+    }
+
+    if (httpd_poll_ctl(poll, EPOLL_CTL_ADD, hd->ctrl_fd, EPOLLIN, &hd->ctrl_fd) != ESP_OK ||
+            httpd_poll_ctl(poll, EPOLL_CTL_ADD, hd->listen_fd, EPOLLIN, &hd->listen_fd) != ESP_OK) {
+        httpd_poll_deinit(hd);
+        return ESP_FAIL;
+    }
+    poll->listen_enabled = true;
+    return ESP_OK;
+}
+
+void httpd_poll_deinit(struct httpd_data *hd)
+{
+    struct httpd_poller *poll = hd->hd_poll;
+    if (!poll) {
+        return;
+    }
+    if (poll->epoll_fd >= 0) {
+        close(poll->epoll_fd);
+    }
+    free(poll->sessions);
+    free(poll->pending);
+    free(poll->events);
+    free(poll);
+    hd->hd_poll = NULL;
+}
+
+esp_err_t httpd_poll_add(struct httpd_data *hd, struct sock_db *session)
+{
+    return httpd_poll_ctl(hd->hd_poll, EPOLL_CTL_ADD, session->fd, EPOLLIN, session);
+}
+
+void httpd_poll_del(struct httpd_data *hd, struct sock_db *session)
+{
+    /* A stale entry may stay in the pending list, it is skipped
+     * as long as the flag is clear */
+    session->poll_pending = false;
+    /* This fails for descriptors which have been closed behind our back
+     * (see httpd_sess_delete_invalid()), the kernel has dropped those already */
+    if (epoll_ctl(hd->hd_poll->epoll_fd, EPOLL_CTL_DEL, session->fd, NULL) < 0) {
+        ESP_LOGD(TAG, LOG_FMT("error in epoll_ctl for fd %d (%d)"), session->fd, errno);
+    }
+}
+
+void httpd_poll_processed(struct httpd_data *hd, struct sock_db *session)
+{
+    struct httpd_poller *poll = hd->hd_poll;
+    if (session->poll_pending || poll->pending_count == hd->config.max_open_sockets) {
+        return;
+    }
+    if (httpd_sess_pending(hd, session)) {
+        session->poll_pending = true;
+        poll->pending[poll->pending_count++] = session;
+    }
+}
+
+void httpd_poll_pause(struct httpd_data *hd, struct sock_db *session)
+{
+    session->poll_paused = true;
+    httpd_poll_ctl(hd->hd_poll, EPOLL_CTL_MOD, session->fd, 0, session);
+}
+
+void httpd_poll_resume(struct httpd_data *hd, struct sock_db *session)
+{
+    session->poll_paused = false;
+    httpd_poll_ctl(hd->hd_poll, EPOLL_CTL_MOD, session->fd, EPOLLIN, session);
+}
+
+esp_err_t httpd_poll_wait(struct httpd_data *hd, struct httpd_poll_result *res)
+{
+    struct httpd_poller *poll = hd->hd_poll;
+
+    /* Only listen for new connections if server has capacity to
+     * handle more (or when LRU purge is enabled, in which case
+     * older connections will be closed) */
+    bool listen_enabled = hd->config.lru_purge_enable ||
+                          hd->hd_sd_active_count < hd->config.max_open_sockets;
+    if (listen_enabled != poll->listen_enabled) {
+        if (httpd_poll_ctl(poll, EPOLL_CTL_MOD, hd->listen_fd, listen_enabled ? EPOLLIN : 0, &hd->listen_fd) == ESP_OK) {
+            poll->listen_enabled = listen_enabled;
+        }
+    }
+
+    res->ctrl_ready = false;
+    res->listen_ready = false;
+    res->sess_count = 0;
+    res->sessions = poll->sessions;
+
+    /* Don't block if there are sessions to be processed anyway */
+    int timeout = poll->pending_count ? 0 : -1;
+    ESP_LOGD(TAG, LOG_FMT("doing epoll_wait, timeout = %d"), timeout);
+    int active_cnt = epoll_wait(poll->epoll_fd, poll->events, poll->max_events, timeout);
+    if (active_cnt < 0) {
+        if (errno == EINTR) {
+            return ESP_OK;
+        }
+        ESP_LOGE(TAG, LOG_FMT("error in epoll_wait (%d)"), errno);
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < active_cnt; i++) {
+        void *ptr = poll->events[i].data.ptr;
+        if (ptr == &hd->ctrl_fd) {
+            res->ctrl_ready = true;
+        } else if (ptr == &hd->listen_fd) {
+            res->listen_ready = true;
+        } else {
+            struct sock_db *session = (struct sock_db *)ptr;
+            /* Reported by the socket already, drop it from the pending list */
+            session->poll_pending = false;
+            poll->sessions[res->sess_count++] = session;
+        }
+    }
+
+    for (int i = 0; i < poll->pending_count; i++) {
+        struct sock_db *session = poll->pending[i];
+        if (session->poll_pending && res->sess_count < hd->config.max_open_sockets) {
+            session->poll_pending = false;
+            poll->sessions[res->sess_count++] = session;
+        }
+    }
+    poll->pending_count = 0;
+    return ESP_OK;
+}
+
+#endif /* HTTPD_POLL_EPOLL */
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2023-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -7,7 +7,13 @@
 
 #include <unistd.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
+#include <errno.h>
+#include <sys/types.h>
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -16,8 +22,29 @@ extern "C" {
 #define OS_SUCCESS ESP_OK
 #define OS_FAIL    ESP_FAIL
 
+/* epoll is only available on Linux hosts, other hosts (e.g. macOS) keep using select() */
+#if CONFIG_HTTPD_POLL_EPOLL && defined(__linux__)
+#define HTTPD_POLL_EPOLL 1
+#endif
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
 typedef TaskHandle_t othread_t;
 
+struct httpd_os_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;     /* Signalled whenever an item is added or removed */
+    unsigned length;
+    unsigned item_size;
+    unsigned head;
+    unsigned count;
+    uint8_t items[];
+};
+
+typedef struct httpd_os_queue *oqueue_t;
+
 static inline int httpd_os_thread_create(othread_t *thread,
                                  const char *name, uint16_t stacksize, int prio,
                                  void (*thread_routine)(void *arg), void *arg,
@@ -50,6 +77,74 @@ static inline othread_t httpd_os_thread_handle(void)
     return (othread_t)pthread_self();
 }
 
+static inline int httpd_os_queue_create(oqueue_t *queue, unsigned length, unsigned item_size)
+{
+    oqueue_t q = calloc(1, sizeof(struct httpd_os_queue) + length * item_size);
+    if (q == NULL) {
+        return OS_FAIL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->length = length;
+    q->item_size = item_size;
+    *queue = q;
+    return OS_SUCCESS;
+}
+
+static inline void httpd_os_queue_delete(oqueue_t queue)
+{
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue);
+}
+
+/* Blocks until there is space in the queue */
+static inline int httpd_os_queue_send(oqueue_t queue, const void *item)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    unsigned tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return OS_SUCCESS;
+}
+
+/* Fails if the queue is empty and block is false */
+static inline int httpd_os_queue_recv(oqueue_t queue, void *item, bool block)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (!block) {
+            pthread_mutex_unlock(&queue->lock);
+            return OS_FAIL;
+        }
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return OS_SUCCESS;
+}
+
+/* Sends count bytes of the file starting at offset to the socket without copying
+ * them to user space. Returns the number of bytes sent, or -1 with errno set,
+ * errno is ENOSYS if the host doesn't support it */
+static inline ssize_t httpd_os_sendfile(int sockfd, int fd, off_t offset, size_t count)
+{
+#if defined(__linux__)
+    return sendfile(sockfd, fd, &offset, count);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 #ifdef __cplusplus
 }
 #endif
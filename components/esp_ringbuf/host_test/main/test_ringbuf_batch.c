@@ -0,0 +1,342 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+#include "unity.h"
+
+#define TEST_BUFFER_SIZE            512
+#define TEST_DATA_SIZE              1024
+#define TEST_BATCH_SIZE             8
+#define TEST_TIMEOUT_TICKS          pdMS_TO_TICKS(1000)
+
+static uint8_t s_test_data[TEST_DATA_SIZE];
+
+static void fill_test_data(void)
+{
+    for (int i = 0; i < TEST_DATA_SIZE; i++) {
+        s_test_data[i] = (uint8_t)(i * 13 + i / 256);
+    }
+}
+
+/* Sends batches of items of random length without blocking and receives them in batches, over many rounds so that
+ * the items wrap around the end of the buffer in every possible way */
+static void check_batches_received_in_order(RingbufferType_t type)
+{
+    RingbufHandle_t buffer = xRingbufferCreate(TEST_BUFFER_SIZE, type);
+    TEST_ASSERT_NOT_NULL(buffer);
+    size_t max_item_size = xRingbufferGetMaxItemSize(buffer) / 4;
+
+    size_t sent_offset = 0;
+    size_t recv_offset = 0;
+    for (int round = 0; round < 200; round++) {
+        const void *items[TEST_BATCH_SIZE];
+        size_t sizes[TEST_BATCH_SIZE];
+        size_t offset = sent_offset;
+        for (int i = 0; i < TEST_BATCH_SIZE; i++) {
+            sizes[i] = rand() % (max_item_size + 1);
+            if (offset + sizes[i] > TEST_DATA_SIZE) {
+                offset = 0;
+            }
+            items[i] = &s_test_data[offset];
+            offset += sizes[i];
+        }
+        /* Items that do not fit stay unsent, so the offset of the next round continues after the last sent one */
+        size_t sent = xRingbufferSendBatch(buffer, items, sizes, TEST_BATCH_SIZE, 0);
+        TEST_ASSERT_GREATER_THAN(0, sent);
+        sent_offset = (const uint8_t *)items[sent - 1] - s_test_data + sizes[sent - 1];
+
+        void *received[TEST_BATCH_SIZE];
+        size_t received_sizes[TEST_BATCH_SIZE];
+        size_t num = xRingbufferReceiveBatch(buffer, received, received_sizes, TEST_BATCH_SIZE, 0);
+        TEST_ASSERT_EQUAL(sent, num);
+        for (int i = 0; i < num; i++) {
+            if (recv_offset + received_sizes[i] > TEST_DATA_SIZE) {
+                recv_offset = 0;
+            }
+            TEST_ASSERT_EQUAL(sizes[i], received_sizes[i]);
+            TEST_ASSERT_EQUAL(0, memcmp(received[i], &s_test_data[recv_offset], received_sizes[i]));
+            recv_offset += received_sizes[i];
+        }
+        vRingbufferReturnBatch(buffer, received, num);
+    }
+    void *item;
+    size_t size;
+    TEST_ASSERT_EQUAL(0, xRingbufferReceiveBatch(buffer, &item, &size, 1, 0));
+    vRingbufferDelete(buffer);
+}
+
+TEST_CASE("Ring buffer batches are received in order", "[esp_ringbuf]")
+{
+    fill_test_data();
+    check_batches_received_in_order(RINGBUF_TYPE_NOSPLIT);
+    check_batches_received_in_order(RINGBUF_TYPE_NOSPLIT_SPSC);
+}
+
+TEST_CASE("Ring buffer batch send stops when the buffer is full", "[esp_ringbuf]")
+{
+    const RingbufferType_t types[] = { RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_NOSPLIT_SPSC, RINGBUF_TYPE_ALLOWSPLIT, RINGBUF_TYPE_BYTEBUF, RINGBUF_TYPE_BYTEBUF_SPSC };
+    fill_test_data();
+
+    for (int t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        RingbufHandle_t buffer = xRingbufferCreate(TEST_BUFFER_SIZE, types[t]);
+        TEST_ASSERT_NOT_NULL(buffer);
+
+        /* 64 items of 64 bytes never fit into the buffer, the ones that do are sent */
+        const void *items[64];
+        size_t sizes[64];
+        for (int i = 0; i < 64; i++) {
+            items[i] = &s_test_data[i * 16];
+            sizes[i] = 64;
+        }
+        size_t sent = xRingbufferSendBatch(buffer, items, sizes, 64, pdMS_TO_TICKS(10));
+        TEST_ASSERT_GREATER_THAN(0, sent);
+        TEST_ASSERT_LESS_THAN(64, sent);
+        TEST_ASSERT_LESS_THAN(64, xRingbufferGetCurFreeSize(buffer));
+
+        UBaseType_t waiting;
+        vRingbufferGetInfo(buffer, NULL, NULL, NULL, NULL, &waiting);
+        TEST_ASSERT_EQUAL((types[t] == RINGBUF_TYPE_BYTEBUF || types[t] == RINGBUF_TYPE_BYTEBUF_SPSC) ? sent * 64 : sent, waiting);
+
+        /* An item that can never fit stops the batch without waiting */
+        sizes[0] = xRingbufferGetMaxItemSize(buffer) + 1;
+        TEST_ASSERT_EQUAL(0, xRingbufferSendBatch(buffer, items, sizes, 64, portMAX_DELAY));
+        vRingbufferDelete(buffer);
+    }
+}
+
+TEST_CASE("Ring buffer batch send to a byte buffer appends the items", "[esp_ringbuf]")
+{
+    const RingbufferType_t types[] = { RINGBUF_TYPE_BYTEBUF, RINGBUF_TYPE_BYTEBUF_SPSC };
+    fill_test_data();
+
+    for (int t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        RingbufHandle_t buffer = xRingbufferCreate(TEST_BUFFER_SIZE, types[t]);
+        TEST_ASSERT_NOT_NULL(buffer);
+
+        /* Start in the middle of the buffer so that the data wraps around */
+        void *item;
+        size_t size;
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(buffer, s_test_data, TEST_BUFFER_SIZE / 2 + 3, 0));
+        TEST_ASSERT_NOT_NULL(item = xRingbufferReceive(buffer, &size, 0));
+        vRingbufferReturnItem(buffer, item);
+
+        const void *items[] = { &s_test_data[0], NULL, &s_test_data[100], &s_test_data[400] };
+        size_t sizes[] = { 100, 0, 300, 100 };
+        TEST_ASSERT_EQUAL(4, xRingbufferSendBatch(buffer, items, sizes, 4, 0));
+
+        size_t received = 0;
+        while ((item = xRingbufferReceive(buffer, &size, 0)) != NULL) {
+            TEST_ASSERT_EQUAL(0, memcmp(item, &s_test_data[received], size));
+            received += size;
+            vRingbufferReturnItem(buffer, item);
+        }
+        TEST_ASSERT_EQUAL(500, received);
+        vRingbufferDelete(buffer);
+    }
+}
+
+TEST_CASE("Ring buffer sendv gathers the segments into one item", "[esp_ringbuf]")
+{
+    fill_test_data();
+    RingbufHandle_t buffer = xRingbufferCreate(TEST_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    TEST_ASSERT_NOT_NULL(buffer);
+
+    for (int round = 0; round < 20; round++) {
+        const uint32_t header = 0x12345678 + round;
+        const size_t payload_size = 11 * round;
+        const RingbufferIOVec_t iov[] = {
+            { .pvBase = &header, .xLen = sizeof(header) },
+            { .pvBase = NULL, .xLen = 0 },
+            { .pvBase = s_test_data, .xLen = payload_size },
+        };
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendv(buffer, iov, 3, 0));
+
+        size_t size;
+        uint8_t *item = xRingbufferReceive(buffer, &size, 0);
+        TEST_ASSERT_NOT_NULL(item);
+        TEST_ASSERT_EQUAL(sizeof(header) + payload_size, size);
+        TEST_ASSERT_EQUAL(0, memcmp(item, &header, sizeof(header)));
+        TEST_ASSERT_EQUAL(0, memcmp(item + sizeof(header), s_test_data, payload_size));
+        vRingbufferReturnItem(buffer, item);
+    }
+
+    /* The segments together are larger than the maximum item size */
+    const size_t half = xRingbufferGetMaxItemSize(buffer) / 2 + 1;
+    const RingbufferIOVec_t iov[] = {
+        { .pvBase = s_test_data, .xLen = half },
+        { .pvBase = s_test_data, .xLen = half },
+    };
+    TEST_ASSERT_EQUAL(pdFALSE, xRingbufferSendv(buffer, iov, 2, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendv(buffer, iov, 1, 0));
+    vRingbufferDelete(buffer);
+}
+
+TEST_CASE("Ring buffer batch send notifies the queue set once per item", "[esp_ringbuf]")
+{
+    fill_test_data();
+    RingbufHandle_t buffer = xRingbufferCreate(TEST_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    QueueSetHandle_t queue_set = xQueueCreateSet(16);
+    TEST_ASSERT_NOT_NULL(buffer);
+    TEST_ASSERT_NOT_NULL(queue_set);
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferAddToQueueSetRead(buffer, queue_set));
+
+    const void *items[] = { s_test_data, s_test_data, s_test_data };
+    const size_t sizes[] = { 8, 16, 24 };
+    TEST_ASSERT_EQUAL(3, xRingbufferSendBatch(buffer, items, sizes, 3, 0));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferCanRead(buffer, xQueueSelectFromSet(queue_set, 0)));
+        size_t size;
+        void *item = xRingbufferReceive(buffer, &size, 0);
+        TEST_ASSERT_NOT_NULL(item);
+        TEST_ASSERT_EQUAL(sizes[i], size);
+        vRingbufferReturnItem(buffer, item);
+    }
+    TEST_ASSERT_NULL(xQueueSelectFromSet(queue_set, 0));
+
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferRemoveFromQueueSetRead(buffer, queue_set));
+    vQueueDelete(queue_set);
+    vRingbufferDelete(buffer);
+}
+
+typedef struct {
+    RingbufHandle_t buffer;
+    size_t item_num;
+    SemaphoreHandle_t done;
+} batch_producer_args_t;
+
+/* Sends all items of 4 bytes, numbered in order, in a single batch that does not fit into the buffer */
+static void batch_producer_task(void *arg)
+{
+    batch_producer_args_t *args = (batch_producer_args_t *)arg;
+    static uint32_t numbers[256];
+    static const void *items[256];
+    static size_t sizes[256];
+    for (int i = 0; i < args->item_num; i++) {
+        numbers[i] = i;
+        items[i] = &numbers[i];
+        sizes[i] = sizeof(numbers[i]);
+    }
+    TEST_ASSERT_EQUAL(args->item_num, xRingbufferSendBatch(args->buffer, items, sizes, args->item_num, TEST_TIMEOUT_TICKS));
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("Ring buffer batch send blocks until all items are sent", "[esp_ringbuf]")
+{
+    const RingbufferType_t types[] = { RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_NOSPLIT_SPSC };
+
+    for (int t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        batch_producer_args_t args = {
+            .buffer = xRingbufferCreate(TEST_BUFFER_SIZE / 4, types[t]),
+            .item_num = 256,
+            .done = xSemaphoreCreateBinary(),
+        };
+        TEST_ASSERT_NOT_NULL(args.buffer);
+        TEST_ASSERT_NOT_NULL(args.done);
+        TEST_ASSERT(xTaskCreate(batch_producer_task, "producer", 4096, &args, uxTaskPriorityGet(NULL), NULL) == pdPASS);
+
+        uint32_t expected = 0;
+        while (expected < args.item_num) {
+            void *items[TEST_BATCH_SIZE];
+            size_t sizes[TEST_BATCH_SIZE];
+            size_t num = xRingbufferReceiveBatch(args.buffer, items, sizes, TEST_BATCH_SIZE, TEST_TIMEOUT_TICKS);
+            TEST_ASSERT_GREATER_THAN(0, num);
+            for (int i = 0; i < num; i++) {
+                TEST_ASSERT_EQUAL(sizeof(uint32_t), sizes[i]);
+                TEST_ASSERT_EQUAL(expected++, *(uint32_t *)items[i]);
+            }
+            vRingbufferReturnBatch(args.buffer, items, num);
+        }
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(args.done, TEST_TIMEOUT_TICKS));
+        vSemaphoreDelete(args.done);
+        vRingbufferDelete(args.buffer);
+    }
+}
+
+/* ---------------------------------------------- Throughput benchmark ----------------------------------------------
+ * Small items are sent, received and returned by the same task one at a time and in batches, which measures how much
+ * of the cost of the per-item path is saved by taking the critical section once per batch.
+ */
+
+#define PERF_BUFFER_SIZE            4096
+#define PERF_TOTAL_SIZE             (4 * 1024 * 1024)
+#define PERF_BATCH_SIZE             16
+
+/* Returns MB/s */
+static double measure_throughput(RingbufferType_t type, size_t item_size, bool batch)
+{
+    RingbufHandle_t buffer = xRingbufferCreate(PERF_BUFFER_SIZE, type);
+    TEST_ASSERT_NOT_NULL(buffer);
+    const void *items[PERF_BATCH_SIZE];
+    size_t sizes[PERF_BATCH_SIZE];
+    void *received[PERF_BATCH_SIZE];
+    size_t received_sizes[PERF_BATCH_SIZE];
+    for (int i = 0; i < PERF_BATCH_SIZE; i++) {
+        items[i] = s_test_data;
+        sizes[i] = item_size;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t sent = 0; sent < PERF_TOTAL_SIZE; sent += item_size * PERF_BATCH_SIZE) {
+        if (batch) {
+            TEST_ASSERT_EQUAL(PERF_BATCH_SIZE, xRingbufferSendBatch(buffer, items, sizes, PERF_BATCH_SIZE, 0));
+            TEST_ASSERT_EQUAL(PERF_BATCH_SIZE, xRingbufferReceiveBatch(buffer, received, received_sizes, PERF_BATCH_SIZE, 0));
+            vRingbufferReturnBatch(buffer, received, PERF_BATCH_SIZE);
+        } else {
+            for (int i = 0; i < PERF_BATCH_SIZE; i++) {
+                TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(buffer, items[i], sizes[i], 0));
+            }
+            for (int i = 0; i < PERF_BATCH_SIZE; i++) {
+                received[i] = xRingbufferReceive(buffer, &received_sizes[i], 0);
+                TEST_ASSERT_NOT_NULL(received[i]);
+            }
+            for (int i = 0; i < PERF_BATCH_SIZE; i++) {
+                vRingbufferReturnItem(buffer, received[i]);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    vRingbufferDelete(buffer);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return PERF_TOTAL_SIZE / seconds / (1024 * 1024);
+}
+
+/* Best of a few runs, the host is not idle */
+static double best_throughput(RingbufferType_t type, size_t item_size, bool batch)
+{
+    double best = 0;
+    for (int i = 0; i < 3; i++) {
+        double mbps = measure_throughput(type, item_size, batch);
+        best = mbps > best ? mbps : best;
+    }
+    return best;
+}
+
+TEST_CASE("Ring buffer batch throughput compared to single items", "[esp_ringbuf][perf]")
+{
+    const size_t item_sizes[] = { 4, 16, 64 };
+    fill_test_data();
+
+    printf("%10s %14s %14s %14s %14s\n", "item size", "no-split", "batch", "no-split SPSC", "batch SPSC");
+    for (int i = 0; i < sizeof(item_sizes) / sizeof(item_sizes[0]); i++) {
+        printf("%10zu %9.1f MB/s %9.1f MB/s %9.1f MB/s %9.1f MB/s\n", item_sizes[i],
+               best_throughput(RINGBUF_TYPE_NOSPLIT, item_sizes[i], false),
+               best_throughput(RINGBUF_TYPE_NOSPLIT, item_sizes[i], true),
+               best_throughput(RINGBUF_TYPE_NOSPLIT_SPSC, item_sizes[i], false),
+               best_throughput(RINGBUF_TYPE_NOSPLIT_SPSC, item_sizes[i], true));
+    }
+}
@@ -0,0 +1,240 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+#include "unity.h"
+
+#define TEST_BUFFER_SIZE            160
+#define TEST_DATA_SIZE              4096
+#define TEST_TIMEOUT_TICKS          pdMS_TO_TICKS(1000)
+
+static uint8_t s_test_data[TEST_DATA_SIZE];
+
+typedef struct {
+    RingbufHandle_t buffer;
+    size_t max_item_size;
+    size_t total_size;
+    SemaphoreHandle_t done;
+} producer_args_t;
+
+static void fill_test_data(void)
+{
+    for (int i = 0; i < TEST_DATA_SIZE; i++) {
+        s_test_data[i] = (uint8_t)(i * 7 + i / 256);
+    }
+}
+
+/* Sends total_size bytes of the test data in items of random length */
+static void producer_task(void *arg)
+{
+    producer_args_t *args = (producer_args_t *)arg;
+    size_t sent = 0;
+    while (sent < args->total_size) {
+        size_t len = rand() % (args->max_item_size + 1);
+        if (len > args->total_size - sent) {
+            len = args->total_size - sent;
+        }
+        size_t offset = sent % TEST_DATA_SIZE;
+        if (len > TEST_DATA_SIZE - offset) {
+            len = TEST_DATA_SIZE - offset;
+        }
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(args->buffer, &s_test_data[offset], len, TEST_TIMEOUT_TICKS));
+        sent += len;
+    }
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
+
+static void check_items_received_in_order(RingbufferType_t type, UBaseType_t producer_priority)
+{
+    RingbufHandle_t buffer = xRingbufferCreate(TEST_BUFFER_SIZE, type);
+    TEST_ASSERT_NOT_NULL(buffer);
+    producer_args_t args = {
+        .buffer = buffer,
+        .max_item_size = xRingbufferGetMaxItemSize(buffer),
+        .total_size = 4 * TEST_DATA_SIZE,
+        .done = xSemaphoreCreateBinary(),
+    };
+    TEST_ASSERT_NOT_NULL(args.done);
+    TEST_ASSERT(xTaskCreate(producer_task, "producer", 4096, &args, producer_priority, NULL) == pdPASS);
+
+    size_t received = 0;
+    while (received < args.total_size) {
+        size_t size;
+        uint8_t *item;
+        if (type == RINGBUF_TYPE_BYTEBUF_SPSC && received % 3) {
+            item = xRingbufferReceiveUpTo(buffer, &size, TEST_TIMEOUT_TICKS, 1 + received % 17);
+        } else {
+            item = xRingbufferReceive(buffer, &size, TEST_TIMEOUT_TICKS);
+        }
+        TEST_ASSERT_NOT_NULL(item);
+        for (size_t i = 0; i < size; i++) {
+            TEST_ASSERT_EQUAL_HEX8(s_test_data[(received + i) % TEST_DATA_SIZE], item[i]);
+        }
+        received += size;
+        vRingbufferReturnItem(buffer, item);
+    }
+    TEST_ASSERT_EQUAL(args.total_size, received);
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(args.done, TEST_TIMEOUT_TICKS));
+
+    UBaseType_t waiting;
+    vRingbufferGetInfo(buffer, NULL, NULL, NULL, NULL, &waiting);
+    TEST_ASSERT_EQUAL(0, waiting);
+    vSemaphoreDelete(args.done);
+    vRingbufferDelete(buffer);
+}
+
+TEST_CASE("SPSC ring buffer items are received in order", "[esp_ringbuf]")
+{
+    const RingbufferType_t types[] = { RINGBUF_TYPE_NOSPLIT_SPSC, RINGBUF_TYPE_BYTEBUF_SPSC };
+    fill_test_data();
+    srand(3);
+    for (int i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        /* Consumer waits for the producer, then the producer waits for the consumer */
+        check_items_received_in_order(types[i], uxTaskPriorityGet(NULL) + 1);
+        check_items_received_in_order(types[i], uxTaskPriorityGet(NULL) - 1);
+    }
+}
+
+TEST_CASE("SPSC no-split ring buffer frees items returned out of order", "[esp_ringbuf]")
+{
+    RingbufHandle_t buffer = xRingbufferCreate(TEST_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT_SPSC);
+    TEST_ASSERT_NOT_NULL(buffer);
+    /* Depending on the header size and where the items wrap around, 4 to 6 items fit */
+    const size_t item_size = 16;
+    fill_test_data();
+
+    for (int round = 0; round < 20; round++) {
+        int sent = 0;
+        while (xRingbufferSend(buffer, &s_test_data[sent], item_size, 0) == pdTRUE) {
+            sent++;
+        }
+        TEST_ASSERT_GREATER_OR_EQUAL(3, sent);
+        TEST_ASSERT_EQUAL(0, xRingbufferSendFromISR(buffer, s_test_data, item_size, NULL));
+        TEST_ASSERT_LESS_THAN(item_size, xRingbufferGetCurFreeSize(buffer));
+
+        uint8_t *items[8];
+        for (int i = 0; i < sent; i++) {
+            size_t size;
+            items[i] = xRingbufferReceive(buffer, &size, 0);
+            TEST_ASSERT_NOT_NULL(items[i]);
+            TEST_ASSERT_EQUAL(item_size, size);
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(&s_test_data[i], items[i], item_size);
+        }
+        size_t size;
+        TEST_ASSERT_NULL(xRingbufferReceive(buffer, &size, 0));
+
+        /* Returning the second item does not free anything, the first one frees both */
+        vRingbufferReturnItem(buffer, items[1]);
+        TEST_ASSERT_LESS_THAN(item_size, xRingbufferGetCurFreeSize(buffer));
+        vRingbufferReturnItemFromISR(buffer, items[0], NULL);
+        TEST_ASSERT_GREATER_OR_EQUAL(item_size, xRingbufferGetCurFreeSize(buffer));
+        for (int i = sent - 1; i >= 2; i--) {
+            vRingbufferReturnItem(buffer, items[i]);
+        }
+        TEST_ASSERT_EQUAL(xRingbufferGetMaxItemSize(buffer), xRingbufferGetCurFreeSize(buffer));
+
+        /* Move the positions, so that the next round wraps around at a different point */
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(buffer, s_test_data, round % 24, 0));
+        void *item = xRingbufferReceive(buffer, &size, 0);
+        TEST_ASSERT_EQUAL(round % 24, size);
+        vRingbufferReturnItem(buffer, item);
+    }
+    vRingbufferDelete(buffer);
+}
+
+TEST_CASE("SPSC ring buffer send and receive time out", "[esp_ringbuf]")
+{
+    const RingbufferType_t types[] = { RINGBUF_TYPE_NOSPLIT_SPSC, RINGBUF_TYPE_BYTEBUF_SPSC };
+    fill_test_data();
+    for (int i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        RingbufHandle_t buffer = xRingbufferCreate(TEST_BUFFER_SIZE, types[i]);
+        TEST_ASSERT_NOT_NULL(buffer);
+        size_t size;
+        TickType_t start = xTaskGetTickCount();
+        TEST_ASSERT_NULL(xRingbufferReceive(buffer, &size, 5));
+        TEST_ASSERT_GREATER_OR_EQUAL(5, xTaskGetTickCount() - start);
+
+        size_t max_size = xRingbufferGetMaxItemSize(buffer);
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(buffer, s_test_data, max_size, 0));
+        TEST_ASSERT_EQUAL(pdFALSE, xRingbufferSend(buffer, s_test_data, max_size + 1, 0));
+        while (xRingbufferSend(buffer, s_test_data, 4, 0) == pdTRUE) {
+        }
+        start = xTaskGetTickCount();
+        TEST_ASSERT_EQUAL(pdFALSE, xRingbufferSend(buffer, s_test_data, 4, 5));
+        TEST_ASSERT_GREATER_OR_EQUAL(5, xTaskGetTickCount() - start);
+
+        /* Not supported */
+        QueueSetHandle_t queue_set = xQueueCreateSet(1);
+        TEST_ASSERT_EQUAL(pdFALSE, xRingbufferAddToQueueSetRead(buffer, queue_set));
+        vQueueDelete(queue_set);
+        vRingbufferDelete(buffer);
+    }
+}
+
+/* ---------------------------------------------- Throughput benchmark ----------------------------------------------
+ * Items of a fixed size are sent and immediately received and returned by the same task, for the lock-based ring
+ * buffer types and their single-producer/single-consumer counterparts. This measures the cost of the send/receive/return
+ * path itself; a producer and a consumer in separate tasks would mostly measure context switches of the Linux port.
+ */
+
+#define PERF_BUFFER_SIZE            4096
+#define PERF_TOTAL_SIZE             (4 * 1024 * 1024)
+
+/* Returns MB/s */
+static double measure_throughput(RingbufferType_t type, size_t item_size)
+{
+    RingbufHandle_t buffer = xRingbufferCreate(PERF_BUFFER_SIZE, type);
+    TEST_ASSERT_NOT_NULL(buffer);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t sent = 0; sent < PERF_TOTAL_SIZE; sent += item_size) {
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(buffer, s_test_data, item_size, 0));
+        size_t size;
+        void *item = xRingbufferReceive(buffer, &size, 0);
+        TEST_ASSERT_NOT_NULL(item);
+        vRingbufferReturnItem(buffer, item);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    vRingbufferDelete(buffer);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return PERF_TOTAL_SIZE / seconds / (1024 * 1024);
+}
+
+/* Best of a few runs, the host is not idle */
+static double best_throughput(RingbufferType_t type, size_t item_size)
+{
+    double best = 0;
+    for (int i = 0; i < 3; i++) {
+        double mbps = measure_throughput(type, item_size);
+        best = mbps > best ? mbps : best;
+    }
+    return best;
+}
+
+TEST_CASE("SPSC ring buffer throughput compared to the lock-based ring buffer", "[esp_ringbuf][perf]")
+{
+    const size_t item_sizes[] = { 16, 64, 256, 1024 };
+    fill_test_data();
+
+    printf("%10s %14s %14s %14s %14s\n", "item size", "no-split", "no-split SPSC", "byte buf", "byte buf SPSC");
+    for (int i = 0; i < sizeof(item_sizes) / sizeof(item_sizes[0]); i++) {
+        printf("%10zu %9.1f MB/s %9.1f MB/s %9.1f MB/s %9.1f MB/s\n", item_sizes[i],
+               best_throughput(RINGBUF_TYPE_NOSPLIT, item_sizes[i]),
+               best_throughput(RINGBUF_TYPE_NOSPLIT_SPSC, item_sizes[i]),
+               best_throughput(RINGBUF_TYPE_BYTEBUF, item_sizes[i]),
+               best_throughput(RINGBUF_TYPE_BYTEBUF_SPSC, item_sizes[i]));
+    }
+}
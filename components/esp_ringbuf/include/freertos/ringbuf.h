@@ -41,9 +41,39 @@ typedef enum {
      * time.
      */
     RINGBUF_TYPE_BYTEBUF,
+    /**
+     * Same as RINGBUF_TYPE_NOSPLIT, but for a single producer and a single
+     * consumer. Items are sent and received without taking the ring buffer's
+     * spinlock, see the notes on single-producer/single-consumer ring buffers
+     * below.
+     */
+    RINGBUF_TYPE_NOSPLIT_SPSC,
+    /**
+     * Same as RINGBUF_TYPE_BYTEBUF, but for a single producer and a single
+     * consumer. Data is sent and received without taking the ring buffer's
+     * spinlock, see the notes on single-producer/single-consumer ring buffers
+     * below.
+     */
+    RINGBUF_TYPE_BYTEBUF_SPSC,
     RINGBUF_TYPE_MAX,
 } RingbufferType_t;
 
+/*
+ * Notes on single-producer/single-consumer (SPSC) ring buffers:
+ *
+ * - Only one task or ISR may send to the ring buffer, and only one task or ISR
+ *   may receive from it and return the received items. The producer and the
+ *   consumer may run on different cores.
+ * - The producer and the consumer only exchange the positions up to which
+ *   data has been written and freed, so sending and receiving does not enter
+ *   a critical section unless the other side is blocked waiting.
+ * - A blocked sender or receiver waits on its task notification (index 0),
+ *   like the FreeRTOS stream buffers do. The task should not wait on its own
+ *   notifications while it uses the ring buffer.
+ * - xRingbufferSendAcquire()/xRingbufferSendComplete() and queue sets are not
+ *   supported.
+ */
+
 /**
  * @brief Struct that is equivalent in size to the ring buffer's data structure
  *
@@ -65,6 +95,14 @@ typedef struct xSTATIC_RINGBUFFER {
     /** @endcond */
 } StaticRingbuffer_t;
 
+/**
+ * @brief Segment of an item sent with xRingbufferSendv()
+ */
+typedef struct {
+    const void *pvBase;     /**< Start of the segment. NULL is allowed if xLen is 0 */
+    size_t xLen;            /**< Length of the segment in bytes */
+} RingbufferIOVec_t;
+
 /**
  * @brief       Create a ring buffer
  *
@@ -191,6 +229,7 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer,
  *       aligned fashion.
  * @note An xItemSize of 0 will result in a buffer being acquired, but the buffer
  *       will have a size of 0.
+ * @note Not supported by single-producer/single-consumer ring buffers.
  *
  * @return
  *      - pdTRUE if succeeded
@@ -214,6 +253,62 @@ BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, s
  */
 BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem);
 
+/**
+ * @brief       Insert several items into the ring buffer
+ *
+ * Attempt to insert xItemNum items into the ring buffer, in order. Each time
+ * the task runs, as many of the remaining items as fit are copied in a single
+ * critical section and the receiving task is woken up once. This function will
+ * block until all items are sent or until it times out.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to insert the items into
+ * @param[in]   ppvItems        Array of pointers to the data of each item. NULL is allowed for items of size 0.
+ * @param[in]   pxItemSizes     Array of the sizes of each item
+ * @param[in]   xItemNum        Number of items to insert
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
+ *
+ * @note    Each item is stored as if sent with xRingbufferSend(). Items of byte
+ *          buffers are appended to the buffer one after the other.
+ * @note    If the ring buffer was added to a queue set, the queue set is notified
+ *          once for every item sent.
+ * @note    Items following an item larger than the maximum permissible size of
+ *          the buffer are not sent.
+ *
+ * @return  Number of items sent, starting from the first one. Less than xItemNum on time-out.
+ */
+size_t xRingbufferSendBatch(RingbufHandle_t xRingbuffer,
+                            const void *const *ppvItems,
+                            const size_t *pxItemSizes,
+                            size_t xItemNum,
+                            TickType_t xTicksToWait);
+
+/**
+ * @brief       Insert an item gathered from several segments into the ring buffer
+ *
+ * Space for the whole item is acquired as with xRingbufferSendAcquire(), the
+ * segments are copied into it one after the other and the item is sent as with
+ * xRingbufferSendComplete(). This avoids assembling the item in a temporary
+ * buffer first, e.g. to prepend a header to a payload. This function will block
+ * until enough free space is available or until it times out.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to insert the item into
+ * @param[in]   pxIOVec         Array of segments of the item
+ * @param[in]   xIOVecNum       Number of segments
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
+ *
+ * @note Only applicable for no-split ring buffers. Use xRingbufferSendBatch()
+ *       to send several segments to a byte buffer.
+ * @note Not supported by single-producer/single-consumer ring buffers.
+ *
+ * @return
+ *      - pdTRUE if succeeded
+ *      - pdFALSE on time-out or when the item is larger than the maximum permissible size of the buffer
+ */
+BaseType_t xRingbufferSendv(RingbufHandle_t xRingbuffer,
+                            const RingbufferIOVec_t *pxIOVec,
+                            size_t xIOVecNum,
+                            TickType_t xTicksToWait);
+
 /**
  * @brief   Retrieve an item from the ring buffer
  *
@@ -362,6 +457,31 @@ void *xRingbufferReceiveUpTo(RingbufHandle_t xRingbuffer,
  */
 void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize, size_t xMaxSize);
 
+/**
+ * @brief   Retrieve several items from a no-split ring buffer
+ *
+ * Attempt to retrieve up to xMaxItems items from the ring buffer. This function
+ * will block until at least one item is available or until it times out, then
+ * retrieves all items available at that point (up to xMaxItems) in a single
+ * critical section.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to retrieve the items from
+ * @param[out]  ppvItems        Array of at least xMaxItems entries to which pointers to the retrieved items will be written
+ * @param[out]  pxItemSizes     Array of at least xMaxItems entries to which the sizes of the retrieved items will be written
+ * @param[in]   xMaxItems       Maximum number of items to retrieve
+ * @param[in]   xTicksToWait    Ticks to wait for items in the ring buffer.
+ *
+ * @note    The retrieved items must be returned with vRingbufferReturnItem() or vRingbufferReturnBatch().
+ * @note    This function should only be called on no-split buffers
+ *
+ * @return  Number of items retrieved, 0 on timeout.
+ */
+size_t xRingbufferReceiveBatch(RingbufHandle_t xRingbuffer,
+                               void **ppvItems,
+                               size_t *pxItemSizes,
+                               size_t xMaxItems,
+                               TickType_t xTicksToWait);
+
 /**
  * @brief   Return a previously-retrieved item to the ring buffer
  *
@@ -384,6 +504,18 @@ void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
  */
 void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, BaseType_t *pxHigherPriorityTaskWoken);
 
+/**
+ * @brief   Return several previously-retrieved items to the ring buffer
+ *
+ * The items are returned in a single critical section and the sending task is
+ * woken up once.
+ *
+ * @param[in]   xRingbuffer Ring buffer the items were retrieved from
+ * @param[in]   ppvItems    Array of items that were received earlier
+ * @param[in]   xItemNum    Number of items to return
+ */
+void vRingbufferReturnBatch(RingbufHandle_t xRingbuffer, void *const *ppvItems, size_t xItemNum);
+
 /**
  * @brief   Delete a ring buffer
  *
@@ -444,6 +576,8 @@ size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer);
  * @param[in]   xRingbuffer     Ring buffer to add to the queue set
  * @param[in]   xQueueSet       Queue set to add the ring buffer to
  *
+ * @note    Single-producer/single-consumer ring buffers can not be added to a queue set.
+ *
  * @return
  *      - pdTRUE on success, pdFALSE otherwise
  */
@@ -27,6 +27,7 @@
 #define rbBUFFER_FULL_FLAG          ( ( UBaseType_t ) 4 )   //The ring buffer is currently full (write pointer == free pointer)
 #define rbBUFFER_STATIC_FLAG        ( ( UBaseType_t ) 8 )   //The ring buffer is statically allocated
 #define rbUSING_QUEUE_SET           ( ( UBaseType_t ) 16 )  //The ring buffer has been added to a queue set
+#define rbSPSC_FLAG                 ( ( UBaseType_t ) 32 )  //The ring buffer has a single producer and a single consumer
 
 //Item flags
 #define rbITEM_FREE_FLAG            ( ( UBaseType_t ) 1 )   //Item has been retrieved and returned by application, free to overwrite
@@ -49,6 +50,23 @@ typedef void *(*GetItemFunction_t)(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsS
 typedef void (*ReturnItemFunction_t)(Ringbuffer_t *pxRingbuffer, uint8_t *pvItem);
 typedef size_t (*GetCurMaxSizeFunction_t)(Ringbuffer_t *pxRingbuffer);
 
+/*
+ * State of a single-producer/single-consumer ring buffer. The producer and the
+ * consumer only share the positions up to which data has been written and
+ * freed. Positions count the bytes (including headers and padding) that went
+ * through the buffer and are only ever written by one side, so they are
+ * accessed with acquire/release ordering instead of under the spinlock.
+ */
+typedef struct {
+    size_t xWritten;                            //Bytes published by the producer, written by the producer only
+    size_t xRead;                               //Bytes retrieved by the consumer, written by the consumer only
+    size_t xFreed;                              //Bytes returned by the consumer, written by the consumer only
+    size_t xItemsSent;                          //Items sent to a no-split buffer, written by the producer only
+    size_t xItemsReceived;                      //Items received from a no-split buffer, written by the consumer only
+    TaskHandle_t xTaskWaitingToSend;            //Producer task blocked waiting for free space
+    TaskHandle_t xTaskWaitingToReceive;         //Consumer task blocked waiting for data
+} RingbufferSpsc_t;
+
 typedef struct RingbufferDefinition {
     size_t xSize;                               //Size of the data storage
     size_t xMaxItemSize;                        //Maximum item size
@@ -68,14 +86,20 @@ typedef struct RingbufferDefinition {
     uint8_t *pucTail;                           //Pointer to the end of the ring buffer storage area
 
     BaseType_t xItemsWaiting;                   //Number of items/bytes(for byte buffers) currently in ring buffer that have not yet been read
-    List_t xTasksWaitingToSend;                 //List of tasks that are blocked waiting to send/acquire onto this ring buffer. Stored in priority order.
-    List_t xTasksWaitingToReceive;              //List of tasks that are blocked waiting to receive from this ring buffer. Stored in priority order.
+    union {
+        struct {
+            List_t xTasksWaitingToSend;         //List of tasks that are blocked waiting to send/acquire onto this ring buffer. Stored in priority order.
+            List_t xTasksWaitingToReceive;      //List of tasks that are blocked waiting to receive from this ring buffer. Stored in priority order.
+        };
+        RingbufferSpsc_t xSpsc;                 //Positions and waiting tasks of single-producer/single-consumer ring buffers
+    };
     QueueSetHandle_t xQueueSet;                 //Ring buffer's read queue set handle.
 
     portMUX_TYPE mux;                           //Spinlock required for SMP
 } Ringbuffer_t;
 
 _Static_assert(sizeof(StaticRingbuffer_t) == sizeof(Ringbuffer_t), "StaticRingbuffer_t != Ringbuffer_t");
+_Static_assert(sizeof(RingbufferSpsc_t) <= 2 * sizeof(List_t), "RingbufferSpsc_t does not fit in place of the task lists");
 
 // ------------------------------------------------ Forward Declares ---------------------------------------------------
 
@@ -170,21 +194,29 @@ static size_t prvGetCurMaxSizeAllowSplit(Ringbuffer_t *pxRingbuffer);
 static size_t prvGetCurMaxSizeByteBuf(Ringbuffer_t *pxRingbuffer);
 
 /*
-Generic function used to send or acquire an item/buffer.
-- If sending, set ppvItem to NULL. pvItem remains unchanged on failure.
-- If acquiring, set pvItem to NULL. ppvItem remains unchanged on failure.
+Generic function used to send items or acquire a buffer. Returns the number of
+items sent or acquired.
+- If sending, set ppvItem to NULL. The xItemNum items in ppvItems/pxItemSizes
+  are sent in order. As many of them as fit are copied in one critical section,
+  waking up the receiving task(s) once, until all are sent or it times out.
+- If acquiring, set ppvItems to NULL and xItemNum to 1. ppvItem remains
+  unchanged on failure.
 */
-static BaseType_t prvSendAcquireGeneric(Ringbuffer_t *pxRingbuffer,
-                                        const void *pvItem,
-                                        void **ppvItem,
-                                        size_t xItemSize,
-                                        TickType_t xTicksToWait);
+static size_t prvSendAcquireGeneric(Ringbuffer_t *pxRingbuffer,
+                                    const void *const *ppvItems,
+                                    void **ppvItem,
+                                    const size_t *pxItemSizes,
+                                    size_t xItemNum,
+                                    TickType_t xTicksToWait);
 
 /*
 Generic function used to retrieve an item/data from ring buffers. If called on
 an allow-split buffer, and pvItem2 and xItemSize2 are not NULL, both parts of
 a split item will be retrieved. xMaxSize will only take effect if called on
 byte buffers. xItemSize must remain unchanged if no item is retrieved.
+If pxItemNum is not NULL (no-split buffers only), pvItem1 and xItemSize1 are
+arrays of *pxItemNum entries. Once an item is available, up to *pxItemNum items
+are retrieved in one go and *pxItemNum is set to the number retrieved.
 */
 static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer,
                                     void **pvItem1,
@@ -192,6 +224,7 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer,
                                     size_t *xItemSize1,
                                     size_t *xItemSize2,
                                     size_t xMaxSize,
+                                    size_t *pxItemNum,
                                     TickType_t xTicksToWait);
 
 //From ISR version of prvReceiveGeneric()
@@ -202,6 +235,57 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer,
                                            size_t *xItemSize2,
                                            size_t xMaxSize);
 
+/*
+The following functions implement single-producer/single-consumer ring buffers
+and are thread safe as long as only the producer sends and only the consumer
+receives and returns items. They do not enter the critical section, except to
+wake up a blocked task.
+*/
+
+/*
+Copies an item to a no-split or byte buffer (producer only)
+Entry:
+    - xFreed is the consumer's freed position, as loaded by the caller
+Exit:
+    - Returns pdFALSE without changing the buffer if the item does not fit
+    - Otherwise, the item is copied, dummy data is added if necessary and xWritten is published
+*/
+static BaseType_t prvSpscCopyItem(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize, size_t xFreed);
+
+/*
+Retrieves an item, or up to xMaxSize bytes from a byte buffer (consumer only)
+Entry:
+    - xWritten is the producer's written position, as loaded by the caller
+Exit:
+    - Returns pdFALSE if there is nothing to retrieve (or a byte buffer has data that has not been returned yet)
+    - Otherwise, pucRead and xRead are advanced past the item and any dummy data
+*/
+static BaseType_t prvSpscGetItem(Ringbuffer_t *pxRingbuffer, void **ppvItem, size_t *pxItemSize, size_t xMaxSize, size_t xWritten);
+
+//Returns an item (consumer only). pucFree is advanced as far as possible and xFreed is published
+static void prvSpscReturnItem(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
+//Blocks the calling task until *pxPosition changes from xPosition, or until it times out
+static BaseType_t prvSpscWait(Ringbuffer_t *pxRingbuffer,
+                              TaskHandle_t *pxWaitingTask,
+                              const size_t *pxPosition,
+                              size_t xPosition,
+                              TickType_t *pxTicksToWait,
+                              TimeOut_t *pxTimeOut,
+                              BaseType_t *pxEntryTimeSet);
+
+//Wakes up the task blocked in prvSpscWait() on the other side of the ring buffer, if there is one
+static void prvSpscNotify(Ringbuffer_t *pxRingbuffer, TaskHandle_t *pxWaitingTask, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken);
+
+//Sends items to a single-producer/single-consumer ring buffer, blocking while they do not fit. Returns the number of items sent
+static size_t prvSpscSend(Ringbuffer_t *pxRingbuffer, const void *const *ppvItems, const size_t *pxItemSizes, size_t xItemNum, TickType_t xTicksToWait);
+
+//Receives an item from a single-producer/single-consumer ring buffer, blocking while there is none
+static BaseType_t prvSpscReceive(Ringbuffer_t *pxRingbuffer, void **ppvItem, size_t *pxItemSize, size_t xMaxSize, TickType_t xTicksToWait);
+
+//Get the maximum size an item that can currently have if sent to a single-producer/single-consumer ring buffer
+static size_t prvSpscGetCurMaxSize(Ringbuffer_t *pxRingbuffer);
+
 // ------------------------------------------------ Static Functions ---------------------------------------------------
 
 static void prvInitializeNewRingbuffer(size_t xBufferSize,
@@ -221,7 +305,7 @@ static void prvInitializeNewRingbuffer(size_t xBufferSize,
     pxNewRingbuffer->uxRingbufferFlags = 0;
 
     //Initialize type dependent values and function pointers
-    if (xBufferType == RINGBUF_TYPE_NOSPLIT) {
+    if (xBufferType == RINGBUF_TYPE_NOSPLIT || xBufferType == RINGBUF_TYPE_NOSPLIT_SPSC) {
         pxNewRingbuffer->xCheckItemFits = prvCheckItemFitsDefault;
         pxNewRingbuffer->vCopyItem = prvCopyItemNoSplit;
         pxNewRingbuffer->pvGetItem = prvGetItemDefault;
@@ -252,8 +336,14 @@ static void prvInitializeNewRingbuffer(size_t xBufferSize,
         pxNewRingbuffer->xGetCurMaxSize = prvGetCurMaxSizeByteBuf;
     }
 
-    vListInitialise(&pxNewRingbuffer->xTasksWaitingToSend);
-    vListInitialise(&pxNewRingbuffer->xTasksWaitingToReceive);
+    if (xBufferType == RINGBUF_TYPE_NOSPLIT_SPSC || xBufferType == RINGBUF_TYPE_BYTEBUF_SPSC) {
+        //The producer and the consumer block on task notifications instead of the lists
+        pxNewRingbuffer->uxRingbufferFlags |= rbSPSC_FLAG;
+        memset(&pxNewRingbuffer->xSpsc, 0, sizeof(pxNewRingbuffer->xSpsc));
+    } else {
+        vListInitialise(&pxNewRingbuffer->xTasksWaitingToSend);
+        vListInitialise(&pxNewRingbuffer->xTasksWaitingToReceive);
+    }
     pxNewRingbuffer->xQueueSet = NULL;
 
     portMUX_INITIALIZE(&pxNewRingbuffer->mux);
@@ -262,7 +352,11 @@ static void prvInitializeNewRingbuffer(size_t xBufferSize,
 static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer)
 {
     size_t xReturn;
-    if (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) {
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        //Load xFreed first, it can never get ahead of an xWritten loaded after it
+        size_t xFreed = __atomic_load_n(&pxRingbuffer->xSpsc.xFreed, __ATOMIC_ACQUIRE);
+        xReturn = pxRingbuffer->xSize - (__atomic_load_n(&pxRingbuffer->xSpsc.xWritten, __ATOMIC_ACQUIRE) - xFreed);
+    } else if (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) {
         xReturn =  0;
     } else {
         BaseType_t xFreeSize = pxRingbuffer->pucFree - pxRingbuffer->pucAcquire;
@@ -742,34 +836,50 @@ static size_t prvGetCurMaxSizeByteBuf(Ringbuffer_t *pxRingbuffer)
     return xFreeSize;
 }
 
-static BaseType_t prvSendAcquireGeneric(Ringbuffer_t *pxRingbuffer,
-                                        const void *pvItem,
-                                        void **ppvItem,
-                                        size_t xItemSize,
-                                        TickType_t xTicksToWait)
+static size_t prvSendAcquireGeneric(Ringbuffer_t *pxRingbuffer,
+                                    const void *const *ppvItems,
+                                    void **ppvItem,
+                                    const size_t *pxItemSizes,
+                                    size_t xItemNum,
+                                    TickType_t xTicksToWait)
 {
-    BaseType_t xReturn = pdFALSE;
+    size_t xItemsDone = 0;
     BaseType_t xExitLoop = pdFALSE;
     BaseType_t xEntryTimeSet = pdFALSE;
-    BaseType_t xNotifyQueueSet = pdFALSE;
+    size_t xNotifyQueueSet = 0;
     TimeOut_t xTimeOut;
 
     while (xExitLoop == pdFALSE) {
         portENTER_CRITICAL(&pxRingbuffer->mux);
-        if (pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
-            //xItemSize will fit. Copy or acquire the buffer immediately
-            if (ppvItem) {
-                //Acquire the buffer
-                *ppvItem = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
-            } else {
-                //Copy item into buffer
-                pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
+        if (ppvItem) {
+            //Acquire the buffer if xItemSize will fit
+            if (pxRingbuffer->xCheckItemFits(pxRingbuffer, pxItemSizes[0]) == pdTRUE) {
+                *ppvItem = prvAcquireItemNoSplit(pxRingbuffer, pxItemSizes[0]);
+                xItemsDone = 1;
+            }
+        } else {
+            //Copy as many of the remaining items into the buffer as currently fit
+            size_t xItemsCopied = 0;
+            while (xItemsDone < xItemNum) {
+                size_t xItemSize = pxItemSizes[xItemsDone];
+                if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
+                    xItemsDone++;   //Sending 0 bytes to byte buffer has no effect
+                    continue;
+                }
+                if (pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdFALSE) {
+                    break;
+                }
+                pxRingbuffer->vCopyItem(pxRingbuffer, ppvItems[xItemsDone], xItemSize);
+                xItemsDone++;
+                xItemsCopied++;
+            }
+            if (xItemsCopied > 0) {
                 if (pxRingbuffer->xQueueSet) {
-                    //If ring buffer was added to a queue set, notify the queue set
-                    xNotifyQueueSet = pdTRUE;
+                    //If ring buffer was added to a queue set, notify the queue set once per item
+                    xNotifyQueueSet = xItemsCopied;
                 } else {
-                    //If a task was waiting for data to arrive on the ring buffer, unblock it immediately.
-                    if (listLIST_IS_EMPTY(&pxRingbuffer->xTasksWaitingToReceive) == pdFALSE) {
+                    //If tasks were waiting for data to arrive on the ring buffer, unblock as many as there are new items
+                    while (xItemsCopied-- > 0 && listLIST_IS_EMPTY(&pxRingbuffer->xTasksWaitingToReceive) == pdFALSE) {
                         if (xTaskRemoveFromEventList(&pxRingbuffer->xTasksWaitingToReceive) == pdTRUE) {
                             //The unblocked task will preempt us. Trigger a yield here.
                             portYIELD_WITHIN_API();
@@ -777,9 +887,15 @@ static BaseType_t prvSendAcquireGeneric(Ringbuffer_t *pxRingbuffer,
                     }
                 }
             }
-            xReturn = pdTRUE;
+        }
+
+        if (xItemsDone == xItemNum) {
+            //All items copied, or the buffer acquired
             xExitLoop = pdTRUE;
             goto loop_end;
+        } else if (xNotifyQueueSet > 0) {
+            //Notify the queue set of the items sent so far before blocking
+            goto loop_end;
         } else if (xTicksToWait == (TickType_t) 0) {
             //No block time. Return immediately.
             xExitLoop = pdTRUE;
@@ -800,13 +916,13 @@ static BaseType_t prvSendAcquireGeneric(Ringbuffer_t *pxRingbuffer,
         }
 loop_end:
         portEXIT_CRITICAL(&pxRingbuffer->mux);
-    }
-    //Defer notifying the queue set until we are outside the loop and critical section.
-    if (xNotifyQueueSet == pdTRUE) {
-        xQueueSend((QueueHandle_t)pxRingbuffer->xQueueSet, (QueueSetMemberHandle_t *)&pxRingbuffer, 0);
+        //Defer notifying the queue set until we are outside the critical section.
+        for (; xNotifyQueueSet > 0; xNotifyQueueSet--) {
+            xQueueSend((QueueHandle_t)pxRingbuffer->xQueueSet, (QueueSetMemberHandle_t *)&pxRingbuffer, 0);
+        }
     }
 
-    return xReturn;
+    return xItemsDone;
 }
 
 static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer,
@@ -815,6 +931,7 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer,
                                     size_t *xItemSize1,
                                     size_t *xItemSize2,
                                     size_t xMaxSize,
+                                    size_t *pxItemNum,
                                     TickType_t xTicksToWait)
 {
     BaseType_t xReturn = pdFALSE;
@@ -829,6 +946,22 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer,
     }
 #endif /*__clang_analyzer__ */
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (prvSpscReceive(pxRingbuffer, pvItem1, xItemSize1, xMaxSize, xTicksToWait) == pdFALSE) {
+            return pdFALSE;
+        }
+        if (pxItemNum) {
+            //Get the items that are already available without waiting again
+            size_t xItemNum = 1;
+            size_t xWritten = __atomic_load_n(&pxRingbuffer->xSpsc.xWritten, __ATOMIC_ACQUIRE);
+            while (xItemNum < *pxItemNum && prvSpscGetItem(pxRingbuffer, &pvItem1[xItemNum], &xItemSize1[xItemNum], 0, xWritten) == pdTRUE) {
+                xItemNum++;
+            }
+            *pxItemNum = xItemNum;
+        }
+        return pdTRUE;
+    }
+
     while (xExitLoop == pdFALSE) {
         portENTER_CRITICAL(&pxRingbuffer->mux);
         if (prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
@@ -841,6 +974,15 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer,
                 //Get (first) item from no-split/allow-split buffers
                 *pvItem1 = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize1);
             }
+            if (pxItemNum) {
+                //Get the items that are already available in the same critical section
+                size_t xItemNum = 1;
+                while (xItemNum < *pxItemNum && prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
+                    pvItem1[xItemNum] = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, &xItemSize1[xItemNum]);
+                    xItemNum++;
+                }
+                *pxItemNum = xItemNum;
+            }
             //If split buffer, check for split items
             if (pxRingbuffer->uxRingbufferFlags & rbALLOW_SPLIT_FLAG) {
                 if (xIsSplit == pdTRUE) {
@@ -895,6 +1037,11 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer,
     }
 #endif /*__clang_analyzer__ */
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        size_t xWritten = __atomic_load_n(&pxRingbuffer->xSpsc.xWritten, __ATOMIC_ACQUIRE);
+        return prvSpscGetItem(pxRingbuffer, pvItem1, xItemSize1, xMaxSize, xWritten);
+    }
+
     portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
     if (prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
         BaseType_t xIsSplit = pdFALSE;
@@ -924,6 +1071,300 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer,
     return xReturn;
 }
 
+static BaseType_t prvSpscCopyItem(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize, size_t xFreed)
+{
+    RingbufferSpsc_t *pxSpsc = &pxRingbuffer->xSpsc;
+    size_t xFreeSize = pxRingbuffer->xSize - (pxSpsc->xWritten - xFreed);
+    uint8_t *pucAcquire = pxRingbuffer->pucAcquire;
+    size_t xRemLen = pxRingbuffer->pucTail - pucAcquire;    //Length from pucAcquire until end of buffer
+    size_t xAdvance;                                        //Bytes of the buffer used up by the item
+
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        if (xItemSize > xFreeSize) {
+            return pdFALSE;
+        }
+        if (xRemLen <= xItemSize) {
+            //Data wraps around (or ends exactly at the end of the buffer)
+            memcpy(pucAcquire, pucItem, xRemLen);
+            memcpy(pxRingbuffer->pucHead, pucItem + xRemLen, xItemSize - xRemLen);
+            pucAcquire = pxRingbuffer->pucHead + (xItemSize - xRemLen);
+        } else {
+            memcpy(pucAcquire, pucItem, xItemSize);
+            pucAcquire += xItemSize;
+        }
+        xAdvance = xItemSize;
+    } else {
+        configASSERT(rbCHECK_ALIGNED(pucAcquire));
+        configASSERT(xRemLen >= rbHEADER_SIZE);     //pucAcquire is wrapped around when a header no longer fits
+
+        size_t xTotalItemSize = rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE;
+        uint8_t *pucItemHeader = pucAcquire;
+        xAdvance = xTotalItemSize;
+        if (xRemLen < xTotalItemSize) {
+            //Item does not fit before the end of the buffer, the remaining length becomes dummy data
+            pucItemHeader = pxRingbuffer->pucHead;
+            xAdvance += xRemLen;
+        }
+        uint8_t *pucNext = pucItemHeader + xTotalItemSize;
+        if (pxRingbuffer->pucTail - pucNext < rbHEADER_SIZE) {
+            //Remaining length can't fit a header, it is skipped along with the item
+            xAdvance += pxRingbuffer->pucTail - pucNext;
+            pucNext = pxRingbuffer->pucHead;
+        }
+        if (xAdvance > xFreeSize) {
+            return pdFALSE;
+        }
+
+        if (pucItemHeader != pucAcquire) {
+            ItemHeader_t *pxDummy = (ItemHeader_t *)pucAcquire;
+            pxDummy->uxItemFlags = rbITEM_DUMMY_DATA_FLAG;
+            pxDummy->xItemLen = 0;
+        }
+        ItemHeader_t *pxHeader = (ItemHeader_t *)pucItemHeader;
+        pxHeader->xItemLen = xItemSize;
+        pxHeader->uxItemFlags = 0;
+        memcpy(pucItemHeader + rbHEADER_SIZE, pucItem, xItemSize);
+        pucAcquire = pucNext;
+        __atomic_store_n(&pxSpsc->xItemsSent, pxSpsc->xItemsSent + 1, __ATOMIC_RELAXED);
+    }
+
+    //Wrap around pucAcquire if it reaches the end
+    if (pucAcquire == pxRingbuffer->pucTail) {
+        pucAcquire = pxRingbuffer->pucHead;
+    }
+    pxRingbuffer->pucAcquire = pucAcquire;
+    pxRingbuffer->pucWrite = pucAcquire;
+    //Publish the item, the consumer must see its contents before the new position
+    __atomic_store_n(&pxSpsc->xWritten, pxSpsc->xWritten + xAdvance, __ATOMIC_RELEASE);
+    return pdTRUE;
+}
+
+static BaseType_t prvSpscGetItem(Ringbuffer_t *pxRingbuffer, void **ppvItem, size_t *pxItemSize, size_t xMaxSize, size_t xWritten)
+{
+    RingbufferSpsc_t *pxSpsc = &pxRingbuffer->xSpsc;
+    uint8_t *pucRead = pxRingbuffer->pucRead;
+    size_t xRead = pxSpsc->xRead;
+
+    if (xWritten == xRead) {
+        return pdFALSE;     //No items/data available for retrieval
+    }
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        if (xRead != pxSpsc->xFreed) {
+            return pdFALSE;     //Byte buffers do not allow multiple retrievals before return
+        }
+        //Return contiguous data from the read pointer, up to xMaxSize if given
+        size_t xLen = xWritten - xRead;
+        if (xLen > (size_t)(pxRingbuffer->pucTail - pucRead)) {
+            xLen = pxRingbuffer->pucTail - pucRead;
+        }
+        if (xMaxSize != 0 && xLen > xMaxSize) {
+            xLen = xMaxSize;
+        }
+        *ppvItem = pucRead;
+        *pxItemSize = xLen;
+        pucRead += xLen;
+        xRead += xLen;
+        if (pucRead == pxRingbuffer->pucTail) {
+            pucRead = pxRingbuffer->pucHead;
+        }
+    } else {
+        ItemHeader_t *pxHeader = (ItemHeader_t *)pucRead;
+        if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+            //Dummy data indicates wrap around
+            xRead += pxRingbuffer->pucTail - pucRead;
+            pucRead = pxRingbuffer->pucHead;
+            pxHeader = (ItemHeader_t *)pucRead;
+        }
+        configASSERT(pxHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+        *ppvItem = pucRead + rbHEADER_SIZE;
+        *pxItemSize = pxHeader->xItemLen;
+        pucRead += rbHEADER_SIZE + rbALIGN_SIZE(pxHeader->xItemLen);
+        xRead += rbHEADER_SIZE + rbALIGN_SIZE(pxHeader->xItemLen);
+        //Skip the remaining length if it can't fit a header, as the producer did
+        if ((pxRingbuffer->pucTail - pucRead) < rbHEADER_SIZE) {
+            xRead += pxRingbuffer->pucTail - pucRead;
+            pucRead = pxRingbuffer->pucHead;
+        }
+        __atomic_store_n(&pxSpsc->xItemsReceived, pxSpsc->xItemsReceived + 1, __ATOMIC_RELEASE);
+    }
+    configASSERT(xWritten - xRead <= pxRingbuffer->xSize);     //Check the read position has not overtaken the written one
+    pxRingbuffer->pucRead = pucRead;
+    __atomic_store_n(&pxSpsc->xRead, xRead, __ATOMIC_RELEASE);
+    return pdTRUE;
+}
+
+static void prvSpscReturnItem(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    RingbufferSpsc_t *pxSpsc = &pxRingbuffer->xSpsc;
+    size_t xFreed = pxSpsc->xFreed;
+
+    configASSERT(pucItem >= pxRingbuffer->pucHead);
+    configASSERT(pucItem <= pxRingbuffer->pucTail);     //Inclusive of pucTail in the case of zero length item at the very end
+
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        //Byte buffers do not allow multiple outstanding reads, free everything that was read
+        pxRingbuffer->pucFree = pxRingbuffer->pucRead;
+        xFreed = pxSpsc->xRead;
+    } else {
+        ItemHeader_t *pxCurHeader = (ItemHeader_t *)(pucItem - rbHEADER_SIZE);
+        configASSERT(rbCHECK_ALIGNED(pucItem));
+        configASSERT((pxCurHeader->uxItemFlags & (rbITEM_DUMMY_DATA_FLAG | rbITEM_FREE_FLAG)) == 0);
+        pxCurHeader->uxItemFlags |= rbITEM_FREE_FLAG;
+
+        //Items might be returned out of order, move the free pointer past all items returned so far
+        uint8_t *pucFree = pxRingbuffer->pucFree;
+        pxCurHeader = (ItemHeader_t *)pucFree;
+        while (xFreed != pxSpsc->xRead && (pxCurHeader->uxItemFlags & (rbITEM_FREE_FLAG | rbITEM_DUMMY_DATA_FLAG))) {
+            if (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+                xFreed += pxRingbuffer->pucTail - pucFree;
+                pucFree = pxRingbuffer->pucHead;
+            } else {
+                size_t xItemTotalSize = rbHEADER_SIZE + rbALIGN_SIZE(pxCurHeader->xItemLen);
+                pucFree += xItemTotalSize;
+                xFreed += xItemTotalSize;
+                if ((pxRingbuffer->pucTail - pucFree) < rbHEADER_SIZE) {
+                    xFreed += pxRingbuffer->pucTail - pucFree;
+                    pucFree = pxRingbuffer->pucHead;
+                }
+            }
+            pxCurHeader = (ItemHeader_t *)pucFree;
+        }
+        pxRingbuffer->pucFree = pucFree;
+    }
+    //Publish the free space, the consumer must be done with the data before the producer overwrites it
+    __atomic_store_n(&pxSpsc->xFreed, xFreed, __ATOMIC_RELEASE);
+}
+
+static BaseType_t prvSpscWait(Ringbuffer_t *pxRingbuffer,
+                              TaskHandle_t *pxWaitingTask,
+                              const size_t *pxPosition,
+                              size_t xPosition,
+                              TickType_t *pxTicksToWait,
+                              TimeOut_t *pxTimeOut,
+                              BaseType_t *pxEntryTimeSet)
+{
+    if (*pxTicksToWait == (TickType_t) 0) {
+        return pdFALSE;
+    }
+    if (*pxEntryTimeSet == pdFALSE) {
+        //This is our first block. Set entry time
+        vTaskInternalSetTimeOutState(pxTimeOut);
+        *pxEntryTimeSet = pdTRUE;
+    }
+    if (xTaskCheckForTimeOut(pxTimeOut, pxTicksToWait) == pdTRUE) {
+        return pdFALSE;
+    }
+
+    /*
+     * Register as the waiting task, then check the position again. The other
+     * side publishes the position before checking for a waiting task, so
+     * either it sees this task and notifies it, or this task sees the new
+     * position and does not block. A notification left over from an earlier
+     * wait only causes another iteration of the caller's loop.
+     */
+    (void) xTaskNotifyStateClear(NULL);
+    __atomic_store_n(pxWaitingTask, xTaskGetCurrentTaskHandle(), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(pxPosition, __ATOMIC_RELAXED) == xPosition) {
+        (void) xTaskNotifyWait(0, 0, NULL, *pxTicksToWait);
+    }
+    portENTER_CRITICAL(&pxRingbuffer->mux);
+    __atomic_store_n(pxWaitingTask, NULL, __ATOMIC_RELAXED);
+    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    return pdTRUE;
+}
+
+static void prvSpscNotify(Ringbuffer_t *pxRingbuffer, TaskHandle_t *pxWaitingTask, BaseType_t xFromISR, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    TaskHandle_t xTask;
+
+    //The position must be published before checking for a waiting task. See prvSpscWait()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(pxWaitingTask, __ATOMIC_RELAXED) == NULL) {
+        return;
+    }
+    if (xFromISR) {
+        portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
+        xTask = __atomic_load_n(pxWaitingTask, __ATOMIC_RELAXED);
+        __atomic_store_n(pxWaitingTask, NULL, __ATOMIC_RELAXED);
+        portEXIT_CRITICAL_ISR(&pxRingbuffer->mux);
+        if (xTask != NULL) {
+            (void) xTaskNotifyFromISR(xTask, 0, eNoAction, pxHigherPriorityTaskWoken);
+        }
+    } else {
+        portENTER_CRITICAL(&pxRingbuffer->mux);
+        xTask = __atomic_load_n(pxWaitingTask, __ATOMIC_RELAXED);
+        __atomic_store_n(pxWaitingTask, NULL, __ATOMIC_RELAXED);
+        portEXIT_CRITICAL(&pxRingbuffer->mux);
+        if (xTask != NULL) {
+            (void) xTaskNotify(xTask, 0, eNoAction);
+        }
+    }
+}
+
+static size_t prvSpscSend(Ringbuffer_t *pxRingbuffer, const void *const *ppvItems, const size_t *pxItemSizes, size_t xItemNum, TickType_t xTicksToWait)
+{
+    RingbufferSpsc_t *pxSpsc = &pxRingbuffer->xSpsc;
+    BaseType_t xEntryTimeSet = pdFALSE;
+    TimeOut_t xTimeOut;
+    size_t xItemsSent = 0;
+
+    size_t xFreed = __atomic_load_n(&pxSpsc->xFreed, __ATOMIC_ACQUIRE);
+    while (1) {
+        //Copy as many of the remaining items as currently fit, then wake up the consumer once
+        size_t xItemsBefore = xItemsSent;
+        while (xItemsSent < xItemNum && prvSpscCopyItem(pxRingbuffer, ppvItems[xItemsSent], pxItemSizes[xItemsSent], xFreed) == pdTRUE) {
+            xItemsSent++;
+        }
+        if (xItemsSent != xItemsBefore) {
+            prvSpscNotify(pxRingbuffer, &pxSpsc->xTaskWaitingToReceive, pdFALSE, NULL);
+        }
+        if (xItemsSent == xItemNum) {
+            break;
+        }
+        //Buffer is full. Wait for the consumer to return items
+        if (prvSpscWait(pxRingbuffer, &pxSpsc->xTaskWaitingToSend, &pxSpsc->xFreed, xFreed, &xTicksToWait, &xTimeOut, &xEntryTimeSet) == pdFALSE) {
+            break;
+        }
+        xFreed = __atomic_load_n(&pxSpsc->xFreed, __ATOMIC_ACQUIRE);
+    }
+    return xItemsSent;
+}
+
+static BaseType_t prvSpscReceive(Ringbuffer_t *pxRingbuffer, void **ppvItem, size_t *pxItemSize, size_t xMaxSize, TickType_t xTicksToWait)
+{
+    RingbufferSpsc_t *pxSpsc = &pxRingbuffer->xSpsc;
+    BaseType_t xEntryTimeSet = pdFALSE;
+    TimeOut_t xTimeOut;
+
+    size_t xWritten = __atomic_load_n(&pxSpsc->xWritten, __ATOMIC_ACQUIRE);
+    while (prvSpscGetItem(pxRingbuffer, ppvItem, pxItemSize, xMaxSize, xWritten) == pdFALSE) {
+        //Buffer is empty. Wait for the producer to send items
+        if (prvSpscWait(pxRingbuffer, &pxSpsc->xTaskWaitingToReceive, &pxSpsc->xWritten, xWritten, &xTicksToWait, &xTimeOut, &xEntryTimeSet) == pdFALSE) {
+            return pdFALSE;
+        }
+        xWritten = __atomic_load_n(&pxSpsc->xWritten, __ATOMIC_ACQUIRE);
+    }
+    return pdTRUE;
+}
+
+static size_t prvSpscGetCurMaxSize(Ringbuffer_t *pxRingbuffer)
+{
+    size_t xFreeSize = prvGetFreeSize(pxRingbuffer);
+    if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) || xFreeSize == 0) {
+        return xFreeSize;
+    }
+
+    //The free space starts at pucAcquire, a no-split item needs a header and contiguous space
+    size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;
+    if (xFreeSize > xRemLen) {
+        //Free space wraps around, select largest contiguous free space
+        xFreeSize = (xRemLen > xFreeSize - xRemLen) ? xRemLen : xFreeSize - xRemLen;
+    }
+    xFreeSize = (xFreeSize > rbHEADER_SIZE) ? (xFreeSize - rbHEADER_SIZE) & ~rbALIGN_MASK : 0;
+    return (xFreeSize > pxRingbuffer->xMaxItemSize) ? pxRingbuffer->xMaxItemSize : xFreeSize;
+}
+
 // ------------------------------------------------ Public Functions ---------------------------------------------------
 
 RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType)
@@ -932,7 +1373,7 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferTy
     configASSERT(xBufferType < RINGBUF_TYPE_MAX);
 
     //Allocate memory
-    if (xBufferType != RINGBUF_TYPE_BYTEBUF) {
+    if (xBufferType != RINGBUF_TYPE_BYTEBUF && xBufferType != RINGBUF_TYPE_BYTEBUF_SPSC) {
         xBufferSize = rbALIGN_SIZE(xBufferSize);    //xBufferSize is rounded up for no-split/allow-split buffers
     }
     Ringbuffer_t *pxNewRingbuffer = calloc(1, sizeof(Ringbuffer_t));
@@ -965,7 +1406,7 @@ RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize,
     configASSERT(xBufferSize > 0);
     configASSERT(xBufferType < RINGBUF_TYPE_MAX);
     configASSERT(pucRingbufferStorage != NULL && pxStaticRingbuffer != NULL);
-    if (xBufferType != RINGBUF_TYPE_BYTEBUF) {
+    if (xBufferType != RINGBUF_TYPE_BYTEBUF && xBufferType != RINGBUF_TYPE_BYTEBUF_SPSC) {
         //No-split/allow-split buffer sizes must be 32-bit aligned
         configASSERT(rbCHECK_ALIGNED(xBufferSize));
     }
@@ -983,7 +1424,7 @@ BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, s
     //Check arguments
     configASSERT(pxRingbuffer);
     configASSERT(ppvItem != NULL);
-    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0); //Send acquire currently only supported in NoSplit buffers
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG | rbSPSC_FLAG)) == 0); //Send acquire currently only supported in NoSplit buffers
 
     *ppvItem = NULL;
     if (xItemSize > pxRingbuffer->xMaxItemSize) {
@@ -993,7 +1434,7 @@ BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, s
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
 
-    return prvSendAcquireGeneric(pxRingbuffer, NULL, ppvItem, xItemSize, xTicksToWait);
+    return (prvSendAcquireGeneric(pxRingbuffer, NULL, ppvItem, &xItemSize, 1, xTicksToWait) == 1) ? pdTRUE : pdFALSE;
 }
 
 BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem)
@@ -1004,7 +1445,7 @@ BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem)
     //Check arguments
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
-    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG | rbSPSC_FLAG)) == 0);
 
     portENTER_CRITICAL(&pxRingbuffer->mux);
     prvSendItemDoneNoSplit(pxRingbuffer, pvItem);
@@ -1044,8 +1485,11 @@ BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer,
     if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return (prvSpscSend(pxRingbuffer, &pvItem, &xItemSize, 1, xTicksToWait) == 1) ? pdTRUE : pdFALSE;
+    }
 
-    return prvSendAcquireGeneric(pxRingbuffer, pvItem, NULL, xItemSize, xTicksToWait);
+    return (prvSendAcquireGeneric(pxRingbuffer, &pvItem, NULL, &xItemSize, 1, xTicksToWait) == 1) ? pdTRUE : pdFALSE;
 }
 
 BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer,
@@ -1066,6 +1510,14 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer,
     if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        size_t xFreed = __atomic_load_n(&pxRingbuffer->xSpsc.xFreed, __ATOMIC_ACQUIRE);
+        if (prvSpscCopyItem(pxRingbuffer, pvItem, xItemSize, xFreed) == pdFALSE) {
+            return pdFALSE;
+        }
+        prvSpscNotify(pxRingbuffer, &pxRingbuffer->xSpsc.xTaskWaitingToReceive, pdTRUE, pxHigherPriorityTaskWoken);
+        return pdTRUE;
+    }
 
     portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
     if (pxRingbuffer->xCheckItemFits(xRingbuffer, xItemSize) == pdTRUE) {
@@ -1096,6 +1548,68 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer,
     return xReturn;
 }
 
+size_t xRingbufferSendBatch(RingbufHandle_t xRingbuffer,
+                            const void *const *ppvItems,
+                            const size_t *pxItemSizes,
+                            size_t xItemNum,
+                            TickType_t xTicksToWait)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+
+    //Check arguments
+    configASSERT(pxRingbuffer);
+    configASSERT((ppvItems != NULL && pxItemSizes != NULL) || xItemNum == 0);
+    for (size_t i = 0; i < xItemNum; i++) {
+        configASSERT(ppvItems[i] != NULL || pxItemSizes[i] == 0);
+        if (pxItemSizes[i] > pxRingbuffer->xMaxItemSize) {
+            xItemNum = i;   //Data will never ever fit in the queue. Only send the items before it
+            break;
+        }
+    }
+    if (xItemNum == 0) {
+        return 0;
+    }
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvSpscSend(pxRingbuffer, ppvItems, pxItemSizes, xItemNum, xTicksToWait);
+    }
+
+    return prvSendAcquireGeneric(pxRingbuffer, ppvItems, NULL, pxItemSizes, xItemNum, xTicksToWait);
+}
+
+BaseType_t xRingbufferSendv(RingbufHandle_t xRingbuffer,
+                            const RingbufferIOVec_t *pxIOVec,
+                            size_t xIOVecNum,
+                            TickType_t xTicksToWait)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+
+    //Check arguments
+    configASSERT(pxRingbuffer);
+    configASSERT(pxIOVec != NULL || xIOVecNum == 0);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG | rbSPSC_FLAG)) == 0); //Gathering relies on send acquire, only supported in NoSplit buffers
+
+    size_t xItemSize = 0;
+    for (size_t i = 0; i < xIOVecNum; i++) {
+        configASSERT(pxIOVec[i].pvBase != NULL || pxIOVec[i].xLen == 0);
+        if (pxIOVec[i].xLen > pxRingbuffer->xMaxItemSize - xItemSize) {
+            return pdFALSE;     //Data will never ever fit in the queue.
+        }
+        xItemSize += pxIOVec[i].xLen;
+    }
+
+    //Acquire space for the whole item, gather the segments into it outside of the critical section, then send it
+    void *pvItem;
+    if (prvSendAcquireGeneric(pxRingbuffer, NULL, &pvItem, &xItemSize, 1, xTicksToWait) == 0) {
+        return pdFALSE;
+    }
+    uint8_t *pucDest = (uint8_t *)pvItem;
+    for (size_t i = 0; i < xIOVecNum; i++) {
+        memcpy(pucDest, pxIOVec[i].pvBase, pxIOVec[i].xLen);
+        pucDest += pxIOVec[i].xLen;
+    }
+    return xRingbufferSendComplete(xRingbuffer, pvItem);
+}
+
 void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
@@ -1105,7 +1619,7 @@ void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickTy
 
     //Attempt to retrieve an item
     void *pvTempItem;
-    if (prvReceiveGeneric(pxRingbuffer, &pvTempItem, NULL, pxItemSize, NULL, 0, xTicksToWait) == pdTRUE) {
+    if (prvReceiveGeneric(pxRingbuffer, &pvTempItem, NULL, pxItemSize, NULL, 0, NULL, xTicksToWait) == pdTRUE) {
         return pvTempItem;
     } else {
         return NULL;
@@ -1141,7 +1655,7 @@ BaseType_t xRingbufferReceiveSplit(RingbufHandle_t xRingbuffer,
     configASSERT(pxRingbuffer && ppvHeadItem && ppvTailItem && pxHeadItemSize && pxTailItemSize);
     configASSERT(pxRingbuffer->uxRingbufferFlags & rbALLOW_SPLIT_FLAG);
 
-    return prvReceiveGeneric(pxRingbuffer, ppvHeadItem, ppvTailItem, pxHeadItemSize, pxTailItemSize, 0, xTicksToWait);
+    return prvReceiveGeneric(pxRingbuffer, ppvHeadItem, ppvTailItem, pxHeadItemSize, pxTailItemSize, 0, NULL, xTicksToWait);
 }
 
 BaseType_t xRingbufferReceiveSplitFromISR(RingbufHandle_t xRingbuffer,
@@ -1175,7 +1689,7 @@ void *xRingbufferReceiveUpTo(RingbufHandle_t xRingbuffer,
     }
     //Attempt to retrieve up to xMaxSize bytes
     void *pvTempItem;
-    if (prvReceiveGeneric(pxRingbuffer, &pvTempItem, NULL, pxItemSize, NULL, xMaxSize, xTicksToWait) == pdTRUE) {
+    if (prvReceiveGeneric(pxRingbuffer, &pvTempItem, NULL, pxItemSize, NULL, xMaxSize, NULL, xTicksToWait) == pdTRUE) {
         return pvTempItem;
     } else {
         return NULL;
@@ -1202,12 +1716,42 @@ void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemS
     }
 }
 
+size_t xRingbufferReceiveBatch(RingbufHandle_t xRingbuffer,
+                               void **ppvItems,
+                               size_t *pxItemSizes,
+                               size_t xMaxItems,
+                               TickType_t xTicksToWait)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+
+    //Check arguments
+    configASSERT(pxRingbuffer && ppvItems && pxItemSizes);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0);  //This function should only be called for no-split buffers
+
+    if (xMaxItems == 0) {
+        return 0;
+    }
+    //Attempt to retrieve up to xMaxItems items
+    size_t xItemNum = xMaxItems;
+    if (prvReceiveGeneric(pxRingbuffer, ppvItems, NULL, pxItemSizes, NULL, 0, &xItemNum, xTicksToWait) == pdTRUE) {
+        return xItemNum;
+    } else {
+        return 0;
+    }
+}
+
 void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        prvSpscReturnItem(pxRingbuffer, (uint8_t *)pvItem);
+        prvSpscNotify(pxRingbuffer, &pxRingbuffer->xSpsc.xTaskWaitingToSend, pdFALSE, NULL);
+        return;
+    }
+
     portENTER_CRITICAL(&pxRingbuffer->mux);
     pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
     //If a task was waiting for space to send, unblock it immediately.
@@ -1226,6 +1770,12 @@ void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, Bas
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        prvSpscReturnItem(pxRingbuffer, (uint8_t *)pvItem);
+        prvSpscNotify(pxRingbuffer, &pxRingbuffer->xSpsc.xTaskWaitingToSend, pdTRUE, pxHigherPriorityTaskWoken);
+        return;
+    }
+
     portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
     pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
     //If a task was waiting for space to send, unblock it immediately.
@@ -1240,6 +1790,37 @@ void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, Bas
     portEXIT_CRITICAL_ISR(&pxRingbuffer->mux);
 }
 
+void vRingbufferReturnBatch(RingbufHandle_t xRingbuffer, void *const *ppvItems, size_t xItemNum)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL || xItemNum == 0);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) == 0 || xItemNum <= 1);   //Byte buffers do not allow multiple retrievals before return
+
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        for (size_t i = 0; i < xItemNum; i++) {
+            configASSERT(ppvItems[i] != NULL);
+            prvSpscReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+        }
+        prvSpscNotify(pxRingbuffer, &pxRingbuffer->xSpsc.xTaskWaitingToSend, pdFALSE, NULL);
+        return;
+    }
+
+    portENTER_CRITICAL(&pxRingbuffer->mux);
+    for (size_t i = 0; i < xItemNum; i++) {
+        configASSERT(ppvItems[i] != NULL);
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+    }
+    //If tasks were waiting for space to send, unblock as many as there are returned items
+    for (size_t i = 0; i < xItemNum && listLIST_IS_EMPTY(&pxRingbuffer->xTasksWaitingToSend) == pdFALSE; i++) {
+        if (xTaskRemoveFromEventList(&pxRingbuffer->xTasksWaitingToSend) == pdTRUE) {
+            //The unblocked task will preempt us. Trigger a yield here.
+            portYIELD_WITHIN_API();
+        }
+    }
+    portEXIT_CRITICAL(&pxRingbuffer->mux);
+}
+
 void vRingbufferDelete(RingbufHandle_t xRingbuffer)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
@@ -1264,6 +1845,10 @@ size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer)
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvSpscGetCurMaxSize(pxRingbuffer);
+    }
+
     size_t xFreeSize;
     portENTER_CRITICAL(&pxRingbuffer->mux);
     xFreeSize = pxRingbuffer->xGetCurMaxSize(pxRingbuffer);
@@ -1278,6 +1863,10 @@ BaseType_t xRingbufferAddToQueueSetRead(RingbufHandle_t xRingbuffer, QueueSetHan
 
     configASSERT(pxRingbuffer && xQueueSet);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return pdFALSE;     //Single-producer/single-consumer ring buffers do not notify queue sets
+    }
+
     portENTER_CRITICAL(&pxRingbuffer->mux);
     if (pxRingbuffer->xQueueSet != NULL || prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
         /*
@@ -1343,7 +1932,16 @@ void vRingbufferGetInfo(RingbufHandle_t xRingbuffer,
         *uxAcquire = (UBaseType_t)(pxRingbuffer->pucAcquire - pxRingbuffer->pucHead);
     }
     if (uxItemsWaiting != NULL) {
-        *uxItemsWaiting = (UBaseType_t)(pxRingbuffer->xItemsWaiting);
+        if (!(pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG)) {
+            *uxItemsWaiting = (UBaseType_t)(pxRingbuffer->xItemsWaiting);
+        } else if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+            //Consumer positions are loaded first, they can never get ahead of the producer's
+            size_t xRead = __atomic_load_n(&pxRingbuffer->xSpsc.xRead, __ATOMIC_ACQUIRE);
+            *uxItemsWaiting = (UBaseType_t)(__atomic_load_n(&pxRingbuffer->xSpsc.xWritten, __ATOMIC_ACQUIRE) - xRead);
+        } else {
+            size_t xItemsReceived = __atomic_load_n(&pxRingbuffer->xSpsc.xItemsReceived, __ATOMIC_ACQUIRE);
+            *uxItemsWaiting = (UBaseType_t)(__atomic_load_n(&pxRingbuffer->xSpsc.xItemsSent, __ATOMIC_ACQUIRE) - xItemsReceived);
+        }
     }
     portEXIT_CRITICAL(&pxRingbuffer->mux);
 }
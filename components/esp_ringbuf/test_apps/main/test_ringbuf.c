@@ -860,7 +860,7 @@ static void read_from_buffer(RingbufHandle_t buffer, RingbufferType_t buf_type,
             char *item_data, *item_data2;
 
             //Select appropriate receive function for type of ring buffer
-            if (buf_type ==  RINGBUF_TYPE_NOSPLIT) {
+            if (buf_type ==  RINGBUF_TYPE_NOSPLIT || buf_type == RINGBUF_TYPE_NOSPLIT_SPSC) {
                 item_data = (char *)xRingbufferReceive(buffer, &item_size, TIMEOUT_TICKS);
             } else if (buf_type == RINGBUF_TYPE_ALLOWSPLIT) {
                 BaseType_t ret = xRingbufferReceiveSplit(buffer, (void **)&item_data, (void **)&item_data2, &item_size, &item_size2, TIMEOUT_TICKS);
@@ -871,7 +871,7 @@ static void read_from_buffer(RingbufHandle_t buffer, RingbufferType_t buf_type,
 
             //Check received item and return it
             TEST_ASSERT_MESSAGE(item_data != NULL, "Failed to receive an item");
-            if (buf_type == RINGBUF_TYPE_BYTEBUF) {
+            if (buf_type == RINGBUF_TYPE_BYTEBUF || buf_type == RINGBUF_TYPE_BYTEBUF_SPSC) {
                 TEST_ASSERT_MESSAGE(item_size <= max_rec_size, "Received data exceeds max size");
             }
             for (int i = 0; i < item_size; i++) {
@@ -945,7 +945,7 @@ static void cleanup(void)
 TEST_CASE("Test ring buffer SMP", "[esp_ringbuf]")
 {
     setup();
-    //Iterate through buffer types (No split, split, then byte buff)
+    //Iterate through buffer types (No split, split, byte buff, then their SPSC variants)
     for (RingbufferType_t buf_type = 0; buf_type < RINGBUF_TYPE_MAX; buf_type++) {
         //Create buffer
         task_args_t task_args;
@@ -977,7 +977,7 @@ TEST_CASE("Test ring buffer SMP", "[esp_ringbuf]")
 TEST_CASE("Test static ring buffer SMP", "[esp_ringbuf]")
 {
     setup();
-    //Iterate through buffer types (No split, split, then byte buff)
+    //Iterate through buffer types (No split, split, byte buff, then their SPSC variants)
     for (RingbufferType_t buf_type = 0; buf_type < RINGBUF_TYPE_MAX; buf_type++) {
         StaticRingbuffer_t *buffer_struct;
         uint8_t *buffer_storage;
@@ -5,6 +5,7 @@
  */
 
 #include <sys/param.h>
+#include <stdlib.h>
 #include <string.h>
 #include "soc/soc.h"
 #include "esp_types.h"
@@ -80,6 +81,11 @@ struct esp_timer {
     uint64_t total_callback_run_time;
 #endif // WITH_PROFILING
     LIST_ENTRY(esp_timer) list_entry;
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+    struct esp_timer* heap_parent;
+    struct esp_timer* heap_left;
+    struct esp_timer* heap_right;
+#endif // CONFIG_ESP_TIMER_QUEUE_HEAP
 };
 
 static inline bool is_initialized(void);
@@ -88,6 +94,9 @@ static esp_err_t timer_remove(esp_timer_handle_t timer);
 static bool timer_armed(esp_timer_handle_t timer);
 static void timer_list_lock(esp_timer_dispatch_t timer_type);
 static void timer_list_unlock(esp_timer_dispatch_t timer_type);
+static esp_timer_handle_t timer_queue_first(esp_timer_dispatch_t dispatch_method);
+static void timer_queue_insert(esp_timer_handle_t timer);
+static void timer_queue_remove(esp_timer_handle_t timer);
 
 #if WITH_PROFILING
 static void timer_insert_inactive(esp_timer_handle_t timer);
@@ -96,10 +105,20 @@ static void timer_remove_inactive(esp_timer_handle_t timer);
 
 __attribute__((unused)) static const char* TAG = "esp_timer";
 
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+// min-heaps of currently armed timers for two dispatch methods: ISR and TASK.
+// The heaps are binary trees linked through the timers, so arming a timer doesn't allocate memory.
+typedef struct {
+    esp_timer_handle_t root;
+    size_t count;
+} timer_heap_t;
+static timer_heap_t s_timers[ESP_TIMER_MAX];
+#else
 // lists of currently armed timers for two dispatch methods: ISR and TASK
 static LIST_HEAD(esp_timer_list, esp_timer) s_timers[ESP_TIMER_MAX] = {
     [0 ...(ESP_TIMER_MAX - 1)] = LIST_HEAD_INITIALIZER(s_timers)
 };
+#endif // CONFIG_ESP_TIMER_QUEUE_HEAP
 #if WITH_PROFILING
 // lists of unarmed timers for two dispatch methods: ISR and TASK,
 // used only to be able to dump statistics about all the timers
@@ -319,24 +338,9 @@ static IRAM_ATTR esp_err_t timer_insert(esp_timer_handle_t timer, bool without_u
 #if WITH_PROFILING
     timer_remove_inactive(timer);
 #endif
-    esp_timer_handle_t it, last = NULL;
     esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
-    if (LIST_FIRST(&s_timers[dispatch_method]) == NULL) {
-        LIST_INSERT_HEAD(&s_timers[dispatch_method], timer, list_entry);
-    } else {
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
-            if (timer->alarm < it->alarm) {
-                LIST_INSERT_BEFORE(it, timer, list_entry);
-                break;
-            }
-            last = it;
-        }
-        if (it == NULL) {
-            assert(last);
-            LIST_INSERT_AFTER(last, timer, list_entry);
-        }
-    }
-    if (without_update_alarm == false && timer == LIST_FIRST(&s_timers[dispatch_method])) {
+    timer_queue_insert(timer);
+    if (without_update_alarm == false && timer == timer_queue_first(dispatch_method)) {
         esp_timer_impl_set_alarm_id(timer->alarm, dispatch_method);
     }
     return ESP_OK;
@@ -346,13 +350,13 @@ static IRAM_ATTR esp_err_t timer_remove(esp_timer_handle_t timer)
 {
     esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
     timer_list_lock(dispatch_method);
-    esp_timer_handle_t first_timer = LIST_FIRST(&s_timers[dispatch_method]);
-    LIST_REMOVE(timer, list_entry);
+    esp_timer_handle_t first_timer = timer_queue_first(dispatch_method);
+    timer_queue_remove(timer);
     timer->alarm = 0;
     timer->period = 0;
     if (timer == first_timer) { // if this timer was the first in the list.
         uint64_t next_timestamp = UINT64_MAX;
-        first_timer = LIST_FIRST(&s_timers[dispatch_method]);
+        first_timer = timer_queue_first(dispatch_method);
         if (first_timer) { // if after removing the timer from the list, this list is not empty.
             next_timestamp = first_timer->alarm;
         }
@@ -365,6 +369,174 @@ static IRAM_ATTR esp_err_t timer_remove(esp_timer_handle_t timer)
     return ESP_OK;
 }
 
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+
+/* Swap a timer with its parent in the heap */
+static IRAM_ATTR void timer_heap_swap(esp_timer_handle_t parent, esp_timer_handle_t child)
+{
+    esp_timer_dispatch_t dispatch_method = child->flags & FL_ISR_DISPATCH_METHOD;
+    esp_timer_handle_t grandparent = parent->heap_parent;
+    esp_timer_handle_t left = child->heap_left;
+    esp_timer_handle_t right = child->heap_right;
+    esp_timer_handle_t sibling;
+
+    if (parent->heap_left == child) {
+        sibling = parent->heap_right;
+        child->heap_left = parent;
+        child->heap_right = sibling;
+    } else {
+        sibling = parent->heap_left;
+        child->heap_left = sibling;
+        child->heap_right = parent;
+    }
+    child->heap_parent = grandparent;
+    if (sibling) {
+        sibling->heap_parent = child;
+    }
+
+    parent->heap_left = left;
+    parent->heap_right = right;
+    parent->heap_parent = child;
+    if (left) {
+        left->heap_parent = parent;
+    }
+    if (right) {
+        right->heap_parent = parent;
+    }
+
+    if (grandparent == NULL) {
+        s_timers[dispatch_method].root = child;
+    } else if (grandparent->heap_left == parent) {
+        grandparent->heap_left = child;
+    } else {
+        grandparent->heap_right = child;
+    }
+}
+
+static IRAM_ATTR void timer_heap_sift_up(esp_timer_handle_t timer)
+{
+    while (timer->heap_parent != NULL && timer->alarm < timer->heap_parent->alarm) {
+        timer_heap_swap(timer->heap_parent, timer);
+    }
+}
+
+static IRAM_ATTR void timer_heap_sift_down(esp_timer_handle_t timer)
+{
+    while (true) {
+        esp_timer_handle_t smallest = timer;
+        if (timer->heap_left != NULL && timer->heap_left->alarm < smallest->alarm) {
+            smallest = timer->heap_left;
+        }
+        if (timer->heap_right != NULL && timer->heap_right->alarm < smallest->alarm) {
+            smallest = timer->heap_right;
+        }
+        if (smallest == timer) {
+            break;
+        }
+        timer_heap_swap(timer, smallest);
+    }
+}
+
+/* Return the link to the node at a position (1 for the root) of a complete binary tree.
+ * The bits of the position below its most significant bit give the path from the root: 0 for left, 1 for right.
+ */
+static IRAM_ATTR esp_timer_handle_t* timer_heap_link(timer_heap_t* heap, size_t position, esp_timer_handle_t* parent)
+{
+    esp_timer_handle_t* link = &heap->root;
+    *parent = NULL;
+    for (int bit = 30 - __builtin_clz(position); bit >= 0; --bit) {
+        *parent = *link;
+        link = ((position >> bit) & 1) ? &(*parent)->heap_right : &(*parent)->heap_left;
+    }
+    return link;
+}
+
+static IRAM_ATTR esp_timer_handle_t timer_queue_first(esp_timer_dispatch_t dispatch_method)
+{
+    return s_timers[dispatch_method].root;
+}
+
+static IRAM_ATTR void timer_queue_insert(esp_timer_handle_t timer)
+{
+    timer_heap_t* heap = &s_timers[timer->flags & FL_ISR_DISPATCH_METHOD];
+    esp_timer_handle_t parent;
+    esp_timer_handle_t* link = timer_heap_link(heap, heap->count + 1, &parent);
+    *link = timer;
+    timer->heap_parent = parent;
+    timer->heap_left = NULL;
+    timer->heap_right = NULL;
+    heap->count++;
+    timer_heap_sift_up(timer);
+}
+
+static IRAM_ATTR void timer_queue_remove(esp_timer_handle_t timer)
+{
+    timer_heap_t* heap = &s_timers[timer->flags & FL_ISR_DISPATCH_METHOD];
+    esp_timer_handle_t parent;
+    esp_timer_handle_t* link = timer_heap_link(heap, heap->count, &parent);
+    esp_timer_handle_t last = *link;
+    *link = NULL;
+    heap->count--;
+    if (last == timer) {
+        return;
+    }
+
+    /* Move the last timer to the place of the removed one, then restore the heap order */
+    last->heap_parent = timer->heap_parent;
+    last->heap_left = timer->heap_left;
+    last->heap_right = timer->heap_right;
+    if (last->heap_left) {
+        last->heap_left->heap_parent = last;
+    }
+    if (last->heap_right) {
+        last->heap_right->heap_parent = last;
+    }
+    if (timer->heap_parent == NULL) {
+        heap->root = last;
+    } else if (timer->heap_parent->heap_left == timer) {
+        timer->heap_parent->heap_left = last;
+    } else {
+        timer->heap_parent->heap_right = last;
+    }
+    timer_heap_sift_down(last);
+    timer_heap_sift_up(last);
+}
+
+#else // CONFIG_ESP_TIMER_QUEUE_HEAP
+
+static IRAM_ATTR esp_timer_handle_t timer_queue_first(esp_timer_dispatch_t dispatch_method)
+{
+    return LIST_FIRST(&s_timers[dispatch_method]);
+}
+
+static IRAM_ATTR void timer_queue_insert(esp_timer_handle_t timer)
+{
+    esp_timer_handle_t it, last = NULL;
+    esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
+    if (LIST_FIRST(&s_timers[dispatch_method]) == NULL) {
+        LIST_INSERT_HEAD(&s_timers[dispatch_method], timer, list_entry);
+    } else {
+        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
+            if (timer->alarm < it->alarm) {
+                LIST_INSERT_BEFORE(it, timer, list_entry);
+                break;
+            }
+            last = it;
+        }
+        if (it == NULL) {
+            assert(last);
+            LIST_INSERT_AFTER(last, timer, list_entry);
+        }
+    }
+}
+
+static IRAM_ATTR void timer_queue_remove(esp_timer_handle_t timer)
+{
+    LIST_REMOVE(timer, list_entry);
+}
+
+#endif // CONFIG_ESP_TIMER_QUEUE_HEAP
+
 #if WITH_PROFILING
 
 static IRAM_ATTR void timer_insert_inactive(esp_timer_handle_t timer)
@@ -416,13 +588,13 @@ static bool timer_process_alarm(esp_timer_dispatch_t dispatch_method)
     bool processed = false;
     esp_timer_handle_t it;
     while (1) {
-        it = LIST_FIRST(&s_timers[dispatch_method]);
+        it = timer_queue_first(dispatch_method);
         int64_t now = esp_timer_impl_get_time();
         if (it == NULL || it->alarm > now) {
             break;
         }
         processed = true;
-        LIST_REMOVE(it, list_entry);
+        timer_queue_remove(it);
         if (it->event_id == EVENT_ID_DELETE_TIMER) {
             // It is handled only by ESP_TIMER_TASK (see esp_timer_delete()).
             // All the ESP_TIMER_ISR timers which should be deleted are moved by esp_timer_delete() to the ESP_TIMER_TASK list.
@@ -596,7 +768,7 @@ esp_err_t esp_timer_deinit(void)
 
     /* Check if there are any active timers */
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
-        if (!LIST_EMPTY(&s_timers[dispatch_method])) {
+        if (timer_queue_first(dispatch_method) != NULL) {
             return ESP_ERR_INVALID_STATE;
         }
     }
@@ -640,6 +812,44 @@ static void print_timer_info(esp_timer_handle_t t, char** dst, size_t* dst_size)
     *dst_size -= cb;
 }
 
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+/* Copy the timers of a subtree to an array, stopping when it is full */
+static size_t timer_heap_collect(esp_timer_handle_t timer, esp_timer_handle_t* timers, size_t count, size_t max_count)
+{
+    if (timer == NULL || count == max_count) {
+        return count;
+    }
+    timers[count++] = timer;
+    count = timer_heap_collect(timer->heap_left, timers, count, max_count);
+    return timer_heap_collect(timer->heap_right, timers, count, max_count);
+}
+
+static int timer_alarm_cmp(const void* a, const void* b)
+{
+    uint64_t alarm_a = (*(const esp_timer_handle_t*)a)->alarm;
+    uint64_t alarm_b = (*(const esp_timer_handle_t*)b)->alarm;
+    return (alarm_a > alarm_b) - (alarm_a < alarm_b);
+}
+#endif // CONFIG_ESP_TIMER_QUEUE_HEAP
+
+/* Print the armed timers, earliest alarm first. Called with the timer list locked. */
+static void print_armed_timers(esp_timer_dispatch_t dispatch_method, esp_timer_handle_t* sort_buf, size_t sort_buf_len,
+                               char** dst, size_t* dst_size)
+{
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+    size_t count = timer_heap_collect(s_timers[dispatch_method].root, sort_buf, 0, sort_buf_len);
+    qsort(sort_buf, count, sizeof(esp_timer_handle_t), timer_alarm_cmp);
+    for (size_t i = 0; i < count; ++i) {
+        print_timer_info(sort_buf[i], dst, dst_size);
+    }
+#else
+    esp_timer_handle_t it;
+    LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
+        print_timer_info(it, dst, dst_size);
+    }
+#endif
+}
+
 esp_err_t esp_timer_dump(FILE* stream)
 {
     /* Since timer lock is a critical section, we don't want to print directly
@@ -648,15 +858,19 @@ esp_err_t esp_timer_dump(FILE* stream)
      * print to it, then dump this memory to stdout.
      */
 
-    esp_timer_handle_t it;
+    esp_timer_handle_t it __attribute__((unused));
 
     /* First count the number of timers */
     size_t timer_count = 0;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+        timer_count += s_timers[dispatch_method].count;
+#else
         LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
             ++timer_count;
         }
+#endif
 #if WITH_PROFILING
         LIST_FOREACH(it, &s_inactive_timers[dispatch_method], list_entry) {
             ++timer_count;
@@ -675,14 +889,23 @@ esp_err_t esp_timer_dump(FILE* stream)
     if (print_buf == NULL) {
         return ESP_ERR_NO_MEM;
     }
+    size_t sort_buf_len = 0;
+    esp_timer_handle_t* sort_buf = NULL;
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+    /* The heaps aren't sorted, their timers are copied here to be sorted by alarm */
+    sort_buf_len = timer_count + 3;
+    sort_buf = calloc(sort_buf_len, sizeof(esp_timer_handle_t));
+    if (sort_buf == NULL) {
+        free(print_buf);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
 
     /* Print to the buffer */
     char* pos = print_buf;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
-            print_timer_info(it, &pos, &buf_size);
-        }
+        print_armed_timers(dispatch_method, sort_buf, sort_buf_len, &pos, &buf_size);
 #if WITH_PROFILING
         LIST_FOREACH(it, &s_inactive_timers[dispatch_method], list_entry) {
             print_timer_info(it, &pos, &buf_size);
@@ -705,6 +928,7 @@ esp_err_t esp_timer_dump(FILE* stream)
     }
 
     free(print_buf);
+    free(sort_buf);
     return ESP_OK;
 }
 
@@ -713,7 +937,7 @@ int64_t IRAM_ATTR esp_timer_get_next_alarm(void)
     int64_t next_alarm = INT64_MAX;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        esp_timer_handle_t it = LIST_FIRST(&s_timers[dispatch_method]);
+        esp_timer_handle_t it = timer_queue_first(dispatch_method);
         if (it) {
             if (next_alarm > it->alarm) {
                 next_alarm = it->alarm;
@@ -724,11 +948,32 @@ int64_t IRAM_ATTR esp_timer_get_next_alarm(void)
     return next_alarm;
 }
 
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+/* Return the earliest alarm of the timers of a subtree which may wake up the CPU, if it is earlier than next_alarm.
+ * The timers in a subtree never expire before its root, so the subtrees whose root expires after next_alarm are skipped.
+ */
+static IRAM_ATTR int64_t timer_heap_next_wake_up(esp_timer_handle_t timer, int64_t next_alarm)
+{
+    if (timer == NULL || (int64_t)timer->alarm >= next_alarm) {
+        return next_alarm;
+    }
+    // timers with the SKIP_UNHANDLED_EVENTS flag do not want to wake up CPU from a sleep mode.
+    if ((timer->flags & FL_SKIP_UNHANDLED_EVENTS) == 0) {
+        return timer->alarm;
+    }
+    next_alarm = timer_heap_next_wake_up(timer->heap_left, next_alarm);
+    return timer_heap_next_wake_up(timer->heap_right, next_alarm);
+}
+#endif // CONFIG_ESP_TIMER_QUEUE_HEAP
+
 int64_t IRAM_ATTR esp_timer_get_next_alarm_for_wake_up(void)
 {
     int64_t next_alarm = INT64_MAX;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
+#if CONFIG_ESP_TIMER_QUEUE_HEAP
+        next_alarm = timer_heap_next_wake_up(s_timers[dispatch_method].root, next_alarm);
+#else
         esp_timer_handle_t it = NULL;
         LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
             // timers with the SKIP_UNHANDLED_EVENTS flag do not want to wake up CPU from a sleep mode.
@@ -739,6 +984,7 @@ int64_t IRAM_ATTR esp_timer_get_next_alarm_for_wake_up(void)
                 break;
             }
         }
+#endif // CONFIG_ESP_TIMER_QUEUE_HEAP
         timer_list_unlock(dispatch_method);
     }
     return next_alarm;
@@ -487,6 +487,57 @@ TEST_CASE("esp_timer_get_time returns monotonic values", "[esp_timer]")
     }
 }
 
+TEST_CASE("esp_timer start/stop performance with 1000 armed timers", "[esp_timer]")
+{
+    const int timer_count = 1000;
+    esp_timer_handle_t* timers = calloc(timer_count, sizeof(esp_timer_handle_t));
+    TEST_ASSERT_NOT_NULL(timers);
+    esp_timer_create_args_t args = {
+        .callback = &dummy_cb,
+        .name = "bench"
+    };
+    for (int i = 0; i < timer_count; ++i) {
+        TEST_ESP_OK(esp_timer_create(&args, &timers[i]));
+    }
+
+    /* Timeouts are spread over 1..2 seconds in a shuffled order, so that the timers are not armed in expiry order */
+    int64_t t_start = esp_timer_get_time();
+    for (int i = 0; i < timer_count; ++i) {
+        TEST_ESP_OK(esp_timer_start_once(timers[i], SEC + (i * 7919) % timer_count * 1000));
+    }
+    int64_t t_armed = esp_timer_get_time();
+
+    uint64_t min_expiry = UINT64_MAX;
+    for (int i = 0; i < timer_count; ++i) {
+        uint64_t expiry;
+        TEST_ESP_OK(esp_timer_get_expiry_time(timers[i], &expiry));
+        min_expiry = MIN(min_expiry, expiry);
+    }
+    TEST_ASSERT_EQUAL_INT64((int64_t)min_expiry, esp_timer_get_next_alarm());
+
+    /* Restart each timer with a new timeout while all the others stay armed */
+    int64_t t_restart_start = esp_timer_get_time();
+    for (int i = 0; i < timer_count; ++i) {
+        TEST_ESP_OK(esp_timer_restart(timers[i], SEC + (i * 104729) % timer_count * 1000));
+    }
+    int64_t t_restarted = esp_timer_get_time();
+
+    for (int i = 0; i < timer_count; ++i) {
+        TEST_ESP_OK(esp_timer_stop(timers[i]));
+    }
+    int64_t t_stopped = esp_timer_get_time();
+
+    printf("%d timers: start %d ns, restart %d ns, stop %d ns per timer\n", timer_count,
+           (int)((t_armed - t_start) * 1000 / timer_count),
+           (int)((t_restarted - t_restart_start) * 1000 / timer_count),
+           (int)((t_stopped - t_restarted) * 1000 / timer_count));
+
+    for (int i = 0; i < timer_count; ++i) {
+        TEST_ESP_OK(esp_timer_delete(timers[i]));
+    }
+    free(timers);
+}
+
 TEST_CASE("Can dump esp_timer stats", "[esp_timer]")
 {
     esp_timer_dump(stdout);
@@ -5,6 +5,8 @@
  */
 
 #include <string.h>
+#include <stdbool.h>
+#include <sys/lock.h>
 #include "diskio_impl.h"
 #include "ffconf.h"
 #include "ff.h"
@@ -19,6 +21,202 @@ wl_handle_t ff_wl_handles[FF_VOLUMES] = {
         [0 ... FF_VOLUMES - 1] = WL_INVALID_HANDLE
 };
 
+#if CONFIG_FATFS_WL_CACHE_SECTORS > 0
+/*
+ * Write-back sector cache
+ *
+ * Single sector writes (FAT, directory and partial file data sectors, which FATFS rewrites over and over)
+ * are kept in RAM until the cache needs the slot, or until FATFS syncs the volume. When a dirty sector is
+ * written back, the dirty sectors adjacent to it are written back as well, so that the whole run is erased
+ * by one wl_erase_range call. Writes of several sectors (file data) go to the flash directly.
+ * Reads are served from the cache if the sector is cached, but they don't allocate cache slots.
+ */
+typedef struct {
+    DWORD sector;
+    uint32_t last_used;     // value of use_counter when the sector was last accessed
+    bool valid;
+    bool dirty;
+    BYTE *data;
+} wl_cache_entry_t;
+
+typedef struct {
+    _lock_t lock;           // FATFS may read a volume while it writes it (CONFIG_FATFS_CONCURRENT_READ)
+    size_t sector_size;
+    uint32_t use_counter;
+    wl_cache_entry_t entries[CONFIG_FATFS_WL_CACHE_SECTORS];
+} wl_cache_t;
+
+static wl_cache_t *s_wl_caches[FF_VOLUMES];
+
+static wl_cache_t *wl_cache_create(size_t sector_size)
+{
+    wl_cache_t *cache = ff_memalloc(sizeof(wl_cache_t) + CONFIG_FATFS_WL_CACHE_SECTORS * sector_size);
+    if (cache == NULL) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(wl_cache_t));
+    _lock_init(&cache->lock);
+    cache->sector_size = sector_size;
+    BYTE *data = (BYTE *)(cache + 1);
+    for (int i = 0; i < CONFIG_FATFS_WL_CACHE_SECTORS; i++) {
+        cache->entries[i].data = data + i * sector_size;
+    }
+    return cache;
+}
+
+static wl_cache_entry_t *wl_cache_find(wl_cache_t *cache, DWORD sector)
+{
+    for (int i = 0; i < CONFIG_FATFS_WL_CACHE_SECTORS; i++) {
+        wl_cache_entry_t *entry = &cache->entries[i];
+        if (entry->valid && entry->sector == sector) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static bool wl_cache_is_dirty(wl_cache_t *cache, DWORD sector)
+{
+    wl_cache_entry_t *entry = wl_cache_find(cache, sector);
+    return entry != NULL && entry->dirty;
+}
+
+/* Write back the run of consecutive dirty sectors which contains the sector of the entry */
+static esp_err_t wl_cache_write_back(wl_handle_t wl_handle, wl_cache_t *cache, wl_cache_entry_t *entry)
+{
+    DWORD first = entry->sector;
+    DWORD last = entry->sector;
+    while (first > 0 && wl_cache_is_dirty(cache, first - 1)) {
+        first--;
+    }
+    while (wl_cache_is_dirty(cache, last + 1)) {
+        last++;
+    }
+
+    size_t sector_size = cache->sector_size;
+    esp_err_t err = wl_erase_range(wl_handle, first * sector_size, (last - first + 1) * sector_size);
+    if (unlikely(err != ESP_OK)) {
+        ESP_LOGE(TAG, "wl_erase_range failed (0x%x)", err);
+        return err;
+    }
+    for (DWORD sector = first; sector <= last; sector++) {
+        wl_cache_entry_t *it = wl_cache_find(cache, sector);
+        err = wl_write(wl_handle, sector * sector_size, it->data, sector_size);
+        if (unlikely(err != ESP_OK)) {
+            ESP_LOGE(TAG, "wl_write failed (0x%x)", err);
+            return err;
+        }
+        it->dirty = false;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t wl_cache_flush(wl_handle_t wl_handle, wl_cache_t *cache)
+{
+    for (int i = 0; i < CONFIG_FATFS_WL_CACHE_SECTORS; i++) {
+        wl_cache_entry_t *entry = &cache->entries[i];
+        if (entry->valid && entry->dirty) {
+            esp_err_t err = wl_cache_write_back(wl_handle, cache, entry);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+/* Return a free entry, or the least recently used one after writing it back */
+static wl_cache_entry_t *wl_cache_evict(wl_handle_t wl_handle, wl_cache_t *cache)
+{
+    wl_cache_entry_t *victim = &cache->entries[0];
+    for (int i = 0; i < CONFIG_FATFS_WL_CACHE_SECTORS; i++) {
+        wl_cache_entry_t *entry = &cache->entries[i];
+        if (!entry->valid) {
+            return entry;
+        }
+        // unsigned difference, so that the order stays right when use_counter wraps around
+        if (cache->use_counter - entry->last_used > cache->use_counter - victim->last_used) {
+            victim = entry;
+        }
+    }
+    if (victim->dirty && wl_cache_write_back(wl_handle, cache, victim) != ESP_OK) {
+        return NULL;
+    }
+    victim->valid = false;
+    return victim;
+}
+
+static void wl_cache_invalidate(wl_cache_t *cache, DWORD sector, UINT count)
+{
+    for (int i = 0; i < CONFIG_FATFS_WL_CACHE_SECTORS; i++) {
+        wl_cache_entry_t *entry = &cache->entries[i];
+        if (entry->valid && entry->sector >= sector && entry->sector - sector < count) {
+            entry->valid = false;
+            entry->dirty = false;
+        }
+    }
+}
+
+static DRESULT wl_cache_read(wl_handle_t wl_handle, wl_cache_t *cache, BYTE *buff, DWORD sector, UINT count)
+{
+    size_t sector_size = cache->sector_size;
+    // the sectors which are not cached are read from the flash in runs
+    DWORD run_start = sector;
+    for (DWORD it = sector; it <= sector + count; it++) {
+        wl_cache_entry_t *entry = (it < sector + count) ? wl_cache_find(cache, it) : NULL;
+        if (entry == NULL && it < sector + count) {
+            continue;
+        }
+        if (it > run_start) {
+            esp_err_t err = wl_read(wl_handle, run_start * sector_size, buff + (run_start - sector) * sector_size,
+                                    (it - run_start) * sector_size);
+            if (unlikely(err != ESP_OK)) {
+                ESP_LOGE(TAG, "wl_read failed (0x%x)", err);
+                return RES_ERROR;
+            }
+        }
+        if (entry != NULL) {
+            memcpy(buff + (it - sector) * sector_size, entry->data, sector_size);
+            entry->last_used = ++cache->use_counter;
+        }
+        run_start = it + 1;
+    }
+    return RES_OK;
+}
+
+static DRESULT wl_cache_write(wl_handle_t wl_handle, wl_cache_t *cache, const BYTE *buff, DWORD sector)
+{
+    wl_cache_entry_t *entry = wl_cache_find(cache, sector);
+    if (entry == NULL) {
+        entry = wl_cache_evict(wl_handle, cache);
+        if (entry == NULL) {
+            return RES_ERROR;
+        }
+        entry->sector = sector;
+        entry->valid = true;
+    }
+    memcpy(entry->data, buff, cache->sector_size);
+    entry->dirty = true;
+    entry->last_used = ++cache->use_counter;
+    return RES_OK;
+}
+
+/* Write back the dirty sectors and free the cache of a drive */
+static void wl_cache_delete(BYTE pdrv)
+{
+    wl_cache_t *cache = s_wl_caches[pdrv];
+    if (cache == NULL) {
+        return;
+    }
+    if (ff_wl_handles[pdrv] != WL_INVALID_HANDLE && wl_cache_flush(ff_wl_handles[pdrv], cache) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to write back the sector cache of pdrv=%i", (unsigned int)pdrv);
+    }
+    _lock_close(&cache->lock);
+    ff_memfree(cache);
+    s_wl_caches[pdrv] = NULL;
+}
+#endif // CONFIG_FATFS_WL_CACHE_SECTORS > 0
+
 DSTATUS ff_wl_initialize (BYTE pdrv)
 {
     return 0;
@@ -34,6 +232,15 @@ DRESULT ff_wl_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
     ESP_LOGV(TAG, "ff_wl_read - pdrv=%i, sector=%i, count=%i", (unsigned int)pdrv, (unsigned int)sector, (unsigned int)count);
     wl_handle_t wl_handle = ff_wl_handles[pdrv];
     assert(wl_handle + 1);
+#if CONFIG_FATFS_WL_CACHE_SECTORS > 0
+    wl_cache_t *cache = s_wl_caches[pdrv];
+    if (cache != NULL) {
+        _lock_acquire(&cache->lock);
+        DRESULT res = wl_cache_read(wl_handle, cache, buff, sector, count);
+        _lock_release(&cache->lock);
+        return res;
+    }
+#endif
     esp_err_t err = wl_read(wl_handle, sector * wl_sector_size(wl_handle), buff, count * wl_sector_size(wl_handle));
     if (unlikely(err != ESP_OK)) {
         ESP_LOGE(TAG, "wl_read failed (0x%x)", err);
@@ -47,6 +254,20 @@ DRESULT ff_wl_write (BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
     ESP_LOGV(TAG, "ff_wl_write - pdrv=%i, sector=%i, count=%i", (unsigned int)pdrv, (unsigned int)sector, (unsigned int)count);
     wl_handle_t wl_handle = ff_wl_handles[pdrv];
     assert(wl_handle + 1);
+#if CONFIG_FATFS_WL_CACHE_SECTORS > 0
+    wl_cache_t *cache = s_wl_caches[pdrv];
+    if (cache != NULL) {
+        _lock_acquire(&cache->lock);
+        if (count == 1) {
+            DRESULT res = wl_cache_write(wl_handle, cache, buff, sector);
+            _lock_release(&cache->lock);
+            return res;
+        }
+        // the cached copies of these sectors are overwritten
+        wl_cache_invalidate(cache, sector, count);
+        _lock_release(&cache->lock);
+    }
+#endif
     esp_err_t err = wl_erase_range(wl_handle, sector * wl_sector_size(wl_handle), count * wl_sector_size(wl_handle));
     if (unlikely(err != ESP_OK)) {
         ESP_LOGE(TAG, "wl_erase_range failed (0x%x)", err);
@@ -67,6 +288,16 @@ DRESULT ff_wl_ioctl (BYTE pdrv, BYTE cmd, void *buff)
     assert(wl_handle + 1);
     switch (cmd) {
     case CTRL_SYNC:
+#if CONFIG_FATFS_WL_CACHE_SECTORS > 0
+        if (s_wl_caches[pdrv] != NULL) {
+            _lock_acquire(&s_wl_caches[pdrv]->lock);
+            esp_err_t err = wl_cache_flush(wl_handle, s_wl_caches[pdrv]);
+            _lock_release(&s_wl_caches[pdrv]->lock);
+            if (err != ESP_OK) {
+                return RES_ERROR;
+            }
+        }
+#endif
         return RES_OK;
     case GET_SECTOR_COUNT:
         *((DWORD *) buff) = wl_size(wl_handle) / wl_sector_size(wl_handle);
@@ -93,6 +324,13 @@ esp_err_t ff_diskio_register_wl_partition(BYTE pdrv, wl_handle_t flash_handle)
         .write = &ff_wl_write,
         .ioctl = &ff_wl_ioctl
     };
+#if CONFIG_FATFS_WL_CACHE_SECTORS > 0
+    wl_cache_delete(pdrv);
+    s_wl_caches[pdrv] = wl_cache_create(wl_sector_size(flash_handle));
+    if (s_wl_caches[pdrv] == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
     ff_wl_handles[pdrv] = flash_handle;
     ff_diskio_register(pdrv, &wl_impl);
     return ESP_OK;
@@ -112,6 +350,9 @@ void ff_diskio_clear_pdrv_wl(wl_handle_t flash_handle)
 {
     for (int i = 0; i < FF_VOLUMES; i++) {
         if (flash_handle == ff_wl_handles[i]) {
+#if CONFIG_FATFS_WL_CACHE_SECTORS > 0
+            wl_cache_delete(i);
+#endif
             ff_wl_handles[i] = WL_INVALID_HANDLE;
         }
     }
@@ -27,6 +27,9 @@ extern "C" {
  *
  * @param pdrv  drive number
  * @param flash_handle  handle of the wear levelling partition.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if pdrv is out of range,
+ *         ESP_ERR_NO_MEM if the sector cache (CONFIG_FATFS_WL_CACHE_SECTORS) can't be allocated.
  */
 esp_err_t ff_diskio_register_wl_partition(unsigned char pdrv, wl_handle_t flash_handle);
 unsigned char ff_diskio_get_pdrv_wl(wl_handle_t flash_handle);
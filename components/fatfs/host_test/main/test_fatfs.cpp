@@ -3,11 +3,16 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  */
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <thread>
+#include <vector>
 
 #include "ff.h"
 #include "esp_partition.h"
+#include "esp_private/partition_linux.h"
 #include "wear_levelling.h"
 #include "diskio_impl.h"
 #include "diskio_wl.h"
@@ -282,3 +287,296 @@ TEST_CASE("Test mounting 2 volumes, writing data and formatting the 2nd one, rea
     esp_result = wl_unmount(wl_handle1);
     REQUIRE(esp_result == ESP_OK);
 }
+
+static size_t partition_erase_count(const esp_partition_t *partition)
+{
+    size_t count = 0;
+    for (size_t offset = 0; offset < partition->size; offset += ESP_PARTITION_EMULATED_SECTOR_SIZE) {
+        count += esp_partition_get_sector_erase_count((partition->address + offset) / ESP_PARTITION_EMULATED_SECTOR_SIZE);
+    }
+    return count;
+}
+
+TEST_CASE("Write many small files, report writes/s and erase count", "[fatfs]")
+{
+    FRESULT fr_result;
+    esp_err_t esp_result;
+
+    const esp_partition_t *partition = NULL;
+    BYTE pdrv = UINT8_MAX;
+    FATFS fs;
+    wl_handle_t wl_handle = WL_INVALID_HANDLE;
+
+    prepare_fatfs("storage", &partition, &wl_handle, &pdrv);
+    char drv[3] = {(char)('0' + pdrv), ':', 0};
+    fr_result = f_mount(&fs, drv, 1);
+    REQUIRE(fr_result == FR_OK);
+
+    const int file_count = 100;
+    const int writes_per_file = 4;
+    char path[16];
+    char data[64];
+
+    size_t erase_count_before = partition_erase_count(partition);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < file_count; i++) {
+        FIL file;
+        UINT bw;
+        snprintf(path, sizeof(path), "%s/f%d.txt", drv, i);
+        fr_result = f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE);
+        REQUIRE(fr_result == FR_OK);
+        for (int j = 0; j < writes_per_file; j++) {
+            memset(data, 'a' + (i + j) % 26, sizeof(data));
+            fr_result = f_write(&file, data, sizeof(data), &bw);
+            REQUIRE(fr_result == FR_OK);
+            REQUIRE(bw == sizeof(data));
+        }
+        fr_result = f_close(&file);
+        REQUIRE(fr_result == FR_OK);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    size_t erase_count = partition_erase_count(partition) - erase_count_before;
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d files, %d writes: %.0f writes/s, %zu sector erases (CONFIG_FATFS_WL_CACHE_SECTORS=%d)\n",
+           file_count, file_count * writes_per_file, file_count * writes_per_file / seconds, erase_count,
+           CONFIG_FATFS_WL_CACHE_SECTORS);
+
+    // Remount and check that the files were written to flash
+    fr_result = f_mount(0, drv, 0);
+    REQUIRE(fr_result == FR_OK);
+    ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(wl_handle);
+    esp_result = wl_unmount(wl_handle);
+    REQUIRE(esp_result == ESP_OK);
+
+    esp_result = wl_mount(partition, &wl_handle);
+    REQUIRE(esp_result == ESP_OK);
+    esp_result = ff_diskio_register_wl_partition(pdrv, wl_handle);
+    REQUIRE(esp_result == ESP_OK);
+    fr_result = f_mount(&fs, drv, 1);
+    REQUIRE(fr_result == FR_OK);
+
+    for (int i = 0; i < file_count; i++) {
+        FIL file;
+        UINT br;
+        char read[sizeof(data)];
+        snprintf(path, sizeof(path), "%s/f%d.txt", drv, i);
+        fr_result = f_open(&file, path, FA_READ);
+        REQUIRE(fr_result == FR_OK);
+        REQUIRE(f_size(&file) == writes_per_file * sizeof(data));
+        for (int j = 0; j < writes_per_file; j++) {
+            memset(data, 'a' + (i + j) % 26, sizeof(data));
+            fr_result = f_read(&file, read, sizeof(read), &br);
+            REQUIRE(fr_result == FR_OK);
+            REQUIRE(br == sizeof(read));
+            REQUIRE(memcmp(data, read, sizeof(data)) == 0);
+        }
+        fr_result = f_close(&file);
+        REQUIRE(fr_result == FR_OK);
+    }
+
+    fr_result = f_mount(0, drv, 0);
+    REQUIRE(fr_result == FR_OK);
+    ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(wl_handle);
+    esp_result = wl_unmount(wl_handle);
+    REQUIRE(esp_result == ESP_OK);
+}
+
+static void read_file_task(const char *path, size_t file_size, int rounds, bool *ok)
+{
+    const size_t chunk_size = 32 * 1024;
+    uint8_t *buf = (uint8_t *) malloc(chunk_size);
+    *ok = buf != NULL;
+    for (int round = 0; round < rounds && *ok; round++) {
+        FIL file;
+        if (f_open(&file, path, FA_READ) != FR_OK) {
+            *ok = false;
+            break;
+        }
+        for (size_t offset = 0; offset < file_size; offset += chunk_size) {
+            UINT br;
+            if (f_read(&file, buf, chunk_size, &br) != FR_OK || br != chunk_size) {
+                *ok = false;
+                break;
+            }
+            for (size_t i = 0; i < chunk_size; i += sizeof(uint32_t)) {
+                if (*(uint32_t *)(buf + i) != (uint32_t)(offset + i) + path[4]) {
+                    *ok = false;
+                    break;
+                }
+            }
+        }
+        f_close(&file);
+    }
+    free(buf);
+}
+
+TEST_CASE("Read files of a volume from several threads at the same time", "[fatfs]")
+{
+    FRESULT fr_result;
+    esp_err_t esp_result;
+
+    const esp_partition_t *partition = NULL;
+    BYTE pdrv = UINT8_MAX;
+    FATFS fs;
+    wl_handle_t wl_handle = WL_INVALID_HANDLE;
+
+    prepare_fatfs("storage", &partition, &wl_handle, &pdrv);
+    char drv[3] = {(char)('0' + pdrv), ':', 0};
+    fr_result = f_mount(&fs, drv, 1);
+    REQUIRE(fr_result == FR_OK);
+
+    const int max_threads = 4;
+    const size_t file_size = 128 * 1024;
+    const int rounds = 20;
+    char paths[max_threads][16];
+    uint8_t *data = (uint8_t *) malloc(file_size);
+    REQUIRE(data != NULL);
+    for (int t = 0; t < max_threads; t++) {
+        FIL file;
+        UINT bw;
+        snprintf(paths[t], sizeof(paths[t]), "%s/r%d", drv, t);
+        for (size_t i = 0; i < file_size; i += sizeof(uint32_t)) {
+            *(uint32_t *)(data + i) = (uint32_t) i + paths[t][4];
+        }
+        fr_result = f_open(&file, paths[t], FA_CREATE_ALWAYS | FA_WRITE);
+        REQUIRE(fr_result == FR_OK);
+        fr_result = f_write(&file, data, file_size, &bw);
+        REQUIRE(fr_result == FR_OK);
+        REQUIRE(bw == file_size);
+        fr_result = f_close(&file);
+        REQUIRE(fr_result == FR_OK);
+    }
+    free(data);
+
+    for (int thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        std::vector<std::thread> threads;
+        bool ok[max_threads] = {};
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int t = 0; t < thread_count; t++) {
+            threads.emplace_back(read_file_task, paths[t], file_size, rounds, &ok[t]);
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%d reader threads: %.1f MB/s (CONFIG_FATFS_CONCURRENT_READ=%d)\n", thread_count,
+               thread_count * rounds * file_size / seconds / (1024 * 1024), FF_FS_CONCURRENT_READ);
+        for (int t = 0; t < thread_count; t++) {
+            REQUIRE(ok[t]);
+        }
+    }
+
+    fr_result = f_mount(0, drv, 0);
+    REQUIRE(fr_result == FR_OK);
+    ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(wl_handle);
+    esp_result = wl_unmount(wl_handle);
+    REQUIRE(esp_result == ESP_OK);
+}
+
+TEST_CASE("Random reads of a fragmented file with and without the fast seek table", "[fatfs]")
+{
+    FRESULT fr_result;
+    esp_err_t esp_result;
+
+    const esp_partition_t *partition = NULL;
+    BYTE pdrv = UINT8_MAX;
+    FATFS fs;
+    wl_handle_t wl_handle = WL_INVALID_HANDLE;
+
+    prepare_fatfs("storage", &partition, &wl_handle, &pdrv);
+    char drv[3] = {(char)('0' + pdrv), ':', 0};
+    fr_result = f_mount(&fs, drv, 1);
+    REQUIRE(fr_result == FR_OK);
+
+    // write two files in turns, so that each of them is made of many fragments
+    const size_t chunk_size = 32 * 1024;
+    const size_t chunk_count = 12;
+    const size_t file_size = chunk_size * chunk_count;
+    FIL files[2];
+    const char *paths[2] = {"random", "other"};
+    char path[2][16];
+    uint8_t *data = (uint8_t *) malloc(chunk_size);
+    REQUIRE(data != NULL);
+    for (int f = 0; f < 2; f++) {
+        snprintf(path[f], sizeof(path[f]), "%s/%s", drv, paths[f]);
+        fr_result = f_open(&files[f], path[f], FA_CREATE_ALWAYS | FA_WRITE);
+        REQUIRE(fr_result == FR_OK);
+    }
+    for (size_t c = 0; c < chunk_count; c++) {
+        for (size_t i = 0; i < chunk_size; i += sizeof(uint32_t)) {
+            *(uint32_t *)(data + i) = (uint32_t)(c * chunk_size + i);
+        }
+        for (int f = 0; f < 2; f++) {
+            UINT bw;
+            fr_result = f_write(&files[f], data, chunk_size, &bw);
+            REQUIRE(fr_result == FR_OK);
+            REQUIRE(bw == chunk_size);
+        }
+    }
+    for (int f = 0; f < 2; f++) {
+        fr_result = f_close(&files[f]);
+        REQUIRE(fr_result == FR_OK);
+    }
+    free(data);
+
+    FIL file;
+    fr_result = f_open(&file, path[0], FA_READ);
+    REQUIRE(fr_result == FR_OK);
+
+    // build the link map table the same way as vfs_fat does: first find out its size, then fill it
+    DWORD probe[4] = {4};
+    file.cltbl = probe;
+    fr_result = f_lseek(&file, CREATE_LINKMAP);
+    REQUIRE(fr_result == FR_NOT_ENOUGH_CORE);
+    DWORD *clmt = (DWORD *) malloc(probe[0] * sizeof(DWORD));
+    REQUIRE(clmt != NULL);
+    clmt[0] = probe[0];
+    file.cltbl = clmt;
+    fr_result = f_lseek(&file, CREATE_LINKMAP);
+    REQUIRE(fr_result == FR_OK);
+    file.cltbl = NULL;
+
+    const int read_count = 5000;
+    size_t read_ops[2];
+    for (int fast_seek = 0; fast_seek < 2; fast_seek++) {
+        file.cltbl = fast_seek ? clmt : NULL;
+        srand(1);
+        size_t read_ops_start = esp_partition_get_read_ops();
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < read_count; i++) {
+            uint32_t offset = (rand() % (file_size / sizeof(uint32_t))) * sizeof(uint32_t);
+            uint32_t value;
+            UINT br;
+            fr_result = f_lseek(&file, offset);
+            REQUIRE(fr_result == FR_OK);
+            fr_result = f_read(&file, &value, sizeof(value), &br);
+            REQUIRE(fr_result == FR_OK);
+            REQUIRE(br == sizeof(value));
+            REQUIRE(value == offset);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        read_ops[fast_seek] = esp_partition_get_read_ops() - read_ops_start;
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%s fast seek table (%" PRIu32 " words): %.0f random reads/s, %zu partition reads\n",
+               fast_seek ? "With" : "Without", (uint32_t) clmt[0], read_count / seconds, read_ops[fast_seek]);
+    }
+    file.cltbl = NULL;
+    free(clmt);
+    REQUIRE(read_ops[1] <= read_ops[0]);
+
+    fr_result = f_close(&file);
+    REQUIRE(fr_result == FR_OK);
+    fr_result = f_mount(0, drv, 0);
+    REQUIRE(fr_result == FR_OK);
+    ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(wl_handle);
+    esp_result = wl_unmount(wl_handle);
+    REQUIRE(esp_result == ESP_OK);
+}
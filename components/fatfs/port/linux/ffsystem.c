@@ -6,9 +6,10 @@
 
 #include "ff.h"
 #include <stdlib.h>
+#include <pthread.h>
 
 /* This is the implementation for host-side testing on Linux.
- * Host-side tests are single threaded, so lock functionality isn't needed.
+ * The volumes are locked with pthread mutexes, so that host tests can access them from several threads.
  */
 
 void* ff_memalloc(UINT msize)
@@ -21,25 +22,26 @@ void ff_memfree(void* mblock)
     free(mblock);
 }
 
-static int* Mutex[FF_VOLUMES + 1]; /* Table of mutex handle */
+static pthread_mutex_t Mutex[FF_VOLUMES + 1]; /* Table of mutex handle */
 
 /* 1:Function succeeded, 0:Could not create the mutex */
 int ff_mutex_create(int vol)
 {
-    Mutex[vol] = NULL;
-    return 1;
+    return pthread_mutex_init(&Mutex[vol], NULL) == 0;
 }
 
 void ff_mutex_delete(int vol)
 {
+    pthread_mutex_destroy(&Mutex[vol]);
 }
 
 /* 1:Function succeeded, 0:Could not acquire lock */
 int ff_mutex_take(int vol)
 {
-    return 1;
+    return pthread_mutex_lock(&Mutex[vol]) == 0;
 }
 
 void ff_mutex_give(int vol)
 {
+    pthread_mutex_unlock(&Mutex[vol]);
 }
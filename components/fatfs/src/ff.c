@@ -3964,7 +3964,17 @@ FRESULT f_read (
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+#if FF_FS_CONCURRENT_READ
+				{	/* Release the volume while the data sectors are read, so that other files can be accessed meanwhile */
+					unlock_volume(fs, FR_OK);
+					DRESULT dres = disk_read(fs->pdrv, rbuff, sect, cc);
+					res = validate(&fp->obj, &fs);	/* Take the volume again, it may have been unmounted meanwhile */
+					if (res != FR_OK) LEAVE_FF(fs, res);
+					if (dres != RES_OK) ABORT(fs, FR_DISK_ERR);
+				}
+#else
 				if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#endif
 #if !FF_FS_READONLY && FF_FS_MINIMIZE <= 2		/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if FF_FS_TINY
 				if (fs->wflag && fs->winsect - sect < cc) {
@@ -311,6 +311,17 @@
 /  The FF_FS_TIMEOUT defines timeout period in unit of O/S time tick.
 */
 
+#if defined(CONFIG_FATFS_CONCURRENT_READ) && FF_FS_REENTRANT && !FF_FS_TINY
+#define FF_FS_CONCURRENT_READ	1
+#else
+#define FF_FS_CONCURRENT_READ	0
+#endif
+/* ESP-IDF specific option. If enabled, f_read() releases the volume lock while it reads
+/  whole sectors of file data directly to the caller's buffer, so that other files on the
+/  same volume can be accessed meanwhile. The disk I/O functions of the volume must be
+/  safe to call concurrently from several tasks.
+*/
+
 #include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
@@ -250,6 +250,22 @@ void test_fatfs_lseek(const char* filename)
     TEST_ASSERT_EQUAL(18, fread(buf, 1, sizeof(buf), f));
     TEST_ASSERT_EQUAL_INT8_ARRAY(ref_buf, buf, sizeof(ref_buf) - 1);
     TEST_ASSERT_EQUAL(0, fclose(f));
+
+    // the table of a file opened with O_APPEND is built again after each write
+    f = fopen(filename, "ab+");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(0, fseek(f, 11, SEEK_SET));
+    TEST_ASSERT_EQUAL(0, fgetc(f));
+    TEST_ASSERT_EQUAL(0, fseek(f, 0, SEEK_CUR));
+    TEST_ASSERT_EQUAL(4, fprintf(f, "def\n"));
+    TEST_ASSERT_EQUAL(0, fflush(f));
+    TEST_ASSERT_EQUAL(0, fseek(f, -8, SEEK_END));
+    TEST_ASSERT_EQUAL(8, fread(buf, 1, sizeof(buf), f));
+    TEST_ASSERT_EQUAL_INT8_ARRAY("abc\ndef\n", buf, 8);
+    TEST_ASSERT_EQUAL(0, fseek(f, 0, SEEK_SET));
+    TEST_ASSERT_EQUAL(18, fread(buf, 1, 18, f));
+    TEST_ASSERT_EQUAL_INT8_ARRAY(ref_buf, buf, sizeof(ref_buf) - 1);
+    TEST_ASSERT_EQUAL(0, fclose(f));
 #endif
 
 }
@@ -24,11 +24,16 @@ typedef struct {
     char fat_drive[8];  /* FAT drive name */
     char base_path[ESP_VFS_PATH_MAX];   /* base path in VFS where partition is registered */
     size_t max_files;   /* max number of simultaneously open files; size of files[] array */
-    _lock_t lock;       /* guard for access to this structure */
+    _lock_t lock;       /* guard for access to this structure, the file table and the paths */
     FATFS fs;           /* fatfs library FS structure */
     char tmp_path_buf[FILENAME_MAX+3];  /* temporary buffer used to prepend drive name to the path */
     char tmp_path_buf2[FILENAME_MAX+3]; /* as above; used in functions which take two path arguments */
     bool *o_append;  /* O_APPEND is stored here for each max_files entries (because O_APPEND is not compatible with FA_OPEN_APPEND) */
+    _lock_t *file_locks; /* lock for each of max_files entries, held during operations on the open file */
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    size_t clmt_bytes;   /* memory used by the link map tables (FIL.cltbl) of the open files */
+    bool *clmt_outdated; /* set for each of max_files entries if the link map table is to be built on the next seek */
+#endif
     FIL files[0];   /* array with max_files entries; must be the final member of the structure */
 } vfs_fat_ctx_t;
 
@@ -184,18 +189,41 @@ esp_err_t esp_vfs_fat_register_cfg(const esp_vfs_fat_conf_t* conf, FATFS** out_f
         return ESP_ERR_NO_MEM;
     }
     memset(fat_ctx->o_append, 0, max_files * sizeof(bool));
+    fat_ctx->file_locks = ff_memalloc(max_files * sizeof(_lock_t));
+    if (fat_ctx->file_locks == NULL) {
+        free(fat_ctx->o_append);
+        free(fat_ctx);
+        return ESP_ERR_NO_MEM;
+    }
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    fat_ctx->clmt_outdated = ff_memalloc(max_files * sizeof(bool));
+    if (fat_ctx->clmt_outdated == NULL) {
+        ff_memfree(fat_ctx->file_locks);
+        free(fat_ctx->o_append);
+        free(fat_ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    memset(fat_ctx->clmt_outdated, 0, max_files * sizeof(bool));
+#endif
     fat_ctx->max_files = max_files;
     strlcpy(fat_ctx->fat_drive, conf->fat_drive, sizeof(fat_ctx->fat_drive) - 1);
     strlcpy(fat_ctx->base_path, conf->base_path, sizeof(fat_ctx->base_path) - 1);
 
     esp_err_t err = esp_vfs_register(conf->base_path, &vfs, fat_ctx);
     if (err != ESP_OK) {
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+        ff_memfree(fat_ctx->clmt_outdated);
+#endif
+        ff_memfree(fat_ctx->file_locks);
         free(fat_ctx->o_append);
         free(fat_ctx);
         return err;
     }
 
     _lock_init(&fat_ctx->lock);
+    for (size_t i = 0; i < max_files; i++) {
+        _lock_init(&fat_ctx->file_locks[i]);
+    }
     s_fat_ctxs[ctx] = fat_ctx;
 
     //compatibility
@@ -218,6 +246,13 @@ esp_err_t esp_vfs_fat_unregister_path(const char* base_path)
         return err;
     }
     _lock_close(&fat_ctx->lock);
+    for (size_t i = 0; i < fat_ctx->max_files; i++) {
+        _lock_close(&fat_ctx->file_locks[i]);
+    }
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    ff_memfree(fat_ctx->clmt_outdated);
+#endif
+    ff_memfree(fat_ctx->file_locks);
     free(fat_ctx->o_append);
     free(fat_ctx);
     s_fat_ctxs[ctx] = NULL;
@@ -344,6 +379,97 @@ static void prepend_drive_to_path(vfs_fat_ctx_t * ctx, const char ** path, const
     }
 }
 
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+/* The link map table (CLMT) of a file lets f_lseek() and f_read() find the clusters of the file without following
+ * the cluster chain in the FAT. FATFS can't expand a file which has a table, so tables are only kept for files opened
+ * read-only or with O_APPEND, whose writes only add to the end of the file. The table is built on the first seek,
+ * dropped before each operation which may change the clusters of the file and built again on the next seek.
+ * The functions below are called with the lock of the file held.
+ */
+
+static inline bool clmt_enabled(vfs_fat_ctx_t* ctx, int fd)
+{
+    return !(ctx->files[fd].flag & FA_WRITE) || ctx->o_append[fd];
+}
+
+static void clmt_build(vfs_fat_ctx_t* ctx, int fd)
+{
+    FIL* file = &ctx->files[fd];
+    ctx->clmt_outdated[fd] = false;
+    if (file->obj.sclust == 0) {
+        return; // no cluster allocated yet
+    }
+
+    // the table of a contiguous file takes 4 words; for other files, this gives the size of the table
+    DWORD probe[4] = { 4 };
+    file->cltbl = probe;
+    FRESULT res = f_lseek(file, CREATE_LINKMAP);
+    file->cltbl = NULL;
+    DWORD words = probe[0];
+    if ((res != FR_OK && res != FR_NOT_ENOUGH_CORE) || words > CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE) {
+        ESP_LOGD(TAG, "%s: no fast seek, fresult=%d, CLMT size %" PRIu32, __func__, res, (uint32_t) words);
+        return;
+    }
+
+    size_t size = words * sizeof(DWORD);
+    _lock_acquire(&ctx->lock);
+    bool fits = ctx->clmt_bytes + size <= CONFIG_FATFS_FAST_SEEK_MEMORY_BUDGET;
+    if (fits) {
+        ctx->clmt_bytes += size;
+    }
+    _lock_release(&ctx->lock);
+    if (!fits) {
+        ESP_LOGD(TAG, "%s: no fast seek, CLMT size %" PRIu32 " exceeds the budget", __func__, (uint32_t) words);
+        return;
+    }
+
+    DWORD* table = ff_memalloc(size);
+    if (table != NULL) {
+        if (res == FR_OK) {
+            memcpy(table, probe, size);
+        } else {
+            table[0] = words;
+            file->cltbl = table;
+            res = f_lseek(file, CREATE_LINKMAP);
+            file->cltbl = NULL;
+        }
+    }
+    if (table == NULL || res != FR_OK) {
+        ESP_LOGD(TAG, "%s: no fast seek, fresult=%d", __func__, res);
+        ff_memfree(table);
+        _lock_acquire(&ctx->lock);
+        ctx->clmt_bytes -= size;
+        _lock_release(&ctx->lock);
+        return;
+    }
+    file->cltbl = table;
+}
+
+static void clmt_release(vfs_fat_ctx_t* ctx, int fd)
+{
+    FIL* file = &ctx->files[fd];
+    if (file->cltbl != NULL) {
+        size_t size = file->cltbl[0] * sizeof(DWORD);
+        ff_memfree(file->cltbl);
+        file->cltbl = NULL;
+        _lock_acquire(&ctx->lock);
+        ctx->clmt_bytes -= size;
+        _lock_release(&ctx->lock);
+    }
+    ctx->clmt_outdated[fd] = clmt_enabled(ctx, fd);
+}
+
+static void clmt_prepare_seek(vfs_fat_ctx_t* ctx, int fd, FSIZE_t offset)
+{
+    FIL* file = &ctx->files[fd];
+    if (offset > f_size(file) && (file->flag & FA_WRITE)) {
+        clmt_release(ctx, fd); // seeking past the end expands the file
+    } else if (ctx->clmt_outdated[fd]) {
+        clmt_build(ctx, fd);
+    }
+}
+#endif // CONFIG_FATFS_USE_FASTSEEK
+
 static int vfs_fat_open(void* ctx, const char * path, int flags, int mode)
 {
     ESP_LOGV(TAG, "%s: path=\"%s\", flags=%x, mode=%x", __func__, path, flags, mode);
@@ -367,39 +493,6 @@ static int vfs_fat_open(void* ctx, const char * path, int flags, int mode)
         return -1;
     }
 
-#ifdef CONFIG_FATFS_USE_FASTSEEK
-    FIL* file = &fat_ctx->files[fd];
-    //fast-seek is only allowed in read mode, since file cannot be expanded
-    //to use it.
-    if(!(fat_mode_conv(flags) & (FA_WRITE))) {
-        DWORD *clmt_mem =  ff_memalloc(sizeof(DWORD) * CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE);
-        if (clmt_mem == NULL) {
-            f_close(file);
-            file_cleanup(fat_ctx, fd);
-            _lock_release(&fat_ctx->lock);
-            ESP_LOGE(TAG, "open: Failed to pre-allocate CLMT buffer for fast-seek");
-            errno = ENOMEM;
-            return -1;
-        }
-
-        file->cltbl = clmt_mem;
-        file->cltbl[0] = CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE;
-        res = f_lseek(file, CREATE_LINKMAP);
-        ESP_LOGD(TAG, "%s: fast-seek has: %s",
-                __func__,
-                (res == FR_OK) ? "activated" : "failed");
-        if(res != FR_OK) {
-            ESP_LOGW(TAG, "%s: fast-seek not activated reason code: %d",
-                    __func__, res);
-            //If linkmap creation fails, fallback to the non fast seek.
-            ff_memfree(file->cltbl);
-            file->cltbl = NULL;
-        }
-    } else {
-        file->cltbl = NULL;
-    }
-#endif
-
     // O_APPEND need to be stored because it is not compatible with FA_OPEN_APPEND:
     //  - FA_OPEN_APPEND means to jump to the end of file only after open()
     //  - O_APPEND means to jump to the end only before each write()
@@ -407,36 +500,45 @@ static int vfs_fat_open(void* ctx, const char * path, int flags, int mode)
     // therefore this flag is stored here (at this VFS level) in order to save
     // memory.
     fat_ctx->o_append[fd] = (flags & O_APPEND) == O_APPEND;
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    fat_ctx->clmt_outdated[fd] = clmt_enabled(fat_ctx, fd);
+#endif
     _lock_release(&fat_ctx->lock);
     return fd;
 }
 
+/* Operations on an open file only take the lock of the file, so that different files can be accessed at the
+ * same time. FATFS itself serializes the accesses to the FAT and directories with the lock of the volume.
+ */
 static ssize_t vfs_fat_write(void* ctx, int fd, const void * data, size_t size)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
     FRESULT res;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     if (fat_ctx->o_append[fd]) {
         if ((res = f_lseek(file, f_size(file))) != FR_OK) {
             ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
             errno = fresult_to_errno(res);
-            _lock_release(&fat_ctx->lock);
+            _lock_release(&fat_ctx->file_locks[fd]);
             return -1;
         }
     }
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    clmt_release(fat_ctx, fd);
+#endif
     unsigned written = 0;
     res = f_write(file, data, size, &written);
     if (((written == 0) && (size != 0)) && (res == 0)) {
         errno = ENOSPC;
-        _lock_release(&fat_ctx->lock);
+        _lock_release(&fat_ctx->file_locks[fd]);
         return -1;
     }
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
         if (written == 0) {
-            _lock_release(&fat_ctx->lock);
+            _lock_release(&fat_ctx->file_locks[fd]);
             return -1;
         }
     }
@@ -447,12 +549,12 @@ static ssize_t vfs_fat_write(void* ctx, int fd, const void * data, size_t size)
         if (res != FR_OK) {
             ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
             errno = fresult_to_errno(res);
-            _lock_release(&fat_ctx->lock);
+            _lock_release(&fat_ctx->file_locks[fd]);
             return -1;
         }
      }
 #endif
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return written;
 }
 
@@ -461,7 +563,9 @@ static ssize_t vfs_fat_read(void* ctx, int fd, void * dst, size_t size)
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
     unsigned read = 0;
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FRESULT res = f_read(file, dst, size, &read);
+    _lock_release(&fat_ctx->file_locks[fd]);
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
@@ -476,10 +580,13 @@ static ssize_t vfs_fat_pread(void *ctx, int fd, void *dst, size_t size, off_t of
 {
     ssize_t ret = -1;
     vfs_fat_ctx_t *fat_ctx = (vfs_fat_ctx_t *) ctx;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL *file = &fat_ctx->files[fd];
     const off_t prev_pos = f_tell(file);
 
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    clmt_prepare_seek(fat_ctx, fd, offset);
+#endif
     FRESULT f_res = f_lseek(file, offset);
 
     if (f_res != FR_OK) {
@@ -508,7 +615,7 @@ static ssize_t vfs_fat_pread(void *ctx, int fd, void *dst, size_t size, off_t of
     }
 
 pread_release:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 }
 
@@ -516,10 +623,13 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
 {
     ssize_t ret = -1;
     vfs_fat_ctx_t *fat_ctx = (vfs_fat_ctx_t *) ctx;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL *file = &fat_ctx->files[fd];
     const off_t prev_pos = f_tell(file);
 
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    clmt_release(fat_ctx, fd);
+#endif
     FRESULT f_res = f_lseek(file, offset);
 
     if (f_res != FR_OK) {
@@ -532,7 +642,7 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
     f_res = f_write(file, src, size, &wr);
     if (((wr == 0) && (size != 0)) && (f_res == 0)) {
         errno = ENOSPC;
-        return -1;
+        goto pwrite_release;
     }
     if (f_res == FR_OK) {
         ret = wr;
@@ -564,7 +674,7 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
 #endif
 
 pwrite_release:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 }
 
@@ -572,7 +682,9 @@ static int vfs_fat_fsync(void* ctx, int fd)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FRESULT res = f_sync(file);
+    _lock_release(&fat_ctx->file_locks[fd]);
     int rc = 0;
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
@@ -585,17 +697,17 @@ static int vfs_fat_fsync(void* ctx, int fd)
 static int vfs_fat_close(void* ctx, int fd)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
-    _lock_acquire(&fat_ctx->lock);
-    FIL* file = &fat_ctx->files[fd];
-
+    // wait for the operations on the file to finish, then free its entry in the file table
+    _lock_acquire(&fat_ctx->file_locks[fd]);
 #ifdef CONFIG_FATFS_USE_FASTSEEK
-    ff_memfree(file->cltbl);
-    file->cltbl = NULL;
+    clmt_release(fat_ctx, fd);
 #endif
-
+    _lock_acquire(&fat_ctx->lock);
+    FIL* file = &fat_ctx->files[fd];
     FRESULT res = f_close(file);
     file_cleanup(fat_ctx, fd);
     _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     int rc = 0;
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
@@ -610,6 +722,7 @@ static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
     off_t new_pos;
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     if (mode == SEEK_SET) {
         new_pos = offset;
     } else if (mode == SEEK_CUR) {
@@ -619,6 +732,7 @@ static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
         off_t size = f_size(file);
         new_pos = size + offset;
     } else {
+        _lock_release(&fat_ctx->file_locks[fd]);
         errno = EINVAL;
         return -1;
     }
@@ -627,8 +741,12 @@ static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
     ESP_LOGD(TAG, "%s: offset=%ld, filesize:=%" PRIu64, __func__, new_pos, f_size(file));
 #else
     ESP_LOGD(TAG, "%s: offset=%ld, filesize:=%" PRIu32, __func__, new_pos, f_size(file));
+#endif
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    clmt_prepare_seek(fat_ctx, fd, new_pos);
 #endif
     FRESULT res = f_lseek(file, new_pos);
+    _lock_release(&fat_ctx->file_locks[fd]);
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
@@ -642,7 +760,9 @@ static int vfs_fat_fstat(void* ctx, int fd, struct stat * st)
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
     memset(st, 0, sizeof(*st));
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     st->st_size = f_size(file);
+    _lock_release(&fat_ctx->file_locks[fd]);
     st->st_mode = S_IRWXU | S_IRWXG | S_IRWXO | S_IFREG;
     st->st_mtime = 0;
     st->st_atime = 0;
@@ -1177,7 +1297,7 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
         return ret;
     }
 
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     file = &fat_ctx->files[fd];
     if (file == NULL) {
         ESP_LOGD(TAG, "ftruncate NULL file pointer");
@@ -1186,6 +1306,9 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
         goto out;
     }
 
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    clmt_release(fat_ctx, fd);
+#endif
     FSIZE_t seek_ptr_pos = (FSIZE_t) f_tell(file); // current seek pointer position
     FSIZE_t sz = (FSIZE_t) f_size(file); // current file size (end of file position)
 
@@ -1242,7 +1365,7 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
 #endif
 
 out:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 
 fail:
@@ -186,6 +186,7 @@ esp_err_t esp_vfs_fat_spiflash_mount_rw_wl(const char* base_path,
 fail:
     esp_vfs_fat_unregister_path(base_path);
     ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(*wl_handle);
     free(ctx);
     return ret;
 }
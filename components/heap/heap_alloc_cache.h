@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Size-class free lists which keep small freed blocks for reuse, used by the allocation caches in front of
+   heap_caps_malloc() (see CONFIG_HEAP_ALLOC_CACHE).
+
+   A cached block is still allocated as far as multi_heap is concerned. While the block is in the cache, its first
+   word links it to the next block of the same size class and its second word holds the capabilities of the heap it
+   belongs to, so that it is only handed out again for requests which that heap could satisfy.
+
+   These functions don't lock anything, the caller is responsible for that. CONFIG_HEAP_ALLOC_CACHE_MAX_SIZE and
+   CONFIG_HEAP_ALLOC_CACHE_SIZE must be defined before including this header.
+*/
+
+#define HEAP_ALLOC_CACHE_CLASS_SIZE 8
+#define HEAP_ALLOC_CACHE_CLASSES ((CONFIG_HEAP_ALLOC_CACHE_MAX_SIZE + HEAP_ALLOC_CACHE_CLASS_SIZE - 1) / HEAP_ALLOC_CACHE_CLASS_SIZE)
+
+/* Round an allocation size up to its size class. Blocks allocated from the heaps with the rounded size go back to
+   the size class they were allocated for when they are freed. */
+#define HEAP_ALLOC_CACHE_ROUND_SIZE(SIZE) (((SIZE) + HEAP_ALLOC_CACHE_CLASS_SIZE - 1) & ~(size_t)(HEAP_ALLOC_CACHE_CLASS_SIZE - 1))
+
+typedef struct heap_alloc_cache_block_ {
+    struct heap_alloc_cache_block_ *next;
+    uint32_t caps;
+} heap_alloc_cache_block_t;
+
+typedef struct {
+    heap_alloc_cache_block_t *classes[HEAP_ALLOC_CACHE_CLASSES];
+    size_t size; ///< Number of bytes held in the cache, counted by size class
+} heap_alloc_cache_t;
+
+/* Take a block which can hold 'size' bytes (1 to CONFIG_HEAP_ALLOC_CACHE_MAX_SIZE) and which belongs to a heap
+   having all the capabilities in 'caps'. Returns NULL if the cache has no such block.
+*/
+static inline void *heap_alloc_cache_get(heap_alloc_cache_t *cache, size_t size, uint32_t caps)
+{
+    size_t index = (size - 1) / HEAP_ALLOC_CACHE_CLASS_SIZE;
+    heap_alloc_cache_block_t **prev = &cache->classes[index];
+
+    for (heap_alloc_cache_block_t *block = *prev; block != NULL; block = block->next) {
+        if ((block->caps & caps) == caps) {
+            *prev = block->next;
+            cache->size -= (index + 1) * HEAP_ALLOC_CACHE_CLASS_SIZE;
+            return block;
+        }
+        prev = &block->next;
+    }
+    return NULL;
+}
+
+/* Put a block with 'block_size' usable bytes, which belongs to a heap with capabilities 'caps', into the cache.
+   Returns false if the block is too small or too big to be cached, or if the cache is full.
+*/
+static inline bool heap_alloc_cache_put(heap_alloc_cache_t *cache, void *p, size_t block_size, uint32_t caps)
+{
+    size_t class_num = block_size / HEAP_ALLOC_CACHE_CLASS_SIZE;
+    if (block_size < sizeof(heap_alloc_cache_block_t) || class_num > HEAP_ALLOC_CACHE_CLASSES) {
+        return false;
+    }
+
+    size_t class_size = class_num * HEAP_ALLOC_CACHE_CLASS_SIZE;
+    if (cache->size + class_size > CONFIG_HEAP_ALLOC_CACHE_SIZE) {
+        return false;
+    }
+
+    heap_alloc_cache_block_t *block = (heap_alloc_cache_block_t *)p;
+    block->next = cache->classes[class_num - 1];
+    block->caps = caps;
+    cache->classes[class_num - 1] = block;
+    cache->size += class_size;
+    return true;
+}
+
+/* Take any block out of the cache, used to return the cached blocks to their heaps.
+   Returns NULL if the cache is empty.
+*/
+static inline void *heap_alloc_cache_pop(heap_alloc_cache_t *cache)
+{
+    for (size_t index = 0; index < HEAP_ALLOC_CACHE_CLASSES; index++) {
+        heap_alloc_cache_block_t *block = cache->classes[index];
+        if (block != NULL) {
+            cache->classes[index] = block->next;
+            cache->size -= (index + 1) * HEAP_ALLOC_CACHE_CLASS_SIZE;
+            return block;
+        }
+    }
+    return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -404,6 +404,7 @@ void heap_caps_print_heap_info( uint32_t caps )
                    info.free_blocks, info.total_blocks);
         }
     }
+    heap_pool_print_info(caps);
     printf("  Totals:\n");
     heap_caps_get_info(&info, caps);
 
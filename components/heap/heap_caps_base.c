@@ -23,6 +23,78 @@
 #define CALL_HOOK(hook, ...) {}
 #endif
 
+#if CONFIG_HEAP_ALLOC_CACHE
+#include "esp_cpu.h"
+#include "soc/soc_caps.h"
+#include "heap_alloc_cache.h"
+
+/* Caches of small free blocks, one for each CPU core (see heap_alloc_cache.h).
+
+   The lock of a cache is only contended when a task is moved to the other core while it allocates or frees memory,
+   or when the caches are flushed, so the cores don't have to take the lock of the same heap for every small
+   allocation.
+*/
+typedef struct {
+    multi_heap_lock_t lock;
+    heap_alloc_cache_t cache;
+} core_alloc_cache_t;
+
+static core_alloc_cache_t s_alloc_caches[SOC_CPU_CORES_NUM] = {
+    [0 ... (SOC_CPU_CORES_NUM - 1)] = { .lock = MULTI_HEAP_LOCK_STATIC_INITIALIZER },
+};
+
+HEAP_IRAM_ATTR static void *alloc_cache_get(size_t size, uint32_t caps)
+{
+    core_alloc_cache_t *core_cache = &s_alloc_caches[esp_cpu_get_core_id()];
+
+    MULTI_HEAP_LOCK(&core_cache->lock);
+    void *p = heap_alloc_cache_get(&core_cache->cache, size, caps);
+    MULTI_HEAP_UNLOCK(&core_cache->lock);
+    return p;
+}
+
+HEAP_IRAM_ATTR static bool alloc_cache_put(heap_t *heap, void *p)
+{
+    // Only internal memory is cached, so that the caches don't change where
+    // the allocations which prefer internal memory are placed
+    uint32_t caps = get_all_caps(heap);
+    if ((caps & MALLOC_CAP_INTERNAL) == 0) {
+        return false;
+    }
+
+    size_t block_size = multi_heap_get_allocated_size(heap->heap, p);
+    core_alloc_cache_t *core_cache = &s_alloc_caches[esp_cpu_get_core_id()];
+
+    MULTI_HEAP_LOCK(&core_cache->lock);
+    bool cached = heap_alloc_cache_put(&core_cache->cache, p, block_size, caps);
+    MULTI_HEAP_UNLOCK(&core_cache->lock);
+    return cached;
+}
+
+/* Return all the cached blocks to their heaps. Returns true if any block was returned. */
+HEAP_IRAM_ATTR static bool alloc_cache_flush(void)
+{
+    bool flushed = false;
+
+    for (int core = 0; core < SOC_CPU_CORES_NUM; core++) {
+        core_alloc_cache_t *core_cache = &s_alloc_caches[core];
+        while (true) {
+            MULTI_HEAP_LOCK(&core_cache->lock);
+            void *p = heap_alloc_cache_pop(&core_cache->cache);
+            MULTI_HEAP_UNLOCK(&core_cache->lock);
+            if (p == NULL) {
+                break;
+            }
+            heap_t *heap = find_containing_heap(p);
+            assert(heap != NULL);
+            multi_heap_free(heap->heap, p);
+            flushed = true;
+        }
+    }
+    return flushed;
+}
+#endif // CONFIG_HEAP_ALLOC_CACHE
+
 /*
   This takes a memory chunk in a region that can be addressed as both DRAM as well as IRAM. It will convert it to
   IRAM in such a way that it can be later freed. It assumes both the address as well as the length to be word-aligned.
@@ -51,7 +123,8 @@ HEAP_IRAM_ATTR void heap_caps_free( void *ptr)
         return;
     }
 
-    if (esp_ptr_in_diram_iram(ptr)) {
+    bool ptr_in_diram_iram = esp_ptr_in_diram_iram(ptr);
+    if (ptr_in_diram_iram) {
         //Memory allocated here is actually allocated in the DRAM alias region and
         //cannot be de-allocated as usual. dram_alloc_to_iram_addr stores a pointer to
         //the equivalent DRAM address, though; free that.
@@ -61,6 +134,12 @@ HEAP_IRAM_ATTR void heap_caps_free( void *ptr)
     void *block_owner_ptr = MULTI_HEAP_REMOVE_BLOCK_OWNER_OFFSET(ptr);
     heap_t *heap = find_containing_heap(block_owner_ptr);
     assert(heap != NULL && "free() target pointer is outside heap areas");
+#if CONFIG_HEAP_ALLOC_CACHE
+    if (!ptr_in_diram_iram && alloc_cache_put(heap, block_owner_ptr)) {
+        CALL_HOOK(esp_heap_trace_free_hook, ptr);
+        return;
+    }
+#endif
     multi_heap_free(heap->heap, block_owner_ptr);
 
     CALL_HOOK(esp_heap_trace_free_hook, ptr);
@@ -100,6 +179,24 @@ HEAP_IRAM_ATTR NOINLINE_ATTR void *heap_caps_malloc_base( size_t size, uint32_t
         size = (size + 3) & (~3); // int overflow checked above
     }
 
+    size_t alloc_size = size;
+#if CONFIG_HEAP_ALLOC_CACHE
+    if (MULTI_HEAP_ADD_BLOCK_OWNER_SIZE(size) <= CONFIG_HEAP_ALLOC_CACHE_MAX_SIZE && !(caps & MALLOC_CAP_EXEC)) {
+        ret = alloc_cache_get(MULTI_HEAP_ADD_BLOCK_OWNER_SIZE(size), caps);
+        if (ret != NULL) {
+            MULTI_HEAP_SET_BLOCK_OWNER(ret);
+            ret = MULTI_HEAP_ADD_BLOCK_OWNER_OFFSET(ret);
+            CALL_HOOK(esp_heap_trace_alloc_hook, ret, size, caps);
+            return ret;
+        }
+        // allocate the whole size class, so that the block can be cached for this size once it's freed.
+        // The hooks still get the requested size.
+        alloc_size = MULTI_HEAP_REMOVE_BLOCK_OWNER_SIZE(HEAP_ALLOC_CACHE_ROUND_SIZE(MULTI_HEAP_ADD_BLOCK_OWNER_SIZE(size)));
+    }
+
+    bool cache_flushed = false;
+retry:
+#endif
     for (int prio = 0; prio < SOC_MEMORY_TYPE_NO_PRIOS; prio++) {
         //Iterate over heaps and check capabilities at this priority
         heap_t *heap;
@@ -118,17 +215,17 @@ HEAP_IRAM_ATTR NOINLINE_ATTR void *heap_caps_malloc_base( size_t size, uint32_t
                         //This is special, insofar that what we're going to get back is a DRAM address. If so,
                         //we need to 'invert' it (lowest address in DRAM == highest address in IRAM and vice-versa) and
                         //add a pointer to the DRAM equivalent before the address we're going to return.
-                        ret = multi_heap_malloc(heap->heap, MULTI_HEAP_ADD_BLOCK_OWNER_SIZE(size) + 4);  // int overflow checked above
+                        ret = multi_heap_malloc(heap->heap, MULTI_HEAP_ADD_BLOCK_OWNER_SIZE(alloc_size) + 4);  // int overflow checked above
                         if (ret != NULL) {
                             MULTI_HEAP_SET_BLOCK_OWNER(ret);
                             ret = MULTI_HEAP_ADD_BLOCK_OWNER_OFFSET(ret);
-                            uint32_t *iptr = dram_alloc_to_iram_addr(ret, size + 4);  // int overflow checked above
+                            uint32_t *iptr = dram_alloc_to_iram_addr(ret, alloc_size + 4);  // int overflow checked above
                             CALL_HOOK(esp_heap_trace_alloc_hook, iptr, size, caps);
                             return iptr;
                         }
                     } else {
                         //Just try to alloc, nothing special.
-                        ret = multi_heap_malloc(heap->heap, MULTI_HEAP_ADD_BLOCK_OWNER_SIZE(size));
+                        ret = multi_heap_malloc(heap->heap, MULTI_HEAP_ADD_BLOCK_OWNER_SIZE(alloc_size));
                         if (ret != NULL) {
                             MULTI_HEAP_SET_BLOCK_OWNER(ret);
                             ret = MULTI_HEAP_ADD_BLOCK_OWNER_OFFSET(ret);
@@ -141,6 +238,14 @@ HEAP_IRAM_ATTR NOINLINE_ATTR void *heap_caps_malloc_base( size_t size, uint32_t
         }
     }
 
+#if CONFIG_HEAP_ALLOC_CACHE
+    //The memory may be held by the allocation caches, return it to the heaps and try again.
+    if (!cache_flushed && alloc_cache_flush()) {
+        cache_flushed = true;
+        goto retry;
+    }
+#endif
+
     //Nothing usable found.
     return NULL;
 }
@@ -259,6 +364,10 @@ HEAP_IRAM_ATTR void *heap_caps_calloc_base( size_t n, size_t size, uint32_t caps
 
 HEAP_IRAM_ATTR void *heap_caps_aligned_alloc_base(size_t alignment, size_t size, uint32_t caps)
 {
+#if CONFIG_HEAP_ALLOC_CACHE
+    bool cache_flushed = false;
+retry:
+#endif
     for (int prio = 0; prio < SOC_MEMORY_TYPE_NO_PRIOS; prio++) {
         //Iterate over heaps and check capabilities at this priority
         heap_t *heap;
@@ -284,6 +393,20 @@ HEAP_IRAM_ATTR void *heap_caps_aligned_alloc_base(size_t alignment, size_t size,
         }
     }
 
+#if CONFIG_HEAP_ALLOC_CACHE
+    if (!cache_flushed && alloc_cache_flush()) {
+        cache_flushed = true;
+        goto retry;
+    }
+#endif
+
     //Nothing usable found.
     return NULL;
 }
+
+void heap_caps_alloc_cache_flush(void)
+{
+#if CONFIG_HEAP_ALLOC_CACHE
+    alloc_cache_flush();
+#endif
+}
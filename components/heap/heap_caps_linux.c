@@ -195,6 +195,10 @@ void heap_caps_dump_all(void)
     heap_caps_dump(MALLOC_CAP_INVALID);
 }
 
+void heap_caps_alloc_cache_flush(void)
+{
+}
+
 size_t heap_caps_get_allocated_size( void *ptr )
 {
     return 0;
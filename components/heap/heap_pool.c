@@ -0,0 +1,268 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <sys/param.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_pool.h"
+#include "multi_heap.h"
+#include "multi_heap_internal.h"
+#include "multi_heap_config.h"
+#include "heap_private.h"
+
+/*
+A pool hands out objects of a single size. It allocates its memory from the heap in slabs, each holding a header
+and objects_per_slab object slots, and keeps the free slots in a list which is threaded through the slots
+themselves. The slabs are only returned to the heap when the pool is deleted.
+
+If heap poisoning is enabled, each slot also holds the same head & tail poison structures as a heap block (see
+multi_heap_poisoning.c), and the link to the next free slot is stored in the space of the head structure.
+*/
+
+#define POOL_ALIGN(X) (((X) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+typedef struct heap_pool_slab_ {
+    struct heap_pool_slab_ *next;
+} heap_pool_slab_t;
+
+typedef struct heap_pool_slot_ {
+    struct heap_pool_slot_ *next;
+} heap_pool_slot_t;
+
+struct heap_pool {
+    multi_heap_lock_t lock;
+    size_t object_size;
+    size_t slot_size;
+    size_t objects_per_slab;
+    uint32_t caps;
+    heap_pool_slot_t *free_slots;
+    heap_pool_slab_t *slabs;
+    size_t slab_count;
+    size_t allocated_objects;
+    size_t peak_allocated_objects;
+    SLIST_ENTRY(heap_pool) next;
+};
+
+/* All the pools, for heap_caps_print_heap_info() */
+static SLIST_HEAD(heap_pool_ll, heap_pool) s_pools = SLIST_HEAD_INITIALIZER(s_pools);
+static multi_heap_lock_t s_pools_lock = MULTI_HEAP_LOCK_STATIC_INITIALIZER;
+
+FORCE_INLINE_ATTR size_t slab_size(const struct heap_pool *pool)
+{
+    return POOL_ALIGN(sizeof(heap_pool_slab_t)) + pool->slot_size * pool->objects_per_slab;
+}
+
+heap_pool_handle_t heap_pool_create(size_t object_size, size_t objects_per_slab, uint32_t caps)
+{
+    if (object_size == 0 || objects_per_slab == 0) {
+        return NULL;
+    }
+
+    size_t slot_size = MAX(object_size, sizeof(heap_pool_slot_t));
+#ifdef MULTI_HEAP_POISONING
+    slot_size = object_size + multi_heap_internal_poison_overhead();
+#endif
+    slot_size = POOL_ALIGN(slot_size);
+    if (slot_size < object_size) {
+        return NULL;
+    }
+
+    size_t slots_bytes;
+    if (__builtin_mul_overflow(slot_size, objects_per_slab, &slots_bytes)
+            || slots_bytes > HEAP_SIZE_MAX) {
+        return NULL;
+    }
+
+    struct heap_pool *pool = heap_caps_calloc(1, sizeof(struct heap_pool), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (pool == NULL) {
+        return NULL;
+    }
+    MULTI_HEAP_LOCK_INIT(&pool->lock);
+    pool->object_size = object_size;
+    pool->slot_size = slot_size;
+    pool->objects_per_slab = objects_per_slab;
+    pool->caps = caps;
+
+    MULTI_HEAP_LOCK(&s_pools_lock);
+    SLIST_INSERT_HEAD(&s_pools, pool, next);
+    MULTI_HEAP_UNLOCK(&s_pools_lock);
+
+    return pool;
+}
+
+void heap_pool_delete(heap_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    MULTI_HEAP_LOCK(&s_pools_lock);
+    SLIST_REMOVE(&s_pools, pool, heap_pool, next);
+    MULTI_HEAP_UNLOCK(&s_pools_lock);
+
+    heap_pool_slab_t *slab = pool->slabs;
+    while (slab != NULL) {
+        heap_pool_slab_t *next = slab->next;
+        heap_caps_free(slab);
+        slab = next;
+    }
+    heap_caps_free(pool);
+}
+
+/* Allocate a slab and link its slots together. Called without the pool lock held. */
+HEAP_IRAM_ATTR static heap_pool_slab_t *alloc_slab(heap_pool_handle_t pool, heap_pool_slot_t **last_slot)
+{
+    heap_pool_slab_t *slab = heap_caps_malloc(slab_size(pool), pool->caps);
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    uint8_t *slots = (uint8_t *)slab + POOL_ALIGN(sizeof(heap_pool_slab_t));
+#ifdef MULTI_HEAP_POISONING_SLOW
+    multi_heap_internal_poison_fill_region(slots, pool->slot_size * pool->objects_per_slab, true);
+#endif
+    for (size_t i = 0; i < pool->objects_per_slab - 1; i++) {
+        ((heap_pool_slot_t *)(slots + i * pool->slot_size))->next = (heap_pool_slot_t *)(slots + (i + 1) * pool->slot_size);
+    }
+    *last_slot = (heap_pool_slot_t *)(slots + (pool->objects_per_slab - 1) * pool->slot_size);
+    (*last_slot)->next = NULL;
+    return slab;
+}
+
+HEAP_IRAM_ATTR void *heap_pool_alloc(heap_pool_handle_t pool)
+{
+    assert(pool != NULL);
+
+    MULTI_HEAP_LOCK(&pool->lock);
+    while (pool->free_slots == NULL) {
+        // don't hold the pool lock while allocating from the heap
+        MULTI_HEAP_UNLOCK(&pool->lock);
+        heap_pool_slot_t *last_slot;
+        heap_pool_slab_t *slab = alloc_slab(pool, &last_slot);
+        if (slab == NULL) {
+            return NULL;
+        }
+        MULTI_HEAP_LOCK(&pool->lock);
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->slab_count++;
+        last_slot->next = pool->free_slots;
+        pool->free_slots = (heap_pool_slot_t *)((uint8_t *)slab + POOL_ALIGN(sizeof(heap_pool_slab_t)));
+    }
+
+    heap_pool_slot_t *slot = pool->free_slots;
+    pool->free_slots = slot->next;
+    pool->allocated_objects++;
+    pool->peak_allocated_objects = MAX(pool->peak_allocated_objects, pool->allocated_objects);
+    MULTI_HEAP_UNLOCK(&pool->lock);
+
+#ifdef MULTI_HEAP_POISONING
+    return multi_heap_internal_poison_object(slot, pool->object_size);
+#else
+    return slot;
+#endif
+}
+
+HEAP_IRAM_ATTR void heap_pool_free(heap_pool_handle_t pool, void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    assert(pool != NULL);
+
+#ifdef MULTI_HEAP_POISONING
+    heap_pool_slot_t *slot = multi_heap_internal_unpoison_object(ptr, pool->object_size);
+    assert(slot != NULL && "heap_pool_free() object is corrupt");
+#else
+    heap_pool_slot_t *slot = ptr;
+#endif
+
+    MULTI_HEAP_LOCK(&pool->lock);
+    slot->next = pool->free_slots;
+    pool->free_slots = slot;
+    pool->allocated_objects--;
+    MULTI_HEAP_UNLOCK(&pool->lock);
+}
+
+/* Called with the pool lock held */
+static void get_info(const struct heap_pool *pool, heap_pool_info_t *info)
+{
+    info->object_size = pool->object_size;
+    info->slab_count = pool->slab_count;
+    info->total_bytes = pool->slab_count * slab_size(pool);
+    info->total_objects = pool->slab_count * pool->objects_per_slab;
+    info->allocated_objects = pool->allocated_objects;
+    info->free_objects = info->total_objects - pool->allocated_objects;
+    info->peak_allocated_objects = pool->peak_allocated_objects;
+}
+
+void heap_pool_get_info(heap_pool_handle_t pool, heap_pool_info_t *info)
+{
+    assert(pool != NULL && info != NULL);
+
+    MULTI_HEAP_LOCK(&pool->lock);
+    get_info(pool, info);
+    MULTI_HEAP_UNLOCK(&pool->lock);
+}
+
+/* Does any slab of the pool lie in a heap with the given capabilities? Called with the pool lock held. */
+static bool pool_caps_match(const struct heap_pool *pool, uint32_t caps)
+{
+    for (heap_pool_slab_t *slab = pool->slabs; slab != NULL; slab = slab->next) {
+        heap_t *heap = find_containing_heap(slab);
+        if (heap != NULL && heap_caps_match(heap, caps)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void heap_pool_print_info(uint32_t caps)
+{
+    /* printf() can't be called with the locks held, so look up the pools one at a time by their position in
+       the list. A pool which is created or deleted meanwhile may be missed or printed twice. */
+    bool header_printed = false;
+    for (int index = 0; ; index++) {
+        heap_pool_handle_t found = NULL;
+        bool match = false;
+        heap_pool_info_t info;
+
+        MULTI_HEAP_LOCK(&s_pools_lock);
+        heap_pool_handle_t pool;
+        int i = 0;
+        SLIST_FOREACH(pool, &s_pools, next) {
+            if (i++ == index) {
+                found = pool;
+                MULTI_HEAP_LOCK(&pool->lock);
+                match = pool_caps_match(pool, caps);
+                if (match) {
+                    get_info(pool, &info);
+                }
+                MULTI_HEAP_UNLOCK(&pool->lock);
+                break;
+            }
+        }
+        MULTI_HEAP_UNLOCK(&s_pools_lock);
+
+        if (found == NULL) {
+            break;
+        }
+        if (!match) {
+            continue;
+        }
+        if (!header_printed) {
+            printf("  Pools:\n");
+            header_printed = true;
+        }
+        printf("    Pool %p object_size %d slabs %d total %d\n",
+               found, info.object_size, info.slab_count, info.total_bytes);
+        printf("      allocated_objects %d free_objects %d peak_allocated_objects %d\n",
+               info.allocated_objects, info.free_objects, info.peak_allocated_objects);
+    }
+}
@@ -74,6 +74,11 @@ FORCE_INLINE_ATTR heap_t *find_containing_heap(void *ptr )
     return NULL;
 }
 
+/* Print the pools (see esp_heap_pool.h) which have slabs in heaps with the given capabilities.
+   Called by heap_caps_print_heap_info().
+*/
+void heap_pool_print_info(uint32_t caps);
+
 /*
  Because we don't want to add _another_ known allocation method to the stack of functions to trace wrt memory tracing,
  these are declared private. The newlib malloc()/realloc() implementation also calls these, so they are declared
@@ -0,0 +1,455 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <inttypes.h>
+#include <sdkconfig.h>
+
+#define HEAP_TRACE_SRCFILE /* don't warn on inclusion here */
+#include "esp_heap_trace.h"
+#undef HEAP_TRACE_SRCFILE
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#include "soc/soc_caps.h"
+
+/*
+The sampling heap profiler decides whether to sample an allocation by counting down the bytes allocated on each CPU
+core. When an allocation is bigger than what is left of the countdown, it is sampled and a new countdown is drawn
+from an exponential distribution with a mean of sample_interval bytes, as in tcmalloc or Go. This gives each
+allocation of N bytes a probability of 1 - exp(-N / sample_interval) to be sampled, which is what pprof expects
+to scale the samples back.
+
+Unsampled allocations only update the countdown of their core, without taking any lock or reading their call
+stack. A task and an ISR running on the same core, or a task migrating to another core, can race on the countdown,
+which only skews the sampling a little. Frees take the lock to look up their address while sampled allocations are
+live.
+
+The samples are aggregated by call stack in 'stacks', which is append-only until the profiler is restarted and is
+indexed by a hash table. The addresses of the sampled allocations which are not freed yet are kept in another hash
+table, 'live', so that their frees can be deducted from the in-use statistics. Both hash tables use linear probing.
+*/
+
+#define STACK_DEPTH CONFIG_HEAP_TRACING_STACK_DEPTH
+#define NUM_STACKS CONFIG_HEAP_TRACE_SAMPLING_STACKS
+#define NUM_STACK_SLOTS (NUM_STACKS * 2)
+#define NUM_LIVE CONFIG_HEAP_TRACE_SAMPLING_LIVE
+#define NUM_LIVE_SLOTS (NUM_LIVE + NUM_LIVE / 3)
+
+/* Worst case length of a line of the profile: the counts, and " 0x12345678" per frame */
+#define LINE_LEN (64 + STACK_DEPTH * 11)
+
+typedef struct {
+    void *alloced_by[STACK_DEPTH];
+    uint32_t hash;
+    size_t alloc_count;
+    size_t alloc_bytes;
+    size_t inuse_count;
+    size_t inuse_bytes;
+} sampled_stack_t;
+
+typedef struct {
+    void *address;  // NULL if the slot is free
+    size_t size;
+    uint16_t stack; // index in 'stacks'
+} live_sample_t;
+
+static portMUX_TYPE s_sampling_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool s_sampling;
+static size_t s_sample_interval;
+static size_t s_bytes_until_sample[SOC_CPU_CORES_NUM];
+static uint32_t s_random = 1;
+
+/* Allocated on the first call to heap_trace_sampling_start(), in internal RAM as they are used from ISRs */
+static sampled_stack_t *s_stacks;
+static uint16_t *s_stack_slots; // index in s_stacks + 1, or 0 if the slot is free
+static live_sample_t *s_live;
+
+static size_t s_stack_count;
+static size_t s_live_count;
+static size_t s_total_samples;
+static size_t s_dropped_samples;
+static size_t s_untracked_samples;
+
+/* xorshift32, called with the lock held */
+static HEAP_IRAM_ATTR uint32_t next_random(void)
+{
+    uint32_t x = s_random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s_random = x;
+    return x;
+}
+
+/* log2(1 + i / 64) in Q16, in DRAM as it is used from ISRs */
+static const DRAM_ATTR uint32_t s_log2_table[65] = {
+    0, 1466, 2909, 4331, 5732, 7112, 8473, 9814,
+    11136, 12440, 13727, 14996, 16248, 17484, 18704, 19909,
+    21098, 22272, 23433, 24579, 25711, 26830, 27936, 29029,
+    30109, 31178, 32234, 33279, 34312, 35334, 36346, 37346,
+    38336, 39316, 40286, 41246, 42196, 43137, 44068, 44990,
+    45904, 46809, 47705, 48593, 49472, 50344, 51207, 52063,
+    52911, 53751, 54584, 55410, 56229, 57040, 57845, 58643,
+    59434, 60219, 60997, 61769, 62534, 63294, 64047, 64794,
+    65536,
+};
+
+/* Draw the number of bytes to allocate before the next sample, from an exponential distribution with a mean of
+   s_sample_interval. -ln(u) is computed from log2(u) in fixed point, so that the FPU isn't used in ISRs. */
+static HEAP_IRAM_ATTR size_t next_sample_countdown(void)
+{
+    uint32_t x = next_random(); // u = x / 2^32, x is never 0
+    int msb = 31 - __builtin_clz(x);
+    uint32_t f = ((msb >= 16) ? (x >> (msb - 16)) : (x << (16 - msb))) & 0xffff;  // x = 2^msb * (1 + f), Q16
+    uint32_t i = f >> 10;
+    uint32_t log2_f = s_log2_table[i] + (((s_log2_table[i + 1] - s_log2_table[i]) * (f & 0x3ff)) >> 10);
+    uint32_t log2_x = ((uint32_t)msb << 16) + log2_f;
+    uint32_t neg_ln_u = ((uint64_t)((32u << 16) - log2_x) * 45426) >> 16;  // 45426 = ln(2) * 2^16
+    uint64_t countdown = ((uint64_t)s_sample_interval * neg_ln_u) >> 16;
+    return (countdown == 0) ? 1 : (countdown > SIZE_MAX ? SIZE_MAX : (size_t)countdown);
+}
+
+static HEAP_IRAM_ATTR uint32_t hash_stack(void * const *callers)
+{
+    uint32_t hash = 2166136261UL; // FNV-1a
+    for (int i = 0; i < STACK_DEPTH; i++) {
+        hash = (hash ^ (uint32_t)callers[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+static HEAP_IRAM_ATTR size_t hash_address(void *p)
+{
+    // addresses are at least 4 bytes aligned, see hash_idx() in heap_trace_standalone.c
+    return ((((uint32_t)p >> 3) +
+             ((uint32_t)p >> 5) +
+             ((uint32_t)p >> 7)) * 16777619UL) % NUM_LIVE_SLOTS;
+}
+
+/* Find the entry of a call stack, or add one. Returns -1 if all the entries are in use. Called with the lock held. */
+static HEAP_IRAM_ATTR int find_or_add_stack(void * const *callers)
+{
+    uint32_t hash = hash_stack(callers);
+    size_t slot = hash % NUM_STACK_SLOTS;
+
+    // there are twice as many slots as entries, so there is always a free slot to end the search
+    while (s_stack_slots[slot] != 0) {
+        int index = s_stack_slots[slot] - 1;
+        if (s_stacks[index].hash == hash && memcmp(s_stacks[index].alloced_by, callers, sizeof(void *) * STACK_DEPTH) == 0) {
+            return index;
+        }
+        slot = (slot + 1) % NUM_STACK_SLOTS;
+    }
+
+    if (s_stack_count == NUM_STACKS) {
+        return -1;
+    }
+    int index = s_stack_count++;
+    sampled_stack_t *stack = &s_stacks[index];
+    memset(stack, 0, sizeof(sampled_stack_t));
+    memcpy(stack->alloced_by, callers, sizeof(void *) * STACK_DEPTH);
+    stack->hash = hash;
+    s_stack_slots[slot] = index + 1;
+    return index;
+}
+
+/* Called with the lock held */
+static HEAP_IRAM_ATTR bool live_add(void *p, size_t size, int stack)
+{
+    if (s_live_count == NUM_LIVE) {
+        return false;
+    }
+    size_t slot = hash_address(p);
+    while (s_live[slot].address != NULL) {
+        slot = (slot + 1) % NUM_LIVE_SLOTS;
+    }
+    s_live[slot] = (live_sample_t) {
+        .address = p,
+        .size = size,
+        .stack = stack,
+    };
+    s_live_count++;
+    return true;
+}
+
+/* Remove an address from 'live', moving back the entries which follow it in the probe sequence so that they can
+   still be found. Returns false if the address isn't there. Called with the lock held. */
+static HEAP_IRAM_ATTR bool live_remove(void *p, live_sample_t *removed)
+{
+    size_t slot = hash_address(p);
+    while (s_live[slot].address != p) {
+        if (s_live[slot].address == NULL) {
+            return false;
+        }
+        slot = (slot + 1) % NUM_LIVE_SLOTS;
+    }
+    *removed = s_live[slot];
+
+    size_t hole = slot;
+    for (size_t next = (slot + 1) % NUM_LIVE_SLOTS; s_live[next].address != NULL; next = (next + 1) % NUM_LIVE_SLOTS) {
+        size_t home = hash_address(s_live[next].address);
+        // the entry can move to the hole unless its home slot is cyclically in (hole, next]
+        bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays) {
+            s_live[hole] = s_live[next];
+            hole = next;
+        }
+    }
+    s_live[hole].address = NULL;
+    s_live_count--;
+    return true;
+}
+
+/* Called by trace_malloc() and trace_realloc() in heap_trace.inc for every successful allocation, before its call
+   stack is read. Returns true if the allocation must be sampled. */
+HEAP_IRAM_ATTR bool heap_trace_sampling_should_sample(size_t size)
+{
+    if (!s_sampling) {
+        return false;
+    }
+
+    size_t *countdown = &s_bytes_until_sample[esp_cpu_get_core_id()];
+    if (size < *countdown) {
+        *countdown -= size;
+        return false;
+    }
+    return true;
+}
+
+/* Called by trace_malloc() and trace_realloc() in heap_trace.inc for the allocations which
+   heap_trace_sampling_should_sample() selected */
+HEAP_IRAM_ATTR void heap_trace_sampling_record_alloc(const heap_trace_record_t *record)
+{
+    portENTER_CRITICAL_SAFE(&s_sampling_mux);
+    if (s_sampling) {
+        s_bytes_until_sample[esp_cpu_get_core_id()] = next_sample_countdown();
+        s_total_samples++;
+        int index = find_or_add_stack(record->alloced_by);
+        if (index < 0) {
+            s_dropped_samples++;
+        } else {
+            sampled_stack_t *stack = &s_stacks[index];
+            stack->alloc_count++;
+            stack->alloc_bytes += record->size;
+            if (live_add(record->address, record->size, index)) {
+                stack->inuse_count++;
+                stack->inuse_bytes += record->size;
+            } else {
+                s_untracked_samples++;
+            }
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_sampling_mux);
+}
+
+/* Called by trace_free() and trace_realloc() in heap_trace.inc for every free */
+HEAP_IRAM_ATTR void heap_trace_sampling_record_free(void *p)
+{
+    if (s_live_count == 0 || p == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL_SAFE(&s_sampling_mux);
+    live_sample_t removed;
+    if (s_live_count != 0 && live_remove(p, &removed)) {
+        sampled_stack_t *stack = &s_stacks[removed.stack];
+        stack->inuse_count--;
+        stack->inuse_bytes -= removed.size;
+    }
+    portEXIT_CRITICAL_SAFE(&s_sampling_mux);
+}
+
+esp_err_t heap_trace_sampling_start(size_t sample_interval)
+{
+    if (sample_interval == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_stacks == NULL) {
+        sampled_stack_t *stacks = heap_caps_malloc(sizeof(sampled_stack_t) * NUM_STACKS, MALLOC_CAP_INTERNAL);
+        uint16_t *stack_slots = heap_caps_malloc(sizeof(uint16_t) * NUM_STACK_SLOTS, MALLOC_CAP_INTERNAL);
+        live_sample_t *live = heap_caps_malloc(sizeof(live_sample_t) * NUM_LIVE_SLOTS, MALLOC_CAP_INTERNAL);
+        if (stacks == NULL || stack_slots == NULL || live == NULL) {
+            heap_caps_free(stacks);
+            heap_caps_free(stack_slots);
+            heap_caps_free(live);
+            return ESP_ERR_NO_MEM;
+        }
+        portENTER_CRITICAL(&s_sampling_mux);
+        s_stacks = stacks;
+        s_stack_slots = stack_slots;
+        s_live = live;
+        portEXIT_CRITICAL(&s_sampling_mux);
+    }
+
+    portENTER_CRITICAL(&s_sampling_mux);
+    memset(s_stack_slots, 0, sizeof(uint16_t) * NUM_STACK_SLOTS);
+    memset(s_live, 0, sizeof(live_sample_t) * NUM_LIVE_SLOTS);
+    s_stack_count = 0;
+    s_live_count = 0;
+    s_total_samples = 0;
+    s_dropped_samples = 0;
+    s_untracked_samples = 0;
+
+    s_sample_interval = sample_interval;
+    s_random = esp_cpu_get_cycle_count() | 1;
+    for (int core = 0; core < SOC_CPU_CORES_NUM; core++) {
+        s_bytes_until_sample[core] = next_sample_countdown();
+    }
+    s_sampling = true;
+    portEXIT_CRITICAL(&s_sampling_mux);
+    return ESP_OK;
+}
+
+esp_err_t heap_trace_sampling_stop(void)
+{
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_sampling_mux);
+    if (!s_sampling) {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    s_sampling = false;
+    portEXIT_CRITICAL(&s_sampling_mux);
+    return ret;
+}
+
+size_t heap_trace_sampling_get_count(void)
+{
+    return s_stack_count;
+}
+
+esp_err_t heap_trace_sampling_get(size_t index, heap_trace_sample_t *sample)
+{
+    if (sample == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_sampling_mux);
+    if (index >= s_stack_count) {
+        ret = ESP_ERR_INVALID_ARG;
+    } else {
+        const sampled_stack_t *stack = &s_stacks[index];
+        memcpy(sample->alloced_by, stack->alloced_by, sizeof(void *) * STACK_DEPTH);
+        sample->alloc_count = stack->alloc_count;
+        sample->alloc_bytes = stack->alloc_bytes;
+        sample->inuse_count = stack->inuse_count;
+        sample->inuse_bytes = stack->inuse_bytes;
+    }
+    portEXIT_CRITICAL(&s_sampling_mux);
+    return ret;
+}
+
+esp_err_t heap_trace_sampling_summary(heap_trace_sampling_summary_t *summary)
+{
+    if (summary == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_sampling_mux);
+    summary->sample_interval = s_sample_interval;
+    summary->total_samples = s_total_samples;
+    summary->count = s_stack_count;
+    summary->capacity = NUM_STACKS;
+    summary->dropped_samples = s_dropped_samples;
+    summary->untracked_samples = s_untracked_samples;
+    portEXIT_CRITICAL(&s_sampling_mux);
+    return ESP_OK;
+}
+
+/* Estimate the bytes allocated from the samples, the same way as pprof */
+static size_t unsample_bytes(size_t count, size_t bytes, size_t sample_interval)
+{
+    if (count == 0 || bytes == 0) {
+        return 0;
+    }
+    double average = (double)bytes / count;
+    return (size_t)(bytes / (1.0 - exp(-average / sample_interval)));
+}
+
+/* Append the call stack to a line: leaf first separated by spaces for pprof, root first separated by ';' for
+   collapsed stacks. Frames which couldn't be read are skipped. */
+static int print_stack(char *line, size_t len, const heap_trace_sample_t *sample, bool collapsed)
+{
+    int pos = 0;
+    int frames = 0;
+    for (int i = 0; i < STACK_DEPTH; i++) {
+        void *pc = sample->alloced_by[collapsed ? STACK_DEPTH - 1 - i : i];
+        if (pc == NULL) {
+            continue;
+        }
+        const char *separator = collapsed ? (frames > 0 ? ";" : "") : " ";
+        pos += snprintf(line + pos, len - pos, "%s%p", separator, pc);
+        frames++;
+    }
+    if (frames == 0 && collapsed) {
+        pos += snprintf(line + pos, len - pos, "[unknown]");
+    }
+    return pos;
+}
+
+esp_err_t heap_trace_sampling_write(heap_trace_sampling_format_t format, heap_trace_sampling_write_t write, void *arg)
+{
+    if (write == NULL || format > HEAP_TRACE_SAMPLING_FORMAT_COLLAPSED_ALLOC) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char line[LINE_LEN];
+    heap_trace_sample_t sample;
+    size_t sample_interval = s_sample_interval;
+
+    if (format == HEAP_TRACE_SAMPLING_FORMAT_PPROF) {
+        heap_trace_sample_t total = { 0 };
+        for (size_t i = 0; heap_trace_sampling_get(i, &sample) == ESP_OK; i++) {
+            total.inuse_count += sample.inuse_count;
+            total.inuse_bytes += sample.inuse_bytes;
+            total.alloc_count += sample.alloc_count;
+            total.alloc_bytes += sample.alloc_bytes;
+        }
+        snprintf(line, sizeof(line), "heap profile: %u: %u [%u: %u] @ heap_v2/%u\n",
+                 total.inuse_count, total.inuse_bytes, total.alloc_count, total.alloc_bytes, sample_interval);
+        write(arg, line);
+    }
+
+    // the callback is called without the lock held, so the call stacks are copied one at a time
+    for (size_t i = 0; heap_trace_sampling_get(i, &sample) == ESP_OK; i++) {
+        int pos;
+        if (format == HEAP_TRACE_SAMPLING_FORMAT_PPROF) {
+            pos = snprintf(line, sizeof(line), "%u: %u [%u: %u] @",
+                           sample.inuse_count, sample.inuse_bytes, sample.alloc_count, sample.alloc_bytes);
+            pos += print_stack(line + pos, sizeof(line) - pos, &sample, false);
+        } else {
+            size_t bytes;
+            if (format == HEAP_TRACE_SAMPLING_FORMAT_COLLAPSED_INUSE) {
+                bytes = unsample_bytes(sample.inuse_count, sample.inuse_bytes, sample_interval);
+            } else {
+                bytes = unsample_bytes(sample.alloc_count, sample.alloc_bytes, sample_interval);
+            }
+            if (bytes == 0) {
+                continue;
+            }
+            pos = print_stack(line, sizeof(line), &sample, true);
+            pos += snprintf(line + pos, sizeof(line) - pos, " %u", bytes);
+        }
+        snprintf(line + pos, sizeof(line) - pos, "\n");
+        write(arg, line);
+    }
+    return ESP_OK;
+}
+
+static void write_stdout(void *arg, const char *line)
+{
+    fputs(line, stdout);
+}
+
+void heap_trace_sampling_dump(heap_trace_sampling_format_t format)
+{
+    heap_trace_sampling_write(format, write_stdout, NULL);
+}
@@ -422,6 +422,12 @@ static void heap_trace_dump_base(bool internal_ram, bool psram)
     portEXIT_CRITICAL(&trace_mux);
 }
 
+/* Used by heap_trace.inc to skip reading the call stack when nothing is recorded */
+static HEAP_IRAM_ATTR bool is_tracing(void)
+{
+    return tracing;
+}
+
 /* Add a new allocation to the heap trace records */
 static HEAP_IRAM_ATTR void record_allocation(const heap_trace_record_t *r_allocation)
 {
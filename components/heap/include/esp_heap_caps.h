@@ -431,6 +431,18 @@ void heap_caps_dump(uint32_t caps);
  */
 void heap_caps_dump_all(void);
 
+/**
+ * @brief Return the memory held by the allocation caches to the heaps
+ *
+ * When CONFIG_HEAP_ALLOC_CACHE is enabled, small freed blocks are kept in a cache
+ * for each CPU core and are reported as allocated until they are returned to the heaps.
+ * Call this function before measuring the free heap size or looking for leaks.
+ *
+ * @note The caches are also flushed when an allocation fails. If CONFIG_HEAP_ALLOC_CACHE
+ *       is disabled, this function does nothing.
+ */
+void heap_caps_alloc_cache_flush(void);
+
 /**
  * @brief Return the size that a particular pointer was allocated with.
  *
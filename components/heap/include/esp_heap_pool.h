@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Handle to a pool of fixed-size objects
+ */
+typedef struct heap_pool *heap_pool_handle_t;
+
+/**
+ * @brief Structure to access pool metadata via heap_pool_get_info
+ */
+typedef struct {
+    size_t object_size;             ///< Size of each object in the pool, as passed to heap_pool_create()
+    size_t slab_count;              ///< Number of slabs allocated from the heap
+    size_t total_bytes;             ///< Total size of the slabs, including the pool metadata and the heap poisoning overhead
+    size_t total_objects;           ///< Number of objects which fit in the slabs
+    size_t allocated_objects;       ///< Number of objects currently allocated from the pool
+    size_t free_objects;            ///< Number of objects which can be allocated without allocating another slab
+    size_t peak_allocated_objects;  ///< Highest number of objects allocated at the same time
+} heap_pool_info_t;
+
+/**
+ * @brief Create a pool of fixed-size objects
+ *
+ * The pool allocates memory from the heap in slabs of objects_per_slab objects, using
+ * heap_caps_malloc() with the given capabilities, and keeps its free objects in a list.
+ * Allocating and freeing an object is constant time and has no per-object metadata,
+ * except for the heap poisoning structures if heap poisoning is enabled.
+ *
+ * The slabs stay allocated until the pool is deleted. They are reported as allocated blocks
+ * of their heap by heap_caps_get_info(), and the pools are listed by heap_caps_print_heap_info().
+ *
+ * @param object_size Size of each object, in bytes
+ * @param objects_per_slab Number of objects allocated from the heap at once
+ * @param caps Bitwise OR of MALLOC_CAP_* flags indicating the type of memory for the slabs
+ *
+ * @return Handle to the pool, or NULL if the arguments are invalid or there isn't enough memory.
+ */
+heap_pool_handle_t heap_pool_create(size_t object_size, size_t objects_per_slab, uint32_t caps);
+
+/**
+ * @brief Delete a pool and free all its slabs
+ *
+ * @param pool Handle to the pool. Objects allocated from the pool must not be used anymore.
+ */
+void heap_pool_delete(heap_pool_handle_t pool);
+
+/**
+ * @brief Allocate an object from a pool
+ *
+ * A new slab is allocated from the heap if the pool has no free object.
+ *
+ * @param pool Handle to the pool
+ *
+ * @return Pointer to the object, aligned to 4 bytes, or NULL if the pool has no free object
+ *         and a new slab can't be allocated.
+ */
+void *heap_pool_alloc(heap_pool_handle_t pool);
+
+/**
+ * @brief Return an object to its pool
+ *
+ * @param pool Handle to the pool
+ * @param ptr NULL, or a pointer previously returned by heap_pool_alloc() for the same pool
+ *
+ * @note If heap poisoning is enabled, the app will crash with an assertion failure if the
+ *       poisoning structures of the object are corrupt.
+ */
+void heap_pool_free(heap_pool_handle_t pool, void *ptr);
+
+/**
+ * @brief Return metadata about a pool
+ *
+ * @param pool Handle to the pool
+ * @param info Pointer to a structure to fill with the pool metadata
+ */
+void heap_pool_get_info(heap_pool_handle_t pool, heap_pool_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
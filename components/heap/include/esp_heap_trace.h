@@ -182,6 +182,156 @@ void heap_trace_dump_caps(const uint32_t caps);
  */
 esp_err_t heap_trace_summary(heap_trace_summary_t *summary);
 
+/**
+ * @brief Call stack of sampled allocations and the statistics of the samples taken from it.
+ *
+ * The counts are raw numbers of samples. Each allocation of N bytes is sampled with a
+ * probability of 1 - exp(-N / sample_interval), so the actual figures can be estimated by
+ * multiplying both the count and the bytes by 1 / (1 - exp(-(bytes / count) / sample_interval)).
+ */
+typedef struct {
+    void *alloced_by[CONFIG_HEAP_TRACING_STACK_DEPTH]; ///< Call stack of the caller which allocated the memory.
+    size_t alloc_count;  ///< Number of sampled allocations made from this call stack
+    size_t alloc_bytes;  ///< Total size of the sampled allocations
+    size_t inuse_count;  ///< Number of sampled allocations which are not freed yet
+    size_t inuse_bytes;  ///< Total size of the sampled allocations which are not freed yet
+} heap_trace_sample_t;
+
+/**
+ * @brief Stores information about the state of the sampling heap profiler.
+ */
+typedef struct {
+    size_t sample_interval;   ///< Average number of bytes allocated between two samples
+    size_t total_samples;     ///< Number of allocations sampled since heap_trace_sampling_start() was called
+    size_t count;             ///< Number of distinct call stacks recorded
+    size_t capacity;          ///< Maximum number of distinct call stacks (CONFIG_HEAP_TRACE_SAMPLING_STACKS)
+    size_t dropped_samples;   ///< Samples which were lost because all the call stack entries were in use
+    size_t untracked_samples; ///< Samples whose free could not be tracked, they are only counted as allocated
+} heap_trace_sampling_summary_t;
+
+/**
+ * @brief Output formats of the sampling heap profiler
+ */
+typedef enum {
+    HEAP_TRACE_SAMPLING_FORMAT_PPROF,           ///< Text heap profile ("heap_v2" format) which can be read by pprof, with the raw sample counts
+    HEAP_TRACE_SAMPLING_FORMAT_COLLAPSED_INUSE, ///< One "frame;frame;... bytes" line per call stack, with the estimated bytes in use (for flame graphs)
+    HEAP_TRACE_SAMPLING_FORMAT_COLLAPSED_ALLOC, ///< One "frame;frame;... bytes" line per call stack, with the estimated bytes allocated (for flame graphs)
+} heap_trace_sampling_format_t;
+
+/**
+ * @brief Callback used to output the lines of a sampled heap profile
+ *
+ * @param arg Argument passed to heap_trace_sampling_write()
+ * @param line Null-terminated line of the profile, including its '\n' terminator
+ */
+typedef void (*heap_trace_sampling_write_t)(void *arg, const char *line);
+
+/**
+ * @brief Start the sampling heap profiler.
+ *
+ * Instead of recording every allocation, the sampling heap profiler records on average one allocation
+ * per sample_interval bytes allocated, and aggregates the samples by the call stack of the caller which
+ * made the allocation. The call stack is only read for sampled allocations, unsampled allocations
+ * only update a byte counter, and frees look up their address in the table of live samples. This
+ * keeps the overhead low enough to leave the profiler running in production firmware.
+ *
+ * The profiler runs independently of heap_trace_start(). The heap_trace_sampling_* functions are only
+ * available if CONFIG_HEAP_TRACE_SAMPLING is enabled.
+ *
+ * @note Calling this function while the profiler is running discards the samples and starts again.
+ *
+ * @param sample_interval Average number of bytes allocated between two samples. Larger values lower
+ *                        the overhead and the accuracy of the profile.
+ * @return
+ * - ESP_ERR_INVALID_ARG sample_interval is 0.
+ * - ESP_ERR_NO_MEM There is not enough internal memory for the profiler tables.
+ * - ESP_OK Profiler is started.
+ */
+esp_err_t heap_trace_sampling_start(size_t sample_interval);
+
+/**
+ * @brief Stop taking samples.
+ *
+ * The frees of the allocations which were sampled are still tracked, so the in-use
+ * statistics stay up to date until heap_trace_sampling_start() is called again.
+ *
+ * @return
+ * - ESP_ERR_INVALID_STATE The profiler was not running.
+ * - ESP_OK Profiler is stopped.
+ */
+esp_err_t heap_trace_sampling_stop(void);
+
+/**
+ * @brief Return the number of distinct call stacks recorded by the sampling heap profiler
+ *
+ * It is safe to call this function while the profiler is running.
+ */
+size_t heap_trace_sampling_get_count(void);
+
+/**
+ * @brief Return the statistics of a call stack recorded by the sampling heap profiler
+ *
+ * @note It is safe to call this function while the profiler is running. New call stacks are added at the end.
+ *
+ * @param index Index (zero-based) of the call stack to return.
+ * @param[out] sample Where the call stack and its statistics will be copied.
+ * @return
+ * - ESP_ERR_INVALID_ARG sample is NULL, or index is out of bounds.
+ * - ESP_OK Call stack returned successfully.
+ */
+esp_err_t heap_trace_sampling_get(size_t index, heap_trace_sample_t *sample);
+
+/**
+ * @brief Get summary information about the sampling heap profiler
+ *
+ * @note It is safe to call this function while the profiler is running.
+ *
+ * @return
+ * - ESP_ERR_INVALID_ARG summary is NULL.
+ * - ESP_OK Summary returned successfully.
+ */
+esp_err_t heap_trace_sampling_summary(heap_trace_sampling_summary_t *summary);
+
+/**
+ * @brief Output the sampled heap profile line by line through a callback
+ *
+ * The call stacks are output as PC addresses, which can be decoded with the application ELF file
+ * (for example by pprof, or by addr2line before generating a flame graph).
+ *
+ * @note It is safe to call this function while the profiler is running. The callback is called
+ *       without any lock held, from the calling task.
+ *
+ * @param format Format of the profile
+ * @param write Callback called for each line of the profile
+ * @param arg Argument passed to the callback
+ * @return
+ * - ESP_ERR_INVALID_ARG write is NULL or format is invalid.
+ * - ESP_OK Profile was output.
+ */
+esp_err_t heap_trace_sampling_write(heap_trace_sampling_format_t format, heap_trace_sampling_write_t write, void *arg);
+
+/**
+ * @brief Dump the sampled heap profile to stdout
+ *
+ * @param format Format of the profile
+ */
+void heap_trace_sampling_dump(heap_trace_sampling_format_t format);
+
+/**
+ * @brief Send the sampled heap profile to the host
+ *
+ * Only available in host-based mode (CONFIG_HEAP_TRACING_TOHOST).
+ *
+ * The profile is sent as SystemView text messages of at most 100 characters, which must be
+ * concatenated on the host to get the lines of the profile back.
+ *
+ * @param format Format of the profile
+ * @return
+ * - ESP_ERR_INVALID_ARG format is invalid.
+ * - ESP_OK Profile was sent.
+ */
+esp_err_t heap_trace_sampling_dump_tohost(heap_trace_sampling_format_t format);
+
 #ifdef __cplusplus
 }
 #endif
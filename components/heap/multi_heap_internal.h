@@ -67,6 +67,21 @@ bool multi_heap_internal_check_block_poisoning(void *start, size_t size, bool is
 */
 void multi_heap_internal_poison_fill_region(void *start, size_t size, bool is_free);
 
+/* Functions used by the heap pools (heap_pool.c) to poison their objects like multi_heap poisons its blocks.
+   An object slot is multi_heap_internal_poison_overhead() bytes bigger than the object.
+*/
+size_t multi_heap_internal_poison_overhead(void);
+
+/* Add the head & tail poison structures of an object of 'size' bytes, in a slot starting at 'start'.
+   Returns the pointer to the object.
+*/
+void *multi_heap_internal_poison_object(void *start, size_t size);
+
+/* Check the poison structures of an object 'p' of 'size' bytes and fill its slot with the free pattern.
+   Returns the start of the slot, or NULL if the poison structures are corrupt.
+*/
+void *multi_heap_internal_unpoison_object(void *p, size_t size);
+
 /* Allow heap poisoning to lock/unlock the heap to avoid race conditions
    if multi_heap_check() is running concurrently.
 */
@@ -443,6 +443,35 @@ void multi_heap_internal_poison_fill_region(void *start, size_t size, bool is_fr
     memset(start, is_free ? FREE_FILL_PATTERN : MALLOC_FILL_PATTERN, size);
 }
 
+size_t multi_heap_internal_poison_overhead(void)
+{
+    return POISON_OVERHEAD;
+}
+
+void *multi_heap_internal_poison_object(void *start, size_t size)
+{
+    uint8_t *data = poison_allocated_region(start, size);
+#ifdef SLOW
+    /* check the object wasn't written to while it was free & swap for MALLOC_FILL_PATTERN */
+    bool ret = verify_fill_pattern(data, size, true, true, true);
+    assert( ret );
+#endif
+    return data;
+}
+
+void *multi_heap_internal_unpoison_object(void *p, size_t size)
+{
+    poison_head_t *head = verify_allocated_region(p, true);
+    if (head == NULL || head->alloc_size != size) {
+        return NULL;
+    }
+#ifdef SLOW
+    /* replace everything with FREE_FILL_PATTERN, including the poison head/tail */
+    memset(head, FREE_FILL_PATTERN, size + POISON_OVERHEAD);
+#endif
+    return head;
+}
+
 #else // !MULTI_HEAP_POISONING
 
 #ifdef MULTI_HEAP_POISONING_SLOW
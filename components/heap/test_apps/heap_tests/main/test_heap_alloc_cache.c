@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ Tests for the per-core caches of small free blocks (CONFIG_HEAP_ALLOC_CACHE).
+
+ The caches are per CPU core, the test task is expected to stay on the same core
+ between a free and the following allocation (the unity task is pinned to CPU0).
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+
+#if CONFIG_HEAP_ALLOC_CACHE
+
+#define INTERNAL_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+/* 34 and 36 bytes are in the same size class, with or without the block owner of task tracking */
+#define SMALL_SIZE 36
+#define SMALL_SIZE_SAME_CLASS 34
+
+TEST_CASE("alloc cache reuses freed blocks for the same size class", "[heap][alloc_cache]")
+{
+    heap_caps_alloc_cache_flush();
+
+    void *p = heap_caps_malloc(SMALL_SIZE, INTERNAL_CAPS);
+    TEST_ASSERT_NOT_NULL(p);
+    size_t free_allocated = heap_caps_get_free_size(INTERNAL_CAPS);
+
+    // the freed block stays allocated in the cache of this core
+    heap_caps_free(p);
+    TEST_ASSERT_EQUAL(free_allocated, heap_caps_get_free_size(INTERNAL_CAPS));
+
+    void *q = heap_caps_malloc(SMALL_SIZE_SAME_CLASS, INTERNAL_CAPS);
+    TEST_ASSERT_EQUAL_PTR(p, q);
+    TEST_ASSERT_EQUAL(free_allocated, heap_caps_get_free_size(INTERNAL_CAPS));
+
+    // flushing returns a cached block to its heap
+    heap_caps_free(q);
+    heap_caps_alloc_cache_flush();
+    TEST_ASSERT_GREATER_THAN(free_allocated, heap_caps_get_free_size(INTERNAL_CAPS));
+}
+
+TEST_CASE("alloc cache doesn't hand out blocks for caps their heap lacks", "[heap][alloc_cache]")
+{
+    heap_caps_alloc_cache_flush();
+
+    void *p = heap_caps_malloc(SMALL_SIZE, INTERNAL_CAPS);
+    TEST_ASSERT_NOT_NULL(p);
+    heap_caps_free(p);
+
+    // the cached block is in internal memory, it must not be returned for external memory
+    void *ext = heap_caps_malloc(SMALL_SIZE, MALLOC_CAP_SPIRAM);
+    TEST_ASSERT(ext != p);
+    if (ext != NULL) {
+        TEST_ASSERT(esp_ptr_external_ram(ext));
+        heap_caps_free(ext);
+    }
+
+    // the block is still in the cache
+    void *q = heap_caps_malloc(SMALL_SIZE, INTERNAL_CAPS);
+    TEST_ASSERT_EQUAL_PTR(p, q);
+    heap_caps_free(q);
+    heap_caps_alloc_cache_flush();
+}
+
+/* Size of the small blocks filling up the internal memory, and length of the run of adjacent blocks freed into
+   the cache. The run must fit in the cache. */
+#define FILL_SIZE 60
+#define RUN_LENGTH 16
+#define RUN_ALLOC_SIZE 512
+
+TEST_CASE("alloc cache is flushed when an allocation fails", "[heap][alloc_cache]")
+{
+    heap_caps_alloc_cache_flush();
+
+    // fill the internal memory with small blocks, each linked to the block allocated before it
+    void **last = NULL;
+    size_t count = 0;
+    void **p;
+    while ((p = heap_caps_malloc(FILL_SIZE, INTERNAL_CAPS)) != NULL) {
+        *p = last;
+        last = p;
+        count++;
+    }
+    printf("allocated %u blocks of %d bytes\n", count, FILL_SIZE);
+    TEST_ASSERT_NULL(heap_caps_malloc(RUN_ALLOC_SIZE, INTERNAL_CAPS));
+
+    // find a run of blocks allocated one after the other at the same distance, they are adjacent in memory
+    void **run = NULL;
+    int run_length = 0;
+    intptr_t run_step = 0;
+    for (void **b = last; b != NULL && *b != NULL && run_length < RUN_LENGTH; b = *b) {
+        intptr_t step = (intptr_t)b - (intptr_t)*b;
+        if (step > 0 && step < 2 * FILL_SIZE && step == run_step) {
+            run_length++;
+        } else {
+            run = b;
+            run_step = step;
+            run_length = 1;
+        }
+    }
+    TEST_ASSERT_EQUAL(RUN_LENGTH, run_length);
+    intptr_t run_end = (intptr_t)run + FILL_SIZE;
+    intptr_t run_start = run_end - (RUN_LENGTH + 1) * run_step;
+
+    // free the run (RUN_LENGTH + 1 blocks) into the cache, it only fits the allocation once it's flushed
+    size_t free_full = heap_caps_get_free_size(INTERNAL_CAPS);
+    void **b = run;
+    void **after_run = NULL;
+    for (void **prev = NULL, **cur = last; cur != NULL; cur = *cur) {
+        if (cur == run) {
+            after_run = prev;
+            break;
+        }
+        prev = cur;
+    }
+    for (int i = 0; i <= RUN_LENGTH; i++) {
+        void **next = *b;
+        heap_caps_free(b);
+        b = next;
+    }
+    if (after_run != NULL) {
+        *after_run = b;
+    } else {
+        last = b;
+    }
+    TEST_ASSERT_EQUAL(free_full, heap_caps_get_free_size(INTERNAL_CAPS));
+
+    void *big = heap_caps_malloc(RUN_ALLOC_SIZE, INTERNAL_CAPS);
+    TEST_ASSERT_NOT_NULL(big);
+    TEST_ASSERT((intptr_t)big >= run_start && (intptr_t)big + RUN_ALLOC_SIZE <= run_end);
+    heap_caps_free(big);
+
+    while (last != NULL) {
+        void **next = *last;
+        heap_caps_free(last);
+        last = next;
+    }
+    heap_caps_alloc_cache_flush();
+}
+
+#endif // CONFIG_HEAP_ALLOC_CACHE
@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ Tests for the fixed-size object pools.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_pool.h"
+#include "esp_memory_utils.h"
+
+#define OBJECT_SIZE 70
+#define OBJECTS_PER_SLAB 8
+
+TEST_CASE("heap pool allocates objects in slabs and reuses them", "[heap][pool]")
+{
+    heap_pool_handle_t pool = heap_pool_create(OBJECT_SIZE, OBJECTS_PER_SLAB, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(pool);
+
+    heap_pool_info_t info;
+    heap_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(OBJECT_SIZE, info.object_size);
+    TEST_ASSERT_EQUAL(0, info.slab_count);
+    TEST_ASSERT_EQUAL(0, info.total_objects);
+
+    uint8_t *objects[OBJECTS_PER_SLAB + 1];
+    for (int i = 0; i < OBJECTS_PER_SLAB + 1; i++) {
+        objects[i] = heap_pool_alloc(pool);
+        TEST_ASSERT_NOT_NULL(objects[i]);
+        TEST_ASSERT(esp_ptr_internal(objects[i]));
+        TEST_ASSERT_EQUAL(0, (intptr_t)objects[i] % 4);
+        memset(objects[i], i, OBJECT_SIZE);
+    }
+    for (int i = 0; i < OBJECTS_PER_SLAB + 1; i++) {
+        for (int j = 0; j < OBJECT_SIZE; j++) {
+            TEST_ASSERT_EQUAL(i, objects[i][j]);
+        }
+    }
+
+    heap_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(2, info.slab_count);
+    TEST_ASSERT_EQUAL(2 * OBJECTS_PER_SLAB, info.total_objects);
+    TEST_ASSERT_EQUAL(OBJECTS_PER_SLAB + 1, info.allocated_objects);
+    TEST_ASSERT_EQUAL(OBJECTS_PER_SLAB - 1, info.free_objects);
+    TEST_ASSERT_EQUAL(OBJECTS_PER_SLAB + 1, info.peak_allocated_objects);
+    TEST_ASSERT_GREATER_OR_EQUAL(2 * OBJECTS_PER_SLAB * OBJECT_SIZE, info.total_bytes);
+
+    heap_caps_print_heap_info(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+    // a freed object is handed out again without allocating another slab
+    heap_pool_free(pool, objects[3]);
+    uint8_t *p = heap_pool_alloc(pool);
+    TEST_ASSERT_EQUAL_PTR(objects[3], p);
+
+    for (int i = 0; i < OBJECTS_PER_SLAB + 1; i++) {
+        heap_pool_free(pool, objects[i]);
+    }
+    heap_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(2, info.slab_count);
+    TEST_ASSERT_EQUAL(0, info.allocated_objects);
+    TEST_ASSERT_EQUAL(OBJECTS_PER_SLAB + 1, info.peak_allocated_objects);
+
+    heap_pool_delete(pool);
+}
+
+TEST_CASE("heap pool creation checks its arguments", "[heap][pool]")
+{
+    TEST_ASSERT_NULL(heap_pool_create(0, OBJECTS_PER_SLAB, MALLOC_CAP_8BIT));
+    TEST_ASSERT_NULL(heap_pool_create(OBJECT_SIZE, 0, MALLOC_CAP_8BIT));
+    TEST_ASSERT_NULL(heap_pool_create(SIZE_MAX / 2, OBJECTS_PER_SLAB, MALLOC_CAP_8BIT));
+
+#ifndef CONFIG_HEAP_ABORT_WHEN_ALLOCATION_FAILS
+    // the pool is created, but the first slab can't be allocated
+    heap_pool_handle_t pool = heap_pool_create(OBJECT_SIZE, OBJECTS_PER_SLAB, MALLOC_CAP_INVALID);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_NULL(heap_pool_alloc(pool));
+    heap_pool_delete(pool);
+#endif
+}
+
+#if CONFIG_HEAP_POISONING_COMPREHENSIVE
+TEST_CASE("heap pool objects are poisoned like heap blocks", "[heap][pool]")
+{
+    heap_pool_handle_t pool = heap_pool_create(OBJECT_SIZE, OBJECTS_PER_SLAB, MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(pool);
+
+    uint8_t *p = heap_pool_alloc(pool);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0xce, p, OBJECT_SIZE);
+
+    heap_pool_free(pool, p);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0xfe, p, OBJECT_SIZE);
+
+    heap_pool_delete(pool);
+}
+#endif
@@ -205,6 +205,64 @@ TEST_CASE("check for summary value validity", "[heap-trace]") {
     heap_trace_stop();
 }
 
+#ifdef CONFIG_HEAP_TRACE_SAMPLING
+static void append_line(void *arg, const char *line)
+{
+    strlcat((char *)arg, line, 1024);
+}
+
+TEST_CASE("sampling heap profiler aggregates allocations by call stack", "[heap-trace]")
+{
+    const size_t alloc_size = 1234;
+    const size_t N = 10;
+    void *ptrs[N];
+
+    // an interval of 1 byte samples every allocation
+    TEST_ESP_OK(heap_trace_sampling_start(1));
+    for (int i = 0; i < N; i++) {
+        ptrs[i] = heap_caps_malloc(alloc_size, MALLOC_CAP_INTERNAL);
+        TEST_ASSERT_NOT_NULL(ptrs[i]);
+    }
+    for (int i = 0; i < N / 2; i++) {
+        heap_caps_free(ptrs[i]);
+    }
+    TEST_ESP_OK(heap_trace_sampling_stop());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, heap_trace_sampling_stop());
+
+    // frees are still tracked when the profiler is stopped
+    for (int i = N / 2; i < N; i++) {
+        heap_caps_free(ptrs[i]);
+    }
+
+    bool found = false;
+    for (int i = 0; i < heap_trace_sampling_get_count(); i++) {
+        heap_trace_sample_t sample;
+        TEST_ESP_OK(heap_trace_sampling_get(i, &sample));
+        if (sample.alloc_count >= N && sample.alloc_bytes >= N * alloc_size) {
+            found = true;
+            TEST_ASSERT(sample.inuse_bytes < sample.alloc_bytes);
+        }
+    }
+    TEST_ASSERT(found);
+
+    heap_trace_sampling_summary_t summary;
+    TEST_ESP_OK(heap_trace_sampling_summary(&summary));
+    TEST_ASSERT_EQUAL(1, summary.sample_interval);
+    TEST_ASSERT(summary.total_samples >= N);
+    TEST_ASSERT_EQUAL(heap_trace_sampling_get_count(), summary.count);
+    TEST_ASSERT_EQUAL(0, summary.dropped_samples);
+
+    static char profile[1024];
+    profile[0] = '\0';
+    TEST_ESP_OK(heap_trace_sampling_write(HEAP_TRACE_SAMPLING_FORMAT_PPROF, append_line, profile));
+    printf("%s", profile);
+    TEST_ASSERT_EQUAL(0, strncmp(profile, "heap profile: ", strlen("heap profile: ")));
+    TEST_ASSERT_NOT_NULL(strstr(profile, "@ heap_v2/1\n"));
+
+    heap_trace_sampling_dump(HEAP_TRACE_SAMPLING_FORMAT_COLLAPSED_ALLOC);
+}
+#endif // CONFIG_HEAP_TRACE_SAMPLING
+
 #ifdef CONFIG_SPIRAM
 void* allocate_pointer(uint32_t caps)
 {
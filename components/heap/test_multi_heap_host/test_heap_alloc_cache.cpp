@@ -0,0 +1,216 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "catch.hpp"
+#include "multi_heap.h"
+
+#define CONFIG_HEAP_ALLOC_CACHE_MAX_SIZE 128
+#define CONFIG_HEAP_ALLOC_CACHE_SIZE 2048
+#include "../heap_alloc_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+TEST_CASE("heap_alloc_cache respects size classes, caps and size limit", "[heap_alloc_cache]")
+{
+    uint8_t heapdata[8 * 1024];
+    multi_heap_handle_t heap = multi_heap_register(heapdata, sizeof(heapdata));
+    heap_alloc_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+
+    void *p = multi_heap_malloc(heap, 32);
+    REQUIRE(p != NULL);
+    size_t block_size = multi_heap_get_allocated_size(heap, p);
+    REQUIRE(heap_alloc_cache_put(&cache, p, block_size, 0x3));
+
+    // A block is handed out for any size of its class, if its heap has the requested caps
+    REQUIRE(heap_alloc_cache_get(&cache, 32, 0x4) == NULL);
+    REQUIRE(heap_alloc_cache_get(&cache, 16, 0x1) == NULL);
+    REQUIRE(heap_alloc_cache_get(&cache, 25, 0x1) == p);
+    REQUIRE(cache.size == 0);
+    REQUIRE(heap_alloc_cache_get(&cache, 25, 0x1) == NULL);
+
+    // Blocks bigger than the largest class are not cached
+    void *big = multi_heap_malloc(heap, CONFIG_HEAP_ALLOC_CACHE_MAX_SIZE + HEAP_ALLOC_CACHE_CLASS_SIZE);
+    REQUIRE(big != NULL);
+    REQUIRE_FALSE(heap_alloc_cache_put(&cache, big, multi_heap_get_allocated_size(heap, big), 0x3));
+    multi_heap_free(heap, big);
+
+    // The cache holds at most CONFIG_HEAP_ALLOC_CACHE_SIZE bytes
+    size_t cached = 0;
+    std::vector<void *> blocks;
+    while (true) {
+        void *block = multi_heap_malloc(heap, 64);
+        REQUIRE(block != NULL);
+        blocks.push_back(block);
+        if (!heap_alloc_cache_put(&cache, block, multi_heap_get_allocated_size(heap, block), 0x1)) {
+            break;
+        }
+        cached++;
+    }
+    REQUIRE(cached == CONFIG_HEAP_ALLOC_CACHE_SIZE / 64);
+    REQUIRE(cache.size == CONFIG_HEAP_ALLOC_CACHE_SIZE);
+    multi_heap_free(heap, blocks.back());
+
+    size_t popped = 0;
+    void *block;
+    while ((block = heap_alloc_cache_pop(&cache)) != NULL) {
+        multi_heap_free(heap, block);
+        popped++;
+    }
+    REQUIRE(popped == cached);
+    REQUIRE(cache.size == 0);
+
+    multi_heap_free(heap, p);
+    multi_heap_info_t info;
+    multi_heap_get_info(heap, &info);
+    REQUIRE(info.allocated_blocks == 0);
+}
+
+/* multi_heap doesn't take any lock on the host, so the benchmark puts a mutex around it which stands in for
+   MULTI_HEAP_LOCK(), and counts how many times it is taken. Each thread stands in for a CPU core and has
+   its own cache with its own (uncontended) lock, like the caches in heap_caps_base.c.
+*/
+namespace {
+
+const uint32_t BENCH_CAPS = 0x1;
+const int BENCH_THREADS = 4;
+const int BENCH_ITERATIONS = 200000;
+const int BENCH_SLOTS = 16;
+
+struct locked_heap {
+    multi_heap_handle_t heap;
+    std::mutex lock;
+    size_t lock_count;
+};
+
+struct core_cache {
+    std::mutex lock;
+    heap_alloc_cache_t cache;
+};
+
+void *bench_malloc(locked_heap *heap, core_cache *cache, size_t size)
+{
+    if (cache != NULL) {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        void *p = heap_alloc_cache_get(&cache->cache, size, BENCH_CAPS);
+        if (p != NULL) {
+            return p;
+        }
+    }
+    std::lock_guard<std::mutex> guard(heap->lock);
+    heap->lock_count++;
+    return multi_heap_malloc(heap->heap, cache != NULL ? HEAP_ALLOC_CACHE_ROUND_SIZE(size) : size);
+}
+
+void bench_free(locked_heap *heap, core_cache *cache, void *p)
+{
+    if (cache != NULL) {
+        size_t block_size = multi_heap_get_allocated_size(heap->heap, p);
+        std::lock_guard<std::mutex> guard(cache->lock);
+        if (heap_alloc_cache_put(&cache->cache, p, block_size, BENCH_CAPS)) {
+            return;
+        }
+    }
+    std::lock_guard<std::mutex> guard(heap->lock);
+    heap->lock_count++;
+    multi_heap_free(heap->heap, p);
+}
+
+/* Small objects are usually allocated with a handful of sizes (pbuf headers, cJSON nodes, etc.) */
+const size_t bench_sizes[] = { 12, 16, 20, 32, 40, 64, 100, 128 };
+
+/* Replace random blocks with blocks of random small sizes */
+void bench_thread(locked_heap *heap, core_cache *cache, uint32_t seed, bool *failed)
+{
+    void *slots[BENCH_SLOTS] = {};
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        seed = seed * 1103515245 + 12345;
+        int slot = (seed >> 16) % BENCH_SLOTS;
+        size_t size = bench_sizes[(seed >> 8) % (sizeof(bench_sizes) / sizeof(bench_sizes[0]))];
+
+        if (slots[slot] != NULL) {
+            bench_free(heap, cache, slots[slot]);
+        }
+        slots[slot] = bench_malloc(heap, cache, size);
+        if (slots[slot] == NULL) {
+            *failed = true;
+            break;
+        }
+        memset(slots[slot], i, size);
+    }
+
+    for (int slot = 0; slot < BENCH_SLOTS; slot++) {
+        if (slots[slot] != NULL) {
+            bench_free(heap, cache, slots[slot]);
+        }
+    }
+}
+
+struct bench_result {
+    size_t lock_count;
+    double seconds;
+};
+
+bench_result run_bench(void *heapdata, size_t heapsize, bool use_cache)
+{
+    locked_heap heap;
+    heap.heap = multi_heap_register(heapdata, heapsize);
+    heap.lock_count = 0;
+    REQUIRE(heap.heap != NULL);
+    size_t free_before = multi_heap_free_size(heap.heap);
+
+    core_cache caches[BENCH_THREADS];
+    for (int i = 0; i < BENCH_THREADS; i++) {
+        memset(&caches[i].cache, 0, sizeof(caches[i].cache));
+    }
+
+    bool failed[BENCH_THREADS] = {};
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_THREADS; i++) {
+        threads.emplace_back(bench_thread, &heap, use_cache ? &caches[i] : nullptr, 1 + i, &failed[i]);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (int i = 0; i < BENCH_THREADS; i++) {
+        REQUIRE_FALSE(failed[i]);
+        void *p;
+        while ((p = heap_alloc_cache_pop(&caches[i].cache)) != NULL) {
+            multi_heap_free(heap.heap, p);
+        }
+    }
+    REQUIRE(multi_heap_free_size(heap.heap) == free_before);
+
+    return { heap.lock_count, elapsed.count() };
+}
+
+} // namespace
+
+TEST_CASE("heap_alloc_cache removes heap lock contention between threads", "[heap_alloc_cache][perf]")
+{
+    static uint8_t heapdata[64 * 1024];
+
+    bench_result locked = run_bench(heapdata, sizeof(heapdata), false);
+    bench_result cached = run_bench(heapdata, sizeof(heapdata), true);
+
+    size_t ops = 2 * (size_t)BENCH_THREADS * BENCH_ITERATIONS;
+    printf("%d threads, %zu allocations and frees of %zu to %zu bytes\n", BENCH_THREADS, ops, bench_sizes[0], bench_sizes[sizeof(bench_sizes) / sizeof(bench_sizes[0]) - 1]);
+    printf("%-10s | %15s | %10s | %10s\n", "Cache", "Heap lock taken", "Time (ms)", "Mops/s");
+    printf("%-10s | %15zu | %10.1f | %10.2f\n", "none", locked.lock_count, locked.seconds * 1000, ops / locked.seconds / 1e6);
+    printf("%-10s | %15zu | %10.1f | %10.2f\n", "per thread", cached.lock_count, cached.seconds * 1000, ops / cached.seconds / 1e6);
+
+    REQUIRE(locked.lock_count >= ops);
+    REQUIRE(cached.lock_count * 10 < locked.lock_count);
+}
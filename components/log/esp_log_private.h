@@ -7,6 +7,8 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdarg.h>
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -16,6 +18,15 @@ void esp_log_impl_lock(void);
 bool esp_log_impl_lock_timeout(void);
 void esp_log_impl_unlock(void);
 
+#if CONFIG_LOG_DEFERRED
+/* Stores the message in the deferred log buffer, returns false if it has to be printed by the caller */
+bool esp_log_deferred_writev(const char *format, va_list args);
+/* Passes a formatted deferred message to the vprintf-like function */
+void esp_log_deferred_print(const char *format, ...);
+/* Starts draining the deferred log buffers in the background, if the platform supports it */
+void esp_log_impl_deferred_start(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,8 +7,16 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <cstdio>
+#include <climits>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
 #include <regex>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include "esp_log.h"
 
 #include <catch2/catch_test_macros.hpp>
@@ -303,3 +311,331 @@ TEST_CASE("changing early log level")
     ESP_EARLY_LOGI(TEST_TAG, "must indeed be printed");
     CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
 }
+
+ESP_LOG_TAG_DEFINE(s_desc_tag, "desc", ESP_LOG_VERBOSE);
+ESP_LOG_TAG_DEFINE(s_capped_tag, "capped", ESP_LOG_WARN);
+
+TEST_CASE("tag descriptor log level")
+{
+    PrintFixture fix(ESP_LOG_INFO);
+    const std::regex test_print("I \\([0-9]*\\) desc: must indeed be printed", std::regex::ECMAScript);
+
+    /* Set before the descriptor is registered by its first message */
+    esp_log_level_set("desc", ESP_LOG_WARN);
+    ESP_TAG_LOGI(s_desc_tag, "must not be printed");
+    CHECK(fix.get_print_buffer_string().size() == 0);
+    CHECK(s_desc_tag.level == ESP_LOG_WARN);
+
+    esp_log_level_set("desc", ESP_LOG_INFO);
+    ESP_TAG_LOGI(s_desc_tag, "must indeed be printed");
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+
+    fix.reset_buffer();
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    ESP_TAG_LOGW(s_desc_tag, "must not be printed");
+    CHECK(fix.get_print_buffer_string().size() == 0);
+
+    esp_log_level_set("*", ESP_LOG_INFO);
+    ESP_TAG_LOGI(s_desc_tag, "must indeed be printed");
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+    CHECK(esp_log_level_get("desc") == ESP_LOG_INFO);
+}
+
+TEST_CASE("tag descriptor maximum level removes messages at compile time")
+{
+    PrintFixture fix(ESP_LOG_VERBOSE);
+    int evaluated = 0;
+
+    ESP_TAG_LOGI(s_capped_tag, "%d", ++evaluated);
+    ESP_TAG_LOGV(s_capped_tag, "%d", ++evaluated);
+    CHECK(evaluated == 0);
+    CHECK(fix.get_print_buffer_string().size() == 0);
+    /* Nothing has been logged with it yet */
+    CHECK(s_capped_tag.level == ESP_LOG_TAG_UNREGISTERED);
+
+    const std::regex test_print("W \\([0-9]*\\) capped: 1", std::regex::ECMAScript);
+    ESP_TAG_LOGW(s_capped_tag, "%d", ++evaluated);
+    CHECK(evaluated == 1);
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+}
+
+static const size_t BENCH_TAGS = 256;
+static string s_bench_names[BENCH_TAGS];
+static esp_log_tag_t s_bench_descs[BENCH_TAGS];
+
+static int discard_print(const char *format, va_list args)
+{
+    return 0;
+}
+
+/* Nanoseconds per message, each of the first tag_count tags logs in turn */
+template<typename LogFn>
+static double log_time(size_t tag_count, LogFn log_fn)
+{
+    const size_t MESSAGES = 50000;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < MESSAGES; ++i) {
+        log_fn(i % tag_count);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / MESSAGES;
+}
+
+TEST_CASE("tag descriptors compared to tag strings", "[perf]")
+{
+    vprintf_like_t old_vprintf = esp_log_set_vprintf(discard_print);
+    esp_log_level_set("*", ESP_LOG_INFO);
+    for (size_t i = 0; i < BENCH_TAGS; ++i) {
+        s_bench_names[i] = "bench" + to_string(i);
+        s_bench_descs[i] = { s_bench_names[i].c_str(), ESP_LOG_TAG_UNREGISTERED, nullptr };
+        /* Levels set per tag are kept in the list searched on cache misses */
+        esp_log_level_set(s_bench_names[i].c_str(), ESP_LOG_INFO);
+    }
+
+    printf("%6s %22s %22s %22s %22s\n", "tags", "string, skipped (ns)", "desc, skipped (ns)",
+           "string, printed (ns)", "desc, printed (ns)");
+    for (size_t tag_count : { (size_t)8, BENCH_TAGS }) {
+        double results[4];
+        for (int printed = 0; printed < 2; ++printed) {
+            const esp_log_level_t level = printed ? ESP_LOG_INFO : ESP_LOG_DEBUG;
+            results[printed * 2] = log_time(tag_count, [level](size_t i) {
+                ESP_LOG_LEVEL_LOCAL(level, s_bench_names[i].c_str(), "message %d", (int)i);
+            });
+            results[printed * 2 + 1] = log_time(tag_count, [level](size_t i) {
+                enum { desc_max_level = ESP_LOG_VERBOSE };
+                esp_log_tag_t &desc = s_bench_descs[i];
+                if (level == ESP_LOG_INFO) {
+                    ESP_TAG_LOGI(desc, "message %d", (int)i);
+                } else {
+                    ESP_TAG_LOGD(desc, "message %d", (int)i);
+                }
+            });
+        }
+        printf("%6zu %22.1f %22.1f %22.1f %22.1f\n", tag_count, results[0], results[1], results[2], results[3]);
+    }
+
+    esp_log_level_set("*", ESP_LOG_INFO);
+    esp_log_set_vprintf(old_vprintf);
+}
+
+/* Disables deferred mode again when a test case ends, even if it fails */
+struct DeferredMode {
+    DeferredMode()
+    {
+        esp_log_set_deferred(true);
+    }
+
+    ~DeferredMode()
+    {
+        esp_log_set_deferred(false);
+    }
+};
+
+static vector<string> s_captured;
+
+static int capture_print(const char *format, va_list args)
+{
+    char buf[512];
+    int ret = vsnprintf(buf, sizeof(buf), format, args);
+    s_captured.push_back(buf);
+    return ret;
+}
+
+static string without_timestamp(const string &message)
+{
+    return regex_replace(message, std::regex("^([EWIDV]) \\([0-9]*\\)"), "$1 ()");
+}
+
+TEST_CASE("deferred messages are printed like immediate ones")
+{
+    PrintFixture fix(ESP_LOG_VERBOSE);
+    const char raw[4] = { 'a', 'b', 'c', 'd' };
+    vector<function<void()>> messages = {
+        [] { ESP_LOGI(TEST_TAG, "plain text"); },
+        [] { esp_log_write(ESP_LOG_INFO, TEST_TAG, "%d %i %u %o %x %X %c %%|\n", -42, 7, 3000000000u, 8, 255, 0xabc, 'z'); },
+        [] { esp_log_write(ESP_LOG_INFO, TEST_TAG, "%ld %lu %lld %llx %jd %zu %td\n", -1L, ULONG_MAX, LLONG_MIN,
+                           0x123456789abcULL, INTMAX_MAX, sizeof(double), (ptrdiff_t) -3); },
+        [] { esp_log_write(ESP_LOG_INFO, TEST_TAG, "%hhu %hd %5.2f|%-12.3e|%g %a %+05d\n", 300, -5, 3.14159, 1e-7, 0.5, 1.0, 9); },
+        [] { esp_log_write(ESP_LOG_INFO, TEST_TAG, "%p %s %10s|%-6s|\n", (void *)0x1234, "literal", "right", "left"); },
+        [] { esp_log_write(ESP_LOG_INFO, TEST_TAG, "[%*d] [%-*d] [%.*f] [%*.*s]\n", 6, 42, 6, 42, 2, 1.23456, 8, 2, "xyz"); },
+        /* A negative width is a '-' flag, a negative precision is ignored */
+        [] { esp_log_write(ESP_LOG_INFO, TEST_TAG, "[%*d] [%.*d] [%.*s]\n", -6, 42, -1, 7, -1, "all"); },
+        /* Strings are copied, they may change before the message is printed */
+        [] {
+            char buf[16] = "before";
+            ESP_LOGW(TEST_TAG, "stack string %s", buf);
+            strcpy(buf, "after");
+        },
+        /* Only the characters within the precision are read */
+        [&raw] { esp_log_write(ESP_LOG_INFO, TEST_TAG, "%.*s|%.2s\n", 3, raw, raw); },
+    };
+
+    for (auto &message : messages) {
+        fix.reset_buffer();
+        message();
+        const string immediate = without_timestamp(fix.get_print_buffer_string());
+        CHECK(!immediate.empty());
+
+        fix.reset_buffer();
+        {
+            DeferredMode deferred;
+            message();
+            CHECK(fix.get_print_buffer_string().empty());
+            CHECK(esp_log_deferred_drain(SIZE_MAX) == 1);
+        }
+        CHECK(without_timestamp(fix.get_print_buffer_string()) == immediate);
+    }
+}
+
+TEST_CASE("deferred messages which can't be stored are printed immediately")
+{
+    PrintFixture fix(ESP_LOG_VERBOSE);
+    DeferredMode deferred;
+
+    esp_log_write(ESP_LOG_INFO, TEST_TAG, "%.1Lf\n", (long double)1.5);
+    CHECK(fix.get_print_buffer_string() == "1.5\n");
+
+    fix.reset_buffer();
+    esp_log_write(ESP_LOG_INFO, TEST_TAG, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n",
+                  1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17);
+    CHECK(fix.get_print_buffer_string() == "1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17\n");
+    CHECK(esp_log_deferred_drain(SIZE_MAX) == 0);
+
+    /* Long strings are cut to 127 characters */
+    fix.reset_buffer();
+    string long_str(300, 'x');
+    esp_log_write(ESP_LOG_INFO, TEST_TAG, "%s\n", long_str.c_str());
+    CHECK(fix.get_print_buffer_string().empty());
+    CHECK(esp_log_deferred_drain(SIZE_MAX) == 1);
+    CHECK(fix.get_print_buffer_string() == string(127, 'x') + "\n");
+}
+
+TEST_CASE("deferred messages are dropped when the buffer is full")
+{
+    const int MESSAGES = 10000;
+    BasicLogFixture fix(ESP_LOG_VERBOSE);
+    vprintf_like_t old_vprintf = esp_log_set_vprintf(capture_print);
+    s_captured.clear();
+    {
+        DeferredMode deferred;
+        for (int i = 0; i < MESSAGES; ++i) {
+            esp_log_write(ESP_LOG_INFO, TEST_TAG, "message %d\n", i);
+        }
+        size_t printed = esp_log_deferred_drain(SIZE_MAX);
+        CHECK(printed > 0);
+        CHECK(printed < MESSAGES);
+        REQUIRE(s_captured.size() == printed + 1);
+        for (size_t i = 0; i < printed; ++i) {
+            CHECK(s_captured[i] == "message " + to_string(i) + "\n");
+        }
+        CHECK(s_captured.back() == to_string(MESSAGES - printed) + " log messages dropped\n");
+
+        /* There is space again */
+        s_captured.clear();
+        esp_log_write(ESP_LOG_INFO, TEST_TAG, "message %d\n", MESSAGES);
+        CHECK(esp_log_deferred_drain(SIZE_MAX) == 1);
+        CHECK(s_captured == vector<string> { "message " + to_string(MESSAGES) + "\n" });
+    }
+    esp_log_set_vprintf(old_vprintf);
+}
+
+ESP_LOG_TAG_DEFINE(s_thread_tag, "thread", ESP_LOG_VERBOSE);
+
+TEST_CASE("deferred messages of concurrent threads are printed in order")
+{
+    const int THREADS = 4;
+    const int MESSAGES = 20000;
+    BasicLogFixture fix(ESP_LOG_VERBOSE);
+    vprintf_like_t old_vprintf = esp_log_set_vprintf(capture_print);
+    s_captured.clear();
+    {
+        DeferredMode deferred;
+        atomic<int> running(THREADS);
+        vector<thread> threads;
+        for (int t = 0; t < THREADS; ++t) {
+            threads.emplace_back([t, &running] {
+                for (int i = 0; i < MESSAGES; ++i) {
+                    ESP_TAG_LOGI(s_thread_tag, "%d %d", t, i);
+                }
+                running--;
+            });
+        }
+        while (running > 0) {
+            esp_log_deferred_drain(SIZE_MAX);
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        esp_log_deferred_drain(SIZE_MAX);
+    }
+    esp_log_set_vprintf(old_vprintf);
+
+    /* Messages of each thread are in order, none are lost without being counted */
+    const std::regex message_re("I \\([0-9]*\\) thread: ([0-9]+) ([0-9]+)\n", std::regex::ECMAScript);
+    const std::regex dropped_re("([0-9]+) log messages dropped\n", std::regex::ECMAScript);
+    int last[THREADS] = { -1, -1, -1, -1 };
+    int received = 0;
+    int dropped = 0;
+    for (const string &line : s_captured) {
+        std::smatch match;
+        if (regex_search(line, match, dropped_re)) {
+            dropped += stoi(match[1]);
+            continue;
+        }
+        REQUIRE(regex_search(line, match, message_re));
+        int t = stoi(match[1]);
+        int i = stoi(match[2]);
+        REQUIRE(i > last[t]);
+        last[t] = i;
+        received++;
+    }
+    CHECK(received > 0);
+    CHECK(received + dropped == THREADS * MESSAGES);
+}
+
+static int format_print(const char *format, va_list args)
+{
+    char buf[256];
+    return vsnprintf(buf, sizeof(buf), format, args);
+}
+
+ESP_LOG_TAG_DEFINE(s_bench_tag, "bench", ESP_LOG_VERBOSE);
+
+TEST_CASE("deferred logging compared to formatting in the caller", "[perf]")
+{
+    const int MESSAGES = 20000;
+    /* Well within the space of the buffer, the buffer is drained between batches */
+    const int BATCH = 16;
+    const char *ssid = "access-point";
+    vprintf_like_t old_vprintf = esp_log_set_vprintf(format_print);
+    esp_log_level_set("*", ESP_LOG_INFO);
+
+    auto log_batch = [ssid](int first) {
+        for (int i = first; i < first + BATCH; ++i) {
+            ESP_TAG_LOGI(s_bench_tag, "connected to %s, rssi %d, channel %u", ssid, -40 - i % 50, (unsigned)(i % 13));
+        }
+    };
+
+    std::chrono::duration<double, std::nano> text(0), caller(0), drain(0);
+    for (int i = 0; i < MESSAGES; i += BATCH) {
+        auto start = std::chrono::steady_clock::now();
+        log_batch(i);
+        text += std::chrono::steady_clock::now() - start;
+    }
+    {
+        DeferredMode deferred;
+        for (int i = 0; i < MESSAGES; i += BATCH) {
+            auto start = std::chrono::steady_clock::now();
+            log_batch(i);
+            auto logged = std::chrono::steady_clock::now();
+            CHECK(esp_log_deferred_drain(SIZE_MAX) == BATCH);
+            caller += logged - start;
+            drain += std::chrono::steady_clock::now() - logged;
+        }
+    }
+
+    printf("%18s %18s %18s\n", "text (ns)", "deferred (ns)", "drain (ns)");
+    printf("%18.1f %18.1f %18.1f\n", text.count() / MESSAGES, caller.count() / MESSAGES, drain.count() / MESSAGES);
+
+    esp_log_set_vprintf(old_vprintf);
+}
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -9,6 +9,8 @@
 
 #include <stdint.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <inttypes.h>
 #include "sdkconfig.h"
 #include "esp_rom_sys.h"
@@ -170,6 +172,80 @@ void esp_log_write(esp_log_level_t level, const char* tag, const char* format, .
  */
 void esp_log_writev(esp_log_level_t level, const char* tag, const char* format, va_list args);
 
+/**
+ * @brief Log tag descriptor
+ *
+ * A descriptor defined with ESP_LOG_TAG_DEFINE() keeps the level of its tag, so
+ * the ESP_TAG_LOGx macros check whether a message is printed with a single load
+ * instead of looking the tag string up in esp_log_write(). The descriptor is
+ * registered with the log library the first time a message is logged with it,
+ * and esp_log_level_set() keeps its level up to date from then on. Therefore
+ * descriptors must have static storage duration.
+ */
+typedef struct esp_log_tag {
+    const char *name;           /*!< Tag string, as passed to esp_log_level_set() */
+    uint8_t level;              /*!< Level of the tag, ESP_LOG_TAG_UNREGISTERED until the first message */
+    struct esp_log_tag *next;   /*!< Next registered descriptor */
+} esp_log_tag_t;
+
+/**
+ * @brief Write message into the log for a tag descriptor
+ *
+ * This function is not intended to be used directly. Instead, use one of
+ * ESP_TAG_LOGE, ESP_TAG_LOGW, ESP_TAG_LOGI, ESP_TAG_LOGD, ESP_TAG_LOGV macros.
+ *
+ * This function or these macros should not be used from an interrupt.
+ */
+void esp_log_tag_write(esp_log_tag_t *tag, esp_log_level_t level, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Write message into the log for a tag descriptor, va_list variant
+ * @see esp_log_tag_write()
+ */
+void esp_log_tag_writev(esp_log_tag_t *tag, esp_log_level_t level, const char *format, va_list args);
+
+#if defined(CONFIG_LOG_DEFERRED) || __DOXYGEN__
+
+/**
+ * @brief Enable or disable deferred logging
+ *
+ * In deferred mode, messages which pass the level check are not formatted by
+ * esp_log_write() and esp_log_tag_write(). The format string pointer and the
+ * argument values are stored in a buffer of the current CPU instead, and the
+ * messages are formatted and passed to the vprintf-like function later, by
+ * esp_log_deferred_drain(). On chips running FreeRTOS, a low priority task which
+ * drains the buffers is started when deferred mode is enabled for the first time.
+ *
+ * Format strings must be constant while deferred mode is enabled. Messages with
+ * conversions which can't be stored (%n, long double), or with more than 16
+ * arguments, are printed immediately. Messages are dropped if the buffer is full,
+ * the number of dropped messages is printed with the next drained messages.
+ *
+ * Disabling deferred mode drains the buffers.
+ *
+ * @param enable  true to defer formatting, false to format messages in the caller
+ */
+void esp_log_set_deferred(bool enable);
+
+/**
+ * @brief Returns whether deferred logging is enabled
+ */
+bool esp_log_get_deferred(void);
+
+/**
+ * @brief Format and print deferred messages
+ *
+ * Messages of all CPUs are printed in the order they were logged. Only one
+ * task drains at a time, this function returns 0 if called while another task
+ * is draining.
+ *
+ * @param max_messages  maximum number of messages to print
+ * @return number of messages printed
+ */
+size_t esp_log_deferred_drain(size_t max_messages);
+
+#endif // CONFIG_LOG_DEFERRED
+
 /** @cond */
 
 #include "esp_log_internal.h"
@@ -464,6 +540,111 @@ void esp_log_writev(esp_log_level_t level, const char* tag, const char* format,
     } while(0)
 #endif //CONFIG_LOG_MASTER_LEVEL
 
+/** @cond */
+/* Level of a tag descriptor which has not been registered yet. It lets every
+ * message through to esp_log_tag_write(), which registers the descriptor */
+#define ESP_LOG_TAG_UNREGISTERED  0xff
+/** @endcond */
+
+/**
+ * @brief Define a log tag descriptor for the ESP_TAG_LOGx macros in this file
+ *
+ * Usage: `ESP_LOG_TAG_DEFINE(s_tag, "my_tag", ESP_LOG_INFO);` at file scope, then
+ * `ESP_TAG_LOGI(s_tag, "format", ...)`.
+ *
+ * @param var       Name of the descriptor variable
+ * @param tag_name  Tag string, which can be used to change the log level by ``esp_log_level_set`` at runtime
+ * @param max_level Highest level compiled in for this tag. Like messages above ``LOG_LOCAL_LEVEL``,
+ *                  messages above this level are removed at compile time.
+ */
+#define ESP_LOG_TAG_DEFINE(var, tag_name, max_level)                                      \
+    enum { var ## _max_level = (max_level) };                                             \
+    static esp_log_tag_t var __attribute__((unused)) = {                                  \
+        .name = (tag_name), .level = ESP_LOG_TAG_UNREGISTERED, .next = 0                  \
+    }
+
+/**
+ * @brief Check whether a message of the given level would be printed for a tag descriptor
+ *
+ * Evaluates to a compile time constant false for levels above the maximum level of the tag
+ * or ``LOG_LOCAL_LEVEL``, otherwise it costs a load of the level of the tag. Can be used
+ * to skip the preparation of expensive log output.
+ */
+#ifdef BOOTLOADER_BUILD
+#define ESP_TAG_LOG_ENABLED(var, log_level) ((int)var ## _max_level >= (int)(log_level) && _ESP_LOG_EARLY_ENABLED(log_level))
+#elif defined(CONFIG_LOG_MASTER_LEVEL)
+#define ESP_TAG_LOG_ENABLED(var, log_level) (LOG_LOCAL_LEVEL >= (log_level) && (int)var ## _max_level >= (int)(log_level) && \
+                                             esp_log_get_level_master() >= (log_level) && (var).level >= (log_level))
+#else
+#define ESP_TAG_LOG_ENABLED(var, log_level) (LOG_LOCAL_LEVEL >= (log_level) && (int)var ## _max_level >= (int)(log_level) && \
+                                             (var).level >= (log_level))
+#endif
+
+/**
+ * Macro to output logs at ESP_LOG_ERROR level for a tag descriptor defined with ``ESP_LOG_TAG_DEFINE``.
+ *
+ * @note This macro cannot be used when interrupts are disabled or inside an ISR.
+ *
+ * @param var tag descriptor of the log.
+ *
+ * @see ``ESP_LOGE``
+ */
+#if defined(__cplusplus) && (__cplusplus >  201703L)
+#define ESP_TAG_LOGE( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_ERROR,   E __VA_OPT__(,) __VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_WARN`` level for a tag descriptor.  @see ``ESP_TAG_LOGE``
+#define ESP_TAG_LOGW( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_WARN,    W __VA_OPT__(,) __VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_INFO`` level for a tag descriptor.  @see ``ESP_TAG_LOGE``
+#define ESP_TAG_LOGI( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_INFO,    I __VA_OPT__(,) __VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_DEBUG`` level for a tag descriptor.  @see ``ESP_TAG_LOGE``
+#define ESP_TAG_LOGD( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_DEBUG,   D __VA_OPT__(,) __VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_VERBOSE`` level for a tag descriptor.  @see ``ESP_TAG_LOGE``
+#define ESP_TAG_LOGV( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_VERBOSE, V __VA_OPT__(,) __VA_ARGS__)
+#else // !(defined(__cplusplus) && (__cplusplus >  201703L))
+#define ESP_TAG_LOGE( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_ERROR,   E, ##__VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_WARN`` level for a tag descriptor.  @see ``ESP_TAG_LOGE``
+#define ESP_TAG_LOGW( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_WARN,    W, ##__VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_INFO`` level for a tag descriptor.  @see ``ESP_TAG_LOGE``
+#define ESP_TAG_LOGI( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_INFO,    I, ##__VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_DEBUG`` level for a tag descriptor.  @see ``ESP_TAG_LOGE``
+#define ESP_TAG_LOGD( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_DEBUG,   D, ##__VA_ARGS__)
+/// macro to output logs at ``ESP_LOG_VERBOSE`` level for a tag descriptor.  @see ``ESP_TAG_LOGE``
+#define ESP_TAG_LOGV( var, format, ... ) ESP_TAG_LOG_IMPL(var, format, ESP_LOG_VERBOSE, V, ##__VA_ARGS__)
+#endif // !(defined(__cplusplus) && (__cplusplus >  201703L))
+
+/** @cond */
+#if defined(__cplusplus) && (__cplusplus >  201703L)
+#if defined(BOOTLOADER_BUILD)
+#define _ESP_TAG_LOG_WRITE(var, format, log_level, log_tag_letter, ...) \
+    esp_rom_printf(LOG_FORMAT(log_tag_letter, format), esp_log_timestamp(), (var).name __VA_OPT__(,) __VA_ARGS__)
+#elif CONFIG_LOG_TIMESTAMP_SOURCE_RTOS
+#define _ESP_TAG_LOG_WRITE(var, format, log_level, log_tag_letter, ...) \
+    esp_log_tag_write(&(var), log_level, LOG_FORMAT(log_tag_letter, format), esp_log_timestamp(), (var).name __VA_OPT__(,) __VA_ARGS__)
+#elif CONFIG_LOG_TIMESTAMP_SOURCE_SYSTEM
+#define _ESP_TAG_LOG_WRITE(var, format, log_level, log_tag_letter, ...) \
+    esp_log_tag_write(&(var), log_level, LOG_SYSTEM_TIME_FORMAT(log_tag_letter, format), esp_log_system_timestamp(), (var).name __VA_OPT__(,) __VA_ARGS__)
+#endif
+#define ESP_TAG_LOG_IMPL(var, format, log_level, log_tag_letter, ...) do {                          \
+        if (ESP_TAG_LOG_ENABLED(var, log_level)) {                                                  \
+            _ESP_TAG_LOG_WRITE(var, format, log_level, log_tag_letter __VA_OPT__(,) __VA_ARGS__);   \
+        }} while(0)
+#else // !(defined(__cplusplus) && (__cplusplus >  201703L))
+#if defined(BOOTLOADER_BUILD)
+#define _ESP_TAG_LOG_WRITE(var, format, log_level, log_tag_letter, ...) \
+    esp_rom_printf(LOG_FORMAT(log_tag_letter, format), esp_log_timestamp(), (var).name, ##__VA_ARGS__)
+#elif CONFIG_LOG_TIMESTAMP_SOURCE_RTOS
+#define _ESP_TAG_LOG_WRITE(var, format, log_level, log_tag_letter, ...) \
+    esp_log_tag_write(&(var), log_level, LOG_FORMAT(log_tag_letter, format), esp_log_timestamp(), (var).name, ##__VA_ARGS__)
+#elif CONFIG_LOG_TIMESTAMP_SOURCE_SYSTEM
+#define _ESP_TAG_LOG_WRITE(var, format, log_level, log_tag_letter, ...) \
+    esp_log_tag_write(&(var), log_level, LOG_SYSTEM_TIME_FORMAT(log_tag_letter, format), esp_log_system_timestamp(), (var).name, ##__VA_ARGS__)
+#endif
+#define ESP_TAG_LOG_IMPL(var, format, log_level, log_tag_letter, ...) do {                          \
+        if (ESP_TAG_LOG_ENABLED(var, log_level)) {                                                  \
+            _ESP_TAG_LOG_WRITE(var, format, log_level, log_tag_letter, ##__VA_ARGS__);              \
+        }} while(0)
+#endif // !(defined(__cplusplus) && (__cplusplus >  201703L))
+/** @endcond */
+
 /**
  * @brief Macro to output logs when the cache is disabled. Log at ``ESP_LOG_ERROR`` level.
  *
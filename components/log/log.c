@@ -21,6 +21,17 @@
  * After that, bubble-down operation is performed to fix ordering in the
  * min-heap.
  *
+ * Tags defined with ESP_LOG_TAG_DEFINE are descriptors which hold the level
+ * of the tag themselves, and bypass the cache. A descriptor is added to the
+ * s_log_tag_descs list the first time a message is logged with it, and
+ * esp_log_level_set updates the level of all registered descriptors with
+ * the same name. The check of the level is done by the ESP_TAG_LOGx macros,
+ * so messages which are not printed cost a single load.
+ *
+ * In deferred mode (CONFIG_LOG_DEFERRED), messages which pass the level check
+ * are handed to log_deferred.c, which stores them unformatted and prints them
+ * later through esp_log_deferred_print.
+ *
  */
 
 #include <stdbool.h>
@@ -67,6 +78,7 @@ static cached_tag_entry_t s_log_cache[TAG_CACHE_SIZE];
 static uint32_t s_log_cache_max_generation = 0;
 static uint32_t s_log_cache_entry_count = 0;
 static vprintf_like_t s_log_print_func = &vprintf;
+static esp_log_tag_t *s_log_tag_descs = NULL;
 
 #ifdef LOG_BUILTIN_CHECKS
 static uint32_t s_log_cache_misses = 0;
@@ -110,10 +122,20 @@ void esp_log_level_set(const char *tag, esp_log_level_t level)
     if (strcmp(tag, "*") == 0) {
         esp_log_default_level = level;
         clear_log_level_list();
+        for (esp_log_tag_t *desc = s_log_tag_descs; desc != NULL; desc = desc->next) {
+            desc->level = level;
+        }
         esp_log_impl_unlock();
         return;
     }
 
+    // update registered tag descriptors, unregistered ones will look the level up when registering
+    for (esp_log_tag_t *desc = s_log_tag_descs; desc != NULL; desc = desc->next) {
+        if (strcmp(desc->name, tag) == 0) {
+            desc->level = level;
+        }
+    }
+
     // search for existing tag
     uncached_tag_entry_t *it = NULL;
     SLIST_FOREACH(it, &s_log_tags, entries) {
@@ -206,6 +228,11 @@ void esp_log_writev(esp_log_level_t level,
     if (!should_output(level, level_for_tag)) {
         return;
     }
+#if CONFIG_LOG_DEFERRED
+    if (esp_log_deferred_writev(format, args)) {
+        return;
+    }
+#endif
 
     (*s_log_print_func)(format, args);
 
@@ -221,6 +248,59 @@ void esp_log_write(esp_log_level_t level,
     va_end(list);
 }
 
+void esp_log_tag_writev(esp_log_tag_t *tag,
+                        esp_log_level_t level,
+                        const char *format,
+                        va_list args)
+{
+    if (tag->level == ESP_LOG_TAG_UNREGISTERED) {
+        if (!esp_log_impl_lock_timeout()) {
+            return;
+        }
+        // another task may have registered the descriptor in the meantime
+        if (tag->level == ESP_LOG_TAG_UNREGISTERED) {
+            esp_log_level_t level_for_tag;
+            if (!get_uncached_log_level(tag->name, &level_for_tag)) {
+                level_for_tag = esp_log_default_level;
+            }
+            tag->next = s_log_tag_descs;
+            s_log_tag_descs = tag;
+            tag->level = level_for_tag;
+        }
+        esp_log_impl_unlock();
+    }
+    if (!should_output(level, tag->level)) {
+        return;
+    }
+#if CONFIG_LOG_DEFERRED
+    if (esp_log_deferred_writev(format, args)) {
+        return;
+    }
+#endif
+
+    (*s_log_print_func)(format, args);
+}
+
+void esp_log_tag_write(esp_log_tag_t *tag,
+                       esp_log_level_t level,
+                       const char *format, ...)
+{
+    va_list list;
+    va_start(list, format);
+    esp_log_tag_writev(tag, level, format, list);
+    va_end(list);
+}
+
+#if CONFIG_LOG_DEFERRED
+void esp_log_deferred_print(const char *format, ...)
+{
+    va_list list;
+    va_start(list, format);
+    (*s_log_print_func)(format, list);
+    va_end(list);
+}
+#endif
+
 static inline bool get_cached_log_level(const char *tag, esp_log_level_t *level)
 {
     // Look for `tag` in cache
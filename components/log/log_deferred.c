@@ -0,0 +1,623 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Deferred logging implementation notes.
+ *
+ * Each CPU has a ring buffer of records. A record holds the pointer to the
+ * format string and the raw values of the arguments, which are read from the
+ * va_list according to the conversions in the format string. String arguments
+ * are copied behind the values unless they are in flash. Formatting happens
+ * in esp_log_deferred_drain(), which walks the format string again and formats
+ * one conversion at a time with the stored values.
+ *
+ * Writers reserve space by advancing 'head' with a compare-and-swap, so tasks
+ * preempting each other, interrupts, and tasks migrated to the other CPU may
+ * write into the same ring. A record is published by setting the COMMITTED
+ * flag in its first word last. The reader stops at the first record which is
+ * not committed yet, and clears every record it has printed before advancing
+ * 'tail', so that space reserved but not written yet always reads as not
+ * committed. A record never wraps around the end of the buffer, the space up
+ * to the end is filled with a padding record instead.
+ *
+ * Records carry a global sequence number, the reader merges the rings of all
+ * CPUs in this order.
+ *
+ * To avoid parsing the format string for every message, the types of the
+ * arguments are kept in a small cache indexed by the format string pointer.
+ * Entries are updated like a sequence lock: writers make 'version' odd while
+ * they change an entry, readers retry parsing if 'version' was odd or changed
+ * while they copied the entry. Nobody waits, so messages may be logged from
+ * interrupts as well.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_log_private.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "soc/soc_caps.h"
+#include "esp_cpu.h"
+#include "esp_memory_utils.h"
+#define LOG_DEFERRED_RINGS  SOC_CPU_CORES_NUM
+#else
+#define LOG_DEFERRED_RINGS  1
+#endif
+
+#define RING_SIZE           CONFIG_LOG_DEFERRED_BUFFER_SIZE
+// Largest record, bigger messages are printed immediately
+#define MAX_RECORD_SIZE     (RING_SIZE / 4)
+#define MAX_ARGS            16
+// String arguments are copied up to this length
+#define MAX_STR_LEN         127
+// Conversion specifications longer than this are printed immediately
+#define MAX_CONV_LEN        16
+#define LINE_SIZE           256
+#define SIGNATURE_CACHE_BITS 5
+
+#define RECORD_COMMITTED    (1U << 31)
+#define RECORD_PADDING      (1U << 30)
+#define RECORD_SIZE_MASK    0xffffU
+
+_Static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "CONFIG_LOG_DEFERRED_BUFFER_SIZE must be a power of two");
+
+typedef enum {
+    ARG_NONE,           // "%%"
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_INTMAX,
+    ARG_SIZE,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_PTR,
+    ARG_STR,
+    ARG_UNSUPPORTED,
+} arg_type_t;
+
+#define ARG_TYPE_MASK       0x0f
+// The precision of a string argument is given by the previous argument
+#define ARG_STAR_PRECISION  0x10
+
+typedef struct {
+    uint8_t type;
+    uint8_t stars;          // number of '*' width and precision arguments before the value
+    bool star_precision;    // the last '*' argument is the precision
+    int precision;          // literal precision, -1 if not given
+} conversion_t;
+
+// Types of the arguments of a format string
+typedef struct {
+    uint8_t count;
+    bool cacheable;                 // no string has a literal precision
+    uint8_t types[MAX_ARGS];        // arg_type_t, ARG_STAR_PRECISION
+    int precision[MAX_ARGS];        // literal precision of strings, only set if not cacheable
+} signature_t;
+
+// Signatures of recently used format strings, 'version' is odd while an entry is written
+typedef struct {
+    _Atomic uint32_t version;
+    const char *format;
+    uint8_t count;
+    uint8_t types[MAX_ARGS];
+} signature_entry_t;
+
+typedef union {
+    int i;
+    long l;
+    long long ll;
+    intmax_t j;
+    size_t z;
+    ptrdiff_t t;
+    double d;
+    const void *p;
+    const char *s;
+} log_arg_t;
+
+typedef struct {
+    _Atomic uint32_t state;     // size of the record in bytes | RECORD_COMMITTED | RECORD_PADDING
+    uint32_t seq;
+    const char *format;
+    log_arg_t args[];           // followed by the copied strings
+} log_record_t;
+
+typedef struct {
+    _Atomic uint32_t head;      // end of the reserved space, only increases
+    _Atomic uint32_t tail;      // start of the oldest record, written by the reader only
+    uint8_t buf[RING_SIZE] __attribute__((aligned(8)));
+} log_ring_t;
+
+static log_ring_t s_rings[LOG_DEFERRED_RINGS];
+static signature_entry_t s_signatures[1 << SIGNATURE_CACHE_BITS];
+static atomic_bool s_deferred;
+static atomic_bool s_draining;
+static _Atomic uint32_t s_seq;
+static _Atomic uint32_t s_dropped;
+
+// Only used by the task holding s_draining
+static char s_line[LINE_SIZE];
+static size_t s_line_len;
+
+#if !CONFIG_IDF_TARGET_LINUX
+static inline bool format_is_constant(const char *format)
+{
+    return esp_ptr_in_drom(format);
+}
+
+static inline bool string_is_constant(const char *str)
+{
+    return esp_ptr_in_drom(str);
+}
+
+static inline log_ring_t *current_ring(void)
+{
+    return &s_rings[esp_cpu_get_core_id()];
+}
+#else
+// String literals can't be told apart from other strings on the host: format
+// strings are expected to be literals, all string arguments are copied.
+static inline bool format_is_constant(const char *format)
+{
+    return true;
+}
+
+static inline bool string_is_constant(const char *str)
+{
+    return false;
+}
+
+static inline log_ring_t *current_ring(void)
+{
+    return &s_rings[0];
+}
+#endif
+
+// Parses the conversion specification following a '%', returns the pointer past it
+static const char *parse_conversion(const char *p, conversion_t *conv)
+{
+    conv->stars = 0;
+    conv->star_precision = false;
+    conv->precision = -1;
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        p++;
+    }
+    if (*p == '*') {
+        conv->stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            conv->stars++;
+            conv->star_precision = true;
+            p++;
+        } else {
+            conv->precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                conv->precision = conv->precision * 10 + (*p++ - '0');
+            }
+        }
+    }
+    char length = 0;
+    switch (*p) {
+    case 'h':
+        // char and short arguments are promoted to int
+        p += (p[1] == 'h') ? 2 : 1;
+        break;
+    case 'l':
+        length = (p[1] == 'l') ? 'q' : 'l';
+        p += (p[1] == 'l') ? 2 : 1;
+        break;
+    case 'j':
+    case 'z':
+    case 't':
+    case 'L':
+        length = *p++;
+        break;
+    default:
+        break;
+    }
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        conv->type = length == 'l' ? ARG_LONG :
+                     length == 'q' ? ARG_LLONG :
+                     length == 'j' ? ARG_INTMAX :
+                     length == 'z' ? ARG_SIZE :
+                     length == 't' ? ARG_PTRDIFF :
+                     length == 0 ? ARG_INT : ARG_UNSUPPORTED;
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        conv->type = length == 0 || length == 'l' ? ARG_DOUBLE : ARG_UNSUPPORTED;
+        break;
+    case 'c':
+        conv->type = length == 0 ? ARG_INT : ARG_UNSUPPORTED;
+        break;
+    case 's':
+        conv->type = length == 0 ? ARG_STR : ARG_UNSUPPORTED;
+        break;
+    case 'p':
+        conv->type = ARG_PTR;
+        break;
+    case '%':
+        conv->type = ARG_NONE;
+        break;
+    default:
+        // %n, wide strings and characters, and broken specifications
+        conv->type = ARG_UNSUPPORTED;
+        return *p ? p + 1 : p;
+    }
+    return p + 1;
+}
+
+static log_record_t *ring_reserve(log_ring_t *ring, uint32_t size)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t offset;
+    uint32_t padding;
+    do {
+        offset = head & (RING_SIZE - 1);
+        padding = (offset + size > RING_SIZE) ? RING_SIZE - offset : 0;
+        // Acquire: the reader has cleared the space before advancing tail
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head + padding + size - tail > RING_SIZE) {
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&ring->head, &head, head + padding + size,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    if (padding) {
+        log_record_t *pad = (log_record_t *)&ring->buf[offset];
+        atomic_store_explicit(&pad->state, padding | RECORD_COMMITTED | RECORD_PADDING, memory_order_release);
+        offset = 0;
+    }
+    return (log_record_t *)&ring->buf[offset];
+}
+
+// Returns the oldest committed record of the ring, or NULL
+static log_record_t *ring_peek(log_ring_t *ring)
+{
+    while (true) {
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        log_record_t *record = (log_record_t *)&ring->buf[tail & (RING_SIZE - 1)];
+        uint32_t state = atomic_load_explicit(&record->state, memory_order_acquire);
+        if (!(state & RECORD_COMMITTED)) {
+            return NULL;
+        }
+        if (!(state & RECORD_PADDING)) {
+            return record;
+        }
+        memset(record, 0, sizeof(record->state));
+        atomic_store_explicit(&ring->tail, tail + (state & RECORD_SIZE_MASK), memory_order_release);
+    }
+}
+
+static void ring_release(log_ring_t *ring, log_record_t *record)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t size = atomic_load_explicit(&record->state, memory_order_relaxed) & RECORD_SIZE_MASK;
+    memset(record, 0, size);
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+}
+
+// Parses the format string into the types of the arguments, returns false if it can't be stored
+static bool parse_signature(const char *format, signature_t *sig)
+{
+    sig->count = 0;
+    sig->cacheable = true;
+    for (const char *p = format; (p = strchr(p, '%')) != NULL;) {
+        conversion_t conv;
+        const char *end = parse_conversion(p + 1, &conv);
+        if (conv.type == ARG_UNSUPPORTED || end - p > MAX_CONV_LEN || sig->count + conv.stars + 1 > MAX_ARGS) {
+            return false;
+        }
+        p = end;
+        if (conv.type == ARG_NONE) {
+            continue;
+        }
+        for (int i = 0; i < conv.stars; i++) {
+            sig->types[sig->count++] = ARG_INT;
+        }
+        if (conv.type == ARG_STR && conv.star_precision) {
+            sig->types[sig->count++] = ARG_STR | ARG_STAR_PRECISION;
+        } else {
+            // The literal precision of strings isn't kept in the cache, these are parsed each time
+            sig->cacheable &= conv.type != ARG_STR || conv.precision < 0;
+            sig->precision[sig->count] = conv.precision;
+            sig->types[sig->count++] = conv.type;
+        }
+    }
+    return true;
+}
+
+static inline signature_entry_t *signature_entry(const char *format)
+{
+    return &s_signatures[((uint32_t)((uintptr_t)format >> 2) * 2654435761U) >> (32 - SIGNATURE_CACHE_BITS)];
+}
+
+static bool signature_lookup(const char *format, signature_t *sig)
+{
+    signature_entry_t *entry = signature_entry(format);
+    uint32_t version = atomic_load_explicit(&entry->version, memory_order_acquire);
+    if ((version & 1) || entry->format != format || entry->count > MAX_ARGS) {
+        return false;
+    }
+    sig->count = entry->count;
+    sig->cacheable = true;
+    memcpy(sig->types, entry->types, sig->count);
+    atomic_thread_fence(memory_order_acquire);
+    // The entry was not changed while it was copied
+    return atomic_load_explicit(&entry->version, memory_order_relaxed) == version;
+}
+
+static void signature_store(const char *format, const signature_t *sig)
+{
+    signature_entry_t *entry = signature_entry(format);
+    uint32_t version = atomic_load_explicit(&entry->version, memory_order_relaxed);
+    if ((version & 1) || !atomic_compare_exchange_strong_explicit(&entry->version, &version, version + 1,
+                                                                  memory_order_relaxed, memory_order_relaxed)) {
+        // Somebody else is writing it
+        return;
+    }
+    atomic_thread_fence(memory_order_release);
+    entry->format = format;
+    entry->count = sig->count;
+    memcpy(entry->types, sig->types, sig->count);
+    atomic_store_explicit(&entry->version, version + 2, memory_order_release);
+}
+
+bool esp_log_deferred_writev(const char *format, va_list args)
+{
+    if (!atomic_load_explicit(&s_deferred, memory_order_relaxed) || !format_is_constant(format)) {
+        return false;
+    }
+
+    signature_t sig;
+    if (!signature_lookup(format, &sig)) {
+        if (!parse_signature(format, &sig)) {
+            return false;
+        }
+        if (sig.cacheable) {
+            signature_store(format, &sig);
+        }
+    }
+
+    log_arg_t values[MAX_ARGS];
+    uint8_t copy_len[MAX_ARGS];     // bytes to copy for string arguments, including the terminator
+    size_t size = sizeof(log_record_t) + sig.count * sizeof(log_arg_t);
+
+    va_list list;
+    va_copy(list, args);
+    for (size_t i = 0; i < sig.count; i++) {
+        log_arg_t *value = &values[i];
+        copy_len[i] = 0;
+        switch (sig.types[i] & ARG_TYPE_MASK) {
+        case ARG_INT:
+            value->i = va_arg(list, int);
+            break;
+        case ARG_LONG:
+            value->l = va_arg(list, long);
+            break;
+        case ARG_LLONG:
+            value->ll = va_arg(list, long long);
+            break;
+        case ARG_INTMAX:
+            value->j = va_arg(list, intmax_t);
+            break;
+        case ARG_SIZE:
+            value->z = va_arg(list, size_t);
+            break;
+        case ARG_PTRDIFF:
+            value->t = va_arg(list, ptrdiff_t);
+            break;
+        case ARG_DOUBLE:
+            value->d = va_arg(list, double);
+            break;
+        case ARG_PTR:
+            value->p = va_arg(list, const void *);
+            break;
+        case ARG_STR:
+            value->s = va_arg(list, const char *);
+            if (value->s && !string_is_constant(value->s)) {
+                int precision = (sig.types[i] & ARG_STAR_PRECISION) ? values[i - 1].i :
+                                sig.cacheable ? -1 : sig.precision[i];
+                size_t max_len = (precision >= 0 && precision < MAX_STR_LEN) ? precision : MAX_STR_LEN;
+                copy_len[i] = strnlen(value->s, max_len) + 1;
+                size += copy_len[i];
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    va_end(list);
+
+    size = (size + 7) & ~7U;
+    if (size > MAX_RECORD_SIZE) {
+        return false;
+    }
+    log_record_t *record = ring_reserve(current_ring(), size);
+    if (record == NULL) {
+        atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+        return true;
+    }
+    record->seq = atomic_fetch_add_explicit(&s_seq, 1, memory_order_relaxed);
+    record->format = format;
+    memcpy(record->args, values, sig.count * sizeof(log_arg_t));
+    char *str = (char *)&record->args[sig.count];
+    for (size_t i = 0; i < sig.count; i++) {
+        if (copy_len[i]) {
+            memcpy(str, values[i].s, copy_len[i] - 1);
+            str[copy_len[i] - 1] = '\0';
+            record->args[i].s = str;
+            str += copy_len[i];
+        }
+    }
+    atomic_store_explicit(&record->state, size | RECORD_COMMITTED, memory_order_release);
+    return true;
+}
+
+static void line_flush(void)
+{
+    if (s_line_len) {
+        esp_log_deferred_print("%.*s", (int)s_line_len, s_line);
+        s_line_len = 0;
+    }
+}
+
+static void line_append_text(const char *text, size_t len)
+{
+    while (len) {
+        size_t chunk = LINE_SIZE - 1 - s_line_len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(s_line + s_line_len, text, chunk);
+        s_line_len += chunk;
+        text += chunk;
+        len -= chunk;
+        if (s_line_len == LINE_SIZE - 1) {
+            line_flush();
+        }
+    }
+}
+
+static int format_arg(char *buf, size_t size, const char *spec, uint8_t type, const log_arg_t *arg)
+{
+    switch (type) {
+    case ARG_INT:
+        return snprintf(buf, size, spec, arg->i);
+    case ARG_LONG:
+        return snprintf(buf, size, spec, arg->l);
+    case ARG_LLONG:
+        return snprintf(buf, size, spec, arg->ll);
+    case ARG_INTMAX:
+        return snprintf(buf, size, spec, arg->j);
+    case ARG_SIZE:
+        return snprintf(buf, size, spec, arg->z);
+    case ARG_PTRDIFF:
+        return snprintf(buf, size, spec, arg->t);
+    case ARG_DOUBLE:
+        return snprintf(buf, size, spec, arg->d);
+    case ARG_PTR:
+        return snprintf(buf, size, spec, arg->p);
+    case ARG_STR:
+        return snprintf(buf, size, spec, arg->s);
+    default:
+        return -1;
+    }
+}
+
+static void line_append_arg(const char *spec, uint8_t type, const log_arg_t *arg)
+{
+    int len = format_arg(s_line + s_line_len, LINE_SIZE - s_line_len, spec, type, arg);
+    if (len < 0) {
+        return;
+    }
+    if (s_line_len + len < LINE_SIZE) {
+        s_line_len += len;
+        return;
+    }
+    line_flush();
+    if (type == ARG_STR) {
+        // Long strings are printed on their own instead of being cut
+        esp_log_deferred_print(spec, arg->s);
+        return;
+    }
+    len = format_arg(s_line, LINE_SIZE, spec, type, arg);
+    s_line_len = (len < LINE_SIZE) ? len : LINE_SIZE - 1;
+}
+
+static void render(const log_record_t *record)
+{
+    const log_arg_t *arg = record->args;
+    const char *p = record->format;
+    const char *percent;
+    while ((percent = strchr(p, '%')) != NULL) {
+        line_append_text(p, percent - p);
+        conversion_t conv;
+        p = parse_conversion(percent + 1, &conv);
+        if (conv.type == ARG_NONE) {
+            line_append_text("%", 1);
+            continue;
+        }
+        // Width and precision given as arguments are written into the specification
+        char spec[MAX_CONV_LEN + 24];
+        char *out = spec;
+        for (const char *c = percent; c < p; c++) {
+            if (*c != '*') {
+                *out++ = *c;
+            } else if (c[-1] == '.' && arg->i < 0) {
+                // A negative precision is taken as if it was omitted
+                out--;
+                arg++;
+            } else {
+                out += sprintf(out, "%d", (arg++)->i);
+            }
+        }
+        *out = '\0';
+        line_append_arg(spec, conv.type, arg++);
+    }
+    line_append_text(p, strlen(p));
+    line_flush();
+}
+
+size_t esp_log_deferred_drain(size_t max_messages)
+{
+    if (atomic_exchange_explicit(&s_draining, true, memory_order_acquire)) {
+        return 0;
+    }
+    size_t count = 0;
+    while (count < max_messages) {
+        log_ring_t *next_ring = NULL;
+        log_record_t *next = NULL;
+        for (int i = 0; i < LOG_DEFERRED_RINGS; i++) {
+            log_record_t *record = ring_peek(&s_rings[i]);
+            if (record && (next == NULL || (int32_t)(record->seq - next->seq) < 0)) {
+                next_ring = &s_rings[i];
+                next = record;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+        render(next);
+        ring_release(next_ring, next);
+        count++;
+    }
+    uint32_t dropped = atomic_exchange_explicit(&s_dropped, 0, memory_order_relaxed);
+    if (dropped) {
+        esp_log_deferred_print("%" PRIu32 " log messages dropped\n", dropped);
+    }
+    atomic_store_explicit(&s_draining, false, memory_order_release);
+    return count;
+}
+
+void esp_log_set_deferred(bool enable)
+{
+    if (enable) {
+        esp_log_impl_lock();
+        esp_log_impl_deferred_start();
+        esp_log_impl_unlock();
+    }
+    atomic_store(&s_deferred, enable);
+    if (!enable) {
+        esp_log_deferred_drain(SIZE_MAX);
+    }
+}
+
+bool esp_log_get_deferred(void)
+{
+    return atomic_load(&s_deferred);
+}
@@ -23,6 +23,13 @@
 #define MAX_MUTEX_WAIT_MS 10
 #define MAX_MUTEX_WAIT_TICKS ((MAX_MUTEX_WAIT_MS + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS)
 
+#if CONFIG_LOG_DEFERRED
+// The task draining deferred messages runs just above the idle task
+#define DEFERRED_TASK_STACK_SIZE 3072
+#define DEFERRED_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+#define DEFERRED_TASK_PERIOD_TICKS ((10 + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS)
+#endif
+
 static SemaphoreHandle_t s_log_mutex = NULL;
 
 void esp_log_impl_lock(void)
@@ -55,6 +62,25 @@ void esp_log_impl_unlock(void)
     xSemaphoreGive(s_log_mutex);
 }
 
+#if CONFIG_LOG_DEFERRED
+static void deferred_task(void *arg)
+{
+    while (true) {
+        // Keep draining while the buffers fill up, but let the idle task run in between
+        size_t printed = esp_log_deferred_drain(SIZE_MAX);
+        vTaskDelay(printed ? 1 : DEFERRED_TASK_PERIOD_TICKS);
+    }
+}
+
+void esp_log_impl_deferred_start(void)
+{
+    static TaskHandle_t s_deferred_task = NULL;
+    if (s_deferred_task == NULL) {
+        xTaskCreate(deferred_task, "log_deferred", DEFERRED_TASK_STACK_SIZE, NULL, DEFERRED_TASK_PRIORITY, &s_deferred_task);
+    }
+}
+#endif
+
 char *esp_log_system_timestamp(void)
 {
     static char buffer[18] = {0};
@@ -36,3 +36,10 @@ uint32_t esp_log_timestamp(void)
     uint32_t milliseconds = current_time.tv_sec * 1000 + current_time.tv_nsec / 1000000;
     return milliseconds;
 }
+
+#if CONFIG_LOG_DEFERRED
+void esp_log_impl_deferred_start(void)
+{
+    // Deferred messages are printed by calling esp_log_deferred_drain()
+}
+#endif
@@ -29,6 +29,13 @@ void esp_log_impl_unlock(void)
     s_lock = 0;
 }
 
+#if CONFIG_LOG_DEFERRED
+void esp_log_impl_deferred_start(void)
+{
+    // No task to drain the buffers, messages are printed by calling esp_log_deferred_drain()
+}
+#endif
+
 /* FIXME: define an API for getting the timestamp in soc/hal IDF-2351 */
 uint32_t esp_log_early_timestamp(void)
 {
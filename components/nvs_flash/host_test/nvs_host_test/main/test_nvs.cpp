@@ -17,6 +17,10 @@
 #include <string.h>
 #include <string>
 #include <random>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <algorithm>
 #include "test_fixtures.hpp"
 
 #define TEST_ESP_ERR(rc, res) CHECK((rc) == (res))
@@ -436,6 +440,113 @@ TEST_CASE("can write and read variable length data lots of times", "[nvs]")
     s_perf << "Time to write one string and one integer a thousand times: " << esp_partition_get_total_time() << " us (" << esp_partition_get_erase_ops() << " " << esp_partition_get_write_ops() << " " << esp_partition_get_read_ops() << " " << esp_partition_get_write_bytes() << " " << esp_partition_get_read_bytes() << ")" << std::endl;
 }
 
+TEST_CASE("key index finds the same items as page scan", "[nvs]")
+{
+    const size_t pageCount = 32;
+    const size_t keyCount = 2500;
+    const size_t rounds = 10;
+    PartitionEmulationFixture f(0, pageCount);
+    char key[16];
+
+    for (size_t indexMaxSize : {static_cast<size_t>(0), static_cast<size_t>(128 * 1024)}) {
+        nvs::Storage storage(f.part());
+        TEST_ESP_OK(storage.init(0, pageCount, indexMaxSize));
+
+        if (indexMaxSize == 0) {
+            for (size_t i = 0; i < keyCount; ++i) {
+                snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+                TEST_ESP_OK(storage.writeItem(1, key, static_cast<uint32_t>(i)));
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (size_t i = 0; i < keyCount; ++i) {
+                snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+                uint32_t value;
+                TEST_ESP_OK(storage.readItem(1, key, value));
+                CHECK(value == i);
+            }
+            TEST_ESP_ERR(storage.findKey(1, "nokey", nullptr), ESP_ERR_NVS_NOT_FOUND);
+        }
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        s_perf << "Time to look up " << keyCount << " keys " << rounds << " times in " << pageCount << " pages ("
+               << (indexMaxSize ? "key index" : "page scan") << "): " << us << " us" << std::endl;
+    }
+}
+
+TEST_CASE("key index falls back to page scan when its memory limit is reached", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 8);
+    nvs::Storage storage(f.part());
+    TEST_ESP_OK(storage.init(0, 8, 2048));
+    CHECK(storage.getItemIndex().isActive());
+    char key[16];
+    for (size_t i = 0; i < 200; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(storage.writeItem(1, key, static_cast<uint32_t>(i)));
+    }
+    CHECK(!storage.getItemIndex().isActive());
+    for (size_t i = 0; i < 200; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        uint32_t value;
+        TEST_ESP_OK(storage.readItem(1, key, value));
+        CHECK(value == i);
+    }
+}
+
+TEST_CASE("lazily loaded storage finds the same items as fully loaded storage", "[nvs]")
+{
+    const size_t pageCount = 16;
+    const size_t keyCount = 1000;
+    PartitionEmulationFixture f(0, pageCount);
+    char key[16];
+    uint8_t blob[3000];
+    for (size_t i = 0; i < sizeof(blob); ++i) {
+        blob[i] = static_cast<uint8_t>(i);
+    }
+
+    nvs_stats_t stats;
+    {
+        nvs::Storage storage(f.part());
+        TEST_ESP_OK(storage.init(0, pageCount, 0, false));
+        uint8_t nsA, nsB;
+        TEST_ESP_OK(storage.createOrOpenNamespace("ns_a", true, nsA));
+        TEST_ESP_OK(storage.createOrOpenNamespace("ns_b", true, nsB));
+        for (size_t i = 0; i < keyCount; ++i) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+            TEST_ESP_OK(storage.writeItem(i % 2 ? nsB : nsA, key, static_cast<uint32_t>(i)));
+        }
+        TEST_ESP_OK(storage.writeItem(nsA, nvs::ItemType::BLOB, "blob", blob, sizeof(blob)));
+        TEST_ESP_OK(storage.fillStats(stats));
+    }
+
+    for (size_t indexMaxSize : {static_cast<size_t>(0), static_cast<size_t>(64 * 1024)}) {
+        nvs::Storage storage(f.part());
+        TEST_ESP_OK(storage.init(0, pageCount, indexMaxSize, true));
+        uint8_t nsA, nsB;
+        TEST_ESP_OK(storage.createOrOpenNamespace("ns_b", false, nsB));
+        TEST_ESP_OK(storage.createOrOpenNamespace("ns_a", false, nsA));
+        CHECK(storage.createOrOpenNamespace("ns_c", false, nsA) == ESP_ERR_NVS_NOT_FOUND);
+        TEST_ESP_OK(storage.createOrOpenNamespace("ns_a", false, nsA));
+        for (size_t i = 0; i < keyCount; ++i) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+            uint32_t value;
+            TEST_ESP_OK(storage.readItem(i % 2 ? nsB : nsA, key, value));
+            CHECK(value == i);
+        }
+        uint8_t readBlob[sizeof(blob)];
+        TEST_ESP_OK(storage.readItem(nsA, nvs::ItemType::BLOB, "blob", readBlob, sizeof(readBlob)));
+        CHECK(memcmp(readBlob, blob, sizeof(blob)) == 0);
+
+        nvs_stats_t lazyStats;
+        TEST_ESP_OK(storage.fillStats(lazyStats));
+        CHECK(lazyStats.used_entries == stats.used_entries);
+        CHECK(lazyStats.free_entries == stats.free_entries);
+        CHECK(lazyStats.namespace_count == stats.namespace_count);
+    }
+}
+
 TEST_CASE("can get length of variable length data", "[nvs]")
 {
     PartitionEmulationFixture f(0, 8);
@@ -2345,6 +2456,360 @@ TEST_CASE("writing the identical content does not write or erase", "[nvs]")
     TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
 }
 
+TEST_CASE("transaction stages changes until commit", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 10);
+
+    const uint32_t NVS_FLASH_SECTOR = 5;
+    const uint32_t NVS_FLASH_SECTOR_COUNT_MIN = 3;
+    TEST_ESP_OK(nvs::NVSPartitionManager::get_instance()->init_custom(f.part(),
+                NVS_FLASH_SECTOR,
+                NVS_FLASH_SECTOR_COUNT_MIN));
+
+    nvs_handle_t handle;
+    nvs_handle_t other;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &other));
+    TEST_ESP_OK(nvs_set_i32(handle, "old", 1));
+    TEST_ESP_OK(nvs_set_str(handle, "gone", "erase me"));
+
+    TEST_ESP_ERR(nvs_transaction_abort(handle), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    TEST_ESP_ERR(nvs_transaction_begin(handle), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_OK(nvs_set_i32(handle, "old", 2));
+    TEST_ESP_OK(nvs_set_u8(handle, "new", 3));
+    TEST_ESP_OK(nvs_set_str(handle, "str", "staged"));
+    TEST_ESP_OK(nvs_erase_key(handle, "gone"));
+    TEST_ESP_ERR(nvs_erase_key(handle, "gone"), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_ERR(nvs_erase_key(handle, "missing"), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_ERR(nvs_erase_all(handle), ESP_ERR_NVS_INVALID_STATE);
+
+    // the handle sees its staged changes, other handles don't
+    int32_t i32;
+    uint8_t u8;
+    char str[16];
+    size_t len = sizeof(str);
+    nvs_type_t type;
+    TEST_ESP_OK(nvs_get_i32(handle, "old", &i32));
+    CHECK(i32 == 2);
+    TEST_ESP_OK(nvs_get_u8(handle, "new", &u8));
+    CHECK(u8 == 3);
+    TEST_ESP_ERR(nvs_get_i8(handle, "new", reinterpret_cast<int8_t*>(&u8)), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(nvs_get_str(handle, "str", str, &len));
+    CHECK(strcmp(str, "staged") == 0);
+    TEST_ESP_ERR(nvs_get_str(handle, "gone", str, &len), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(nvs_find_key(handle, "new", &type));
+    CHECK(type == NVS_TYPE_U8);
+    TEST_ESP_OK(nvs_get_i32(other, "old", &i32));
+    CHECK(i32 == 1);
+    TEST_ESP_ERR(nvs_get_u8(other, "new", &u8), ESP_ERR_NVS_NOT_FOUND);
+
+    TEST_ESP_OK(nvs_transaction_abort(handle));
+    TEST_ESP_OK(nvs_get_i32(handle, "old", &i32));
+    CHECK(i32 == 1);
+    TEST_ESP_ERR(nvs_get_u8(handle, "new", &u8), ESP_ERR_NVS_NOT_FOUND);
+
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    TEST_ESP_OK(nvs_set_i32(handle, "old", 2));
+    TEST_ESP_OK(nvs_set_u8(handle, "new", 3));
+    TEST_ESP_OK(nvs_set_str(handle, "str", "staged"));
+    TEST_ESP_OK(nvs_set_str(handle, "str", "committed"));
+    TEST_ESP_OK(nvs_erase_key(handle, "gone"));
+    TEST_ESP_OK(nvs_commit(handle));
+    TEST_ESP_ERR(nvs_transaction_abort(handle), ESP_ERR_NVS_INVALID_STATE);
+
+    nvs_close(handle);
+    nvs_close(other);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+
+    TEST_ESP_OK(nvs::NVSPartitionManager::get_instance()->init_custom(f.part(),
+                NVS_FLASH_SECTOR,
+                NVS_FLASH_SECTOR_COUNT_MIN));
+    TEST_ESP_OK(nvs_open("test", NVS_READONLY, &handle));
+    TEST_ESP_OK(nvs_get_i32(handle, "old", &i32));
+    CHECK(i32 == 2);
+    TEST_ESP_OK(nvs_get_u8(handle, "new", &u8));
+    CHECK(u8 == 3);
+    len = sizeof(str);
+    TEST_ESP_OK(nvs_get_str(handle, "str", str, &len));
+    CHECK(strcmp(str, "committed") == 0);
+    TEST_ESP_ERR(nvs_find_key(handle, "gone", &type), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_ERR(nvs_transaction_begin(handle), ESP_ERR_NVS_READ_ONLY);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("transaction commit spanning several pages keeps storage consistent", "[nvs]")
+{
+    const size_t pageCount = 6;
+    PartitionEmulationFixture f(0, pageCount);
+    std::mt19937 gen(42);
+    std::map<std::string, std::string> strings;
+    std::map<std::string, uint32_t> values;
+    char key[16];
+    char str[80];
+
+    {
+        nvs::Storage storage(f.part());
+        TEST_ESP_OK(storage.init(0, pageCount));
+        for (size_t round = 0; round < 20; ++round) {
+            nvs::Transaction transaction;
+            for (size_t i = 0; i < 40; ++i) {
+                snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(gen() % 60));
+                if (gen() % 4 == 0) {
+                    snprintf(str, sizeof(str), "%0*u", static_cast<int>(gen() % 70), static_cast<unsigned>(gen()));
+                    TEST_ESP_OK(transaction.set(nvs::ItemType::SZ, key, str, strlen(str) + 1));
+                    values.erase(key);
+                    strings[key] = str;
+                } else if (gen() % 8 == 0) {
+                    TEST_ESP_OK(transaction.erase(key));
+                    values.erase(key);
+                    strings.erase(key);
+                } else {
+                    uint32_t value = gen();
+                    TEST_ESP_OK(transaction.set(nvs::ItemType::U32, key, &value, sizeof(value)));
+                    strings.erase(key);
+                    values[key] = value;
+                }
+            }
+            TEST_ESP_OK(storage.writeItems(1, transaction));
+        }
+    }
+
+    nvs::Storage storage(f.part());
+    TEST_ESP_OK(storage.init(0, pageCount));
+    for (size_t i = 0; i < 60; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        if (values.count(key)) {
+            uint32_t value;
+            TEST_ESP_OK(storage.readItem(1, key, value));
+            CHECK(value == values[key]);
+        } else if (strings.count(key)) {
+            TEST_ESP_OK(storage.readItem(1, nvs::ItemType::SZ, key, str, sizeof(str)));
+            CHECK(strings[key] == str);
+        } else {
+            TEST_ESP_ERR(storage.findKey(1, key, nullptr), ESP_ERR_NVS_NOT_FOUND);
+        }
+    }
+}
+
+TEST_CASE("transaction commit needs fewer flash writes than single sets", "[nvs]")
+{
+    const size_t keyCount = 32;
+    PartitionEmulationFixture f(0, 10);
+
+    const uint32_t NVS_FLASH_SECTOR = 0;
+    const uint32_t NVS_FLASH_SECTOR_COUNT_MIN = 10;
+    TEST_ESP_OK(nvs::NVSPartitionManager::get_instance()->init_custom(f.part(),
+                NVS_FLASH_SECTOR,
+                NVS_FLASH_SECTOR_COUNT_MIN));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    char key[16];
+    for (size_t i = 0; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(nvs_set_u32(handle, key, i));
+    }
+
+    esp_partition_clear_stats();
+    for (size_t i = 0; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(nvs_set_u32(handle, key, i + 1));
+    }
+    TEST_ESP_OK(nvs_commit(handle));
+    const size_t singleWriteOps = esp_partition_get_write_ops();
+    s_perf << "Time to update " << keyCount << " keys one by one: " << esp_partition_get_total_time() << " us (" << esp_partition_get_erase_ops() << "E " << esp_partition_get_write_ops() << "W " << esp_partition_get_read_ops() << "R)" << std::endl;
+
+    esp_partition_clear_stats();
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    for (size_t i = 0; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(nvs_set_u32(handle, key, i + 2));
+    }
+    TEST_ESP_OK(nvs_commit(handle));
+    const size_t batchWriteOps = esp_partition_get_write_ops();
+    s_perf << "Time to update " << keyCount << " keys in one transaction: " << esp_partition_get_total_time() << " us (" << esp_partition_get_erase_ops() << "E " << esp_partition_get_write_ops() << "W " << esp_partition_get_read_ops() << "R)" << std::endl;
+    CHECK(batchWriteOps * 4 < singleWriteOps);
+
+    for (size_t i = 0; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        uint32_t value;
+        TEST_ESP_OK(nvs_get_u32(handle, key, &value));
+        CHECK(value == i + 2);
+    }
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("nvs_get_str_ptr and nvs_get_blob_ptr return stored values without copying", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 10);
+
+    const uint32_t NVS_FLASH_SECTOR = 0;
+    const uint32_t NVS_FLASH_SECTOR_COUNT_MIN = 10;
+    TEST_ESP_OK(nvs::NVSPartitionManager::get_instance()->init_custom(f.part(),
+                NVS_FLASH_SECTOR,
+                NVS_FLASH_SECTOR_COUNT_MIN));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    const char* str = "zero-copy string";
+    TEST_ESP_OK(nvs_set_str(handle, "str", str));
+    // large enough to be stored in several chunks
+    const size_t blobSize = nvs::Page::CHUNK_MAX_SIZE * 2 + 100;
+    uint8_t* blob = new uint8_t[blobSize];
+    for (size_t i = 0; i < blobSize; ++i) {
+        blob[i] = static_cast<uint8_t>(i * 7);
+    }
+    TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, blobSize));
+    TEST_ESP_OK(nvs_set_blob(handle, "empty", blob, 0));
+
+    const char* value;
+    size_t len;
+    nvs_lease_t strLease;
+    TEST_ESP_OK(nvs_get_str_ptr(handle, "str", &value, &len, &strLease));
+    CHECK(len == strlen(str) + 1);
+    CHECK(strcmp(value, str) == 0);
+    CHECK(nvs_lease_is_valid(strLease));
+    TEST_ESP_ERR(nvs_get_str_ptr(handle, "blob", &value, &len, &strLease), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_ERR(nvs_get_str_ptr(handle, "str", &value, &len, nullptr), ESP_ERR_INVALID_ARG);
+
+    size_t spanCount = 0;
+    TEST_ESP_OK(nvs_get_blob_ptr(handle, "blob", nullptr, &spanCount, &len, nullptr));
+    CHECK(spanCount == 3);
+    CHECK(len == blobSize);
+    nvs_span_t spans[3];
+    nvs_lease_t blobLease;
+    spanCount = 2;
+    TEST_ESP_ERR(nvs_get_blob_ptr(handle, "blob", spans, &spanCount, &len, &blobLease), ESP_ERR_NVS_INVALID_LENGTH);
+    CHECK(spanCount == 3);
+    TEST_ESP_OK(nvs_get_blob_ptr(handle, "blob", spans, &spanCount, &len, &blobLease));
+    size_t offset = 0;
+    for (size_t i = 0; i < spanCount; ++i) {
+        CHECK(memcmp(spans[i].data, blob + offset, spans[i].size) == 0);
+        offset += spans[i].size;
+    }
+    CHECK(offset == blobSize);
+
+    nvs_lease_t emptyLease;
+    spanCount = 1;
+    TEST_ESP_OK(nvs_get_blob_ptr(handle, "empty", spans, &spanCount, &len, &emptyLease));
+    CHECK(len == 0);
+    nvs_lease_release(emptyLease);
+
+    // the old value stays readable through the lease after the key is modified
+    TEST_ESP_OK(nvs_set_str(handle, "str", "another value"));
+    CHECK(strcmp(value, str) == 0);
+    CHECK(nvs_lease_is_valid(strLease));
+
+    // staged values are not in flash yet
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    TEST_ESP_OK(nvs_set_str(handle, "str", "staged"));
+    TEST_ESP_ERR(nvs_get_str_ptr(handle, "str", &value, &len, &emptyLease), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_OK(nvs_transaction_abort(handle));
+
+    nvs_lease_release(strLease);
+    nvs_close(handle);
+
+    // de-initialization invalidates the remaining leases, they still have to be released
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+    CHECK(!nvs_lease_is_valid(blobLease));
+    nvs_lease_release(blobLease);
+    CHECK(!nvs_lease_is_valid(nullptr));
+    nvs_lease_release(nullptr);
+    delete[] blob;
+}
+
+TEST_CASE("garbage collection erases pages pinned by leases only as a last resort", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 10);
+
+    const uint32_t NVS_FLASH_SECTOR = 0;
+    const uint32_t NVS_FLASH_SECTOR_COUNT_MIN = 3;
+    TEST_ESP_OK(nvs::NVSPartitionManager::get_instance()->init_custom(f.part(),
+                NVS_FLASH_SECTOR,
+                NVS_FLASH_SECTOR_COUNT_MIN));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_set_str(handle, "str", "leased value"));
+    const char* value;
+    nvs_lease_t lease;
+    TEST_ESP_OK(nvs_get_str_ptr(handle, "str", &value, nullptr, &lease));
+    TEST_ESP_OK(nvs_set_str(handle, "str", "new value"));
+
+    // pages with erased entries are available, the pinned page is kept
+    for (uint32_t i = 0; i < 1000; ++i) {
+        TEST_ESP_OK(nvs_set_u32(handle, "counter", i));
+    }
+    CHECK(nvs_lease_is_valid(lease));
+    CHECK(strcmp(value, "leased value") == 0);
+
+    // once the pinned page is the only one which can be freed, it is erased
+    char key[16];
+    esp_err_t err = ESP_OK;
+    for (uint32_t i = 0; err == ESP_OK && nvs_lease_is_valid(lease); ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        err = nvs_set_u32(handle, key, i);
+    }
+    TEST_ESP_OK(err);
+    CHECK(!nvs_lease_is_valid(lease));
+    nvs_lease_release(lease);
+
+    size_t len;
+    TEST_ESP_OK(nvs_get_str_ptr(handle, "str", &value, &len, &lease));
+    CHECK(strcmp(value, "new value") == 0);
+    nvs_lease_release(lease);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("nvs_get_blob_ptr reads less from flash than nvs_get_blob", "[nvs]")
+{
+    const size_t rounds = 100;
+    PartitionEmulationFixture f(0, 10);
+
+    const uint32_t NVS_FLASH_SECTOR = 0;
+    const uint32_t NVS_FLASH_SECTOR_COUNT_MIN = 10;
+    TEST_ESP_OK(nvs::NVSPartitionManager::get_instance()->init_custom(f.part(),
+                NVS_FLASH_SECTOR,
+                NVS_FLASH_SECTOR_COUNT_MIN));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    const size_t blobSize = 8000;
+    uint8_t* blob = new uint8_t[blobSize];
+    memset(blob, 0xa5, blobSize);
+    TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, blobSize));
+
+    esp_partition_clear_stats();
+    for (size_t i = 0; i < rounds; ++i) {
+        size_t len = blobSize;
+        TEST_ESP_OK(nvs_get_blob(handle, "blob", blob, &len));
+    }
+    const size_t copyReadBytes = esp_partition_get_read_bytes();
+    s_perf << "Time to read an " << blobSize << " byte blob " << rounds << " times with nvs_get_blob: " << esp_partition_get_total_time() << " us (" << esp_partition_get_read_ops() << "R " << copyReadBytes << "Rb)" << std::endl;
+
+    esp_partition_clear_stats();
+    for (size_t i = 0; i < rounds; ++i) {
+        nvs_span_t spans[4];
+        size_t spanCount = 4;
+        nvs_lease_t lease;
+        TEST_ESP_OK(nvs_get_blob_ptr(handle, "blob", spans, &spanCount, nullptr, &lease));
+        nvs_lease_release(lease);
+    }
+    const size_t ptrReadBytes = esp_partition_get_read_bytes();
+    s_perf << "Time to read an " << blobSize << " byte blob " << rounds << " times with nvs_get_blob_ptr: " << esp_partition_get_total_time() << " us (" << esp_partition_get_read_ops() << "R " << ptrReadBytes << "Rb)" << std::endl;
+    CHECK(ptrReadBytes * 4 < copyReadBytes);
+
+    delete[] blob;
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
 TEST_CASE("can init storage from flash with random contents", "[nvs]")
 {
     PartitionEmulationFixture f(0, 10);
@@ -2535,6 +3000,107 @@ TEST_CASE("duplicate items are removed", "[nvs][dupes]")
     }
 }
 
+TEST_CASE("duplicate items left by an interrupted batch write are removed", "[nvs][dupes]")
+{
+    PartitionEmulationFixture f(0, 3);
+    const char* keys[] = {"first", "second", "third"};
+    {
+        nvs::Page p;
+        TEST_ESP_OK(p.load(f.part(), 0));
+        TEST_ESP_OK(p.setSeqNumber(0));
+        for (size_t i = 0; i < 3; ++i) {
+            TEST_ESP_OK(p.writeItem<uint32_t>(1, keys[i], i));
+        }
+        TEST_ESP_OK(p.writeItem<uint32_t>(1, "other", 100));
+        TEST_ESP_OK(p.markFull());
+    }
+    {
+        // write new versions to the next page, but don't erase the old ones
+        nvs::Page p;
+        TEST_ESP_OK(p.load(f.part(), 1));
+        TEST_ESP_OK(p.setSeqNumber(1));
+        uint32_t values[3] = {10, 11, 12};
+        nvs::Page::BatchItem items[3];
+        for (size_t i = 0; i < 3; ++i) {
+            items[i] = {nvs::ItemType::U32, keys[i], &values[i], sizeof(values[i])};
+        }
+        TEST_ESP_OK(p.writeItems(1, items, 3));
+    }
+    {
+        nvs::Storage s(f.part());
+        TEST_ESP_OK(s.init(0, 3));
+        for (size_t i = 0; i < 3; ++i) {
+            uint32_t val;
+            TEST_ESP_OK(s.readItem(1, keys[i], val));
+            CHECK(val == 10 + i);
+        }
+        uint32_t val;
+        TEST_ESP_OK(s.readItem(1, "other", val));
+        CHECK(val == 100);
+    }
+    {
+        nvs::Page p;
+        TEST_ESP_OK(p.load(f.part(), 0));
+        CHECK(p.getErasedEntryCount() == 3);
+        CHECK(p.getUsedEntryCount() == 1);
+    }
+}
+
+TEST_CASE("duplicate items on a lazily loaded page are removed when it is first accessed", "[nvs][dupes]")
+{
+    PartitionEmulationFixture f(0, 3);
+    const char* keys[] = {"first", "second", "third"};
+    {
+        nvs::Page p;
+        TEST_ESP_OK(p.load(f.part(), 0));
+        TEST_ESP_OK(p.setSeqNumber(0));
+        for (size_t i = 0; i < 3; ++i) {
+            TEST_ESP_OK(p.writeItem<uint32_t>(1, keys[i], i));
+        }
+        TEST_ESP_OK(p.writeItem<uint32_t>(1, "other", 100));
+        TEST_ESP_OK(p.markFull());
+    }
+    {
+        // write new versions to the next page, but don't erase the old ones
+        nvs::Page p;
+        TEST_ESP_OK(p.load(f.part(), 1));
+        TEST_ESP_OK(p.setSeqNumber(1));
+        uint32_t values[3] = {10, 11, 12};
+        nvs::Page::BatchItem items[3];
+        for (size_t i = 0; i < 3; ++i) {
+            items[i] = {nvs::ItemType::U32, keys[i], &values[i], sizeof(values[i])};
+        }
+        TEST_ESP_OK(p.writeItems(1, items, 3));
+    }
+    {
+        nvs::Storage s(f.part());
+        TEST_ESP_OK(s.init(0, 3, 0, true));
+        {
+            // the full page isn't loaded by init, the old versions are still there
+            nvs::Page p;
+            TEST_ESP_OK(p.load(f.part(), 0));
+            CHECK(p.getErasedEntryCount() == 0);
+            CHECK(p.getUsedEntryCount() == 4);
+        }
+
+        // the full page is searched first, its old versions are erased when it is loaded
+        for (size_t i = 0; i < 3; ++i) {
+            uint32_t val;
+            TEST_ESP_OK(s.readItem(1, keys[i], val));
+            CHECK(val == 10 + i);
+        }
+        uint32_t val;
+        TEST_ESP_OK(s.readItem(1, "other", val));
+        CHECK(val == 100);
+    }
+    {
+        nvs::Page p;
+        TEST_ESP_OK(p.load(f.part(), 0));
+        CHECK(p.getErasedEntryCount() == 3);
+        CHECK(p.getUsedEntryCount() == 1);
+    }
+}
+
 TEST_CASE("recovery after failure to write data", "[nvs]")
 {
     PartitionEmulationFixture f(0, 3);
@@ -2714,6 +3280,188 @@ TEST_CASE("Recovery from power-off when page is being freed", "[nvs]")
     TEST_ESP_OK(nvs_flash_deinit_partition(f.part()->get_partition_name()));
 }
 
+TEST_CASE("incremental garbage collection keeps page erases out of the write path", "[nvs]")
+{
+    const size_t pageCount = 8;
+    const size_t keyCount = 60;
+    const size_t writeCount = 3000;
+    char key[16];
+    char value[64];
+    size_t p99[2];
+
+    for (int gc = 0; gc < 2; ++gc) {
+        PartitionEmulationFixture f(0, pageCount);
+        nvs::Storage storage(f.part());
+        TEST_ESP_OK(storage.init(0, pageCount));
+
+        std::vector<size_t> latencies;
+        for (size_t i = 0; i < writeCount; ++i) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i % keyCount));
+            snprintf(value, sizeof(value), "value of %s written in round %u", key, static_cast<unsigned>(i / keyCount));
+            esp_partition_clear_stats();
+            TEST_ESP_OK(storage.writeItem(1, nvs::ItemType::SZ, key, value, strlen(value) + 1));
+            if (i % 16 == 0) {
+                // values which are never updated keep pages from becoming empty
+                snprintf(key, sizeof(key), "static%u", static_cast<unsigned>(i / 16));
+                TEST_ESP_OK(storage.writeItem(2, key, static_cast<uint32_t>(i)));
+            }
+            latencies.push_back(esp_partition_get_total_time());
+
+            // a background task would run between the writes
+            esp_err_t err = ESP_OK;
+            while (gc && (err = storage.collectGarbage(16)) == ESP_ERR_NOT_FINISHED) { }
+            TEST_ESP_OK(err);
+        }
+
+        for (size_t i = 0; i < keyCount; ++i) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+            size_t round = (writeCount - keyCount + i) / keyCount;
+            snprintf(value, sizeof(value), "value of %s written in round %u", key, static_cast<unsigned>(round));
+            char buf[64];
+            TEST_ESP_OK(storage.readItem(1, nvs::ItemType::SZ, key, buf, sizeof(buf)));
+            CHECK(strcmp(buf, value) == 0);
+        }
+        for (size_t i = 0; i < writeCount; i += 16) {
+            snprintf(key, sizeof(key), "static%u", static_cast<unsigned>(i / 16));
+            uint32_t staticValue;
+            TEST_ESP_OK(storage.readItem(2, key, staticValue));
+            CHECK(staticValue == i);
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        p99[gc] = latencies[latencies.size() * 99 / 100];
+        s_perf << "Write latency " << (gc ? "with" : "without") << " incremental garbage collection: p50 "
+               << latencies[latencies.size() / 2] << " us, p99 " << p99[gc] << " us, max " << latencies.back() << " us" << std::endl;
+    }
+    CHECK(p99[1] * 4 < p99[0]);
+}
+
+TEST_CASE("Recovery from power-off during incremental garbage collection", "[nvs]")
+{
+    const size_t pageCount = 4;
+    const size_t keyCount = 20;
+    const size_t staticKeyCount = 40;
+    const size_t opCount = 100;
+    char key[16];
+    char value[64];
+    char buf[64];
+    auto makeValue = [&](size_t keyIdx, size_t round) {
+        snprintf(value, sizeof(value), "value of key%u written in round %u",
+                 static_cast<unsigned>(keyIdx), static_cast<unsigned>(round));
+    };
+
+    bool failed = true;
+    for (size_t failAfter = 0; failed; failAfter += 37) {
+        INFO(failAfter);
+        PartitionEmulationFixture f(0, pageCount);
+        size_t rounds[keyCount] = {};
+        size_t uncertainKey = keyCount;
+        failed = false;
+        {
+            nvs::Storage storage(f.part());
+            TEST_ESP_OK(storage.init(0, pageCount));
+            size_t i = 0;
+            // interleave values which are never updated, until garbage collection has to move them
+            esp_err_t err;
+            do {
+                snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i % keyCount));
+                rounds[i % keyCount] = i / keyCount;
+                makeValue(i % keyCount, i / keyCount);
+                TEST_ESP_OK(storage.writeItem(1, nvs::ItemType::SZ, key, value, strlen(value) + 1));
+                if (i < staticKeyCount) {
+                    snprintf(key, sizeof(key), "static%u", static_cast<unsigned>(i));
+                    TEST_ESP_OK(storage.writeItem(2, key, static_cast<uint32_t>(i)));
+                }
+                ++i;
+                REQUIRE(i < 1000);
+            } while ((err = storage.collectGarbage(8)) == ESP_OK);
+            TEST_ESP_ERR(err, ESP_ERR_NOT_FINISHED);
+
+            esp_partition_fail_after(failAfter, ESP_PARTITION_FAIL_AFTER_MODE_BOTH);
+            for (size_t op = 0; op < opCount; ++op, ++i) {
+                err = storage.collectGarbage(8);
+                if (err == ESP_ERR_FLASH_OP_FAIL) {
+                    failed = true;
+                    break;
+                }
+                CHECK((err == ESP_OK || err == ESP_ERR_NOT_FINISHED));
+
+                snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i % keyCount));
+                makeValue(i % keyCount, i / keyCount);
+                err = storage.writeItem(1, nvs::ItemType::SZ, key, value, strlen(value) + 1);
+                if (err == ESP_ERR_FLASH_OP_FAIL || err == ESP_ERR_NVS_REMOVE_FAILED) {
+                    failed = true;
+                    uncertainKey = i % keyCount;
+                    break;
+                }
+                TEST_ESP_OK(err);
+                rounds[i % keyCount] = i / keyCount;
+            }
+            esp_partition_fail_after(SIZE_MAX, ESP_PARTITION_FAIL_AFTER_MODE_BOTH);
+        }
+
+        nvs::Storage storage(f.part());
+        TEST_ESP_OK(storage.init(0, pageCount));
+        for (size_t k = 0; k < keyCount; ++k) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(k));
+            TEST_ESP_OK(storage.readItem(1, nvs::ItemType::SZ, key, buf, sizeof(buf)));
+            makeValue(k, rounds[k]);
+            if (k == uncertainKey && strcmp(buf, value) != 0) {
+                makeValue(k, rounds[k] + 1);
+            }
+            CHECK(strcmp(buf, value) == 0);
+        }
+        for (size_t k = 0; k < staticKeyCount; ++k) {
+            snprintf(key, sizeof(key), "static%u", static_cast<unsigned>(k));
+            uint32_t staticValue;
+            TEST_ESP_OK(storage.readItem(2, key, staticValue));
+            CHECK(staticValue == k);
+        }
+        // no duplicates are left behind
+        nvs_stats_t stats;
+        TEST_ESP_OK(storage.fillStats(stats));
+        CHECK(stats.used_entries == staticKeyCount + keyCount * nvs::Page::getEntryCount(nvs::ItemType::SZ, strlen(value) + 1));
+    }
+}
+
+TEST_CASE("incremental garbage collection stops on a nearly full partition", "[nvs]")
+{
+    const size_t pageCount = 4;
+    char key[16];
+    char value[81];
+    char buf[81];
+
+    // values spanning 4 entries, up to about as many as fit into the pages besides the reserved one
+    for (size_t keyCount : {40, 55, 60, 62}) {
+        INFO(keyCount);
+        PartitionEmulationFixture f(0, pageCount);
+        nvs::Storage storage(f.part());
+        TEST_ESP_OK(storage.init(0, pageCount));
+        for (size_t round = 0; round < 3; ++round) {
+            memset(value, 'a' + round, sizeof(value) - 1);
+            value[sizeof(value) - 1] = 0;
+            for (size_t i = 0; i < keyCount; ++i) {
+                snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+                TEST_ESP_OK(storage.writeItem(1, nvs::ItemType::SZ, key, value, sizeof(value)));
+            }
+        }
+
+        // the steps end even if the values don't leave room for a second free page
+        size_t steps = 0;
+        esp_err_t err;
+        while ((err = storage.collectGarbage(16)) == ESP_ERR_NOT_FINISHED) {
+            REQUIRE(++steps < 100);
+        }
+        TEST_ESP_OK(err);
+
+        for (size_t i = 0; i < keyCount; ++i) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+            TEST_ESP_OK(storage.readItem(1, nvs::ItemType::SZ, key, buf, sizeof(buf)));
+            CHECK(strcmp(buf, value) == 0);
+        }
+    }
+}
+
 TEST_CASE("Check that NVS supports old blob format without blob index", "[nvs]")
 {
     // initialize the fixture with nvs binary loaded
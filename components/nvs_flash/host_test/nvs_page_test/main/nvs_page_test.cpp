@@ -918,6 +918,52 @@ void test_Page_calcEntries__invalid()
     TEST_ASSERT_EQUAL(0, nvsStats.namespace_count);
 }
 
+// Reports the time nvs::Storage::init takes with and without lazy page loading, against the partition size
+void test_Page_load__lazy_init_time()
+{
+    const uint32_t page_counts[] = {4, 16, 64};
+
+    for (uint32_t page_count : page_counts) {
+        PartitionEmulationFixture fix(0, page_count);
+        fix.erase_all();
+
+        // fill all pages but the active one and the one kept free by the garbage collection,
+        // the namespace entry and the keys leave the active page half full for every page count
+        const size_t key_count = (page_count - 2) * Page::ENTRY_COUNT + Page::ENTRY_COUNT / 2 - 1;
+        char key[16];
+        {
+            Storage storage(&fix.part);
+            TEST_ASSERT_EQUAL(ESP_OK, storage.init(0, page_count, 0, false));
+            for (uint32_t i = 0; i < key_count; ++i) {
+                snprintf(key, sizeof(key), "key%u", (unsigned) i);
+                TEST_ASSERT_EQUAL(ESP_OK, storage.writeItem(1, key, i));
+            }
+        }
+
+        size_t init_time[2];
+        size_t init_reads[2];
+        for (int lazy = 0; lazy < 2; ++lazy) {
+            Storage storage(&fix.part);
+            esp_partition_clear_stats();
+            TEST_ASSERT_EQUAL(ESP_OK, storage.init(0, page_count, 0, lazy));
+            init_time[lazy] = esp_partition_get_total_time();
+            init_reads[lazy] = esp_partition_get_read_ops();
+
+            // values on the last full page are still found
+            uint32_t value;
+            snprintf(key, sizeof(key), "key%u", (unsigned) (key_count - 1));
+            TEST_ASSERT_EQUAL(ESP_OK, storage.readItem(1, key, value));
+            TEST_ASSERT_EQUAL(key_count - 1, value);
+        }
+
+        printf("Time to init storage with %u pages: %u us (%u reads), lazy: %u us (%u reads)\n",
+               (unsigned) page_count,
+               (unsigned) init_time[0], (unsigned) init_reads[0],
+               (unsigned) init_time[1], (unsigned) init_reads[1]);
+        TEST_ASSERT_EQUAL(true, init_reads[1] < init_reads[0]);
+    }
+}
+
 int main(int argc, char **argv)
 {
 #define TEMPORARILY_DISABLED(x)
@@ -977,6 +1023,7 @@ int main(int argc, char **argv)
     RUN_TEST(test_Page_calcEntries__active_wo_blob);
     RUN_TEST(test_Page_calcEntries__active_with_blob);
     RUN_TEST(test_Page_calcEntries__invalid);
+    RUN_TEST(test_Page_load__lazy_init_time);
     int failures = UNITY_END();
     return failures;
 }
@@ -127,6 +127,19 @@ typedef struct {
  */
 typedef struct nvs_opaque_iterator_t *nvs_iterator_t;
 
+/**
+ * Opaque pointer type representing a lease on data returned by nvs_get_str_ptr and nvs_get_blob_ptr
+ */
+typedef struct nvs_opaque_lease_t *nvs_lease_t;
+
+/**
+ * @brief Contiguous piece of a value, pointing into the memory-mapped NVS partition
+ */
+typedef struct {
+    const void *data;   /*!< Start of the data */
+    size_t size;        /*!< Number of bytes at data */
+} nvs_span_t;
+
 /**
  * @brief      Open non-volatile storage with a given namespace from the default NVS partition
  *
@@ -501,6 +514,100 @@ esp_err_t nvs_get_str (nvs_handle_t handle, const char* key, char* out_value, si
 esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length);
 /**@}*/
 
+/**
+ * @brief      get a pointer to the string value for given key, without copying it
+ *
+ * The returned pointer points into the NVS partition, mapped into the data address space.
+ * It stays usable until the lease is released with nvs_lease_release. While the lease is held,
+ * the flash page holding the value is only erased by garbage collection if no other page can be
+ * freed. Once that happens, the lease becomes invalid, which can be checked with nvs_lease_is_valid.
+ * Modifying or erasing the key doesn't affect the lease, the old value remains readable.
+ *
+ * \code{c}
+ * // Example (without error checking) of reading a certificate without copying it:
+ * const char *cert;
+ * size_t cert_len;
+ * nvs_lease_t lease;
+ * nvs_get_str_ptr(my_handle, "ca_cert", &cert, &cert_len, &lease);
+ * parse_cert(cert, cert_len);
+ * bool ok = nvs_lease_is_valid(lease); // false if the page was erased while parsing
+ * nvs_lease_release(lease);
+ * \endcode
+ *
+ * @note Not supported for NVS partitions using NVS encryption, use nvs_get_str there.
+ *
+ * @param[in]   handle     Handle obtained from nvs_open function.
+ * @param[in]   key        Key name. Maximum length is (NVS_KEY_NAME_MAX_SIZE-1) characters. Shouldn't be empty.
+ * @param[out]  out_value  Set to the zero terminated string.
+ * @param[out]  length     If not NULL, set to the length of the string including the zero terminator.
+ * @param[out]  out_lease  Set to the lease on the value, has to be released with nvs_lease_release.
+ *
+ * @return
+ *             - ESP_OK if the value was retrieved successfully
+ *             - ESP_ERR_NVS_NOT_FOUND if the requested key doesn't exist
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_INVALID_STATE if the key is part of an open transaction on the handle
+ *             - ESP_ERR_NOT_SUPPORTED if the partition can't be memory-mapped, e.g. because it is encrypted
+ *             - ESP_ERR_INVALID_ARG if out_value or out_lease is NULL
+ *             - ESP_ERR_NO_MEM if memory for the lease could not be allocated
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_get_str_ptr(nvs_handle_t handle, const char* key, const char** out_value, size_t* length, nvs_lease_t* out_lease);
+
+/**
+ * @brief      get pointers to the blob value for given key, without copying it
+ *
+ * Blobs larger than a flash page are stored in several chunks, so the value is returned as a list of spans.
+ * Their concatenation is the value. To get the number of spans, call this function with out_spans set to NULL.
+ * Lease handling is the same as for nvs_get_str_ptr.
+ *
+ * @note Not supported for NVS partitions using NVS encryption, use nvs_get_blob there.
+ *
+ * @param[in]     handle      Handle obtained from nvs_open function.
+ * @param[in]     key         Key name. Maximum length is (NVS_KEY_NAME_MAX_SIZE-1) characters. Shouldn't be empty.
+ * @param[out]    out_spans   Array receiving the spans of the value. May be NULL, in this case only span_count
+ *                            and length are set and no lease is taken.
+ * @param[inout]  span_count  A non-zero pointer to the number of elements in out_spans. Set to the number of
+ *                            spans of the value.
+ * @param[out]    length      If not NULL, set to the length of the value.
+ * @param[out]    out_lease   Set to the lease on the value if out_spans is not NULL. Has to be released with
+ *                            nvs_lease_release.
+ *
+ * @return
+ *             - ESP_OK if the value was retrieved successfully
+ *             - ESP_ERR_NVS_NOT_FOUND if the requested key doesn't exist
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_INVALID_LENGTH if \c span_count is not sufficient for the spans of the value
+ *             - ESP_ERR_NVS_INVALID_STATE if the key is part of an open transaction on the handle
+ *             - ESP_ERR_NOT_SUPPORTED if the partition can't be memory-mapped, e.g. because it is encrypted
+ *             - ESP_ERR_INVALID_ARG if span_count is NULL, or out_lease is NULL while out_spans isn't
+ *             - ESP_ERR_NO_MEM if memory for the lease could not be allocated
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_get_blob_ptr(nvs_handle_t handle, const char* key, nvs_span_t* out_spans, size_t* span_count, size_t* length, nvs_lease_t* out_lease);
+
+/**
+ * @brief      Check whether the data covered by a lease is still in place
+ *
+ * A lease becomes invalid if a flash page it covers is erased or if its NVS partition is de-initialized.
+ * Data read through an invalid lease may be garbage.
+ *
+ * @param[in]  lease  Lease obtained from nvs_get_str_ptr or nvs_get_blob_ptr.
+ *
+ * @return true if the lease is valid, false if it is invalid or NULL
+ */
+bool nvs_lease_is_valid(nvs_lease_t lease);
+
+/**
+ * @brief      Release a lease obtained from nvs_get_str_ptr or nvs_get_blob_ptr
+ *
+ * The pointers obtained along with the lease must not be used afterwards.
+ * Releasing an invalid lease is allowed, releasing NULL does nothing.
+ *
+ * @param[in]  lease  Lease to release.
+ */
+void nvs_lease_release(nvs_lease_t lease);
+
 /**
  * @brief      Lookup key-value pair with given key name.
  *
@@ -555,16 +662,56 @@ esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key);
  *                NVS partition (only if NVS assertion checks are disabled)
  *              - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
  *              - ESP_ERR_NVS_READ_ONLY if handle was opened as read only
+ *              - ESP_ERR_NVS_INVALID_STATE if a transaction is open on the handle
  *              - other error codes from the underlying storage driver
  */
 esp_err_t nvs_erase_all(nvs_handle_t handle);
 
+/**
+ * @brief      Start a transaction on the handle
+ *
+ * Until nvs_commit or nvs_transaction_abort is called, the nvs_set_* functions and
+ * nvs_erase_key only stage the changes in RAM. nvs_get_* and nvs_find_key called with this
+ * handle return the staged values.
+ * nvs_commit then writes all staged values which fit into a page in batches, with one flash write
+ * of the page's entry state table per batch instead of one per value. This makes updating
+ * many keys at once considerably cheaper.
+ *
+ * If nvs_commit fails, a part of the staged changes may have been written. A power loss during
+ * nvs_commit may likewise leave some of the keys updated and others not, but never a key with two values.
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *                     Handles that were opened read only cannot be used.
+ *
+ * @return
+ *             - ESP_OK if the transaction was started
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_READ_ONLY if handle was opened as read only
+ *             - ESP_ERR_NVS_INVALID_STATE if a transaction is already open on the handle
+ *             - ESP_ERR_NO_MEM if memory for the transaction could not be allocated
+ */
+esp_err_t nvs_transaction_begin(nvs_handle_t handle);
+
+/**
+ * @brief      Discard all changes staged since nvs_transaction_begin
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *
+ * @return
+ *             - ESP_OK if the transaction was aborted
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_INVALID_STATE if no transaction is open on the handle
+ */
+esp_err_t nvs_transaction_abort(nvs_handle_t handle);
+
 /**
  * @brief      Write any pending changes to non-volatile storage
  *
  * After setting any values, nvs_commit() must be called to ensure changes are written
  * to non-volatile storage. Individual implementations may write to storage at other times,
  * but this is not guaranteed.
+ * If a transaction was started with nvs_transaction_begin, the staged changes are written
+ * and the transaction is closed.
  *
  * @param[in]  handle  Storage handle obtained with nvs_open.
  *                     Handles that were opened read only cannot be used.
@@ -582,7 +729,7 @@ esp_err_t nvs_commit(nvs_handle_t handle);
  * This function should be called for each handle opened with nvs_open once
  * the handle is not in use any more. Closing the handle may not automatically
  * write the changes to nonvolatile storage. This has to be done explicitly using
- * nvs_commit function.
+ * nvs_commit function. Changes staged by an open transaction are discarded.
  * Once this function is called on a handle, the handle should no longer be used.
  *
  * @param[in]  handle  Storage handle to close
@@ -635,6 +782,36 @@ typedef struct {
  */
 esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *nvs_stats);
 
+/**
+ * @brief      Do one step of incremental garbage collection.
+ *
+ * Once the active page is full and only the page reserved for garbage collection is free,
+ * the next write moves all values out of the page with the most erased entries and erases it.
+ * This function does the same work ahead of time in small steps, so that writes find a free page ready.
+ * A step moves about \c budget entries or erases one flash page. It is called by the background
+ * garbage collection task if CONFIG_NVS_BACKGROUND_GC is enabled.
+ *
+ * \code{c}
+ * // Example of collecting garbage while the application is idle:
+ * while (nvs_gc_step(NULL, 16) == ESP_ERR_NOT_FINISHED) {
+ *     vTaskDelay(1);
+ * }
+ * \endcode
+ *
+ * @param[in]   part_name   Partition name NVS in the partition table.
+ *                          If pass a NULL than will use NVS_DEFAULT_PART_NAME ("nvs").
+ * @param[in]   budget      Number of entries to move in this step. An entry is 32 bytes.
+ *
+ * @return
+ *             - ESP_OK if no garbage collection is needed, or if the stored values leave too few
+ *               erased entries to free another page ahead of time.
+ *             - ESP_ERR_NOT_FINISHED if more steps are needed.
+ *             - ESP_ERR_NVS_NOT_INITIALIZED if the storage driver is not initialized.
+ *             - ESP_ERR_INVALID_ARG if budget is 0.
+ *             - other error codes from the underlying storage driver.
+ */
+esp_err_t nvs_gc_step(const char *part_name, size_t budget);
+
 /**
  * @brief      Calculate all entries in a namespace.
  *
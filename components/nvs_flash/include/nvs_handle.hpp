@@ -208,11 +208,39 @@ public:
 
     /**
      * Commits all changes done through this handle so far.
-     * Currently, NVS writes to storage right after the set and get functions,
+     * Outside of a transaction, NVS writes to storage right after the set and erase functions,
      * but this is not guaranteed.
+     * If a transaction is open, its staged changes are written and the transaction is closed,
+     * see \ref begin_transaction.
      */
     virtual esp_err_t commit() = 0;
 
+    /**
+     * @brief      Starts a transaction on this handle
+     *
+     * Until \ref commit or \ref abort_transaction is called, set and erase functions only stage the changes in RAM.
+     * Get functions of this handle return the staged values. On commit, values which fit into a page are written
+     * in batches with one update of the page's entry state table each, instead of one per item.
+     * If commit fails, a part of the staged changes may have been written.
+     * Power loss during commit never leaves a key with two values, but may leave some keys updated and others not.
+     *
+     * @return
+     *             - ESP_OK if the transaction was started
+     *             - ESP_ERR_NVS_READ_ONLY if the handle was opened as read only
+     *             - ESP_ERR_NVS_INVALID_STATE if a transaction is already open on this handle
+     *             - ESP_ERR_NO_MEM if memory for the transaction could not be allocated
+     */
+    virtual esp_err_t begin_transaction() = 0;
+
+    /**
+     * @brief      Discards all changes staged since \ref begin_transaction and closes the transaction
+     *
+     * @return
+     *             - ESP_OK if the transaction was aborted
+     *             - ESP_ERR_NVS_INVALID_STATE if no transaction is open on this handle
+     */
+    virtual esp_err_t abort_transaction() = 0;
+
     /**
      * @brief      Calculate all entries in the scope of the handle.
      *
@@ -23,6 +23,11 @@
 #include "esp_log.h"
 static const char* TAG = "nvs";
 
+#if CONFIG_NVS_BACKGROUND_GC
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
 /**
  * @brief  Configuration structure for the active default security scheme
  *         for NVS Encryption
@@ -56,6 +61,37 @@ using namespace nvs;
 
 static intrusive_list<NVSHandleEntry> s_nvs_handles;
 
+#if CONFIG_NVS_BACKGROUND_GC
+static TaskHandle_t s_nvs_gc_task;
+
+static void nvs_gc_task(void* arg)
+{
+    while (true) {
+        esp_err_t err;
+        {
+            // released between steps, so that a write waits for one step at most
+            Lock lock;
+            err = NVSPartitionManager::get_instance()->collect_garbage(CONFIG_NVS_BACKGROUND_GC_STEP_ENTRIES);
+        }
+        vTaskDelay((err == ESP_ERR_NOT_FINISHED) ? 1 : pdMS_TO_TICKS(CONFIG_NVS_BACKGROUND_GC_PERIOD_MS));
+    }
+}
+#endif
+
+// Called with the lock held once a partition is initialized
+static esp_err_t start_gc_task()
+{
+#if CONFIG_NVS_BACKGROUND_GC
+    if (s_nvs_gc_task == nullptr &&
+            xTaskCreate(nvs_gc_task, "nvs_gc", CONFIG_NVS_BACKGROUND_GC_TASK_STACK_SIZE, nullptr,
+                        CONFIG_NVS_BACKGROUND_GC_TASK_PRIORITY, &s_nvs_gc_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create garbage collection task");
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
+
 static nvs::Storage* lookup_storage_from_name(const char *name)
 {
     return NVSPartitionManager::get_instance()->lookup_storage_from_name(name);
@@ -114,9 +150,10 @@ extern "C" esp_err_t nvs_flash_init_partition_ptr(const esp_partition_t *partiti
 
     if (init_res != ESP_OK) {
         delete part;
+        return init_res;
     }
 
-    return init_res;
+    return start_gc_task();
 }
 
 #ifndef LINUX_HOST_LEGACY_TEST
@@ -128,7 +165,11 @@ extern "C" esp_err_t nvs_flash_init_partition(const char *part_name)
     }
     Lock lock;
 
-    return NVSPartitionManager::get_instance()->init_partition(part_name);
+    esp_err_t err = NVSPartitionManager::get_instance()->init_partition(part_name);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return start_gc_task();
 }
 
 extern "C" esp_err_t nvs_flash_init(void)
@@ -168,7 +209,11 @@ extern "C" esp_err_t nvs_flash_secure_init_partition(const char *part_name, nvs_
     }
     Lock lock;
 
-    return NVSPartitionManager::get_instance()->secure_init_partition(part_name, cfg);
+    esp_err_t err = NVSPartitionManager::get_instance()->secure_init_partition(part_name, cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return start_gc_task();
 }
 
 extern "C" esp_err_t nvs_flash_secure_init(nvs_sec_cfg_t* cfg)
@@ -408,7 +453,7 @@ extern "C" esp_err_t nvs_set_u64 (nvs_handle_t handle, const char* key, uint64_t
 extern "C" esp_err_t nvs_commit(nvs_handle_t c_handle)
 {
     Lock lock;
-    // no-op for now, to be used when intermediate cache is added
+    // writes the staged items if a transaction is open, no-op otherwise
     NVSHandleSimple *handle;
     auto err = nvs_find_ns_handle(c_handle, &handle);
     if (err != ESP_OK) {
@@ -417,6 +462,30 @@ extern "C" esp_err_t nvs_commit(nvs_handle_t c_handle)
     return handle->commit();
 }
 
+extern "C" esp_err_t nvs_transaction_begin(nvs_handle_t c_handle)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s", __func__);
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->begin_transaction();
+}
+
+extern "C" esp_err_t nvs_transaction_abort(nvs_handle_t c_handle)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s", __func__);
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return handle->abort_transaction();
+}
+
 extern "C" esp_err_t nvs_set_str(nvs_handle_t c_handle, const char* key, const char* value)
 {
     Lock lock;
@@ -535,6 +604,75 @@ extern "C" esp_err_t nvs_get_blob(nvs_handle_t c_handle, const char* key, void*
     return nvs_get_str_or_blob(c_handle, nvs::ItemType::BLOB, key, out_value, length);
 }
 
+extern "C" esp_err_t nvs_get_str_ptr(nvs_handle_t c_handle, const char* key, const char** out_value, size_t* length, nvs_lease_t* out_lease)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s", __func__, key);
+    if (out_value == nullptr || out_lease == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_span_t span;
+    size_t spanCount = 1;
+    size_t dataSize;
+    err = handle->get_item_spans(nvs::ItemType::SZ, key, &span, spanCount, dataSize, out_lease);
+    if (err != ESP_OK) {
+        return err;
+    }
+    *out_value = static_cast<const char*>(span.data);
+    if (length != nullptr) {
+        *length = dataSize;
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_get_blob_ptr(nvs_handle_t c_handle, const char* key, nvs_span_t* out_spans, size_t* span_count, size_t* length, nvs_lease_t* out_lease)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s", __func__, key);
+    if (span_count == nullptr || (out_spans != nullptr && out_lease == nullptr)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    NVSHandleSimple *handle;
+    auto err = nvs_find_ns_handle(c_handle, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t dataSize;
+    err = handle->get_item_spans(nvs::ItemType::BLOB, key, out_spans, *span_count, dataSize, out_lease);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (length != nullptr) {
+        *length = dataSize;
+    }
+    return ESP_OK;
+}
+
+extern "C" bool nvs_lease_is_valid(nvs_lease_t lease)
+{
+    Lock lock;
+    if (lease == nullptr) {
+        return false;
+    }
+    return nvs::Storage::isLeaseValid(lease);
+}
+
+extern "C" void nvs_lease_release(nvs_lease_t lease)
+{
+    Lock lock;
+    if (lease == nullptr) {
+        return;
+    }
+    nvs::Storage::releaseLease(lease);
+}
+
 extern "C" esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats)
 {
     Lock lock;
@@ -561,6 +699,23 @@ extern "C" esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats
     return pStorage->fillStats(*nvs_stats);
 }
 
+extern "C" esp_err_t nvs_gc_step(const char* part_name, size_t budget)
+{
+    Lock lock;
+    nvs::Storage* pStorage;
+
+    if (budget == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pStorage = lookup_storage_from_name((part_name == nullptr) ? NVS_DEFAULT_PART_NAME : part_name);
+    if (pStorage == nullptr) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    return pStorage->collectGarbage(budget);
+}
+
 extern "C" esp_err_t nvs_get_used_entry_count(nvs_handle_t c_handle, size_t* used_entries)
 {
     Lock lock;
@@ -33,6 +33,16 @@ public:
 
     esp_err_t write(size_t dst_offset, const void* src, size_t size) override;
 
+    /**
+     * The mapped content would be encrypted.
+     *
+     * @return ESP_ERR_NOT_SUPPORTED
+     */
+    esp_err_t mmap(size_t src_offset, size_t size, const void** out_ptr, esp_partition_mmap_handle_t* out_handle) override
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
 protected:
     mbedtls_aes_xts_context mEctxt;
     mbedtls_aes_xts_context mDctxt;
@@ -10,6 +10,7 @@
 namespace nvs {
 
 NVSHandleSimple::~NVSHandleSimple() {
+    delete mTransaction;
     NVSPartitionManager::get_instance()->close_handle(this);
 }
 
@@ -18,6 +19,9 @@ esp_err_t NVSHandleSimple::set_typed_item(ItemType datatype, const char *key, co
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
 
+    if (mTransaction) {
+        return mTransaction->set(datatype, key, data, dataSize);
+    }
     return mStoragePtr->writeItem(mNsIndex, datatype, key, data, dataSize);
 }
 
@@ -25,6 +29,10 @@ esp_err_t NVSHandleSimple::get_typed_item(ItemType datatype, const char *key, vo
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
 
+    esp_err_t err;
+    if (readStagedItem(datatype, key, data, dataSize, err)) {
+        return err;
+    }
     return mStoragePtr->readItem(mNsIndex, datatype, key, data, dataSize);
 }
 
@@ -33,6 +41,9 @@ esp_err_t NVSHandleSimple::set_string(const char *key, const char* str)
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
 
+    if (mTransaction) {
+        return mTransaction->set(nvs::ItemType::SZ, key, str, strlen(str) + 1);
+    }
     return mStoragePtr->writeItem(mNsIndex, nvs::ItemType::SZ, key, str, strlen(str) + 1);
 }
 
@@ -41,6 +52,9 @@ esp_err_t NVSHandleSimple::set_blob(const char *key, const void* blob, size_t le
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
 
+    if (mTransaction) {
+        return mTransaction->set(nvs::ItemType::BLOB, key, blob, len);
+    }
     return mStoragePtr->writeItem(mNsIndex, nvs::ItemType::BLOB, key, blob, len);
 }
 
@@ -48,6 +62,10 @@ esp_err_t NVSHandleSimple::get_string(const char *key, char* out_str, size_t len
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
 
+    esp_err_t err;
+    if (readStagedItem(nvs::ItemType::SZ, key, out_str, len, err)) {
+        return err;
+    }
     return mStoragePtr->readItem(mNsIndex, nvs::ItemType::SZ, key, out_str, len);
 }
 
@@ -55,6 +73,10 @@ esp_err_t NVSHandleSimple::get_blob(const char *key, void* out_blob, size_t len)
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
 
+    esp_err_t err;
+    if (readStagedItem(nvs::ItemType::BLOB, key, out_blob, len, err)) {
+        return err;
+    }
     return mStoragePtr->readItem(mNsIndex, nvs::ItemType::BLOB, key, out_blob, len);
 }
 
@@ -62,17 +84,45 @@ esp_err_t NVSHandleSimple::get_item_size(ItemType datatype, const char *key, siz
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
 
+    const Transaction::Entry *entry = mTransaction ? mTransaction->find(key) : nullptr;
+    if (entry) {
+        if (entry->isErased() || entry->datatype() != datatype) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        size = entry->dataSize();
+        return ESP_OK;
+    }
     return mStoragePtr->getItemDataSize(mNsIndex, datatype, key, size);
 }
 
+esp_err_t NVSHandleSimple::get_item_spans(ItemType datatype, const char *key, nvs_span_t *spans, size_t &spanCount,
+        size_t &dataSize, nvs_opaque_lease_t **lease)
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+
+    // staged values are not in flash yet
+    if (mTransaction && mTransaction->find(key)) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+    return mStoragePtr->readItemSpans(mNsIndex, datatype, key, spans, spanCount, dataSize, lease);
+}
+
 esp_err_t NVSHandleSimple::find_key(const char* key, nvs_type_t &nvstype)
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
 
     nvs::ItemType datatype;
-    esp_err_t err = mStoragePtr->findKey(mNsIndex, key, &datatype);
-    if(err != ESP_OK)
-        return err;
+    const Transaction::Entry *entry = mTransaction ? mTransaction->find(key) : nullptr;
+    esp_err_t err = ESP_OK;
+    if (entry) {
+        if (entry->isErased())
+            return ESP_ERR_NVS_NOT_FOUND;
+        datatype = entry->datatype();
+    } else {
+        err = mStoragePtr->findKey(mNsIndex, key, &datatype);
+        if(err != ESP_OK)
+            return err;
+    }
 
     if(datatype == ItemType::BLOB_IDX || datatype == ItemType::BLOB)
         datatype = ItemType::BLOB_DATA;
@@ -87,6 +137,13 @@ esp_err_t NVSHandleSimple::erase_item(const char* key)
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
 
+    if (mTransaction) {
+        const Transaction::Entry *entry = mTransaction->find(key);
+        if (entry ? entry->isErased() : mStoragePtr->findKey(mNsIndex, key, nullptr) == ESP_ERR_NVS_NOT_FOUND) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+        return mTransaction->erase(key);
+    }
     return mStoragePtr->eraseItem(mNsIndex, key);
 }
 
@@ -94,6 +151,7 @@ esp_err_t NVSHandleSimple::erase_all()
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mTransaction) return ESP_ERR_NVS_INVALID_STATE;
 
     return mStoragePtr->eraseNamespace(mNsIndex);
 }
@@ -101,10 +159,56 @@ esp_err_t NVSHandleSimple::erase_all()
 esp_err_t NVSHandleSimple::commit()
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!mTransaction) return ESP_OK;
+
+    esp_err_t err = mStoragePtr->writeItems(mNsIndex, *mTransaction);
+    delete mTransaction;
+    mTransaction = nullptr;
+    return err;
+}
+
+esp_err_t NVSHandleSimple::begin_transaction()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mTransaction) return ESP_ERR_NVS_INVALID_STATE;
+
+    mTransaction = new (std::nothrow) Transaction;
+    if (!mTransaction) return ESP_ERR_NO_MEM;
 
     return ESP_OK;
 }
 
+esp_err_t NVSHandleSimple::abort_transaction()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!mTransaction) return ESP_ERR_NVS_INVALID_STATE;
+
+    delete mTransaction;
+    mTransaction = nullptr;
+    return ESP_OK;
+}
+
+bool NVSHandleSimple::readStagedItem(ItemType datatype, const char *key, void* data, size_t dataSize, esp_err_t &err)
+{
+    const Transaction::Entry *entry = mTransaction ? mTransaction->find(key) : nullptr;
+    if (!entry) {
+        return false;
+    }
+
+    if (entry->isErased() || entry->datatype() != datatype) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (!isVariableLengthType(datatype) && dataSize != entry->dataSize()) {
+        err = ESP_ERR_NVS_TYPE_MISMATCH;
+    } else if (dataSize < entry->dataSize()) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(data, entry->data(), entry->dataSize());
+        err = ESP_OK;
+    }
+    return true;
+}
+
 esp_err_t NVSHandleSimple::get_used_entry_count(size_t& used_entries)
 {
     used_entries = 0;
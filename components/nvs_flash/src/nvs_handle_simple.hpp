@@ -8,6 +8,7 @@
 
 #include "intrusive_list.h"
 #include "nvs_storage.hpp"
+#include "nvs_transaction.hpp"
 #include "nvs_platform.hpp"
 
 #include "nvs_memory_management.hpp"
@@ -32,7 +33,8 @@ public:
         mStoragePtr(StoragePtr),
         mNsIndex(nsIndex),
         mReadOnly(readOnly),
-        valid(1)
+        valid(1),
+        mTransaction(nullptr)
     { }
 
     ~NVSHandleSimple();
@@ -59,10 +61,20 @@ public:
 
     esp_err_t commit() override;
 
+    esp_err_t begin_transaction() override;
+
+    esp_err_t abort_transaction() override;
+
     esp_err_t get_used_entry_count(size_t &usedEntries) override;
 
     esp_err_t getItemDataSize(ItemType datatype, const char *key, size_t &dataSize);
 
+    /**
+     * Zero-copy read of a string or blob, see Storage::readItemSpans.
+     */
+    esp_err_t get_item_spans(ItemType datatype, const char *key, nvs_span_t *spans, size_t &spanCount,
+            size_t &dataSize, nvs_opaque_lease_t **lease);
+
     void debugDump();
 
     esp_err_t fillStats(nvs_stats_t &nvsStats);
@@ -80,6 +92,11 @@ public:
     Storage *get_storage() const;
 
 private:
+    /**
+     * If key is staged in the open transaction, reads the staged value into data, sets err and returns true.
+     */
+    bool readStagedItem(ItemType datatype, const char *key, void *data, size_t dataSize, esp_err_t &err);
+
     /**
      * The underlying storage's object.
      */
@@ -101,6 +118,11 @@ private:
      * Upon opening, a handle is valid. It becomes invalid if the underlying storage is de-initialized.
      */
     uint8_t valid;
+
+    /**
+     * Changes staged since begin_transaction(), nullptr if no transaction is open.
+     */
+    Transaction *mTransaction;
 };
 
 } // nvs
@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "nvs_item_index.hpp"
+#include "esp_log.h"
+
+#define TAG "nvs_item_index"
+
+namespace nvs
+{
+
+ItemIndex::ItemIndex()
+{
+}
+
+ItemIndex::~ItemIndex()
+{
+    clear();
+}
+
+esp_err_t ItemIndex::init(size_t entryCount, size_t maxSize)
+{
+    clear();
+    mMaxSize = maxSize;
+
+    // Aim for about one bucket per four entries of the partition, but never
+    // spend more than a quarter of the memory budget on the bucket array.
+    size_t bucketCount = MIN_BUCKET_COUNT;
+    const size_t wanted = entryCount / 4;
+    while (bucketCount < wanted && bucketCount * 2 * sizeof(Node*) <= maxSize / 4) {
+        bucketCount *= 2;
+    }
+
+    if (bucketCount * sizeof(Node*) > maxSize / 4) {
+        return ESP_OK; // budget too small (or 0), stay inactive
+    }
+
+    mBuckets = new (std::nothrow) Node*[bucketCount];
+    if (!mBuckets) {
+        return ESP_ERR_NO_MEM;
+    }
+    std::fill_n(mBuckets, bucketCount, nullptr);
+    mBucketMask = bucketCount - 1;
+    mUsedSize = bucketCount * sizeof(Node*);
+    return ESP_OK;
+}
+
+void ItemIndex::clear()
+{
+    mBlockList.clearAndFreeNodes();
+    delete[] mBuckets;
+    mBuckets = nullptr;
+    mBucketMask = 0;
+    mFreeNodes = nullptr;
+    mUsedSize = 0;
+}
+
+void ItemIndex::disable()
+{
+    ESP_LOGW(TAG, "key index exceeds %u bytes, falling back to page scan", static_cast<unsigned>(mMaxSize));
+    clear();
+}
+
+ItemIndex::Node* ItemIndex::allocNode()
+{
+    if (!mFreeNodes) {
+        if (mUsedSize + sizeof(NodeBlock) > mMaxSize) {
+            return nullptr;
+        }
+        NodeBlock* block = new (std::nothrow) NodeBlock;
+        if (!block) {
+            return nullptr;
+        }
+        mBlockList.push_back(block);
+        mUsedSize += sizeof(NodeBlock);
+        for (size_t i = 0; i < NodeBlock::ENTRY_COUNT; ++i) {
+            block->mNodes[i].mNext = mFreeNodes;
+            mFreeNodes = &block->mNodes[i];
+        }
+    }
+    Node* node = mFreeNodes;
+    mFreeNodes = node->mNext;
+    return node;
+}
+
+void ItemIndex::insert(const Item& item, Page* page, size_t index)
+{
+    if (!isActive()) {
+        return;
+    }
+
+    Node* node = allocNode();
+    if (!node) {
+        // Missing nodes would make items invisible, so stop using the index altogether
+        disable();
+        return;
+    }
+
+    const uint32_t hash = hashOf(item);
+    Node*& bucket = mBuckets[hash & mBucketMask];
+    node->mPage = page;
+    node->mIndex = index;
+    node->mHash = hash;
+    node->mNext = bucket;
+    bucket = node;
+}
+
+void ItemIndex::erase(const Item& item, Page* page, size_t index)
+{
+    if (!isActive()) {
+        return;
+    }
+
+    const uint32_t hash = hashOf(item);
+    for (Node** it = &mBuckets[hash & mBucketMask]; *it; it = &(*it)->mNext) {
+        Node* node = *it;
+        if (node->mPage == page && node->mIndex == index) {
+            *it = node->mNext;
+            node->mNext = mFreeNodes;
+            mFreeNodes = node;
+            return;
+        }
+    }
+}
+
+void ItemIndex::erasePage(Page* page)
+{
+    if (!isActive()) {
+        return;
+    }
+
+    for (size_t i = 0; i <= mBucketMask; ++i) {
+        Node** it = &mBuckets[i];
+        while (*it) {
+            Node* node = *it;
+            if (node->mPage == page) {
+                *it = node->mNext;
+                node->mNext = mFreeNodes;
+                mFreeNodes = node;
+            } else {
+                it = &node->mNext;
+            }
+        }
+    }
+}
+
+const ItemIndex::Node* ItemIndex::find(uint8_t nsIndex, const char* key, uint8_t chunkIdx) const
+{
+    if (!isActive()) {
+        return nullptr;
+    }
+
+    const uint32_t hash = hashOf(Item(nsIndex, ItemType::ANY, 0, key, chunkIdx));
+    for (const Node* node = mBuckets[hash & mBucketMask]; node; node = node->mNext) {
+        if (node->mHash == hash) {
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+const ItemIndex::Node* ItemIndex::findNext(const Node* node) const
+{
+    for (const Node* it = node->mNext; it; it = it->mNext) {
+        if (it->mHash == node->mHash) {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace nvs
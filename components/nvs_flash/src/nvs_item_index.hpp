@@ -0,0 +1,142 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef nvs_item_index_hpp
+#define nvs_item_index_hpp
+
+#include "sdkconfig.h"
+#include "nvs.h"
+#include "nvs_types.hpp"
+#include "nvs_memory_management.hpp"
+#include "intrusive_list.h"
+
+namespace nvs
+{
+
+class Page;
+
+/**
+ * Partition-wide index of the items stored in the pages of one PageManager.
+ *
+ * The index maps the hash of <namespace index, key, chunk index> (the same hash the per-page HashList uses)
+ * to the page and entry index of every item having this hash. It only narrows down the search: the final
+ * match, including data type and blob version, is always done by Page::findItem. Hash collisions and stale
+ * nodes thus never produce wrong results, only an additional page lookup.
+ *
+ * Memory used by the index is bounded. Once the limit is hit, the index releases its memory and stays
+ * inactive until it is initialized again. Lookups then fall back to scanning all pages.
+ */
+class ItemIndex
+{
+public:
+#if CONFIG_NVS_KEY_INDEX
+    static const size_t DEFAULT_MAX_SIZE = CONFIG_NVS_KEY_INDEX_MAX_SIZE;
+#else
+    static const size_t DEFAULT_MAX_SIZE = 0;
+#endif
+
+    class Node
+    {
+    public:
+        Page* page() const
+        {
+            return mPage;
+        }
+
+        size_t index() const
+        {
+            return mIndex;
+        }
+
+    protected:
+        friend class ItemIndex;
+
+        Node* mNext;
+        Page* mPage;
+        uint32_t mIndex : 8;
+        uint32_t mHash  : 24;
+    };
+
+    ItemIndex();
+    ~ItemIndex();
+
+    /**
+     * Prepares an empty index for a partition with entryCount entries, using at most maxSize bytes of RAM.
+     * A maxSize of 0 leaves the index inactive.
+     */
+    esp_err_t init(size_t entryCount, size_t maxSize);
+
+    void clear();
+
+    bool isActive() const
+    {
+        return mBuckets != nullptr;
+    }
+
+    size_t getUsedSize() const
+    {
+        return mUsedSize;
+    }
+
+    void insert(const Item& item, Page* page, size_t index);
+
+    void erase(const Item& item, Page* page, size_t index);
+
+    void erasePage(Page* page);
+
+    /**
+     * Returns the first node which may hold the item identified by nsIndex, key and chunkIdx,
+     * nullptr if there is none. Use findNext to get the remaining candidates.
+     */
+    const Node* find(uint8_t nsIndex, const char* key, uint8_t chunkIdx) const;
+
+    const Node* findNext(const Node* node) const;
+
+    /**
+     * The index can only be used for lookups of a particular key. For BLOB_DATA with CHUNK_ANY,
+     * the chunk index is unknown and so is the hash.
+     */
+    static bool canLookup(uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx)
+    {
+        return nsIndex != NS_ANY && key != nullptr && (datatype != ItemType::BLOB_DATA || chunkIdx != Item::CHUNK_ANY);
+    }
+
+protected:
+    static const uint8_t NS_ANY = 255;
+    static const size_t MIN_BUCKET_COUNT = 16;
+
+    struct NodeBlock : public intrusive_list_node<NodeBlock>, public ExceptionlessAllocatable {
+        static const size_t ENTRY_COUNT = 32;
+
+        Node mNodes[ENTRY_COUNT];
+    };
+
+    typedef intrusive_list<NodeBlock> TBlockList;
+
+    static uint32_t hashOf(const Item& item)
+    {
+        return item.calculateCrc32WithoutValue() & 0xffffff;
+    }
+
+    Node* allocNode();
+
+    void disable();
+
+    Node** mBuckets = nullptr;
+    size_t mBucketMask = 0;
+    Node* mFreeNodes = nullptr;
+    TBlockList mBlockList;
+    size_t mMaxSize = 0;
+    size_t mUsedSize = 0;
+
+private:
+    ItemIndex(const ItemIndex& other);
+    const ItemIndex& operator= (const ItemIndex& rhs);
+}; // class ItemIndex
+
+} // namespace nvs
+
+#endif /* nvs_item_index_hpp */
@@ -22,16 +22,19 @@ uint32_t Page::Header::calculateCrc32()
                     offsetof(Header, mCrc32) - offsetof(Header, mSeqNumber));
 }
 
-esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
+esp_err_t Page::load(Partition *partition, uint32_t sectorNumber, ItemIndex *itemIndex, bool lazy)
 {
     if (partition == nullptr) {
         return ESP_ERR_INVALID_ARG;
     }
 
     mPartition = partition;
+    mItemIndex = itemIndex;
     mBaseAddress = sectorNumber * SEC_SIZE;
     mUsedEntryCount = 0;
     mErasedEntryCount = 0;
+    mItemsPending = false;
+    mNewerItems = nullptr;
 
     Header header;
     auto rc = mPartition->read_raw(mBaseAddress, &header, sizeof(header));
@@ -81,6 +84,8 @@ esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
     case PageState::FULL:
     case PageState::ACTIVE:
     case PageState::FREEING:
+        // the active page is written to and a freeing page is copied right away, only full pages wait
+        mItemsPending = lazy && mState == PageState::FULL;
         return mLoadEntryTable();
         break;
 
@@ -206,6 +211,10 @@ esp_err_t Page::writeItem(uint8_t nsIndex, ItemType datatype, const char* key, c
         return err;
     }
 
+    if (mItemIndex) {
+        mItemIndex->insert(item, this, mNextFreeEntry);
+    }
+
     if (!isVariableLengthType(datatype)) {
         memcpy(item.data, data, dataSize);
         item.crc32 = item.calculateCrc32();
@@ -247,6 +256,164 @@ esp_err_t Page::writeItem(uint8_t nsIndex, ItemType datatype, const char* key, c
     return ESP_OK;
 }
 
+esp_err_t Page::writeEntries(size_t index, const void* data, size_t count)
+{
+    uint32_t phyAddr;
+    esp_err_t err = getEntryAddress(index, &phyAddr);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = mPartition->write(phyAddr, data, count * ENTRY_SIZE);
+    if (err != ESP_OK) {
+        mState = PageState::INVALID;
+        return err;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Page::writeItems(uint8_t nsIndex, const BatchItem* items, size_t count)
+{
+    esp_err_t err;
+
+    if (mState == PageState::INVALID) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    if (mState == PageState::UNINITIALIZED) {
+        err = initialize();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (mState == PageState::FULL) {
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    NVS_ASSERT_OR_RETURN(count <= BATCH_MAX_ITEMS, ESP_ERR_INVALID_ARG);
+
+    size_t entriesCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const BatchItem& src = items[i];
+        if (strlen(src.key) > Item::MAX_KEY_LENGTH) {
+            return ESP_ERR_NVS_KEY_TOO_LONG;
+        }
+        if (src.dataSize > Page::CHUNK_MAX_SIZE) {
+            return ESP_ERR_NVS_VALUE_TOO_LONG;
+        }
+        if ((!isVariableLengthType(src.datatype)) && src.dataSize > 8) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        entriesCount += getEntryCount(src.datatype, src.dataSize);
+    }
+
+    if (mNextFreeEntry == INVALID_ENTRY || mNextFreeEntry + entriesCount > ENTRY_COUNT) {
+        // page will not fit this amount of data
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    const size_t begin = mNextFreeEntry;
+    size_t index = begin;
+    for (size_t i = 0; i < count; ++i) {
+        const BatchItem& src = items[i];
+        const size_t span = getEntryCount(src.datatype, src.dataSize);
+        Item item(nsIndex, src.datatype, span, src.key);
+        err = mHashList.insert(item, index);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (mItemIndex) {
+            mItemIndex->insert(item, this, index);
+        }
+        index += span;
+    }
+
+    // Entries are collected in the burst buffer and programmed together. The entry
+    // state table is only updated once everything is in flash, so after a power loss
+    // the whole batch is either visible or discarded by mLoadEntryTable.
+    Item burst[BURST_ENTRY_COUNT];
+    size_t burstStart = begin;
+    size_t burstCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const BatchItem& src = items[i];
+        const size_t span = getEntryCount(src.datatype, src.dataSize);
+        if (burstCount == BURST_ENTRY_COUNT) {
+            err = writeEntries(burstStart, burst, burstCount);
+            if (err != ESP_OK) {
+                return err;
+            }
+            burstStart += burstCount;
+            burstCount = 0;
+        }
+
+        Item& item = burst[burstCount++];
+        item = Item(nsIndex, src.datatype, span, src.key);
+        if (!isVariableLengthType(src.datatype)) {
+            memcpy(item.data, src.data, src.dataSize);
+            item.crc32 = item.calculateCrc32();
+            continue;
+        }
+
+        const uint8_t* data = static_cast<const uint8_t*>(src.data);
+        item.varLength.dataCrc32 = Item::calculateCrc32(data, src.dataSize);
+        item.varLength.dataSize = src.dataSize;
+        item.varLength.reserved = 0xffff;
+        item.crc32 = item.calculateCrc32();
+
+        size_t rest = src.dataSize % ENTRY_SIZE;
+        size_t left = src.dataSize - rest;
+        if (left > 0) {
+            err = writeEntries(burstStart, burst, burstCount);
+            if (err != ESP_OK) {
+                return err;
+            }
+            burstStart += burstCount;
+            burstCount = 0;
+            err = writeEntries(burstStart, data, left / ENTRY_SIZE);
+            if (err != ESP_OK) {
+                return err;
+            }
+            burstStart += left / ENTRY_SIZE;
+        }
+
+        if (rest > 0) {
+            if (burstCount == BURST_ENTRY_COUNT) {
+                err = writeEntries(burstStart, burst, burstCount);
+                if (err != ESP_OK) {
+                    return err;
+                }
+                burstStart += burstCount;
+                burstCount = 0;
+            }
+            Item& tail = burst[burstCount++];
+            std::fill_n(tail.rawData, ENTRY_SIZE, 0xff);
+            memcpy(tail.rawData, data + left, rest);
+        }
+    }
+    if (burstCount > 0) {
+        err = writeEntries(burstStart, burst, burstCount);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    err = alterEntryRangeState(begin, begin + entriesCount, EntryState::WRITTEN);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (mFirstUsedEntry == INVALID_ENTRY) {
+        mFirstUsedEntry = begin;
+    }
+    mUsedEntryCount += entriesCount;
+    mNextFreeEntry += entriesCount;
+    return ESP_OK;
+}
+
 esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx, VerOffset chunkStart)
 {
     size_t index = 0;
@@ -274,19 +441,37 @@ esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, vo
         return ESP_ERR_NVS_INVALID_LENGTH;
     }
 
+    if (getEntryCount(item.datatype, item.varLength.dataSize) > item.span) {
+        // data size doesn't match the entries written, handle it like a CRC mismatch
+        rc = eraseEntryAndSpan(index);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    // whole entries are read directly into the destination, only the last one goes through an Item
     uint8_t* dst = reinterpret_cast<uint8_t*>(data);
-    size_t left = item.varLength.dataSize;
-    for (size_t i = index + 1; i < index + item.span; ++i) {
+    size_t rest = item.varLength.dataSize % ENTRY_SIZE;
+    size_t left = item.varLength.dataSize - rest;
+    if (left > 0) {
+        uint32_t phyAddr;
+        rc = getEntryAddress(index + 1, &phyAddr);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        rc = mPartition->read(phyAddr, dst, left);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+    }
+    if (rest > 0) {
         Item ditem;
-        rc = readEntry(i, ditem);
+        rc = readEntry(index + 1 + left / ENTRY_SIZE, ditem);
         if (rc != ESP_OK) {
             return rc;
         }
-        size_t willCopy = ENTRY_SIZE;
-        willCopy = (left < willCopy)?left:willCopy;
-        memcpy(dst, ditem.rawData, willCopy);
-        left -= willCopy;
-        dst += willCopy;
+        memcpy(dst + left, ditem.rawData, rest);
     }
     if (Item::calculateCrc32(reinterpret_cast<uint8_t*>(data), item.varLength.dataSize) != item.varLength.dataCrc32) {
         rc = eraseEntryAndSpan(index);
@@ -396,6 +581,9 @@ esp_err_t Page::eraseEntryAndSpan(size_t index)
             }
         } else {
             mHashList.erase(index);
+            if (mItemIndex) {
+                mItemIndex->erase(item, this, index);
+            }
             span = item.span;
             for (ptrdiff_t i = index + span - 1; i >= static_cast<ptrdiff_t>(index); --i) {
                 rc = mEntryTable.get(i, &state);
@@ -437,6 +625,94 @@ esp_err_t Page::eraseEntryAndSpan(size_t index)
     return ESP_OK;
 }
 
+esp_err_t Page::eraseEntries(const size_t* indices, size_t count)
+{
+    const ptrdiff_t wordCount = TEntryTable::byteSize() / sizeof(uint32_t);
+    static_assert(TEntryTable::byteSize() / sizeof(uint32_t) <= 32, "dirty word mask too small");
+    uint32_t dirtyWords = 0;
+    esp_err_t err;
+
+    for (size_t n = 0; n < count; ++n) {
+        const size_t index = indices[n];
+        NVS_ASSERT_OR_RETURN(index < ENTRY_COUNT, ESP_FAIL);
+
+        EntryState state;
+        err = mEntryTable.get(index, &state);
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        size_t span = 1;
+        if (state == EntryState::WRITTEN) {
+            Item item;
+            err = readEntry(index, item);
+            if (err != ESP_OK) {
+                return err;
+            }
+            mHashList.erase(index);
+            if (item.calculateCrc32() == item.crc32) {
+                if (mItemIndex) {
+                    mItemIndex->erase(item, this, index);
+                }
+                span = item.span;
+                NVS_ASSERT_OR_RETURN(index + span <= ENTRY_COUNT, ESP_FAIL);
+            }
+            for (size_t i = index; i < index + span; ++i) {
+                err = mEntryTable.get(i, &state);
+                if (err != ESP_OK) {
+                    return err;
+                }
+                if (state == EntryState::WRITTEN) {
+                    --mUsedEntryCount;
+                }
+                ++mErasedEntryCount;
+            }
+        }
+
+        for (size_t i = index; i < index + span; ++i) {
+            err = mEntryTable.set(i, EntryState::ERASED);
+            if (err != ESP_OK) {
+                return err;
+            }
+            dirtyWords |= 1u << mEntryTable.getWordIndex(i);
+        }
+
+        if (index + span > mNextFreeEntry) {
+            mNextFreeEntry = index + span;
+        }
+    }
+
+    // Write runs of modified words, last word first as alterEntryRangeState does
+    for (ptrdiff_t last = wordCount - 1; last >= 0; --last) {
+        if (!(dirtyWords & (1u << last))) {
+            continue;
+        }
+        ptrdiff_t first = last;
+        while (first > 0 && (dirtyWords & (1u << (first - 1)))) {
+            --first;
+        }
+        err = mPartition->write_raw(mBaseAddress + ENTRY_TABLE_OFFSET + static_cast<uint32_t>(first) * 4,
+                mEntryTable.data() + first, (last - first + 1) * 4);
+        if (err != ESP_OK) {
+            mState = PageState::INVALID;
+            return err;
+        }
+        last = first;
+    }
+
+    if (mFirstUsedEntry != INVALID_ENTRY) {
+        EntryState state;
+        err = mEntryTable.get(mFirstUsedEntry, &state);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (state != EntryState::WRITTEN) {
+            return updateFirstUsedEntry(mFirstUsedEntry, 1);
+        }
+    }
+    return ESP_OK;
+}
+
 esp_err_t Page::updateFirstUsedEntry(size_t index, size_t span)
 {
     NVS_ASSERT_OR_RETURN(index == mFirstUsedEntry, ESP_FAIL);
@@ -462,6 +738,11 @@ esp_err_t Page::updateFirstUsedEntry(size_t index, size_t span)
 
 esp_err_t Page::copyItems(Page& other)
 {
+    auto rc = loadItems();
+    if (rc != ESP_OK) {
+        return rc;
+    }
+
     if (mFirstUsedEntry == INVALID_ENTRY) {
         return ESP_ERR_NVS_NOT_FOUND;
     }
@@ -498,6 +779,10 @@ esp_err_t Page::copyItems(Page& other)
             return err;
         }
 
+        if (other.mItemIndex) {
+            other.mItemIndex->insert(entry, &other, other.mNextFreeEntry);
+        }
+
         err = other.writeEntry(entry);
         if (err != ESP_OK) {
             return err;
@@ -520,6 +805,69 @@ esp_err_t Page::copyItems(Page& other)
     return ESP_OK;
 }
 
+esp_err_t Page::moveItems(Page& other, size_t maxEntries, size_t& movedEntries)
+{
+    movedEntries = 0;
+
+    auto rc = loadItems();
+    if (rc != ESP_OK) {
+        return rc;
+    }
+
+    if (other.mState == PageState::UNINITIALIZED) {
+        rc = other.initialize();
+        if (rc != ESP_OK) {
+            return rc;
+        }
+    }
+
+    Item entry;
+    while (mFirstUsedEntry != INVALID_ENTRY && movedEntries < maxEntries) {
+        const size_t index = mFirstUsedEntry;
+        rc = readEntry(index, entry);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        const size_t span = entry.span;
+        NVS_ASSERT_OR_RETURN(span > 0 && index + span <= ENTRY_COUNT, ESP_FAIL);
+
+        if (other.getFreeEntryCount() < span) {
+            return ESP_ERR_NVS_PAGE_FULL;
+        }
+
+        rc = other.mHashList.insert(entry, other.mNextFreeEntry);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+
+        if (other.mItemIndex) {
+            other.mItemIndex->insert(entry, &other, other.mNextFreeEntry);
+        }
+
+        rc = other.writeEntry(entry);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+
+        for (size_t i = index + 1; i < index + span; ++i) {
+            readEntry(i, entry);
+            rc = other.writeEntry(entry);
+            if (rc != ESP_OK) {
+                return rc;
+            }
+        }
+
+        // the copy is complete, if power goes out before the original is erased,
+        // PageManager::load finds the duplicate and keeps the copy
+        rc = eraseEntryAndSpan(index);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        movedEntries += span;
+    }
+    return ESP_OK;
+}
+
 esp_err_t Page::mLoadEntryTable()
 {
     // for states where we actually care about data in the page, read entry state table
@@ -657,6 +1005,10 @@ esp_err_t Page::mLoadEntryTable()
                 return err;
             }
 
+            if (mItemIndex) {
+                mItemIndex->insert(item, this, i);
+            }
+
             // search for potential duplicate item
             size_t duplicateIndex = mHashList.find(0, item);
 
@@ -703,65 +1055,105 @@ esp_err_t Page::mLoadEntryTable()
                 }
             }
         }
-    } else if (mState == PageState::FULL || mState == PageState::FREEING) {
-        // We have already filled mHashList for page in active state.
-        // Do the same for the case when page is in full or freeing state.
-        Item item;
-        for (size_t i = mFirstUsedEntry; i < ENTRY_COUNT; ++i) {
-            auto err = mEntryTable.get(i, &state);
-            if (err != ESP_OK) {
-                return err;
-            }
-            if (state != EntryState::WRITTEN) {
-                continue;
-            }
+    } else if ((mState == PageState::FULL || mState == PageState::FREEING) && !mItemsPending) {
+        return mLoadItems();
+    }
 
-            err = readEntry(i, item);
-            if (err != ESP_OK) {
-                mState = PageState::INVALID;
-                return err;
-            }
+    return ESP_OK;
+}
 
-            if (item.crc32 != item.calculateCrc32()) {
-                err = eraseEntryAndSpan(i);
-                if (err != ESP_OK) {
-                    mState = PageState::INVALID;
-                    return err;
-                }
-                continue;
-            }
+esp_err_t Page::mLoadItems()
+{
+    // mLoadEntryTable fills mHashList for the active page.
+    // Do the same for a page in full or freeing state.
+    EntryState state;
+    Item item;
+    for (size_t i = mFirstUsedEntry; i < ENTRY_COUNT; ++i) {
+        auto err = mEntryTable.get(i, &state);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (state != EntryState::WRITTEN) {
+            continue;
+        }
 
-            NVS_ASSERT_OR_RETURN(item.span > 0, ESP_FAIL);
+        err = readEntry(i, item);
+        if (err != ESP_OK) {
+            mState = PageState::INVALID;
+            return err;
+        }
 
-            err = mHashList.insert(item, i);
+        if (item.crc32 != item.calculateCrc32()) {
+            err = eraseEntryAndSpan(i);
             if (err != ESP_OK) {
                 mState = PageState::INVALID;
                 return err;
             }
+            continue;
+        }
 
-            size_t span = item.span;
+        NVS_ASSERT_OR_RETURN(item.span > 0, ESP_FAIL);
 
-            if (isVariableLengthType(item.datatype)) {
-                for (size_t j = i + 1; j < i + span; ++j) {
-                    err = mEntryTable.get(j, &state);
-                    if (err != ESP_OK) {
-                        return err;
-                    }
-                    if (state != EntryState::WRITTEN) {
-                        eraseEntryAndSpan(i);
-                        break;
-                    }
+        err = mHashList.insert(item, i);
+        if (err != ESP_OK) {
+            mState = PageState::INVALID;
+            return err;
+        }
+
+        if (mItemIndex) {
+            mItemIndex->insert(item, this, i);
+        }
+
+        size_t span = item.span;
+
+        if (isVariableLengthType(item.datatype)) {
+            for (size_t j = i + 1; j < i + span; ++j) {
+                err = mEntryTable.get(j, &state);
+                if (err != ESP_OK) {
+                    return err;
+                }
+                if (state != EntryState::WRITTEN) {
+                    eraseEntryAndSpan(i);
+                    break;
                 }
             }
-
-            i += span - 1;
         }
 
+        i += span - 1;
     }
 
     return ESP_OK;
 }
 
+esp_err_t Page::loadItems()
+{
+    if (!mItemsPending) {
+        return ESP_OK;
+    }
+    mItemsPending = false;
+
+    auto err = mLoadItems();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // if power went out after a newer item was written but before this one was erased,
+    // erase it now, same as PageManager::load does for pages which are not loaded lazily
+    const NewerItems* newerItems = mNewerItems;
+    mNewerItems = nullptr;
+    if (newerItems == nullptr) {
+        return ESP_OK;
+    }
+    for (size_t i = 0; i < newerItems->count; ++i) {
+        const Item& item = newerItems->items[i];
+        if (eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) != ESP_OK
+                && item.datatype == ItemType::BLOB_IDX) {
+            // the blob may have been stored in the old format before
+            eraseItem(item.nsIndex, ItemType::BLOB, item.key, item.chunkIndex);
+        }
+    }
+    return ESP_OK;
+}
 
 esp_err_t Page::initialize()
 {
@@ -864,6 +1256,11 @@ esp_err_t Page::findItem(uint8_t nsIndex, ItemType datatype, const char* key, si
         return ESP_ERR_NVS_NOT_FOUND;
     }
 
+    esp_err_t rc = loadItems();
+    if (rc != ESP_OK) {
+        return rc;
+    }
+
     size_t findBeginIndex = itemIndex;
     if (findBeginIndex >= ENTRY_COUNT) {
         return ESP_ERR_NVS_NOT_FOUND;
@@ -893,7 +1290,6 @@ esp_err_t Page::findItem(uint8_t nsIndex, ItemType datatype, const char* key, si
 
     size_t next;
     EntryState state;
-    esp_err_t rc;
     for (size_t i = start; i < end; i = next) {
         next = i + 1;
         rc = mEntryTable.get(i, &state);
@@ -1022,6 +1418,7 @@ esp_err_t Page::setVersion(uint8_t ver)
 
 esp_err_t Page::erase()
 {
+    ++mEraseGeneration;
     auto rc = mPartition->erase_range(mBaseAddress, SPI_FLASH_SEC_SIZE);
     if (rc != ESP_OK) {
         mState = PageState::INVALID;
@@ -1032,7 +1429,12 @@ esp_err_t Page::erase()
     mFirstUsedEntry = INVALID_ENTRY;
     mNextFreeEntry = INVALID_ENTRY;
     mState = PageState::UNINITIALIZED;
+    mItemsPending = false;
+    mNewerItems = nullptr;
     mHashList.clear();
+    if (mItemIndex) {
+        mItemIndex->erasePage(this);
+    }
     return ESP_OK;
 }
 
@@ -1127,8 +1529,6 @@ void Page::debugDump() const
 
 esp_err_t Page::calcEntries(nvs_stats_t &nvsStats)
 {
-    NVS_ASSERT_OR_RETURN(mState != PageState::FREEING, ESP_FAIL);
-
     nvsStats.total_entries += ENTRY_COUNT;
 
     switch (mState) {
@@ -1139,6 +1539,7 @@ esp_err_t Page::calcEntries(nvs_stats_t &nvsStats)
 
         case PageState::FULL:
         case PageState::ACTIVE:
+        case PageState::FREEING:
             nvsStats.used_entries += mUsedEntryCount;
             nvsStats.free_entries += ENTRY_COUNT - mUsedEntryCount; // it's equivalent free + erase entries.
             break;
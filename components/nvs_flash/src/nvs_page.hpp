@@ -16,6 +16,7 @@
 #include "compressed_enum_table.hpp"
 #include "intrusive_list.h"
 #include "nvs_item_hash_list.hpp"
+#include "nvs_item_index.hpp"
 #include "nvs_memory_management.hpp"
 #include "partition.hpp"
 
@@ -49,6 +50,13 @@ public:
 
     static const uint8_t NVS_VERSION = 0xfe; // Decrement to upgrade
 
+    /**
+     * Maximum number of items written by one call to writeItems. If power goes out before a batch
+     * has erased the previous versions of its items, PageManager::load removes the duplicates
+     * among this many trailing items of the last page.
+     */
+    static const size_t BATCH_MAX_ITEMS = 16;
+
     enum class PageState : uint32_t {
         // All bits set, default state after flash erase. Page has not been initialized yet.
         UNINITIALIZED = 0xffffffff,
@@ -78,7 +86,36 @@ public:
         return mState;
     }
 
-    esp_err_t load(Partition *partition, uint32_t sectorNumber);
+    /**
+     * With lazy set, a full page only reads its header and entry state table. Its items are read,
+     * checked and added to the hash list on first access, see loadItems.
+     */
+    esp_err_t load(Partition *partition, uint32_t sectorNumber, ItemIndex *itemIndex = nullptr, bool lazy = false);
+
+    /**
+     * Items found at the end of the last page when the partition was loaded. If power went out
+     * before their previous versions were erased, the duplicates are on pages which were loaded lazily.
+     */
+    struct NewerItems {
+        size_t count;
+        Item items[BATCH_MAX_ITEMS];
+    };
+
+    /**
+     * Loads the items of a lazily loaded page and erases older duplicates of the newer items.
+     * Does nothing if the items are loaded already.
+     */
+    esp_err_t loadItems();
+
+    bool itemsLoaded() const
+    {
+        return !mItemsPending;
+    }
+
+    void setNewerItems(const NewerItems* newerItems)
+    {
+        mNewerItems = newerItems;
+    }
 
     esp_err_t getSeqNumber(uint32_t& seqNumber) const;
 
@@ -100,6 +137,49 @@ public:
 
     esp_err_t eraseEntryAndSpan(size_t index);
 
+    /**
+     * Item written by writeItems. Only types which fit into a single page are supported,
+     * i.e. primitive types and strings.
+     */
+    struct BatchItem {
+        ItemType datatype;
+        const char* key;
+        const void* data;
+        size_t dataSize;
+    };
+
+    /**
+     * Writes count items back to back. Entries are programmed in bursts and their states
+     * are updated in one pass after all data is in flash. Either all items fit into the page
+     * or ESP_ERR_NVS_PAGE_FULL is returned and nothing is written.
+     */
+    esp_err_t writeItems(uint8_t nsIndex, const BatchItem* items, size_t count);
+
+    /**
+     * Same as calling eraseEntryAndSpan for each of the count indices, but every modified
+     * word of the entry state table is written only once.
+     */
+    esp_err_t eraseEntries(const size_t* indices, size_t count);
+
+    static size_t getEntryCount(ItemType datatype, size_t dataSize)
+    {
+        if (!isVariableLengthType(datatype)) {
+            return 1;
+        }
+        return 1 + (dataSize + ENTRY_SIZE - 1) / ENTRY_SIZE;
+    }
+
+    size_t getFreeEntryCount() const
+    {
+        if (mState == PageState::UNINITIALIZED) {
+            return ENTRY_COUNT;
+        }
+        if (mState != PageState::ACTIVE || mNextFreeEntry >= ENTRY_COUNT) {
+            return 0;
+        }
+        return ENTRY_COUNT - mNextFreeEntry;
+    }
+
     template<typename T>
     esp_err_t writeItem(uint8_t nsIndex, const char* key, const T& value)
     {
@@ -141,10 +221,54 @@ public:
 
     esp_err_t copyItems(Page& other);
 
+    /**
+     * Moves items to other in order, erasing each item from this page after its copy is written.
+     * Stops once this page is empty or at least maxEntries entries were moved.
+     * Returns ESP_ERR_NVS_PAGE_FULL if the next item doesn't fit into other.
+     */
+    esp_err_t moveItems(Page& other, size_t maxEntries, size_t& movedEntries);
+
     esp_err_t erase();
 
     void debugDump() const;
 
+    /**
+     * Offset of entry from the beginning of the partition.
+     */
+    esp_err_t getEntryAddress(size_t entry, uint32_t *address) const
+    {
+        NVS_ASSERT_OR_RETURN(entry < ENTRY_COUNT, ESP_FAIL);
+        *address =  mBaseAddress + ENTRY_DATA_OFFSET + static_cast<uint32_t>(entry) * ENTRY_SIZE;
+        return ESP_OK;
+    }
+
+    /**
+     * Pages pinned by a lease on their data are only freed by garbage collection
+     * if no other page can be freed.
+     */
+    void pin()
+    {
+        ++mPinCount;
+    }
+
+    void unpin()
+    {
+        --mPinCount;
+    }
+
+    bool isPinned() const
+    {
+        return mPinCount > 0;
+    }
+
+    /**
+     * Incremented each time the page is erased. Leases compare it to detect that their data is gone.
+     */
+    uint32_t getEraseGeneration() const
+    {
+        return mEraseGeneration;
+    }
+
     esp_err_t calcEntries(nvs_stats_t &nvsStats);
 
 protected:
@@ -176,6 +300,8 @@ protected:
 
     esp_err_t mLoadEntryTable();
 
+    esp_err_t mLoadItems();
+
     esp_err_t initialize();
 
     esp_err_t alterEntryState(size_t index, EntryState state);
@@ -190,6 +316,8 @@ protected:
 
     esp_err_t writeEntryData(const uint8_t* data, size_t size);
 
+    esp_err_t writeEntries(size_t index, const void* data, size_t count);
+
     esp_err_t updateFirstUsedEntry(size_t index, size_t span);
 
     static constexpr size_t getAlignmentForType(ItemType type)
@@ -197,13 +325,6 @@ protected:
         return static_cast<uint8_t>(type) & 0x0f;
     }
 
-    esp_err_t getEntryAddress(size_t entry, uint32_t *address) const
-    {
-        NVS_ASSERT_OR_RETURN(entry < ENTRY_COUNT, ESP_FAIL);
-        *address =  mBaseAddress + ENTRY_DATA_OFFSET + static_cast<uint32_t>(entry) * ENTRY_SIZE;
-        return ESP_OK;
-    }
-
     static const char* pageStateToName(PageState ps);
 
 
@@ -218,18 +339,30 @@ protected:
     size_t mFirstUsedEntry = INVALID_ENTRY;
     uint16_t mUsedEntryCount = 0;
     uint16_t mErasedEntryCount = 0;
+    uint16_t mPinCount = 0;
+    uint32_t mEraseGeneration = 0;
+    bool mItemsPending = false;
+    const NewerItems *mNewerItems = nullptr;
 
     /**
      * This hash list stores hashes of namespace index, key, and ChunkIndex for quick lookup when searching items.
      */
     HashList mHashList;
 
+    /**
+     * Optional partition-wide index owned by the PageManager, kept in sync with mHashList.
+     */
+    ItemIndex *mItemIndex = nullptr;
+
     Partition *mPartition;
 
     static const uint32_t HEADER_OFFSET = 0;
     static const uint32_t ENTRY_TABLE_OFFSET = HEADER_OFFSET + 32;
     static const uint32_t ENTRY_DATA_OFFSET = ENTRY_TABLE_OFFSET + 32;
 
+    // number of entries writeItems collects in RAM before programming them
+    static const size_t BURST_ENTRY_COUNT = 8;
+
     static_assert(sizeof(Header) == 32, "header size must be 32 bytes");
     static_assert(ENTRY_TABLE_OFFSET % 32 == 0, "entry table offset should be aligned");
     static_assert(ENTRY_DATA_OFFSET % 32 == 0, "entry data offset should be aligned");
@@ -7,7 +7,7 @@
 
 namespace nvs
 {
-esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t sectorCount)
+esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t sectorCount, size_t indexMaxSize, bool lazy)
 {
     if (partition == nullptr) {
         return ESP_ERR_INVALID_ARG;
@@ -17,12 +17,20 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
     mPageCount = sectorCount;
     mPageList.clear();
     mFreePageList.clear();
+    mNewerItems.reset();
+    mFreeingPage = nullptr;
+    mItemsLoaded = !lazy;
     mPages.reset(new (nothrow) Page[sectorCount]);
 
     if (!mPages) return ESP_ERR_NO_MEM;
 
+    auto err = mItemIndex.init(sectorCount * Page::ENTRY_COUNT, indexMaxSize);
+    if (err != ESP_OK) {
+        return err;
+    }
+
     for (uint32_t i = 0; i < sectorCount; ++i) {
-        auto err = mPages[i].load(partition, baseSector + i);
+        err = mPages[i].load(partition, baseSector + i, &mItemIndex, lazy);
         if (err != ESP_OK) {
             return err;
         }
@@ -47,7 +55,7 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
         return activatePage();
     } else {
         uint32_t lastSeqNo;
-        auto err = mPageList.back().getSeqNumber(lastSeqNo);
+        err = mPageList.back().getSeqNumber(lastSeqNo);
         if (err != ESP_OK) {
             return err;
         }
@@ -55,62 +63,125 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
     }
 
     // if power went out after a new item for the given key was written,
-    // but before the old one was erased, we end up with a duplicate item
+    // but before the old one was erased, we end up with a duplicate item.
+    // Page::writeItems may have left up to BATCH_MAX_ITEMS of them at the end of the last page.
     Page& lastPage = back();
-    size_t lastItemIndex = SIZE_MAX;
+    err = lastPage.loadItems();
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t lastItemIndices[Page::BATCH_MAX_ITEMS];
+    size_t lastItemCount = 0;
     Item item;
     size_t itemIndex = 0;
     while (lastPage.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+        lastItemIndices[lastItemCount % Page::BATCH_MAX_ITEMS] = itemIndex;
+        ++lastItemCount;
         itemIndex += item.span;
-        lastItemIndex = itemIndex;
     }
 
-    if (lastItemIndex != SIZE_MAX) {
-        auto last = PageManager::TPageListIterator(&lastPage);
-        TPageListIterator it;
-
-        for (it = begin(); it != last; ++it) {
-
-            if ((it->state() != Page::PageState::FREEING) &&
-                    (it->eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) == ESP_OK)) {
-                break;
+    const size_t firstChecked = (lastItemCount > Page::BATCH_MAX_ITEMS) ? lastItemCount - Page::BATCH_MAX_ITEMS : 0;
+    bool freeingFound = std::any_of(begin(), end(), [](const Page& page) -> bool {
+        return page.state() == Page::PageState::FREEING;
+    });
+    if (lazy && !freeingFound && lastItemCount > 0) {
+        // searching the older pages would load all of them. Instead, each lazily loaded page
+        // erases its duplicates of these items once its own items are loaded.
+        mNewerItems.reset(new (nothrow) Page::NewerItems);
+        if (!mNewerItems) {
+            return ESP_ERR_NO_MEM;
+        }
+        mNewerItems->count = 0;
+        for (size_t i = firstChecked; i < lastItemCount; ++i) {
+            itemIndex = lastItemIndices[i % Page::BATCH_MAX_ITEMS];
+            if (lastPage.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+                mNewerItems->items[mNewerItems->count++] = item;
             }
         }
-        if ((it == last) && (item.datatype == ItemType::BLOB_IDX)) {
-            /* Rare case in which the blob was stored using old format, but power went just after writing
-             * blob index during modification. Loop again and delete the old version blob*/
+        for (auto it = begin(); it != end(); ++it) {
+            if (!it->itemsLoaded()) {
+                it->setNewerItems(mNewerItems.get());
+            }
+        }
+    } else {
+        for (size_t i = firstChecked; i < lastItemCount; ++i) {
+            itemIndex = lastItemIndices[i % Page::BATCH_MAX_ITEMS];
+            if (lastPage.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) != ESP_OK) {
+                continue;
+            }
+            auto last = PageManager::TPageListIterator(&lastPage);
+            TPageListIterator it;
+
             for (it = begin(); it != last; ++it) {
 
                 if ((it->state() != Page::PageState::FREEING) &&
-                        (it->eraseItem(item.nsIndex, ItemType::BLOB, item.key, item.chunkIndex) == ESP_OK)) {
+                        (it->eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) == ESP_OK)) {
                     break;
                 }
             }
+            if ((it == last) && (item.datatype == ItemType::BLOB_IDX)) {
+                /* Rare case in which the blob was stored using old format, but power went just after writing
+                 * blob index during modification. Loop again and delete the old version blob*/
+                for (it = begin(); it != last; ++it) {
+
+                    if ((it->state() != Page::PageState::FREEING) &&
+                            (it->eraseItem(item.nsIndex, ItemType::BLOB, item.key, item.chunkIndex) == ESP_OK)) {
+                        break;
+                    }
+                }
+            }
         }
     }
 
     // check if power went out while page was being freed
     for (auto it = begin(); it!= end(); ++it) {
         if (it->state() == Page::PageState::FREEING) {
-            Page* newPage = &mPageList.back();
-            if (newPage->state() == Page::PageState::ACTIVE) {
-                auto err = newPage->erase();
+            if (mFreePageList.empty()) {
+                // requestNewPage took the reserved page, it only holds copies of the items of this page
+                Page* newPage = &mPageList.back();
+                if (newPage->state() == Page::PageState::ACTIVE) {
+                    auto err = newPage->erase();
+                    if (err != ESP_OK) {
+                        return err;
+                    }
+                    mPageList.erase(newPage);
+                    mFreePageList.push_back(newPage);
+                }
+            } else {
+                // collectGarbage erases each item after copying it to the active page, which also gets
+                // new values. An item found on another page is either the copy or was written afterwards.
+                itemIndex = 0;
+                while (it->findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+                    size_t span = item.span;
+                    for (auto other = begin(); other != end(); ++other) {
+                        if (other != it && other->findItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) == ESP_OK) {
+                            err = it->eraseEntryAndSpan(itemIndex);
+                            if (err != ESP_OK) {
+                                return err;
+                            }
+                            break;
+                        }
+                    }
+                    itemIndex += span;
+                }
+            }
+
+            size_t movedEntries;
+            while ((err = it->moveItems(back(), Page::ENTRY_COUNT, movedEntries)) == ESP_ERR_NVS_PAGE_FULL) {
+                if (back().state() == Page::PageState::ACTIVE) {
+                    err = back().markFull();
+                    if (err != ESP_OK) {
+                        return err;
+                    }
+                }
+                err = activatePage();
                 if (err != ESP_OK) {
                     return err;
                 }
-                mPageList.erase(newPage);
-                mFreePageList.push_back(newPage);
             }
-            auto err = activatePage();
             if (err != ESP_OK) {
                 return err;
             }
-            newPage = &mPageList.back();
-
-            err = it->copyItems(*newPage);
-            if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-                return err;
-            }
 
             err = it->erase();
             if (err != ESP_OK) {
@@ -132,6 +203,16 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
     return ESP_OK;
 }
 
+bool PageManager::itemsLoaded()
+{
+    if (!mItemsLoaded) {
+        mItemsLoaded = std::all_of(begin(), end(), [](const Page& page) -> bool {
+            return page.itemsLoaded();
+        });
+    }
+    return mItemsLoaded;
+}
+
 esp_err_t PageManager::requestNewPage()
 {
     if (mFreePageList.empty()) {
@@ -143,20 +224,16 @@ esp_err_t PageManager::requestNewPage()
         return activatePage();
     }
 
-    // find the page with the highest number of erased items
-    TPageListIterator maxUnusedItemsPageIt;
-    size_t maxUnusedItems = 0;
-    for (auto it = begin(); it != end(); ++it) {
-
-        auto unused =  Page::ENTRY_COUNT - it->getUsedEntryCount();
-        if (unused > maxUnusedItems) {
-            maxUnusedItemsPageIt = it;
-            maxUnusedItems = unused;
+    // a page which collectGarbage started to free has to be freed first,
+    // its items always fit into the new page
+    Page* erasedPage = mFreeingPage;
+    if (erasedPage == nullptr) {
+        // prefer pages which are not pinned by zero-copy reads
+        auto it = findPageToFree(end(), true);
+        if (it == end()) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
         }
-    }
-
-    if (maxUnusedItems == 0) {
-        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        erasedPage = it;
     }
 
     esp_err_t err = activatePage();
@@ -164,16 +241,45 @@ esp_err_t PageManager::requestNewPage()
         return err;
     }
 
-    Page* newPage = &mPageList.back();
+    return freePage(erasedPage, &mPageList.back());
+}
 
-    Page* erasedPage = maxUnusedItemsPageIt;
+PageManager::TPageListIterator PageManager::findPageToFree(TPageListIterator last, bool allowPinned)
+{
+    // find the page with the highest number of erased items
+    TPageListIterator maxUnusedItemsPageIt = end();
+    size_t maxUnusedItems = 0;
+    bool maxUnusedItemsPinned = true;
+    for (auto it = begin(); it != last; ++it) {
 
+        auto unused =  Page::ENTRY_COUNT - it->getUsedEntryCount();
+        if (unused == 0) {
+            continue;
+        }
+        bool pinned = it->isPinned();
+        if (pinned && !allowPinned) {
+            continue;
+        }
+        if ((maxUnusedItemsPinned && !pinned) || (pinned == maxUnusedItemsPinned && unused > maxUnusedItems)) {
+            maxUnusedItemsPageIt = it;
+            maxUnusedItems = unused;
+            maxUnusedItemsPinned = pinned;
+        }
+    }
+    return maxUnusedItemsPageIt;
+}
+
+esp_err_t PageManager::freePage(Page* erasedPage, Page* newPage)
+{
 #ifndef NDEBUG
     size_t usedEntries = erasedPage->getUsedEntryCount();
 #endif
-    err = erasedPage->markFreeing();
-    if (err != ESP_OK) {
-        return err;
+    esp_err_t err;
+    if (erasedPage->state() != Page::PageState::FREEING) {
+        err = erasedPage->markFreeing();
+        if (err != ESP_OK) {
+            return err;
+        }
     }
     err = erasedPage->copyItems(*newPage);
     if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
@@ -189,12 +295,69 @@ esp_err_t PageManager::requestNewPage()
     NVS_ASSERT_OR_RETURN(usedEntries == newPage->getUsedEntryCount(), ESP_FAIL);
 #endif
 
-    mPageList.erase(maxUnusedItemsPageIt);
+    if (erasedPage == mFreeingPage) {
+        mFreeingPage = nullptr;
+    }
+    mPageList.erase(erasedPage);
     mFreePageList.push_back(erasedPage);
 
     return ESP_OK;
 }
 
+esp_err_t PageManager::collectGarbage(size_t maxEntries)
+{
+    esp_err_t err;
+    if (mFreeingPage == nullptr) {
+        if (mFreePageList.size() >= 2) {
+            return ESP_OK;
+        }
+        // the active page receives the items, pinned pages are left to requestNewPage
+        auto it = findPageToFree(TPageListIterator(&back()), false);
+        if (it == end()) {
+            return ESP_OK;
+        }
+        // the page with the most erased entries has the fewest items. If they don't fit into the active page,
+        // requestNewPage would take the reserved page for them and the round would end with one free page again.
+        if (it->getUsedEntryCount() > back().getFreeEntryCount()) {
+            return ESP_OK;
+        }
+        err = it->markFreeing();
+        if (err != ESP_OK) {
+            return err;
+        }
+        mFreeingPage = it;
+    }
+
+    if (mFreeingPage->getUsedEntryCount() == 0) {
+        // erasing the page takes a step of its own
+        err = mFreeingPage->erase();
+        if (err != ESP_OK) {
+            return err;
+        }
+        mPageList.erase(mFreeingPage);
+        mFreePageList.push_back(mFreeingPage);
+        mFreeingPage = nullptr;
+        return (mFreePageList.size() >= 2) ? ESP_OK : ESP_ERR_NOT_FINISHED;
+    }
+
+    size_t movedEntries;
+    err = mFreeingPage->moveItems(back(), maxEntries, movedEntries);
+    if (err == ESP_ERR_NVS_PAGE_FULL) {
+        if (back().state() == Page::PageState::ACTIVE) {
+            err = back().markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        // takes a spare page, or frees mFreeingPage right away if only the reserved page is left
+        err = requestNewPage();
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    return ESP_ERR_NOT_FINISHED;
+}
+
 esp_err_t PageManager::activatePage()
 {
     if (mFreePageList.empty()) {
@@ -18,6 +18,7 @@
 #include <list>
 #include "nvs_types.hpp"
 #include "nvs_page.hpp"
+#include "nvs_item_index.hpp"
 #include "partition.hpp"
 #include "intrusive_list.h"
 
@@ -29,9 +30,19 @@ class PageManager
     using TPageListIterator = TPageList::iterator;
 public:
 
+#if CONFIG_NVS_LAZY_LOAD
+    static const bool DEFAULT_LAZY_LOAD = true;
+#else
+    static const bool DEFAULT_LAZY_LOAD = false;
+#endif
+
     PageManager() {}
 
-    esp_err_t load(Partition *partition, uint32_t baseSector, uint32_t sectorCount);
+    /**
+     * With lazy set, only the headers and entry state tables of full pages are read.
+     * Their items are loaded on first access, see Page::load.
+     */
+    esp_err_t load(Partition *partition, uint32_t baseSector, uint32_t sectorCount, size_t indexMaxSize = ItemIndex::DEFAULT_MAX_SIZE, bool lazy = DEFAULT_LAZY_LOAD);
 
     TPageListIterator begin()
     {
@@ -54,6 +65,20 @@ public:
 
     esp_err_t requestNewPage();
 
+    /**
+     * Does a bounded step of the work requestNewPage would do once only the reserved free page is left:
+     * moves at most about maxEntries entries from the page with the most erased entries to the active page,
+     * or erases the page once it is empty. Keeps two free pages available, so that requestNewPage
+     * doesn't need to copy and erase a page while a value is written.
+     *
+     * A page is only freed if its items fit into the active page, so the steps end once the data is too
+     * dense to get a second free page. Writes running between the steps can still fill up the active page,
+     * then requestNewPage finishes freeing the page and the next step starts over.
+     *
+     * Returns ESP_OK if no garbage collection is needed or possible, ESP_ERR_NOT_FINISHED if more steps are needed.
+     */
+    esp_err_t collectGarbage(size_t maxEntries);
+
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
     uint32_t getBaseSector()
@@ -61,14 +86,39 @@ public:
         return mBaseSector;
     }
 
+    const ItemIndex& getItemIndex() const
+    {
+        return mItemIndex;
+    }
+
+    /**
+     * Whether the items of all pages have been loaded. Only then the item index is complete.
+     */
+    bool itemsLoaded();
+
 protected:
     friend class Iterator;
 
     esp_err_t activatePage();
 
+    /**
+     * Returns the page in [begin, last) with the most erased entries, preferring pages which aren't pinned.
+     * Returns end() if no page has erased entries.
+     */
+    TPageListIterator findPageToFree(TPageListIterator last, bool allowPinned);
+
+    /**
+     * Copies the items of erasedPage to newPage and erases it.
+     */
+    esp_err_t freePage(Page* erasedPage, Page* newPage);
+
     TPageList mPageList;
     TPageList mFreePageList;
+    ItemIndex mItemIndex;
     std::unique_ptr<Page[]> mPages;
+    std::unique_ptr<Page::NewerItems> mNewerItems;
+    bool mItemsLoaded = true;
+    Page* mFreeingPage = nullptr;
     uint32_t mBaseSector;
     uint32_t mPageCount;
     uint32_t mSeqNumber;
@@ -71,4 +71,14 @@ bool NVSPartition::get_readonly()
     return mESPPartition->readonly;
 }
 
+esp_err_t NVSPartition::mmap(size_t src_offset, size_t size, const void** out_ptr, esp_partition_mmap_handle_t* out_handle)
+{
+    return esp_partition_mmap(mESPPartition, src_offset, size, ESP_PARTITION_MMAP_DATA, out_ptr, out_handle);
+}
+
+void NVSPartition::munmap(esp_partition_mmap_handle_t handle)
+{
+    esp_partition_munmap(handle);
+}
+
 } // nvs
@@ -104,6 +104,17 @@ public:
      */
     bool get_readonly() override;
 
+    /**
+     * Look into \c esp_partition_mmap for more details.
+     *
+     * @return
+     *      - ESP_OK on success
+     *      - error codes from the esp_partition API
+     */
+    esp_err_t mmap(size_t src_offset, size_t size, const void** out_ptr, esp_partition_mmap_handle_t* out_handle) override;
+
+    void munmap(esp_partition_mmap_handle_t handle) override;
+
 protected:
     const esp_partition_t* mESPPartition;
 };
@@ -229,6 +229,18 @@ size_t NVSPartitionManager::open_handles_size()
     return nvs_handles.size();
 }
 
+esp_err_t NVSPartitionManager::collect_garbage(size_t budget)
+{
+    esp_err_t result = ESP_OK;
+    for (auto it = nvs_storage_list.begin(); it != nvs_storage_list.end(); ++it) {
+        esp_err_t err = it->collectGarbage(budget);
+        if (err != ESP_OK && result != ESP_ERR_NOT_FINISHED) {
+            result = err;
+        }
+    }
+    return result;
+}
+
 Storage* NVSPartitionManager::lookup_storage_from_name(const char* name)
 {
     auto it = find_if(begin(nvs_storage_list), end(nvs_storage_list), [=](Storage& e) -> bool {
@@ -36,6 +36,12 @@ public:
 
     size_t open_handles_size();
 
+    /**
+     * Does a garbage collection step on every initialized partition, see Storage::collectGarbage.
+     * Returns ESP_ERR_NOT_FINISHED if any partition needs more steps.
+     */
+    esp_err_t collect_garbage(size_t budget);
+
 protected:
     NVSPartitionManager() { }
 
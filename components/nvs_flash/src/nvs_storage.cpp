@@ -40,6 +40,7 @@ namespace nvs
 
 Storage::~Storage()
 {
+    invalidateLeases();
     clearNamespaces();
 }
 
@@ -179,15 +180,13 @@ void Storage::eraseOrphanDataBlobs(TBlobIndexList& blobIdxList)
     }
 }
 
-esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
+esp_err_t Storage::loadNamespaces()
 {
-    auto err = mPageManager.load(mPartition, baseSector, sectorCount);
-    if (err != ESP_OK) {
-        mState = StorageState::INVALID;
-        return err;
+    if (mNamespacesLoaded) {
+        return ESP_OK;
     }
 
-    // load namespaces list
+    // namespaces found by createOrOpenNamespace before are listed again
     clearNamespaces();
     std::fill_n(mNamespaceUsage.data(), mNamespaceUsage.byteSize() / 4, 0);
     for (auto it = mPageManager.begin(); it != mPageManager.end(); ++it) {
@@ -198,12 +197,11 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
             NamespaceEntry* entry = new (std::nothrow) NamespaceEntry;
 
             if (!entry) {
-                mState = StorageState::INVALID;
                 return ESP_ERR_NO_MEM;
             }
 
             item.getKey(entry->mName, sizeof(entry->mName));
-            err = item.getValue(entry->mIndex);
+            auto err = item.getValue(entry->mIndex);
             if (err != ESP_OK) {
                 delete entry;
                 return err;
@@ -222,12 +220,21 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
     if (mNamespaceUsage.set(255, true) != ESP_OK) {
         return ESP_FAIL;
     }
+    mNamespacesLoaded = true;
+    return ESP_OK;
+}
+
+esp_err_t Storage::checkBlobIndices()
+{
+    if (mBlobIndicesChecked) {
+        return ESP_OK;
+    }
 
     // Populate list of multi-page index entries.
     TBlobIndexList blobIdxList;
-    err = populateBlobIndices(blobIdxList);
+    auto err = populateBlobIndices(blobIdxList);
     if (err != ESP_OK) {
-        mState = StorageState::INVALID;
+        blobIdxList.clearAndFreeNodes();
         return ESP_ERR_NO_MEM;
     }
 
@@ -240,6 +247,41 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
     // Purge the blob index list
     blobIdxList.clearAndFreeNodes();
 
+    mBlobIndicesChecked = true;
+    return ESP_OK;
+}
+
+esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount, size_t indexMaxSize, bool lazy)
+{
+    // leases point to the pages about to be reloaded
+    invalidateLeases();
+
+    mNamespacesLoaded = false;
+    mBlobIndicesChecked = false;
+    clearNamespaces();
+    std::fill_n(mNamespaceUsage.data(), mNamespaceUsage.byteSize() / 4, 0);
+
+    auto err = mPageManager.load(mPartition, baseSector, sectorCount, indexMaxSize, lazy);
+    if (err != ESP_OK) {
+        mState = StorageState::INVALID;
+        return err;
+    }
+
+    // both have to visit every page, which lazy loading is meant to avoid
+    if (!lazy) {
+        err = loadNamespaces();
+        if (err != ESP_OK) {
+            mState = StorageState::INVALID;
+            return err;
+        }
+
+        err = checkBlobIndices();
+        if (err != ESP_OK) {
+            mState = StorageState::INVALID;
+            return err;
+        }
+    }
+
     mState = StorageState::ACTIVE;
 
 #ifdef DEBUG_STORAGE
@@ -255,8 +297,20 @@ bool Storage::isValid() const
 
 esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
 {
+    size_t itemIndex;
+    return findItem(nsIndex, datatype, key, page, itemIndex, item, chunkIdx, chunkStart);
+}
+
+esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, size_t& itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    // the index lacks the items of pages which have not been loaded yet
+    if (mPageManager.getItemIndex().isActive() && ItemIndex::canLookup(nsIndex, datatype, key, chunkIdx)
+            && mPageManager.itemsLoaded()) {
+        return findIndexedItem(nsIndex, datatype, key, page, itemIndex, item, chunkIdx, chunkStart);
+    }
+
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
-        size_t itemIndex = 0;
+        itemIndex = 0;
         auto err = it->findItem(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart);
         if (err == ESP_OK) {
             page = it;
@@ -266,6 +320,46 @@ esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key,
     return ESP_ERR_NVS_NOT_FOUND;
 }
 
+// Only visits the pages the key index lists for the key. If several pages hold a match,
+// the oldest one wins, which is the page the linear scan in findItem would have returned.
+esp_err_t Storage::findIndexedItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, size_t& itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    const ItemIndex& index = mPageManager.getItemIndex();
+    Page* foundPage = nullptr;
+    uint32_t foundSeqNumber = UINT32_MAX;
+    size_t foundItemIndex = SIZE_MAX;
+
+    const ItemIndex::Node* next;
+    for (auto node = index.find(nsIndex, key, chunkIdx); node != nullptr; node = next) {
+        // Page::findItem may erase corrupted entries, so fetch the next candidate beforehand
+        next = index.findNext(node);
+        Page* candidate = node->page();
+        size_t itemIndex = node->index();
+        uint32_t seqNumber;
+        if (candidate->getSeqNumber(seqNumber) != ESP_OK || seqNumber > foundSeqNumber) {
+            continue;
+        }
+        Item candidateItem;
+        if (candidate->findItem(nsIndex, datatype, key, itemIndex, candidateItem, chunkIdx, chunkStart) != ESP_OK) {
+            continue;
+        }
+        if (candidate == foundPage && itemIndex >= foundItemIndex) {
+            continue;
+        }
+        foundPage = candidate;
+        foundSeqNumber = seqNumber;
+        foundItemIndex = itemIndex;
+        item = candidateItem;
+    }
+
+    if (foundPage == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    page = foundPage;
+    itemIndex = foundItemIndex;
+    return ESP_OK;
+}
+
 esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart)
 {
     uint8_t chunkCount = 0;
@@ -383,6 +477,11 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
 
     esp_err_t err;
     if (datatype == ItemType::BLOB) {
+        // chunks left over by an interrupted blob write could collide with the new ones
+        err = checkBlobIndices();
+        if (err != ESP_OK) {
+            return err;
+        }
         err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
         if(err == ESP_OK) {
             matchedTypePageFound = true;
@@ -526,6 +625,156 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
     return ESP_OK;
 }
 
+esp_err_t Storage::writeItems(uint8_t nsIndex, Transaction& transaction)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    esp_err_t err;
+    for (auto it = transaction.begin(); it != transaction.end(); ++it) {
+        if (it->isErased()) {
+            err = eraseItem(nsIndex, ItemType::ANY, it->key());
+            if (err == ESP_ERR_NVS_NOT_FOUND) {
+                err = ESP_OK;
+            }
+        } else if (it->datatype() == ItemType::BLOB) {
+            err = writeItem(nsIndex, ItemType::BLOB, it->key(), it->data(), it->dataSize());
+        } else {
+            continue;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    Page::BatchItem items[Page::BATCH_MAX_ITEMS];
+    SupersededItem superseded[Page::BATCH_MAX_ITEMS];
+    size_t count = 0;
+    size_t entryCount = 0;
+    for (auto it = transaction.begin(); it != transaction.end(); ) {
+        const ItemType datatype = it->datatype();
+        if (it->isErased() || datatype == ItemType::BLOB) {
+            ++it;
+            continue;
+        }
+
+        Page* findPage = nullptr;
+        size_t itemIndex = 0;
+        Item item;
+#ifdef CONFIG_NVS_LEGACY_DUP_KEYS_COMPATIBILITY
+        err = findItem(nsIndex, datatype, it->key(), findPage, itemIndex, item);
+#else
+        err = findItem(nsIndex, ItemType::ANY, it->key(), findPage, itemIndex, item);
+#endif
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            return err;
+        }
+
+        if (err == ESP_OK) {
+            if (item.datatype == ItemType::BLOB || item.datatype == ItemType::BLOB_IDX || item.datatype == ItemType::BLOB_DATA) {
+                // replacing a blob touches several items, leave it to writeItem
+                err = flushItems(nsIndex, items, superseded, count);
+                if (err != ESP_OK) {
+                    return err;
+                }
+                count = 0;
+                entryCount = 0;
+                err = writeItem(nsIndex, datatype, it->key(), it->data(), it->dataSize());
+                if (err != ESP_OK) {
+                    return err;
+                }
+                ++it;
+                continue;
+            }
+            if (item.datatype == datatype &&
+                    findPage->cmpItem(nsIndex, datatype, it->key(), it->data(), it->dataSize()) == ESP_OK) {
+                ++it;
+                continue;
+            }
+        }
+
+        const size_t itemEntryCount = Page::getEntryCount(datatype, it->dataSize());
+        if (itemEntryCount > Page::ENTRY_COUNT) {
+            return ESP_ERR_NVS_VALUE_TOO_LONG;
+        }
+
+        Page& page = getCurrentPage();
+        if (page.state() == Page::PageState::INVALID) {
+            return ESP_ERR_NVS_INVALID_STATE;
+        }
+        if (count == Page::BATCH_MAX_ITEMS || entryCount + itemEntryCount > page.getFreeEntryCount()) {
+            // Flush what we have, or move on to a new page if the batch is empty. Either way
+            // look up the current item again, the new page may have been filled by garbage collection.
+            if (count > 0) {
+                err = flushItems(nsIndex, items, superseded, count);
+                count = 0;
+                entryCount = 0;
+            } else {
+                if (page.state() != Page::PageState::FULL) {
+                    err = page.markFull();
+                    if (err != ESP_OK) {
+                        return err;
+                    }
+                }
+                err = mPageManager.requestNewPage();
+            }
+            if (err != ESP_OK) {
+                return err;
+            }
+            continue;
+        }
+
+        items[count] = {datatype, it->key(), it->data(), it->dataSize()};
+        superseded[count] = {findPage, itemIndex};
+        ++count;
+        entryCount += itemEntryCount;
+        ++it;
+    }
+
+    err = flushItems(nsIndex, items, superseded, count);
+#ifdef DEBUG_STORAGE
+    debugCheck();
+#endif
+    return err;
+}
+
+esp_err_t Storage::flushItems(uint8_t nsIndex, const Page::BatchItem* items, SupersededItem* superseded, size_t count)
+{
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    auto err = getCurrentPage().writeItems(nsIndex, items, count);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Remove the previous versions, with a single entry state table update per page
+    size_t indices[Page::BATCH_MAX_ITEMS];
+    for (size_t i = 0; i < count; ++i) {
+        Page* page = superseded[i].page;
+        if (page == nullptr) {
+            continue;
+        }
+        size_t indexCount = 0;
+        for (size_t j = i; j < count; ++j) {
+            if (superseded[j].page == page) {
+                indices[indexCount++] = superseded[j].index;
+                superseded[j].page = nullptr;
+            }
+        }
+        err = page->eraseEntries(indices, indexCount);
+        if (err == ESP_ERR_FLASH_OP_FAIL) {
+            return ESP_ERR_NVS_REMOVE_FAILED;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
 esp_err_t Storage::createOrOpenNamespace(const char* nsName, bool canCreate, uint8_t& nsIndex)
 {
     if (mState != StorageState::ACTIVE) {
@@ -534,6 +783,31 @@ esp_err_t Storage::createOrOpenNamespace(const char* nsName, bool canCreate, uin
     auto it = std::find_if(mNamespaces.begin(), mNamespaces.end(), [=] (const NamespaceEntry& e) -> bool {
         return strncmp(nsName, e.mName, sizeof(e.mName) - 1) == 0;
     });
+    if (it == std::end(mNamespaces) && !mNamespacesLoaded) {
+        // look up just this namespace, only the pages up to the one holding it are loaded
+        Page* findPage;
+        Item item;
+        NamespaceEntry* entry = nullptr;
+        if (findItem(Page::NS_INDEX, ItemType::U8, nsName, findPage, item) == ESP_OK) {
+            entry = new (std::nothrow) NamespaceEntry;
+            if (!entry) {
+                return ESP_ERR_NO_MEM;
+            }
+            item.getKey(entry->mName, sizeof(entry->mName));
+            if (item.getValue(entry->mIndex) != ESP_OK || mNamespaceUsage.set(entry->mIndex, true) != ESP_OK) {
+                delete entry;
+                return ESP_FAIL;
+            }
+            mNamespaces.push_back(entry);
+            it = entry;
+        } else if (canCreate) {
+            // a new namespace needs the indices of all existing ones
+            auto err = loadNamespaces();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
     if (it == std::end(mNamespaces)) {
         if (!canCreate) {
             return ESP_ERR_NVS_NOT_FOUND;
@@ -827,6 +1101,197 @@ esp_err_t Storage::findKey(const uint8_t nsIndex, const char* key, ItemType* dat
     return err;
 }
 
+esp_err_t Storage::readItemSpans(uint8_t nsIndex, ItemType datatype, const char* key, nvs_span_t* spans, size_t& spanCount, size_t& dataSize, nvs_opaque_lease_t** lease)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    Page* findPage = nullptr;
+    size_t itemIndex = 0;
+    Item item;
+    size_t chunkCount = 1;
+    VerOffset chunkStart = VerOffset::VER_ANY;
+    bool multiPage = false;
+    esp_err_t err;
+    if (datatype == ItemType::BLOB) {
+        err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, itemIndex, item);
+        if (err == ESP_OK) {
+            multiPage = true;
+            chunkCount = item.blobIndex.chunkCount;
+            chunkStart = item.blobIndex.chunkStart;
+            dataSize = item.blobIndex.dataSize;
+        } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+            /* Blob stored in the format without index */
+            err = findItem(nsIndex, ItemType::BLOB, key, findPage, itemIndex, item);
+        }
+    } else {
+        err = findItem(nsIndex, datatype, key, findPage, itemIndex, item);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!multiPage) {
+        dataSize = item.varLength.dataSize;
+    }
+
+    if (spans == nullptr || spanCount < chunkCount) {
+        spanCount = chunkCount;
+        return (spans == nullptr) ? ESP_OK : ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    spanCount = chunkCount;
+
+    err = mapPartition();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_opaque_lease_t* newLease = new (std::nothrow) nvs_opaque_lease_t;
+    if (newLease) {
+        newLease->pins = new (std::nothrow) nvs_opaque_lease_t::Pin[chunkCount ? chunkCount : 1];
+    }
+    if (!newLease || !newLease->pins) {
+        delete newLease;
+        if (mLeases.empty()) {
+            unmapPartition();
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t offset = 0;
+    for (size_t chunkNum = 0; chunkNum < chunkCount; ++chunkNum) {
+        if (multiPage) {
+            err = findItem(nsIndex, ItemType::BLOB_DATA, key, findPage, itemIndex, item, static_cast<uint8_t> (chunkStart) + chunkNum);
+            if (err != ESP_OK) {
+                break;
+            }
+            if (item.varLength.dataSize > dataSize - offset) {
+                /* The size of the entry in the index is inconsistent with the sum of the sizes of chunks */
+                err = ESP_ERR_NVS_INVALID_LENGTH;
+                break;
+            }
+        }
+        err = getItemSpan(*findPage, itemIndex, item, spans[chunkNum]);
+        if (err != ESP_OK) {
+            break;
+        }
+        newLease->pins[chunkNum] = {findPage, findPage->getEraseGeneration()};
+        offset += spans[chunkNum].size;
+    }
+    if (err == ESP_OK && multiPage && offset != dataSize) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    if (err != ESP_OK) {
+        delete newLease;
+        if (mLeases.empty()) {
+            unmapPartition();
+        }
+        if (multiPage && (err == ESP_ERR_NVS_NOT_FOUND || err == ESP_ERR_NVS_INVALID_LENGTH)) {
+            // cleanup if a chunk is not found or the size is inconsistent, same as readMultiPageBlob
+            eraseMultiPageBlob(nsIndex, key);
+        }
+        return err;
+    }
+
+    for (size_t i = 0; i < chunkCount; ++i) {
+        newLease->pins[i].page->pin();
+    }
+    newLease->pinCount = chunkCount;
+    newLease->storage = this;
+    mLeases.push_back(newLease);
+    *lease = newLease;
+    return ESP_OK;
+}
+
+esp_err_t Storage::getItemSpan(Page& page, size_t itemIndex, const Item& item, nvs_span_t& span)
+{
+    const size_t dataSize = item.varLength.dataSize;
+    if (Page::getEntryCount(item.datatype, dataSize) > item.span) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    uint32_t address;
+    auto err = page.getEntryAddress(itemIndex, &address);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // data starts right after the item header
+    span.data = mMappedData + (address + Page::ENTRY_SIZE - mMappedOffset);
+    span.size = dataSize;
+
+    if (Item::calculateCrc32(static_cast<const uint8_t*>(span.data), dataSize) != item.varLength.dataCrc32) {
+        err = page.eraseEntryAndSpan(itemIndex);
+        if (err != ESP_OK) {
+            return err;
+        }
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::mapPartition()
+{
+    if (mMappedData) {
+        return ESP_OK;
+    }
+
+    const void* ptr;
+    const uint32_t offset = mPageManager.getBaseSector() * SPI_FLASH_SEC_SIZE;
+    auto err = mPartition->mmap(offset, mPageManager.getPageCount() * SPI_FLASH_SEC_SIZE, &ptr, &mMapHandle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    mMappedData = static_cast<const uint8_t*>(ptr);
+    mMappedOffset = offset;
+    return ESP_OK;
+}
+
+void Storage::unmapPartition()
+{
+    if (mMappedData) {
+        mPartition->munmap(mMapHandle);
+        mMappedData = nullptr;
+    }
+}
+
+void Storage::invalidateLeases()
+{
+    for (auto it = mLeases.begin(); it != mLeases.end(); ++it) {
+        it->storage = nullptr;
+    }
+    mLeases.clear();
+    unmapPartition();
+}
+
+bool Storage::isLeaseValid(const nvs_opaque_lease_t* lease)
+{
+    if (lease->storage == nullptr) {
+        return false;
+    }
+    for (size_t i = 0; i < lease->pinCount; ++i) {
+        if (lease->pins[i].page->getEraseGeneration() != lease->pins[i].eraseGeneration) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Storage::releaseLease(nvs_opaque_lease_t* lease)
+{
+    Storage* storage = lease->storage;
+    if (storage) {
+        for (size_t i = 0; i < lease->pinCount; ++i) {
+            lease->pins[i].page->unpin();
+        }
+        storage->mLeases.erase(lease);
+        if (storage->mLeases.empty()) {
+            storage->unmapPartition();
+        }
+    }
+    delete lease;
+}
+
 esp_err_t Storage::getItemDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize)
 {
     if (mState != StorageState::ACTIVE) {
@@ -888,10 +1353,22 @@ void Storage::debugCheck()
 
 esp_err_t Storage::fillStats(nvs_stats_t& nvsStats)
 {
+    auto err = loadNamespaces();
+    if (err != ESP_OK) {
+        return err;
+    }
     nvsStats.namespace_count = mNamespaces.size();
     return mPageManager.fillStats(nvsStats);
 }
 
+esp_err_t Storage::collectGarbage(size_t maxEntries)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    return mPageManager.collectGarbage(maxEntries);
+}
+
 esp_err_t Storage::calcEntriesInNamespace(uint8_t nsIndex, size_t& usedEntries)
 {
     usedEntries = 0;
@@ -935,6 +1412,11 @@ void Storage::fillEntryInfo(Item &item, nvs_entry_info_t &info)
 
 bool Storage::findEntry(nvs_opaque_iterator_t* it, const char* namespace_name)
 {
+    // entries are reported with the name of their namespace
+    if (loadNamespaces() != ESP_OK) {
+        return false;
+    }
+
     it->entryIndex = 0;
     it->nsIndex = Page::NS_ANY;
     it->page = mPageManager.begin();
@@ -950,6 +1432,10 @@ bool Storage::findEntry(nvs_opaque_iterator_t* it, const char* namespace_name)
 
 bool Storage::findEntryNs(nvs_opaque_iterator_t* it, uint8_t nsIndex)
 {
+    if (loadNamespaces() != ESP_OK) {
+        return false;
+    }
+
     it->entryIndex = 0;
     it->nsIndex = nsIndex;
     it->page = mPageManager.begin();
@@ -13,11 +13,34 @@
 #include "nvs_types.hpp"
 #include "nvs_page.hpp"
 #include "nvs_pagemanager.hpp"
+#include "nvs_transaction.hpp"
 #include "nvs_memory_management.hpp"
 #include "partition.hpp"
 
 //extern void dumpBytes(const uint8_t* data, size_t count);
 
+namespace nvs
+{
+class Storage;
+}
+
+struct nvs_opaque_lease_t : public intrusive_list_node<nvs_opaque_lease_t>, public ExceptionlessAllocatable
+{
+    struct Pin {
+        nvs::Page* page;
+        uint32_t eraseGeneration;
+    };
+
+    ~nvs_opaque_lease_t()
+    {
+        delete[] pins;
+    }
+
+    nvs::Storage *storage = nullptr; // nullptr once the storage is gone
+    size_t pinCount = 0;
+    Pin *pins = nullptr;
+};
+
 namespace nvs
 {
 
@@ -55,6 +78,8 @@ class Storage : public intrusive_list_node<Storage>, public ExceptionlessAllocat
 
     typedef intrusive_list<BlobIndexNode> TBlobIndexList;
 
+    typedef intrusive_list<nvs_opaque_lease_t> TLeaseList;
+
 public:
     ~Storage();
 
@@ -64,7 +89,11 @@ public:
         }
     };
 
-    esp_err_t init(uint32_t baseSector, uint32_t sectorCount);
+    /**
+     * With lazy set, items of full pages are loaded on first access. The namespace list and the
+     * consistency check of multi-page blobs are then deferred until they are needed.
+     */
+    esp_err_t init(uint32_t baseSector, uint32_t sectorCount, size_t indexMaxSize = ItemIndex::DEFAULT_MAX_SIZE, bool lazy = PageManager::DEFAULT_LAZY_LOAD);
 
     bool isValid() const;
 
@@ -74,8 +103,25 @@ public:
 
     esp_err_t readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize);
 
+    /**
+     * Applies all changes staged in transaction. Primitive values and strings are written to the
+     * current page in batches of up to Page::BATCH_MAX_ITEMS items, blobs and erasures are applied one by one.
+     */
+    esp_err_t writeItems(uint8_t nsIndex, Transaction& transaction);
+
     esp_err_t findKey(const uint8_t nsIndex, const char* key, ItemType* datatype);
 
+    /**
+     * Looks up a string (SZ) or blob (BLOB) and returns its data as spans into the memory-mapped partition,
+     * one per blob chunk. If spans is nullptr or spanCount is too small, only spanCount and dataSize are set.
+     * Otherwise a lease pinning the pages holding the data is returned, see releaseLease.
+     */
+    esp_err_t readItemSpans(uint8_t nsIndex, ItemType datatype, const char* key, nvs_span_t* spans, size_t& spanCount, size_t& dataSize, nvs_opaque_lease_t** lease);
+
+    static bool isLeaseValid(const nvs_opaque_lease_t* lease);
+
+    static void releaseLease(nvs_opaque_lease_t* lease);
+
     esp_err_t getItemDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize);
 
     esp_err_t eraseItem(uint8_t nsIndex, ItemType datatype, const char* key);
@@ -114,6 +160,11 @@ public:
         return mPageManager.getBaseSector();
     }
 
+    const ItemIndex& getItemIndex() const
+    {
+        return mPageManager.getItemIndex();
+    }
+
     esp_err_t writeMultiPageBlob(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart);
 
     esp_err_t readMultiPageBlob(uint8_t nsIndex, const char* key, void* data, size_t dataSize);
@@ -128,6 +179,11 @@ public:
 
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
+    /**
+     * One step of incremental garbage collection, see PageManager::collectGarbage.
+     */
+    esp_err_t collectGarbage(size_t maxEntries);
+
     esp_err_t calcEntriesInNamespace(uint8_t nsIndex, size_t& usedEntries);
 
     bool findEntry(nvs_opaque_iterator_t* it, const char* name);
@@ -145,6 +201,10 @@ protected:
 
     void clearNamespaces();
 
+    esp_err_t loadNamespaces();
+
+    esp_err_t checkBlobIndices();
+
     esp_err_t populateBlobIndices(TBlobIndexList&);
 
     void eraseMismatchedBlobIndexes(TBlobIndexList&);
@@ -155,6 +215,25 @@ protected:
 
     esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, size_t& itemIndex, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
+
+    esp_err_t findIndexedItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, size_t& itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart);
+
+    struct SupersededItem {
+        Page* page;
+        size_t index;
+    };
+
+    esp_err_t flushItems(uint8_t nsIndex, const Page::BatchItem* items, SupersededItem* superseded, size_t count);
+
+    esp_err_t getItemSpan(Page& page, size_t itemIndex, const Item& item, nvs_span_t& span);
+
+    esp_err_t mapPartition();
+
+    void unmapPartition();
+
+    void invalidateLeases();
+
 protected:
     Partition *mPartition;
     size_t mPageCount;
@@ -162,6 +241,12 @@ protected:
     TNamespaces mNamespaces;
     CompressedEnumTable<bool, 1, 256> mNamespaceUsage;
     StorageState mState = StorageState::INVALID;
+    bool mNamespacesLoaded = false;
+    bool mBlobIndicesChecked = false;
+    TLeaseList mLeases;
+    const uint8_t* mMappedData = nullptr;
+    uint32_t mMappedOffset = 0;
+    esp_partition_mmap_handle_t mMapHandle = 0;
 };
 
 } // namespace nvs
@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstring>
+#include "nvs_transaction.hpp"
+#include "nvs_page.hpp"
+#if __has_include(<bsd/string.h>)
+// for strlcpy
+#include <bsd/string.h>
+#endif
+
+namespace nvs
+{
+
+Transaction::Entry::~Entry()
+{
+    delete[] mData;
+}
+
+esp_err_t Transaction::Entry::assign(ItemType datatype, const void* data, size_t dataSize)
+{
+    uint8_t* buffer = nullptr;
+    if (isVariableLengthType(datatype)) {
+        // keep a valid pointer for empty blobs
+        buffer = new (std::nothrow) uint8_t[dataSize ? dataSize : 1];
+        if (!buffer) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(buffer, data, dataSize);
+    } else if (datatype != ItemType::ANY) {
+        memcpy(mInlineData, data, dataSize);
+    }
+
+    delete[] mData;
+    mData = buffer;
+    mDatatype = datatype;
+    mDataSize = dataSize;
+    return ESP_OK;
+}
+
+Transaction::~Transaction()
+{
+    clear();
+}
+
+esp_err_t Transaction::set(ItemType datatype, const char* key, const void* data, size_t dataSize)
+{
+    if (strlen(key) > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    if (datatype == ItemType::SZ && dataSize > Page::CHUNK_MAX_SIZE) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+    if ((!isVariableLengthType(datatype)) && dataSize > sizeof(Entry::mInlineData)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    Entry* entry = findOrCreate(key);
+    if (!entry) {
+        return ESP_ERR_NO_MEM;
+    }
+    return entry->assign(datatype, data, dataSize);
+}
+
+esp_err_t Transaction::erase(const char* key)
+{
+    if (strlen(key) > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    Entry* entry = findOrCreate(key);
+    if (!entry) {
+        return ESP_ERR_NO_MEM;
+    }
+    return entry->assign(ItemType::ANY, nullptr, 0);
+}
+
+Transaction::Entry* Transaction::find(const char* key)
+{
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (strncmp(it->mKey, key, Item::MAX_KEY_LENGTH) == 0) {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+Transaction::Entry* Transaction::findOrCreate(const char* key)
+{
+    Entry* entry = find(key);
+    if (entry) {
+        return entry;
+    }
+
+    entry = new (std::nothrow) Entry;
+    if (!entry) {
+        return nullptr;
+    }
+    strlcpy(entry->mKey, key, sizeof(entry->mKey));
+    mEntries.push_back(entry);
+    return entry;
+}
+
+void Transaction::clear()
+{
+    mEntries.clearAndFreeNodes();
+}
+
+} // namespace nvs
@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef nvs_transaction_hpp
+#define nvs_transaction_hpp
+
+#include "nvs.h"
+#include "nvs_types.hpp"
+#include "nvs_memory_management.hpp"
+#include "intrusive_list.h"
+
+namespace nvs
+{
+
+/**
+ * Changes staged in RAM by a handle between begin_transaction and commit.
+ *
+ * Each key is staged at most once: setting or erasing a key which is already staged replaces the staged change.
+ * Storage::writeItems applies all staged changes of a transaction.
+ */
+class Transaction : public ExceptionlessAllocatable
+{
+public:
+    class Entry : public intrusive_list_node<Entry>, public ExceptionlessAllocatable
+    {
+    public:
+        ~Entry();
+
+        const char* key() const
+        {
+            return mKey;
+        }
+
+        /**
+         * Data type of the staged value, ItemType::ANY if the key is staged for erasure.
+         */
+        ItemType datatype() const
+        {
+            return mDatatype;
+        }
+
+        bool isErased() const
+        {
+            return mDatatype == ItemType::ANY;
+        }
+
+        const void* data() const
+        {
+            return isVariableLengthType(mDatatype) ? mData : mInlineData;
+        }
+
+        size_t dataSize() const
+        {
+            return mDataSize;
+        }
+
+    protected:
+        friend class Transaction;
+
+        esp_err_t assign(ItemType datatype, const void* data, size_t dataSize);
+
+        char mKey[Item::MAX_KEY_LENGTH + 1];
+        ItemType mDatatype = ItemType::ANY;
+        size_t mDataSize = 0;
+        uint8_t* mData = nullptr;
+        uint8_t mInlineData[8];
+    };
+
+    typedef intrusive_list<Entry> TEntryList;
+    typedef TEntryList::iterator iterator;
+
+    ~Transaction();
+
+    esp_err_t set(ItemType datatype, const char* key, const void* data, size_t dataSize);
+
+    esp_err_t erase(const char* key);
+
+    /**
+     * Returns the staged change for key, nullptr if the key is not part of the transaction.
+     */
+    Entry* find(const char* key);
+
+    void clear();
+
+    iterator begin()
+    {
+        return mEntries.begin();
+    }
+
+    iterator end()
+    {
+        return mEntries.end();
+    }
+
+protected:
+    Entry* findOrCreate(const char* key);
+
+    TEntryList mEntries;
+}; // class Transaction
+
+} // namespace nvs
+
+#endif /* nvs_transaction_hpp */
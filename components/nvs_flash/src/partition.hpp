@@ -8,6 +8,7 @@
 #define PARTITION_HPP_
 
 #include "esp_err.h"
+#include "esp_partition.h"
 
 namespace nvs {
 
@@ -49,6 +50,17 @@ public:
      * Return true if the partition is read-only.
      */
     virtual bool get_readonly() = 0;
+
+    /**
+     * Map size bytes starting at src_offset into the data address space, see esp_partition_mmap.
+     * Partitions whose content can't be read as is, e.g. encrypted ones, return ESP_ERR_NOT_SUPPORTED.
+     */
+    virtual esp_err_t mmap(size_t src_offset, size_t size, const void** out_ptr, esp_partition_mmap_handle_t* out_handle)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    virtual void munmap(esp_partition_mmap_handle_t handle) { }
 };
 
 } // nvs
@@ -512,14 +512,28 @@ esp_err_t WL_Flash::updateWL()
 }
 
 size_t WL_Flash::calcAddr(size_t addr)
+{
+    size_t run_size;
+    return this->calcAddrRun(addr, &run_size);
+}
+
+/*
+ * The logical address space is rotated by wl_dummy_sec_move_count pages, and the pages from the dummy sector on
+ * are shifted by one page. The mapping is therefore contiguous from the address up to the dummy sector, or up to
+ * the end of the rotated space. run_size returns the number of bytes which are contiguous on flash.
+ */
+size_t WL_Flash::calcAddrRun(size_t addr, size_t *run_size)
 {
     size_t result = (this->flash_size - this->state.wl_dummy_sec_move_count * this->cfg.wl_page_size + addr) % this->flash_size;
     size_t dummy_addr = this->state.wl_dummy_sec_pos * this->cfg.wl_page_size;
     if (result < dummy_addr) {
+        *run_size = dummy_addr - result;
     } else {
+        *run_size = this->flash_size - result;
         result += this->cfg.wl_page_size;
     }
-    ESP_LOGV(TAG, "%s - addr= 0x%08" PRIx32 " -> result= 0x%08" PRIx32 ", dummy_addr= 0x%08" PRIx32 , __func__, (uint32_t) addr, (uint32_t) result, (uint32_t)dummy_addr);
+    ESP_LOGV(TAG, "%s - addr= 0x%08" PRIx32 " -> result= 0x%08" PRIx32 ", dummy_addr= 0x%08" PRIx32 ", run_size= 0x%08" PRIx32,
+             __func__, (uint32_t) addr, (uint32_t) result, (uint32_t)dummy_addr, (uint32_t) *run_size);
     return result;
 }
 
@@ -579,15 +593,18 @@ esp_err_t WL_Flash::write(size_t dest_addr, const void *src, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - dest_addr= 0x%08" PRIx32 ", size= 0x%08" PRIx32 , __func__, (uint32_t) dest_addr, (uint32_t) size);
-    uint32_t count = (size - 1) / this->cfg.wl_page_size;
-    for (size_t i = 0; i < count; i++) {
-        size_t virt_addr = this->calcAddr(dest_addr + i * this->cfg.wl_page_size);
-        result = this->partition->write(this->cfg.wl_partition_start_addr + virt_addr, &((uint8_t *)src)[i * this->cfg.wl_page_size], this->cfg.wl_page_size);
+    // write each run of pages which are contiguous on flash at once
+    size_t done = 0;
+    while (done < size) {
+        size_t run_size;
+        size_t virt_addr = this->calcAddrRun(dest_addr + done, &run_size);
+        if (run_size > size - done) {
+            run_size = size - done;
+        }
+        result = this->partition->write(this->cfg.wl_partition_start_addr + virt_addr, &((uint8_t *)src)[done], run_size);
         WL_RESULT_CHECK(result);
+        done += run_size;
     }
-    size_t virt_addr_last = this->calcAddr(dest_addr + count * this->cfg.wl_page_size);
-    result = this->partition->write(this->cfg.wl_partition_start_addr + virt_addr_last, &((uint8_t *)src)[count * this->cfg.wl_page_size], size - count * this->cfg.wl_page_size);
-    WL_RESULT_CHECK(result);
     return result;
 }
 
@@ -598,16 +615,19 @@ esp_err_t WL_Flash::read(size_t src_addr, void *dest, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - src_addr= 0x%08" PRIx32 ", size= 0x%08" PRIx32 , __func__, (uint32_t) src_addr, (uint32_t) size);
-    uint32_t count = (size - 1) / this->cfg.wl_page_size;
-    for (size_t i = 0; i < count; i++) {
-        size_t virt_addr = this->calcAddr(src_addr + i * this->cfg.wl_page_size);
-        ESP_LOGV(TAG, "%s - real_addr= 0x%08" PRIx32 ", size= 0x%08" PRIx32 , __func__, (uint32_t) (this->cfg.wl_partition_start_addr + virt_addr), (uint32_t) size);
-        result = this->partition->read(this->cfg.wl_partition_start_addr + virt_addr, &((uint8_t *)dest)[i * this->cfg.wl_page_size], this->cfg.wl_page_size);
+    // read each run of pages which are contiguous on flash at once
+    size_t done = 0;
+    while (done < size) {
+        size_t run_size;
+        size_t virt_addr = this->calcAddrRun(src_addr + done, &run_size);
+        if (run_size > size - done) {
+            run_size = size - done;
+        }
+        ESP_LOGV(TAG, "%s - real_addr= 0x%08" PRIx32 ", size= 0x%08" PRIx32 , __func__, (uint32_t) (this->cfg.wl_partition_start_addr + virt_addr), (uint32_t) run_size);
+        result = this->partition->read(this->cfg.wl_partition_start_addr + virt_addr, &((uint8_t *)dest)[done], run_size);
         WL_RESULT_CHECK(result);
+        done += run_size;
     }
-    size_t virt_addr_last = this->calcAddr(src_addr + count * this->cfg.wl_page_size);
-    result = this->partition->read(this->cfg.wl_partition_start_addr + virt_addr_last, &((uint8_t *)dest)[count * this->cfg.wl_page_size], size - count * this->cfg.wl_page_size);
-    WL_RESULT_CHECK(result);
     return result;
 }
 
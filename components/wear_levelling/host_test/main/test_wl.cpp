@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "esp_partition.h"
 #include "esp_private/partition_linux.h"
@@ -421,3 +422,84 @@ TEST_CASE("power down between WL status 1 and WL status 2 update", "[wear_levell
 
     free(tmp_state);
 }
+
+TEST_CASE("multi-sector read and write use one partition operation per contiguous run", "[wear_levelling]")
+{
+    esp_err_t result;
+    wl_handle_t wl_handle;
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    // Disable power down failure counting
+    esp_partition_fail_after(SIZE_MAX, 0);
+
+    result = wl_mount(partition, &wl_handle);
+    REQUIRE(result == ESP_OK);
+
+    size_t sector_size = wl_sector_size(wl_handle);
+    size_t wl_flash_size = wl_size(wl_handle);
+    const size_t chunk_size = 64 * 1024;
+    const size_t chunk_sectors = chunk_size / sector_size;
+    uint8_t *data = (uint8_t *) malloc(wl_flash_size);
+    uint8_t *read_per_sector = (uint8_t *) malloc(chunk_size);
+    uint8_t *read_at_once = (uint8_t *) malloc(chunk_size);
+    REQUIRE(data != NULL);
+    REQUIRE(read_per_sector != NULL);
+    REQUIRE(read_at_once != NULL);
+
+    // Erase and write the partition in chunks a few times, so that the dummy sector moves around
+    for (int round = 0; round < 4; round++) {
+        for (size_t i = 0; i < wl_flash_size; i++) {
+            data[i] = (uint8_t)(i * 7 + i / sector_size + round);
+        }
+        for (size_t addr = 0; addr < wl_flash_size; addr += chunk_size) {
+            size_t size = wl_flash_size - addr < chunk_size ? wl_flash_size - addr : chunk_size;
+            REQUIRE(wl_erase_range(wl_handle, addr, size) == ESP_OK);
+            REQUIRE(wl_write(wl_handle, addr, data + addr, size) == ESP_OK);
+        }
+    }
+
+    // Read 64 kB chunks at every sector offset, one sector per call (as each call used to issue one partition
+    // read per sector) and with a single call, compare the data, the partition read operations and the time
+    size_t ops_per_sector = 0;
+    size_t ops_at_once = 0;
+    clock_t time_per_sector = 0;
+    clock_t time_at_once = 0;
+    size_t chunks = 0;
+    for (size_t addr = 0; addr + chunk_size <= wl_flash_size; addr += sector_size, chunks++) {
+        esp_partition_clear_stats();
+        clock_t start = clock();
+        for (size_t i = 0; i < chunk_sectors; i++) {
+            REQUIRE(wl_read(wl_handle, addr + i * sector_size, read_per_sector + i * sector_size, sector_size) == ESP_OK);
+        }
+        time_per_sector += clock() - start;
+        ops_per_sector += esp_partition_get_read_ops();
+
+        esp_partition_clear_stats();
+        start = clock();
+        REQUIRE(wl_read(wl_handle, addr, read_at_once, chunk_size) == ESP_OK);
+        time_at_once += clock() - start;
+        // the chunk can only be split at the dummy sector and at the end of the rotated address space
+        REQUIRE(esp_partition_get_read_ops() <= 3);
+        ops_at_once += esp_partition_get_read_ops();
+
+        REQUIRE(memcmp(read_per_sector, data + addr, chunk_size) == 0);
+        REQUIRE(memcmp(read_at_once, data + addr, chunk_size) == 0);
+    }
+
+    // Unaligned reads cross the same boundaries
+    REQUIRE(wl_read(wl_handle, 100, read_at_once, chunk_size - 200) == ESP_OK);
+    REQUIRE(memcmp(read_at_once, data + 100, chunk_size - 200) == 0);
+
+    printf("%zu reads of %zu bytes: per sector %zu read ops, %.1f ms; at once %zu read ops, %.1f ms\n",
+           chunks, chunk_size, ops_per_sector, time_per_sector * 1000.0 / CLOCKS_PER_SEC,
+           ops_at_once, time_at_once * 1000.0 / CLOCKS_PER_SEC);
+    REQUIRE(ops_at_once < ops_per_sector);
+
+    result = wl_unmount(wl_handle);
+    REQUIRE(result == ESP_OK);
+
+    free(data);
+    free(read_per_sector);
+    free(read_at_once);
+}